@@ -1,55 +1,90 @@
 #include "AutoKeypress.h"
+#include "Metrics.h"
 
 AutoKeypress::AutoKeypress(KeypressCommands *keypressCommands, QObject *parent)
     : QObject(parent), m_keypressCommands(keypressCommands), m_currentIndex(0), m_isRunning(false)
+    , m_isPaused(false), m_intervalMs(DEFAULT_INTERVAL_MS)
 {
-    connect(&m_timer, &QTimer::timeout, this, &AutoKeypress::pressNextKey);
+    connect(&m_timer, &ClockTimer::timeout, this, &AutoKeypress::pressNextKey);
     initializeSequence();
 }
 
+AutoKeypress::~AutoKeypress()
+{
+    stopSequence();
+}
+
 void AutoKeypress::startSequence()
 {
     if (!m_isRunning) {
+        Metrics::instance().autoSequencesStarted.add();
+        Metrics::instance().autoRunning.add(1);
         m_currentIndex = 0;
         m_isRunning = true;
-        m_timer.start(1000); // 1 second delay between keypresses
+        m_timer.start(m_intervalMs);
         pressNextKey();
     }
 }
 
 void AutoKeypress::stopSequence()
 {
+    if (m_isRunning) {
+        Metrics::instance().autoRunning.add(-1);
+    }
     m_isRunning = false;
+    m_isPaused = false;
     m_timer.stop();
 }
 
+void AutoKeypress::pauseSequence()
+{
+    if (m_isRunning) {
+        m_isPaused = true;
+        m_timer.stop();
+    }
+}
+
+void AutoKeypress::resumeSequence(int rewindSteps)
+{
+    if (m_isRunning && m_isPaused) {
+        m_isPaused = false;
+        m_currentIndex = qMax(0, m_currentIndex - rewindSteps);
+        m_timer.start(m_intervalMs);
+        pressNextKey();
+    }
+}
+
 bool AutoKeypress::isRunning() const
 {
     return m_isRunning;
 }
 
+void AutoKeypress::setSequence(const QVector<QString> &sequence)
+{
+    m_sequence = sequence;
+}
+
+void AutoKeypress::setInterval(int intervalMs)
+{
+    m_intervalMs = qMax(1, intervalMs);
+    if (m_isRunning) {
+        m_timer.setInterval(m_intervalMs);
+    }
+}
+
 void AutoKeypress::pressNextKey()
 {
     if (m_currentIndex < m_sequence.size()) {
         QString key = m_sequence[m_currentIndex];
         emit keyPressed(key);
+        Metrics::instance().autoKeypresses.add();
 
-        if (key == "1") m_keypressCommands->sendKeypress1();
-        else if (key == "2") m_keypressCommands->sendKeypress2();
-        else if (key == "3") m_keypressCommands->sendKeypress3();
-        else if (key == "4") m_keypressCommands->sendKeypress4();
-        else if (key == "5") m_keypressCommands->sendKeypress5();
-        else if (key == "6") m_keypressCommands->sendKeypress6();
-        else if (key == "7") m_keypressCommands->sendKeypress7();
-        else if (key == "8") m_keypressCommands->sendKeypress8();
-        else if (key == "9") m_keypressCommands->sendKeypress9();
-        else if (key == "0") m_keypressCommands->sendKeypress0();
-        else if (key == "*") m_keypressCommands->sendKeypressStar();
-        else if (key == "#") m_keypressCommands->sendKeypressHash();
+        m_keypressCommands->sendKey(key, TxPriority::Automation);
 
         m_currentIndex++;
     } else {
         stopSequence();
+        Metrics::instance().autoSequencesCompleted.add();
         emit sequenceCompleted();
     }
 }
@@ -2,21 +2,34 @@
 #define AUTOKEYPRESS_H
 
 #include <QObject>
-#include <QTimer>
 #include <QVector>
 #include "KeypressCommands.h"
+#include "VirtualClock.h"
 
 class AutoKeypress : public QObject
 {
     Q_OBJECT
 
 public:
+    static const int DEFAULT_INTERVAL_MS = 1000;
+
     explicit AutoKeypress(KeypressCommands *keypressCommands, QObject *parent = nullptr);
+    ~AutoKeypress();
 
     void startSequence();
     void stopSequence();
     bool isRunning() const;
 
+    // Holds the sequence at the current step; resume steps back rewindSteps keys first
+    void pauseSequence();
+    void resumeSequence(int rewindSteps = 0);
+    bool isPaused() const { return m_isPaused; }
+
+    void setSequence(const QVector<QString> &sequence);
+    QVector<QString> sequence() const { return m_sequence; }
+    void setInterval(int intervalMs);
+    int interval() const { return m_intervalMs; }
+
 signals:
     void sequenceCompleted();
     void keyPressed(const QString &key);
@@ -26,10 +39,12 @@ private slots:
 
 private:
     KeypressCommands *m_keypressCommands;
-    QTimer m_timer;
+    ClockTimer m_timer;
     QVector<QString> m_sequence;
     int m_currentIndex;
     bool m_isRunning;
+    bool m_isPaused;
+    int m_intervalMs;
 
     void initializeSequence();
 };
@@ -0,0 +1,282 @@
+#include "BenchBaseline.h"
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+double median(QVector<double> samples)
+{
+    if (samples.isEmpty()) {
+        return 0;
+    }
+    std::sort(samples.begin(), samples.end());
+    const int middle = static_cast<int>(samples.size()) / 2;
+    return samples.size() % 2 ? samples.at(middle) : (samples.at(middle - 1) + samples.at(middle)) / 2;
+}
+
+QString formatValue(double value, const QString &unit)
+{
+    // Distributions are stored in ns; us reads better from 10 us up
+    if (unit == "ns" && value >= 10000) {
+        return QString("%1 us").arg(value / 1000, 0, 'f', 1);
+    }
+    return QString("%1 %2").arg(value, 0, 'f', value < 100 ? 1 : 0).arg(unit);
+}
+
+const char *verdictName(BenchBaseline::Verdict verdict)
+{
+    switch (verdict) {
+    case BenchBaseline::Regression:
+        return "REGRESSION";
+    case BenchBaseline::Improvement:
+        return "improved";
+    case BenchBaseline::Missing:
+        return "missing";
+    case BenchBaseline::Unchanged:
+        break;
+    }
+    return "unchanged";
+}
+
+}
+
+QString BenchBaseline::Comparison::format(const QString &unit) const
+{
+    if (verdict == Missing) {
+        return QString("%1  only in the %2 run")
+               .arg(name, -18).arg(baselineCount > 0 ? QString("baseline") : QString("current"));
+    }
+    return QString("%1  %2 -> %3  %4%5%  p=%6  delta=%7  %8")
+           .arg(name, -18)
+           .arg(formatValue(baselineMedian, unit), 10)
+           .arg(formatValue(currentMedian, unit), -10)
+           .arg(changePercent >= 0 ? QString("+") : QString())
+           .arg(changePercent, 0, 'f', 1)
+           .arg(p, 0, 'g', 2)
+           .arg(effect, 0, 'f', 2)
+           .arg(QString::fromLatin1(verdictName(verdict)));
+}
+
+bool BenchBaseline::save(const QString &fileName, QString *errorMessage) const
+{
+    QJsonObject samples;
+    for (auto it = distributions.constBegin(); it != distributions.constEnd(); ++it) {
+        QJsonArray values;
+        for (double value : it.value()) {
+            values.append(value);
+        }
+        samples.insert(it.key(), values);
+    }
+
+    QJsonObject root;
+    root.insert("format", FORMAT_VERSION);
+    root.insert("tool", tool);
+    root.insert("label", label);
+    root.insert("created", created.toString(Qt::ISODate));
+    root.insert("host", host);
+    root.insert("unit", unit);
+    root.insert("distributions", samples);
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        *errorMessage = QString("Cannot write %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    return true;
+}
+
+bool BenchBaseline::load(const QString &fileName, BenchBaseline *baseline, QString *errorMessage)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *errorMessage = QString("Cannot open %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (document.isNull()) {
+        *errorMessage = QString("%1: %2").arg(fileName, parseError.errorString());
+        return false;
+    }
+
+    const QJsonObject root = document.object();
+    const int format = root.value("format").toInt();
+    if (format < 1 || format > FORMAT_VERSION) {
+        *errorMessage = QString("%1: baseline format %2 is not supported (this build reads up to %3)")
+                        .arg(fileName).arg(format).arg(FORMAT_VERSION);
+        return false;
+    }
+
+    BenchBaseline result;
+    result.tool = root.value("tool").toString();
+    result.label = root.value("label").toString();
+    result.created = QDateTime::fromString(root.value("created").toString(), Qt::ISODate);
+    result.host = root.value("host").toString();
+    result.unit = root.value("unit").toString("ns");
+    const QJsonObject samples = root.value("distributions").toObject();
+    for (auto it = samples.constBegin(); it != samples.constEnd(); ++it) {
+        const QJsonArray values = it.value().toArray();
+        QVector<double> distribution;
+        distribution.reserve(values.size());
+        for (const QJsonValue &value : values) {
+            distribution.append(value.toDouble());
+        }
+        result.distributions.insert(it.key(), distribution);
+    }
+    *baseline = result;
+    return true;
+}
+
+BenchBaseline::Comparison BenchBaseline::compare(const QString &name, const QVector<double> &baseline,
+                                                 const QVector<double> &current, const Options &options)
+{
+    Comparison result;
+    result.name = name;
+    result.baselineCount = static_cast<int>(baseline.size());
+    result.currentCount = static_cast<int>(current.size());
+    if (baseline.isEmpty() || current.isEmpty()) {
+        result.verdict = Missing;
+        return result;
+    }
+    result.baselineMedian = median(baseline);
+    result.currentMedian = median(current);
+    result.changePercent = result.baselineMedian > 0
+        ? (result.currentMedian - result.baselineMedian) * 100.0 / result.baselineMedian : 0;
+
+    // Rank both samples together; tied values share their average rank
+    struct Ranked {
+        double value;
+        bool isCurrent;
+    };
+    QVector<Ranked> all;
+    all.reserve(baseline.size() + current.size());
+    for (double value : baseline) {
+        all.append({value, false});
+    }
+    for (double value : current) {
+        all.append({value, true});
+    }
+    std::sort(all.begin(), all.end(), [](const Ranked &a, const Ranked &b) { return a.value < b.value; });
+
+    const double n1 = baseline.size();
+    const double n2 = current.size();
+    const double n = n1 + n2;
+    double currentRankSum = 0;
+    double tieTerm = 0;                        // Sum of t^3 - t over groups of t tied values
+    for (int i = 0; i < all.size();) {
+        int j = i + 1;
+        while (j < all.size() && all.at(j).value == all.at(i).value) {
+            ++j;
+        }
+        const double averageRank = (i + 1 + j) / 2.0;
+        for (int k = i; k < j; ++k) {
+            if (all.at(k).isCurrent) {
+                currentRankSum += averageRank;
+            }
+        }
+        const double t = j - i;
+        tieTerm += t * t * t - t;
+        i = j;
+    }
+
+    result.u = currentRankSum - n2 * (n2 + 1) / 2;
+    result.effect = 2 * result.u / (n1 * n2) - 1;
+
+    // Normal approximation with tie and continuity corrections; the runs
+    // compared here have hundreds of samples or more
+    const double mean = n1 * n2 / 2;
+    const double variance = n1 * n2 / 12 * ((n + 1) - tieTerm / (n * (n - 1)));
+    if (variance > 0) {
+        const double difference = result.u - mean;
+        const double corrected = difference > 0 ? difference - 0.5 : (difference < 0 ? difference + 0.5 : 0);
+        result.z = corrected / std::sqrt(variance);
+        result.p = std::erfc(std::fabs(result.z) / std::sqrt(2.0));
+    }
+
+    const bool significant = result.p < options.alpha && std::fabs(result.effect) >= options.minEffect;
+    if (significant && result.effect > 0 && result.changePercent > options.thresholdPercent) {
+        result.verdict = Regression;
+    } else if (significant && result.effect < 0 && result.changePercent < -options.thresholdPercent) {
+        result.verdict = Improvement;
+    }
+    return result;
+}
+
+QVector<BenchBaseline::Comparison> BenchBaseline::compare(const BenchBaseline &baseline, const BenchBaseline &current,
+                                                          const Options &options)
+{
+    QStringList names = baseline.distributions.keys();
+    for (const QString &name : current.distributions.keys()) {
+        if (!baseline.distributions.contains(name)) {
+            names.append(name);
+        }
+    }
+    std::sort(names.begin(), names.end());
+
+    QVector<Comparison> comparisons;
+    for (const QString &name : names) {
+        comparisons.append(compare(name, baseline.distributions.value(name), current.distributions.value(name),
+                                   options));
+    }
+    return comparisons;
+}
+
+QStringList BenchBaseline::format(const BenchBaseline &baseline, const BenchBaseline &current,
+                                  const QVector<Comparison> &comparisons)
+{
+    QStringList lines;
+    auto describe = [](const BenchBaseline &run) {
+        return QString("%1 on %2, %3").arg(run.label.isEmpty() ? QString("unlabelled") : run.label,
+                                           run.host, run.created.toString(Qt::ISODate));
+    };
+    lines << "Baseline: " + describe(baseline);
+    lines << "Current:  " + describe(current);
+    int regressions = 0;
+    int improvements = 0;
+    for (const Comparison &comparison : comparisons) {
+        lines << "  " + comparison.format(baseline.unit);
+        regressions += comparison.verdict == Regression;
+        improvements += comparison.verdict == Improvement;
+    }
+    lines << QString("%1 regressed, %2 improved, %3 compared")
+             .arg(regressions).arg(improvements).arg(comparisons.size());
+    return lines;
+}
+
+bool BenchBaseline::hasRegression(const QVector<Comparison> &comparisons)
+{
+    for (const Comparison &comparison : comparisons) {
+        if (comparison.verdict == Regression) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int BenchBaseline::run(const QString &baselineFile, const QString &currentFile, const Options &options)
+{
+    QTextStream out(stdout);
+    BenchBaseline baseline;
+    BenchBaseline current;
+    QString errorMessage;
+    if (!load(baselineFile, &baseline, &errorMessage) || !load(currentFile, &current, &errorMessage)) {
+        out << errorMessage << Qt::endl;
+        return 2;
+    }
+    if (baseline.unit != current.unit) {
+        out << QString("Baseline is in %1, current run in %2").arg(baseline.unit, current.unit) << Qt::endl;
+        return 2;
+    }
+
+    const QVector<Comparison> comparisons = compare(baseline, current, options);
+    for (const QString &line : format(baseline, current, comparisons)) {
+        out << line << Qt::endl;
+    }
+    return hasRegression(comparisons) ? 1 : 0;
+}
@@ -0,0 +1,75 @@
+#ifndef BENCHBASELINE_H
+#define BENCHBASELINE_H
+
+#include <QDateTime>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Latency distributions from one benchmark or probe run, saved as a
+// versioned JSON file so a later run can be compared against it. Samples are
+// kept whole, not summarized: the comparison is a Mann-Whitney U test per
+// distribution, which needs no normality and shrugs off the long tails of
+// serial latencies. Cliff's delta gives the effect size, so a tiny but
+// "significant" shift over 10000 samples is not called a regression.
+class BenchBaseline
+{
+public:
+    static const int FORMAT_VERSION = 1;
+
+    enum Verdict {
+        Unchanged,
+        Regression,
+        Improvement,
+        Missing                        // In only one of the two runs
+    };
+
+    struct Options {
+        double thresholdPercent = 5.0; // Median change needed to flag a difference
+        double alpha = 0.01;           // Two-sided significance level
+        double minEffect = 0.147;      // |Cliff's delta| below this is negligible
+    };
+
+    struct Comparison {
+        QString name;
+        int baselineCount = 0;
+        int currentCount = 0;
+        double baselineMedian = 0;
+        double currentMedian = 0;
+        double changePercent = 0;      // Of the median; positive is slower
+        double u = 0;                  // Pairs where the current sample is larger, ties counting half
+        double z = 0;
+        double p = 1;
+        double effect = 0;             // Cliff's delta in [-1, 1]; positive is slower
+        Verdict verdict = Unchanged;
+
+        QString format(const QString &unit) const;
+    };
+
+    QString tool;
+    QString label;                     // e.g. the commit the run was built from
+    QDateTime created;
+    QString host;
+    QString unit = "ns";
+    QMap<QString, QVector<double>> distributions;
+
+    void add(const QString &name, const QVector<double> &samples) { distributions.insert(name, samples); }
+
+    bool save(const QString &fileName, QString *errorMessage) const;
+    static bool load(const QString &fileName, BenchBaseline *baseline, QString *errorMessage);
+
+    static Comparison compare(const QString &name, const QVector<double> &baseline,
+                              const QVector<double> &current, const Options &options);
+    // Every distribution in either run, by name
+    static QVector<Comparison> compare(const BenchBaseline &baseline, const BenchBaseline &current,
+                                       const Options &options);
+    static QStringList format(const BenchBaseline &baseline, const BenchBaseline &current,
+                              const QVector<Comparison> &comparisons);
+    static bool hasRegression(const QVector<Comparison> &comparisons);
+
+    // Headless entry point: compares two saved files; 1 if anything regressed
+    static int run(const QString &baselineFile, const QString &currentFile, const Options &options);
+};
+
+#endif // BENCHBASELINE_H
@@ -0,0 +1,344 @@
+#include "CampaignRunner.h"
+#include "AutoKeypress.h"
+#include "KeypressCommands.h"
+#include "SerialCommunication.h"
+#include "StallWatchdog.h"
+#include "VmcRecovery.h"
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QTextStream>
+#include <QThread>
+
+namespace {
+
+const QString VALID_KEYS = "0123456789*#";
+
+void addStat(std::atomic<quint64> &counter, CampaignStats &total,
+             std::atomic<quint64> CampaignStats::*field)
+{
+    counter.fetch_add(1, std::memory_order_relaxed);
+    (total.*field).fetch_add(1, std::memory_order_relaxed);
+}
+
+// Runs every job for one port, in order, on a thread of its own with its own event loop
+class CampaignWorker
+{
+public:
+    CampaignWorker(CampaignRunner *runner, const QList<CampaignJob> &jobs,
+                   const QList<int> &indices, const QList<CampaignStats *> &stats,
+                   CampaignStats *total)
+        : m_runner(runner), m_jobs(jobs), m_indices(indices), m_stats(stats), m_total(total)
+    {
+    }
+
+    void run()
+    {
+        for (int i = 0; i < m_indices.size(); ++i) {
+            CampaignStats *stats = m_stats.at(i);
+            bool passed = runJob(m_jobs.at(i), *stats);
+            stats->passed.store(passed);
+            stats->finished.store(true);
+
+            int index = m_indices.at(i);
+            QMetaObject::invokeMethod(m_runner, "handleJobFinished", Qt::QueuedConnection,
+                                      Q_ARG(int, index));
+        }
+    }
+
+private:
+    bool runJob(const CampaignJob &job, CampaignStats &stats)
+    {
+        QEventLoop loop;
+        bool portLost = false;
+        bool draining = false;
+        int remaining = job.iterations;
+
+        SerialCommunication serial;
+        KeypressCommands keypress(&serial);
+        AutoKeypress autoKeypress(&keypress);
+        VmcRecovery recovery(&serial);
+        serial.setReliableDelivery(true);
+        recovery.setAutomation(&autoKeypress);
+        recovery.setOptions(VmcRecovery::optionsFromSettings());
+        recovery.setEnabled(job.autoRecover);
+
+        if (!serial.openPort(job.port, SerialCommunication::configForPort(job.port))) {
+            addStat(stats.errors, *m_total, &CampaignStats::errors);
+            return false;
+        }
+
+        autoKeypress.setSequence(job.keys);
+        autoKeypress.setInterval(job.intervalMs);
+
+        auto quitWhenDrained = [&]() {
+            if (draining && serial.reliableLink()->pendingCount() == 0) {
+                loop.quit();
+            }
+        };
+
+        QObject::connect(&autoKeypress, &AutoKeypress::keyPressed, &loop, [&]() {
+            addStat(stats.keysSent, *m_total, &CampaignStats::keysSent);
+        });
+        QObject::connect(&serial, &SerialCommunication::frameDelivered, &loop,
+                         [&](const QByteArray &, qint64 rttMs) {
+            addStat(stats.acked, *m_total, &CampaignStats::acked);
+            stats.latency.record(rttMs);
+            m_total->latency.record(rttMs);
+            quitWhenDrained();
+        });
+        QObject::connect(&serial, &SerialCommunication::frameFailed, &loop, [&]() {
+            addStat(stats.failed, *m_total, &CampaignStats::failed);
+            quitWhenDrained();
+        });
+        QObject::connect(&recovery, &VmcRecovery::recovered, &loop, [&]() {
+            addStat(stats.recoveries, *m_total, &CampaignStats::recoveries);
+        });
+        QObject::connect(&serial, &SerialCommunication::error, &loop, [&]() {
+            addStat(stats.errors, *m_total, &CampaignStats::errors);
+        });
+        QObject::connect(&serial, &SerialCommunication::portStatusChanged, &loop, [&](bool isOpen) {
+            if (!isOpen) {
+                portLost = true;
+                loop.quit();
+            }
+        });
+        QObject::connect(&autoKeypress, &AutoKeypress::sequenceCompleted, &loop, [&]() {
+            addStat(stats.iterationsDone, *m_total, &CampaignStats::iterationsDone);
+            if (--remaining > 0) {
+                autoKeypress.startSequence();
+            } else {
+                // Wait for the last acks (or their retry limit) before closing
+                draining = true;
+                quitWhenDrained();
+            }
+        });
+
+        autoKeypress.startSequence();
+        StallWatchdog::watchCurrentThread(QString("campaign %1").arg(job.port));
+        loop.exec();
+        StallWatchdog::unwatchCurrentThread();
+
+        autoKeypress.stopSequence();
+        serial.disconnect();
+        serial.closePort();
+
+        return !portLost
+            && remaining <= 0
+            && stats.failed.load() == 0
+            && stats.errors.load() == 0;
+    }
+
+    CampaignRunner *m_runner;
+    QList<CampaignJob> m_jobs;
+    QList<int> m_indices;
+    QList<CampaignStats *> m_stats;
+    CampaignStats *m_total;
+};
+
+}
+
+CampaignRunner::CampaignRunner(QObject *parent)
+    : QObject(parent)
+    , m_jobsDone(0)
+{
+    m_reportTimer.setInterval(REPORT_INTERVAL_MS);
+    connect(&m_reportTimer, &QTimer::timeout, this, &CampaignRunner::reportProgress);
+}
+
+CampaignRunner::~CampaignRunner()
+{
+    waitForWorkers();
+}
+
+void CampaignRunner::waitForWorkers()
+{
+    for (const std::unique_ptr<QThread> &thread : m_threads) {
+        thread->wait();
+    }
+    m_threads.clear();
+}
+
+bool CampaignRunner::loadJobs(const QString &fileName, QList<CampaignJob> *jobs, QString *errorMessage)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *errorMessage = QString("Cannot open %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+
+    // {"jobs": [{"port": "ttyUSB0", "script": "123#", "iterations": 100, "intervalMs": 250, "autoRecover": true}]}
+    QJsonParseError parseError;
+    QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (document.isNull()) {
+        *errorMessage = QString("%1: %2").arg(fileName, parseError.errorString());
+        return false;
+    }
+
+    QList<CampaignJob> result;
+    const QJsonArray entries = document.object().value("jobs").toArray();
+    for (int i = 0; i < entries.size(); ++i) {
+        QJsonObject entry = entries.at(i).toObject();
+        CampaignJob job;
+        job.port = entry.value("port").toString();
+        job.iterations = entry.value("iterations").toInt(1);
+        job.intervalMs = entry.value("intervalMs").toInt(job.intervalMs);
+        job.autoRecover = entry.value("autoRecover").toBool(job.autoRecover);
+
+        QString scriptError;
+        if (!parseScript(entry.value("script").toString(), &job.keys, &scriptError)) {
+            *errorMessage = QString("Job %1: %2").arg(i + 1).arg(scriptError);
+            return false;
+        }
+
+        if (job.port.isEmpty() || job.keys.isEmpty() || job.iterations < 1) {
+            *errorMessage = QString("Job %1: needs a port, a non-empty script and iterations >= 1").arg(i + 1);
+            return false;
+        }
+        result.append(job);
+    }
+
+    if (result.isEmpty()) {
+        *errorMessage = QString("%1: no jobs").arg(fileName);
+        return false;
+    }
+
+    *jobs = result;
+    return true;
+}
+
+bool CampaignRunner::parseScript(const QString &script, QVector<QString> *keys, QString *errorMessage)
+{
+    // A script is a key sequence, or the path of a file holding one
+    QString sequence = script;
+    if (QFile::exists(script)) {
+        QFile scriptFile(script);
+        if (!scriptFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            *errorMessage = QString("Cannot open %1: %2").arg(script, scriptFile.errorString());
+            return false;
+        }
+        sequence = QString::fromUtf8(scriptFile.readAll());
+    }
+
+    keys->clear();
+    for (const QChar key : sequence) {
+        if (key.isSpace()) {
+            continue;
+        }
+        if (!VALID_KEYS.contains(key)) {
+            *errorMessage = QString("invalid key '%1' in script").arg(key);
+            return false;
+        }
+        keys->append(QString(key));
+    }
+    return true;
+}
+
+int CampaignRunner::runFromFile(const QString &fileName)
+{
+    QTextStream out(stdout);
+    QList<CampaignJob> jobs;
+    QString loadError;
+    if (!loadJobs(fileName, &jobs, &loadError)) {
+        out << "Campaign: " << loadError << Qt::endl;
+        return 2;
+    }
+
+    CampaignRunner runner;
+    QObject::connect(&runner, &CampaignRunner::finished, qApp, [](bool allPassed) {
+        QCoreApplication::exit(allPassed ? 0 : 1);
+    });
+    runner.start(jobs);
+    return QCoreApplication::exec();
+}
+
+void CampaignRunner::start(const QList<CampaignJob> &jobs)
+{
+    waitForWorkers();
+    m_jobs = jobs;
+    m_stats.clear();
+    m_total.reset();
+    m_jobsDone = 0;
+    for (int i = 0; i < m_jobs.size(); ++i) {
+        m_stats.push_back(std::unique_ptr<CampaignStats>(new CampaignStats));
+    }
+
+    // One worker per port so a port is never opened twice. Workers spend
+    // their time waiting on the line, so every port gets its own thread
+    // however few cores there are.
+    QMap<QString, QList<int>> jobsByPort;
+    for (int i = 0; i < m_jobs.size(); ++i) {
+        jobsByPort[m_jobs.at(i).port].append(i);
+    }
+
+    QTextStream(stdout) << "Campaign: " << m_jobs.size() << " jobs on " << jobsByPort.size()
+                        << " ports, " << jobsByPort.size() << " workers" << Qt::endl;
+
+    m_elapsed.start();
+    m_reportTimer.start();
+
+    for (auto it = jobsByPort.constBegin(); it != jobsByPort.constEnd(); ++it) {
+        QList<CampaignJob> portJobs;
+        QList<CampaignStats *> portStats;
+        for (int index : it.value()) {
+            portJobs.append(m_jobs.at(index));
+            portStats.append(m_stats[index].get());
+        }
+        std::shared_ptr<CampaignWorker> worker(new CampaignWorker(this, portJobs, it.value(), portStats, &m_total));
+        m_threads.emplace_back(QThread::create([worker]() { worker->run(); }));
+        m_threads.back()->setObjectName(QString("campaign %1").arg(it.key()));
+        m_threads.back()->start();
+    }
+}
+
+bool CampaignRunner::allPassed() const
+{
+    for (const auto &stats : m_stats) {
+        if (!stats->finished.load() || !stats->passed.load()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CampaignRunner::reportProgress()
+{
+    QTextStream(stdout) << QString("[%1s] %2/%3 jobs done, ")
+                           .arg(m_elapsed.elapsed() / 1000.0, 0, 'f', 1)
+                           .arg(m_jobsDone).arg(m_jobs.size())
+                        << summarize(m_total) << Qt::endl;
+}
+
+void CampaignRunner::handleJobFinished(int index)
+{
+    const CampaignJob &job = m_jobs.at(index);
+    const CampaignStats &stats = *m_stats[index];
+    m_jobsDone++;
+
+    QTextStream(stdout) << (stats.passed.load() ? "PASS " : "FAIL ") << job.port
+                        << QString(" iterations %1/%2, ").arg(stats.iterationsDone.load()).arg(job.iterations)
+                        << summarize(stats) << Qt::endl;
+    emit jobFinished(index, stats.passed.load());
+
+    if (m_jobsDone == m_jobs.size()) {
+        m_reportTimer.stop();
+        reportProgress();
+        emit finished(allPassed());
+    }
+}
+
+QString CampaignRunner::summarize(const CampaignStats &stats) const
+{
+    return QString("keys %1, acked %2, failed %3, errors %4, recovered %5, p50 <%6 ms, p99 <%7 ms")
+        .arg(stats.keysSent.load())
+        .arg(stats.acked.load())
+        .arg(stats.failed.load())
+        .arg(stats.errors.load())
+        .arg(stats.recoveries.load())
+        .arg(stats.latency.percentile(0.50))
+        .arg(stats.latency.percentile(0.99));
+}
@@ -0,0 +1,91 @@
+#ifndef CAMPAIGNRUNNER_H
+#define CAMPAIGNRUNNER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QList>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "LatencyHistogram.h"
+
+struct CampaignJob {
+    QString port;
+    QVector<QString> keys;
+    int iterations = 1;
+    int intervalMs = 250;
+    bool autoRecover = false;
+};
+
+// Counters shared between a worker thread and the reporting thread
+struct CampaignStats {
+    std::atomic<quint64> keysSent{0};
+    std::atomic<quint64> acked{0};
+    std::atomic<quint64> failed{0};
+    std::atomic<quint64> errors{0};
+    std::atomic<quint64> recoveries{0};
+    std::atomic<quint64> iterationsDone{0};
+    std::atomic<bool> finished{false};
+    std::atomic<bool> passed{false};
+    LatencyHistogram latency;
+
+    // Only while no worker is recording into it
+    void reset()
+    {
+        keysSent = 0;
+        acked = 0;
+        failed = 0;
+        errors = 0;
+        recoveries = 0;
+        iterationsDone = 0;
+        finished = false;
+        passed = false;
+        latency.reset();
+    }
+};
+
+// Runs (port, script, iterations) jobs headless and concurrently: each port is
+// owned by one worker thread, so every rig runs in parallel whatever the core
+// count; jobs for the same port run back to back on that worker.
+class CampaignRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CampaignRunner(QObject *parent = nullptr);
+    ~CampaignRunner();
+
+    static bool loadJobs(const QString &fileName, QList<CampaignJob> *jobs, QString *errorMessage);
+    static bool parseScript(const QString &script, QVector<QString> *keys, QString *errorMessage);
+    static int runFromFile(const QString &fileName);
+
+    void start(const QList<CampaignJob> &jobs);
+    bool allPassed() const;
+
+signals:
+    void jobFinished(int index, bool passed);
+    void finished(bool allPassed);
+
+private slots:
+    void reportProgress();
+    void handleJobFinished(int index);
+
+private:
+    QList<CampaignJob> m_jobs;
+    std::vector<std::unique_ptr<CampaignStats>> m_stats;
+    CampaignStats m_total;
+    std::vector<std::unique_ptr<QThread>> m_threads;  // One per port
+    QTimer m_reportTimer;
+    QElapsedTimer m_elapsed;
+    int m_jobsDone;
+
+    static const int REPORT_INTERVAL_MS = 1000;
+
+    QString summarize(const CampaignStats &stats) const;
+    void waitForWorkers();
+};
+
+#endif // CAMPAIGNRUNNER_H
@@ -0,0 +1,584 @@
+#include "CaptureAnalyzer.h"
+#include "CaptureFile.h"
+#include "VmcProtocol.h"
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThread>
+#include <QtAlgorithms>
+#include <QtEndian>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CAPTURE_SCAN_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CAPTURE_TARGET(isa) __attribute__((target(isa)))
+#else
+#define CAPTURE_TARGET(isa)
+#endif
+
+namespace {
+
+using Report = CaptureAnalyzer::Report;
+using SyncScanner = const uchar *(*)(const uchar *begin, const uchar *end);
+
+// A frame spread over more records than this is treated as truncated
+const int MAX_FRAME_RECORDS = 16;
+
+const uchar *findSyncScalar(const uchar *p, const uchar *end)
+{
+    const uchar sync = static_cast<uchar>(VmcProtocol::SYNC);
+    while (p < end && *p != sync) {
+        ++p;
+    }
+    return p;
+}
+
+#ifdef CAPTURE_SCAN_X86
+CAPTURE_TARGET("sse2")
+const uchar *findSyncSse2(const uchar *p, const uchar *end)
+{
+    const __m128i sync = _mm_set1_epi8(VmcProtocol::SYNC);
+    while (end - p >= 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        quint32 mask = static_cast<quint32>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, sync)));
+        if (mask) {
+            return p + qCountTrailingZeroBits(mask);
+        }
+        p += 16;
+    }
+    return findSyncScalar(p, end);
+}
+
+CAPTURE_TARGET("avx2")
+const uchar *findSyncAvx2(const uchar *p, const uchar *end)
+{
+    const __m256i sync = _mm256_set1_epi8(VmcProtocol::SYNC);
+    while (end - p >= 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        quint32 mask = static_cast<quint32>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, sync)));
+        if (mask) {
+            return p + qCountTrailingZeroBits(mask);
+        }
+        p += 32;
+    }
+    return findSyncSse2(p, end);
+}
+
+bool cpuHasAvx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    // The OS must save the YMM registers as well
+    if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+bool cpuHasSse2()
+{
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    return true;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+#endif
+
+SyncScanner selectScanner(bool simd, QString *name)
+{
+#ifdef CAPTURE_SCAN_X86
+    if (simd && cpuHasAvx2()) {
+        *name = "AVX2";
+        return findSyncAvx2;
+    }
+    if (simd && cpuHasSse2()) {
+        *name = "SSE2";
+        return findSyncSse2;
+    }
+#else
+    Q_UNUSED(simd);
+#endif
+    *name = "scalar";
+    return findSyncScalar;
+}
+
+// A decoded frame, its five bytes packed big-endian into one integer
+struct FrameEvent {
+    qint64 timeNs;
+    quint64 key;
+};
+
+quint64 packFrame(const uchar *frame)
+{
+    quint64 key = 0;
+    for (int i = 0; i < VmcProtocol::FRAME_SIZE; ++i) {
+        key = (key << 8) | frame[i];
+    }
+    return key;
+}
+
+quint8 frameByte(quint64 key, int index)
+{
+    return static_cast<quint8>(key >> (8 * (VmcProtocol::FRAME_SIZE - 1 - index)));
+}
+
+CaptureAnalyzer::TimelineBucket &bucketAt(Report &stats, qint64 timeNs, qint64 bucketNs)
+{
+    return stats.timeline[timeNs / bucketNs];
+}
+
+void recordEcho(Report &stats, quint64 key, qint64 sentNs, qint64 echoNs, qint64 bucketNs)
+{
+    const qint64 latencyNs = echoNs - sentNs;
+    CaptureAnalyzer::CommandStats &command = stats.commands[frameByte(key, 1)];
+    command.count++;
+    command.sumNs += latencyNs;
+    command.maxNs = qMax(command.maxNs, latencyNs);
+    command.latency.record(latencyNs / 1000000);
+
+    CaptureAnalyzer::TimelineBucket &bucket = bucketAt(stats, sentNs, bucketNs);
+    bucket.maxLatencyNs = qMax(bucket.maxLatencyNs, latencyNs);
+    stats.echoes++;
+}
+
+struct ChunkResult {
+    Report stats;
+    qint64 firstNs = 0;
+    qint64 lastNs = 0;
+    std::vector<FrameEvent> leadingRx;   // Unmatched RX that may echo the previous chunk's TX
+    std::vector<FrameEvent> trailingTx;  // TX whose echo may land in the next chunk
+};
+
+class ChunkDecoder
+{
+public:
+    ChunkDecoder(const uchar *records, qint64 recordCount, SyncScanner scan,
+                 const CaptureAnalyzer::Options &options)
+        : m_records(records)
+        , m_recordCount(recordCount)
+        , m_scan(scan)
+        , m_bucketNs(options.bucketSeconds * Q_INT64_C(1000000000))
+        , m_windowNs(options.matchWindowMs * Q_INT64_C(1000000))
+    {
+    }
+
+    void decode(qint64 beginRecord, qint64 endRecord, ChunkResult *result)
+    {
+        Report &stats = result->stats;
+        qint64 guard[2] = {0, 0};
+        countRecords(beginRecord, endRecord, result, guard);
+
+        // Sync bytes are located straight in the mapped records; hits in
+        // timestamps or headers are rejected by their position in the record
+        std::vector<FrameEvent> frames[2];
+        qint64 consumed[2] = {beginRecord * CaptureFormat::RECORD_SIZE,
+                              beginRecord * CaptureFormat::RECORD_SIZE};
+        const uchar *p = m_records + beginRecord * CaptureFormat::RECORD_SIZE;
+        const uchar *end = m_records + endRecord * CaptureFormat::RECORD_SIZE;
+
+        while ((p = m_scan(p, end)) < end) {
+            const qint64 offset = p - m_records;
+            ++p;
+
+            const uchar *record = m_records + (offset / CaptureFormat::RECORD_SIZE) * CaptureFormat::RECORD_SIZE;
+            const int position = static_cast<int>(offset % CaptureFormat::RECORD_SIZE) - CaptureFormat::RECORD_DATA_OFFSET;
+            const quint8 direction = record[8];
+            if (position < 0 || position >= recordLength(record) || direction > CaptureFormat::Rx
+                || offset < consumed[direction]) {
+                continue;
+            }
+
+            uchar frame[VmcProtocol::FRAME_SIZE];
+            qint64 timeNs = 0;
+            qint64 next = gatherFrame(offset, direction, frame, &timeNs);
+            if (next < 0) {
+                continue;
+            }
+            if (!VmcProtocol::hasValidChecksum(reinterpret_cast<const char *>(frame))) {
+                // The first bytes may be the tail of the previous chunk's last frame
+                if (offset >= guard[direction]) {
+                    stats.checksumErrors++;
+                }
+                continue;
+            }
+
+            consumed[direction] = next;
+            FrameEvent event;
+            event.timeNs = timeNs;
+            event.key = packFrame(frame);
+            frames[direction].push_back(event);
+        }
+
+        match(frames[CaptureFormat::Tx], frames[CaptureFormat::Rx], result);
+    }
+
+private:
+    static int recordLength(const uchar *record)
+    {
+        return qMin<int>(record[9], CaptureFormat::RECORD_DATA_SIZE);
+    }
+
+    static qint64 recordTime(const uchar *record)
+    {
+        return qFromLittleEndian<qint64>(record);
+    }
+
+    // Counts bytes per direction and marks the first FRAME_SIZE - 1 data bytes
+    // of each direction, which may belong to a frame started before the chunk
+    void countRecords(qint64 beginRecord, qint64 endRecord, ChunkResult *result, qint64 guard[2]) const
+    {
+        Report &stats = result->stats;
+        int guardBytes[2] = {0, 0};
+        for (qint64 r = beginRecord; r < endRecord; ++r) {
+            const uchar *record = m_records + r * CaptureFormat::RECORD_SIZE;
+            const quint8 direction = record[8];
+            const int length = recordLength(record);
+            if (direction == CaptureFormat::Tx) {
+                stats.txBytes += length;
+            } else if (direction == CaptureFormat::Rx) {
+                stats.rxBytes += length;
+            } else {
+                continue;
+            }
+
+            if (guardBytes[direction] < VmcProtocol::FRAME_SIZE - 1) {
+                const int take = qMin(length, VmcProtocol::FRAME_SIZE - 1 - guardBytes[direction]);
+                guardBytes[direction] += take;
+                guard[direction] = r * CaptureFormat::RECORD_SIZE + CaptureFormat::RECORD_DATA_OFFSET + take;
+            }
+        }
+
+        stats.records = endRecord - beginRecord;
+        result->firstNs = recordTime(m_records + beginRecord * CaptureFormat::RECORD_SIZE);
+        result->lastNs = recordTime(m_records + (endRecord - 1) * CaptureFormat::RECORD_SIZE);
+    }
+
+    // Collects a frame's bytes starting at offset, following later records of
+    // the same direction. Returns the offset just past the frame, or -1 when
+    // the capture ends first.
+    qint64 gatherFrame(qint64 offset, quint8 direction, uchar *frame, qint64 *timeNs) const
+    {
+        qint64 r = offset / CaptureFormat::RECORD_SIZE;
+        int index = static_cast<int>(offset % CaptureFormat::RECORD_SIZE) - CaptureFormat::RECORD_DATA_OFFSET;
+        int have = 0;
+        qint64 next = -1;
+
+        for (int visited = 0; have < VmcProtocol::FRAME_SIZE && r < m_recordCount && visited < MAX_FRAME_RECORDS;
+             ++r, ++visited, index = 0) {
+            const uchar *record = m_records + r * CaptureFormat::RECORD_SIZE;
+            if (record[8] != direction) {
+                continue;
+            }
+            const int length = recordLength(record);
+            while (index < length && have < VmcProtocol::FRAME_SIZE) {
+                frame[have++] = record[CaptureFormat::RECORD_DATA_OFFSET + index++];
+            }
+            next = r * CaptureFormat::RECORD_SIZE + CaptureFormat::RECORD_DATA_OFFSET + index;
+            *timeNs = recordTime(record);
+        }
+        return have == VmcProtocol::FRAME_SIZE ? next : -1;
+    }
+
+    // Pairs each RX frame with the oldest unanswered TX frame of identical bytes
+    void match(const std::vector<FrameEvent> &tx, const std::vector<FrameEvent> &rx, ChunkResult *result) const
+    {
+        Report &stats = result->stats;
+        std::unordered_map<quint64, std::deque<qint64>> pending;
+        size_t t = 0;
+        size_t r = 0;
+
+        while (t < tx.size() || r < rx.size()) {
+            if (r == rx.size() || (t < tx.size() && tx[t].timeNs <= rx[r].timeNs)) {
+                const FrameEvent &event = tx[t++];
+                stats.txFrames++;
+                bucketAt(stats, event.timeNs, m_bucketNs).txFrames++;
+                pending[event.key].push_back(event.timeNs);
+                continue;
+            }
+
+            const FrameEvent &event = rx[r++];
+            stats.rxFrames++;
+            CaptureAnalyzer::TimelineBucket &bucket = bucketAt(stats, event.timeNs, m_bucketNs);
+            bucket.rxFrames++;
+            if (frameByte(event.key, 1) == VmcProtocol::ERROR_COMMAND && frameByte(event.key, 3) != 0) {
+                stats.errorCodes[frameByte(event.key, 2)]++;
+                bucket.errorFrames++;
+            }
+
+            auto it = pending.find(event.key);
+            if (it != pending.end()) {
+                std::deque<qint64> &sent = it->second;
+                while (!sent.empty() && event.timeNs - sent.front() > m_windowNs) {
+                    bucketAt(stats, sent.front(), m_bucketNs).unanswered++;
+                    stats.unanswered++;
+                    sent.pop_front();
+                }
+                if (!sent.empty()) {
+                    recordEcho(stats, event.key, sent.front(), event.timeNs, m_bucketNs);
+                    sent.pop_front();
+                    continue;
+                }
+            }
+
+            if (event.timeNs - result->firstNs <= m_windowNs) {
+                result->leadingRx.push_back(event);
+            } else {
+                stats.unsolicited++;
+            }
+        }
+
+        for (const auto &entry : pending) {
+            for (qint64 sentNs : entry.second) {
+                if (result->lastNs - sentNs > m_windowNs) {
+                    bucketAt(stats, sentNs, m_bucketNs).unanswered++;
+                    stats.unanswered++;
+                } else {
+                    FrameEvent event;
+                    event.timeNs = sentNs;
+                    event.key = entry.first;
+                    result->trailingTx.push_back(event);
+                }
+            }
+        }
+        std::sort(result->trailingTx.begin(), result->trailingTx.end(),
+                  [](const FrameEvent &a, const FrameEvent &b) { return a.timeNs < b.timeNs; });
+    }
+
+    const uchar *m_records;
+    qint64 m_recordCount;
+    SyncScanner m_scan;
+    qint64 m_bucketNs;
+    qint64 m_windowNs;
+};
+
+}
+
+bool CaptureAnalyzer::analyze(const QString &fileName, const Options &options,
+                              Report *report, QString *errorMessage)
+{
+    QElapsedTimer wallTimer;
+    wallTimer.start();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *errorMessage = QString("Cannot open %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+
+    const qint64 size = file.size();
+    if (size < CaptureFormat::HEADER_SIZE) {
+        *errorMessage = QString("%1: not a capture file").arg(fileName);
+        return false;
+    }
+
+    const uchar *map = file.map(0, size);
+    if (!map) {
+        *errorMessage = QString("Cannot map %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+#ifdef Q_OS_UNIX
+    // Every chunk is read front to back exactly once
+    madvise(const_cast<uchar *>(map), static_cast<size_t>(size), MADV_SEQUENTIAL);
+#endif
+
+    if (std::memcmp(map, CaptureFormat::MAGIC, CaptureFormat::MAGIC_SIZE) != 0) {
+        *errorMessage = QString("%1: not a capture file").arg(fileName);
+        return false;
+    }
+
+    // A record cut short by a crash at the end of the file is ignored
+    const uchar *records = map + CaptureFormat::HEADER_SIZE;
+    const qint64 recordCount = (size - CaptureFormat::HEADER_SIZE) / CaptureFormat::RECORD_SIZE;
+    const qint64 recordsPerChunk = qMax<qint64>(1, options.chunkBytes / CaptureFormat::RECORD_SIZE);
+    const int chunkCount = static_cast<int>((recordCount + recordsPerChunk - 1) / recordsPerChunk);
+    const int threadCount = qBound(1, options.threads > 0 ? options.threads : QThread::idealThreadCount(),
+                                   qMax(1, chunkCount));
+
+    report->fileBytes = size;
+    report->startEpochMs = qFromLittleEndian<qint64>(map + CaptureFormat::MAGIC_SIZE);
+    report->chunks = chunkCount;
+    report->threads = threadCount;
+    SyncScanner scan = selectScanner(options.simd, &report->scanner);
+
+    // Chunks are handed out in order; each result is stitched to its neighbours below
+    std::vector<std::unique_ptr<ChunkResult>> results(chunkCount);
+    std::atomic<int> nextChunk{0};
+    auto worker = [&]() {
+        ChunkDecoder decoder(records, recordCount, scan, options);
+        int chunk;
+        while ((chunk = nextChunk.fetch_add(1)) < chunkCount) {
+            std::unique_ptr<ChunkResult> result(new ChunkResult);
+            const qint64 begin = chunk * recordsPerChunk;
+            decoder.decode(begin, qMin(recordCount, begin + recordsPerChunk), result.get());
+            results[chunk] = std::move(result);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < threadCount; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    const qint64 bucketNs = options.bucketSeconds * Q_INT64_C(1000000000);
+    const qint64 windowNs = options.matchWindowMs * Q_INT64_C(1000000);
+    std::deque<FrameEvent> carried;  // TX still awaiting an echo at a chunk boundary
+
+    for (const std::unique_ptr<ChunkResult> &result : results) {
+        const Report &stats = result->stats;
+        report->records += stats.records;
+        report->txBytes += stats.txBytes;
+        report->rxBytes += stats.rxBytes;
+        report->txFrames += stats.txFrames;
+        report->rxFrames += stats.rxFrames;
+        report->echoes += stats.echoes;
+        report->unanswered += stats.unanswered;
+        report->unsolicited += stats.unsolicited;
+        report->checksumErrors += stats.checksumErrors;
+        report->durationNs = qMax(report->durationNs, result->lastNs);
+        for (auto it = stats.errorCodes.constBegin(); it != stats.errorCodes.constEnd(); ++it) {
+            report->errorCodes[it.key()] += it.value();
+        }
+        for (int command = 0; command < 256; ++command) {
+            const CommandStats &source = stats.commands[command];
+            CommandStats &target = report->commands[command];
+            target.count += source.count;
+            target.sumNs += source.sumNs;
+            target.maxNs = qMax(target.maxNs, source.maxNs);
+            target.latency.merge(source.latency);
+        }
+        for (const auto &entry : stats.timeline) {
+            TimelineBucket &target = report->timeline[entry.first];
+            target.txFrames += entry.second.txFrames;
+            target.rxFrames += entry.second.rxFrames;
+            target.errorFrames += entry.second.errorFrames;
+            target.unanswered += entry.second.unanswered;
+            target.maxLatencyNs = qMax(target.maxLatencyNs, entry.second.maxLatencyNs);
+        }
+
+        for (const FrameEvent &echo : result->leadingRx) {
+            auto sent = std::find_if(carried.begin(), carried.end(), [&](const FrameEvent &tx) {
+                return tx.key == echo.key && echo.timeNs - tx.timeNs <= windowNs;
+            });
+            if (sent != carried.end()) {
+                recordEcho(*report, echo.key, sent->timeNs, echo.timeNs, bucketNs);
+                carried.erase(sent);
+            } else {
+                report->unsolicited++;
+            }
+        }
+        while (!carried.empty() && result->lastNs - carried.front().timeNs > windowNs) {
+            bucketAt(*report, carried.front().timeNs, bucketNs).unanswered++;
+            report->unanswered++;
+            carried.pop_front();
+        }
+        carried.insert(carried.end(), result->trailingTx.begin(), result->trailingTx.end());
+    }
+    for (const FrameEvent &tx : carried) {
+        bucketAt(*report, tx.timeNs, bucketNs).unanswered++;
+        report->unanswered++;
+    }
+
+    file.unmap(const_cast<uchar *>(map));
+    report->wallMs = wallTimer.elapsed();
+    return true;
+}
+
+QString CaptureAnalyzer::format(const Report &report, const Options &options)
+{
+    auto ms = [](qint64 ns) { return QString::number(ns / 1e6, 'f', 2); };
+    const double megabytes = report.fileBytes / (1024.0 * 1024.0);
+    const qint64 durationSeconds = report.durationNs / Q_INT64_C(1000000000);
+
+    QString text;
+    text += QString("Capture started %1, %2 MB, %3 records, %4:%5:%6 of traffic\n")
+        .arg(QDateTime::fromMSecsSinceEpoch(report.startEpochMs).toString("yyyy-MM-dd HH:mm:ss"))
+        .arg(megabytes, 0, 'f', 1)
+        .arg(report.records)
+        .arg(durationSeconds / 3600)
+        .arg((durationSeconds / 60) % 60, 2, 10, QChar('0'))
+        .arg(durationSeconds % 60, 2, 10, QChar('0'));
+    text += QString("Analyzed in %1 ms (%2 MB/s): %3 chunks on %4 threads, %5 sync scan\n")
+        .arg(report.wallMs)
+        .arg(report.wallMs > 0 ? megabytes * 1000.0 / report.wallMs : 0.0, 0, 'f', 0)
+        .arg(report.chunks).arg(report.threads).arg(report.scanner);
+    text += QString("TX %1 bytes, %2 frames; RX %3 bytes, %4 frames\n")
+        .arg(report.txBytes).arg(report.txFrames).arg(report.rxBytes).arg(report.rxFrames);
+    text += QString("Echoed %1, unanswered %2, unsolicited %3, checksum errors %4\n")
+        .arg(report.echoes).arg(report.unanswered).arg(report.unsolicited).arg(report.checksumErrors);
+
+    text += "\nEcho latency by command\n";
+    text += "  command      count    mean ms   p50 <ms   p99 <ms     max ms\n";
+    for (int command = 0; command < 256; ++command) {
+        const CommandStats &stats = report.commands[command];
+        if (stats.count == 0) {
+            continue;
+        }
+        text += QString("  0x%1  %2  %3  %4  %5  %6\n")
+            .arg(command, 2, 16, QChar('0'))
+            .arg(stats.count, 13)
+            .arg(ms(stats.sumNs / static_cast<qint64>(stats.count)), 9)
+            .arg(stats.latency.percentile(0.50), 8)
+            .arg(stats.latency.percentile(0.99), 8)
+            .arg(ms(stats.maxNs), 9);
+    }
+
+    text += "\nVMC error frames\n";
+    if (report.errorCodes.isEmpty()) {
+        text += "  none\n";
+    }
+    for (auto it = report.errorCodes.constBegin(); it != report.errorCodes.constEnd(); ++it) {
+        text += QString("  code %1: %2\n").arg(it.key()).arg(it.value());
+    }
+
+    text += QString("\nTimeline (%1 s buckets)\n").arg(options.bucketSeconds);
+    text += "  start                       tx         rx   errors  unanswered  max latency ms\n";
+    for (const auto &entry : report.timeline) {
+        const qint64 startMs = report.startEpochMs + entry.first * options.bucketSeconds * 1000;
+        const TimelineBucket &bucket = entry.second;
+        text += QString("  %1  %2  %3  %4  %5  %6\n")
+            .arg(QDateTime::fromMSecsSinceEpoch(startMs).toString("yyyy-MM-dd HH:mm:ss"))
+            .arg(bucket.txFrames, 9)
+            .arg(bucket.rxFrames, 9)
+            .arg(bucket.errorFrames, 7)
+            .arg(bucket.unanswered, 10)
+            .arg(ms(bucket.maxLatencyNs), 14);
+    }
+    return text;
+}
@@ -0,0 +1,67 @@
+#ifndef CAPTUREANALYZER_H
+#define CAPTUREANALYZER_H
+
+#include <QMap>
+#include <QString>
+#include <map>
+#include <memory>
+#include "LatencyHistogram.h"
+
+// Offline analysis of CaptureWriter files. The capture is memory-mapped and
+// split into record-aligned chunks decoded on all cores; sync bytes are found
+// with an SSE2/AVX2 scan. TX frames are paired with the VMC's echo to give
+// per-command latency, and chunk boundaries are stitched afterwards.
+class CaptureAnalyzer
+{
+public:
+    struct Options {
+        int threads = 0;                  // 0: one per core
+        qint64 chunkBytes = 64 << 20;
+        qint64 bucketSeconds = 3600;      // Timeline resolution
+        qint64 matchWindowMs = 5000;      // Longest TX-to-echo latency considered
+        bool simd = true;
+    };
+
+    struct CommandStats {
+        quint64 count = 0;
+        qint64 sumNs = 0;
+        qint64 maxNs = 0;
+        LatencyHistogram latency;
+    };
+
+    struct TimelineBucket {
+        quint64 txFrames = 0;
+        quint64 rxFrames = 0;
+        quint64 errorFrames = 0;
+        quint64 unanswered = 0;
+        qint64 maxLatencyNs = 0;
+    };
+
+    struct Report {
+        qint64 fileBytes = 0;
+        qint64 startEpochMs = 0;
+        qint64 durationNs = 0;
+        quint64 records = 0;
+        quint64 txBytes = 0;
+        quint64 rxBytes = 0;
+        quint64 txFrames = 0;
+        quint64 rxFrames = 0;
+        quint64 echoes = 0;
+        quint64 unanswered = 0;
+        quint64 unsolicited = 0;
+        quint64 checksumErrors = 0;
+        QMap<int, quint64> errorCodes;    // VMC error code -> error frames seen
+        std::unique_ptr<CommandStats[]> commands{new CommandStats[256]};
+        std::map<qint64, TimelineBucket> timeline;
+        int chunks = 0;
+        int threads = 0;
+        QString scanner;
+        qint64 wallMs = 0;
+    };
+
+    static bool analyze(const QString &fileName, const Options &options,
+                        Report *report, QString *errorMessage);
+    static QString format(const Report &report, const Options &options);
+};
+
+#endif // CAPTUREANALYZER_H
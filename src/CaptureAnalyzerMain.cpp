@@ -0,0 +1,50 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include "CaptureAnalyzer.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("asdCaptureAnalyzer");
+
+    CaptureAnalyzer::Options options;
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Summarizes a serial traffic capture written by asdKeypad.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("capture", "Capture file (.asdcap).");
+    QCommandLineOption threadsOption("threads", "Worker threads (default: one per core).", "count", "0");
+    QCommandLineOption chunkOption("chunk-mb", "Chunk size handed to each worker.", "MB",
+                                   QString::number(options.chunkBytes >> 20));
+    QCommandLineOption bucketOption("bucket", "Timeline bucket length.", "seconds",
+                                    QString::number(options.bucketSeconds));
+    QCommandLineOption windowOption("window", "Longest TX-to-echo latency paired.", "ms",
+                                    QString::number(options.matchWindowMs));
+    QCommandLineOption noSimdOption("no-simd", "Use the scalar sync scan.");
+    parser.addOptions({threadsOption, chunkOption, bucketOption, windowOption, noSimdOption});
+    parser.process(app);
+
+    QTextStream out(stdout);
+    const QStringList captures = parser.positionalArguments();
+    if (captures.size() != 1) {
+        parser.showHelp(2);
+    }
+
+    options.threads = parser.value(threadsOption).toInt();
+    options.chunkBytes = qMax<qint64>(1, parser.value(chunkOption).toLongLong()) << 20;
+    options.bucketSeconds = qMax<qint64>(1, parser.value(bucketOption).toLongLong());
+    options.matchWindowMs = qMax<qint64>(1, parser.value(windowOption).toLongLong());
+    options.simd = !parser.isSet(noSimdOption);
+
+    CaptureAnalyzer::Report report;
+    QString errorMessage;
+    if (!CaptureAnalyzer::analyze(captures.first(), options, &report, &errorMessage)) {
+        out << "Capture analyzer: " << errorMessage << Qt::endl;
+        return 2;
+    }
+
+    out << CaptureAnalyzer::format(report, options);
+    out.flush();
+    return 0;
+}
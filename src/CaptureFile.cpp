@@ -0,0 +1,96 @@
+#include "CaptureFile.h"
+#include "MemoryBudget.h"
+#include "VirtualClock.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QtEndian>
+#include <cstring>
+
+CaptureWriter::CaptureWriter()
+    : m_startNs(0)
+    , m_recordsWritten(0)
+{
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    close();
+}
+
+bool CaptureWriter::open(const QString &fileName, QString *errorMessage)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        *errorMessage = QString("Cannot write %1: %2").arg(fileName, m_file.errorString());
+        return false;
+    }
+
+    char header[CaptureFormat::HEADER_SIZE];
+    std::memcpy(header, CaptureFormat::MAGIC, CaptureFormat::MAGIC_SIZE);
+    qToLittleEndian<qint64>(QDateTime::currentMSecsSinceEpoch(), header + CaptureFormat::MAGIC_SIZE);
+    m_file.write(header, sizeof(header));
+
+    m_startNs = VirtualClock::monotonicNs();
+    m_recordsWritten = 0;
+    MemoryBudget::clear(MemoryBudget::SerialBuffers, &m_buffer);
+    m_buffer.reserve(FLUSH_THRESHOLD_BYTES + CaptureFormat::RECORD_SIZE);
+    qDebug() << "Capturing traffic to" << fileName;
+    return true;
+}
+
+void CaptureWriter::close()
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+    flush();
+    m_file.close();
+    qDebug() << "Capture closed," << m_recordsWritten << "records";
+}
+
+void CaptureWriter::record(CaptureFormat::Direction direction, const QByteArray &data)
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+
+    const qint64 timestampNs = VirtualClock::monotonicNs() - m_startNs;
+    for (int offset = 0; offset < data.size(); offset += CaptureFormat::RECORD_DATA_SIZE) {
+        const int length = qMin(CaptureFormat::RECORD_DATA_SIZE, data.size() - offset);
+
+        char record[CaptureFormat::RECORD_SIZE] = {};
+        qToLittleEndian<qint64>(timestampNs, record);
+        record[8] = static_cast<char>(direction);
+        record[9] = static_cast<char>(length);
+        std::memcpy(record + CaptureFormat::RECORD_DATA_OFFSET, data.constData() + offset, length);
+
+        // Charged to the serial budget until written; over it the buffer goes to disk early
+        if (!MemoryBudget::tryCharge(MemoryBudget::SerialBuffers, sizeof(record))) {
+            flush();
+            if (!MemoryBudget::tryCharge(MemoryBudget::SerialBuffers, sizeof(record))) {
+                MemoryBudget::recordEviction(MemoryBudget::SerialBuffers, sizeof(record));
+                continue;
+            }
+        }
+        m_buffer.append(record, sizeof(record));
+        m_recordsWritten++;
+    }
+
+    if (m_buffer.size() >= FLUSH_THRESHOLD_BYTES) {
+        flush();
+    }
+}
+
+void CaptureWriter::flush()
+{
+    if (m_buffer.isEmpty() || !m_file.isOpen()) {
+        return;
+    }
+    if (m_file.write(m_buffer) != m_buffer.size()) {
+        qDebug() << "Capture write failed:" << m_file.errorString();
+    }
+    m_file.flush();
+    MemoryBudget::clear(MemoryBudget::SerialBuffers, &m_buffer);
+}
@@ -0,0 +1,57 @@
+#ifndef CAPTUREFILE_H
+#define CAPTUREFILE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+// Binary capture of serial traffic. A 16-byte file header (magic, capture
+// start in ms since the epoch) is followed by fixed 16-byte records, so a
+// capture can be split at any record boundary and decoded in parallel:
+//
+//   qint64 timestampNs   little-endian, since capture start
+//   quint8 direction     Tx or Rx
+//   quint8 length        1..RECORD_DATA_SIZE
+//   quint8 data[6]       zero padded
+//
+// Writes longer than six bytes span consecutive records with one timestamp.
+namespace CaptureFormat {
+    const char MAGIC[] = "ASDCAP01";
+    const int MAGIC_SIZE = 8;
+    const int HEADER_SIZE = 16;
+    const int RECORD_SIZE = 16;
+    const int RECORD_DATA_OFFSET = 10;
+    const int RECORD_DATA_SIZE = 6;
+
+    enum Direction : quint8 {
+        Tx = 0,
+        Rx = 1
+    };
+}
+
+class CaptureWriter
+{
+public:
+    CaptureWriter();
+    ~CaptureWriter();
+
+    bool open(const QString &fileName, QString *errorMessage);
+    void close();
+    bool isOpen() const { return m_file.isOpen(); }
+    QString fileName() const { return m_file.fileName(); }
+
+    void record(CaptureFormat::Direction direction, const QByteArray &data);
+    void flush();
+
+    quint64 recordsWritten() const { return m_recordsWritten; }
+
+private:
+    QFile m_file;
+    QByteArray m_buffer;
+    qint64 m_startNs;
+    quint64 m_recordsWritten;
+
+    static const int FLUSH_THRESHOLD_BYTES = 64 * 1024;
+};
+
+#endif // CAPTUREFILE_H
@@ -7,6 +7,10 @@ namespace AppColors {
     const QColor Gold = QColor("#f0b14f");
     const QColor Brown = QColor("#2a2c16");
     const QColor Beige = QColor("#b5945e");
+    // Live panels: link dashboard and memory usage
+    const QColor PanelBackground = QColor("#27201b");
+    const QColor PanelGrid = QColor("#4a3f36");
+    const QColor ErrorRed = QColor("#d9534f");
 }
 
 #endif // COLORS_H
\ No newline at end of file
@@ -0,0 +1,388 @@
+#include "FaultInjectingDevice.h"
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+quint32 thresholdFor(double probability)
+{
+    if (probability <= 0) {
+        return 0;
+    }
+    if (probability >= 1) {
+        return 0xffffffffu;
+    }
+    return static_cast<quint32>(probability * 4294967296.0);
+}
+
+}
+
+bool FaultInjectingDevice::Config::isEnabled() const
+{
+    return corrupt > 0 || drop > 0 || duplicate > 0 || reorder > 0 || delay > 0
+        || partialWrite > 0 || disconnect > 0;
+}
+
+FaultInjectingDevice::FaultInjectingDevice(QIODevice *inner, const Config &config, QObject *parent)
+    : QIODevice(parent)
+    , m_inner(inner)
+    , m_config(config)
+    , m_random(config.seed)
+    , m_writes(0)
+    , m_reads(0)
+    , m_wireWritten(0)
+    , m_releaseAtNs(0)
+{
+    m_thresholds[Corrupt] = thresholdFor(config.corrupt);
+    m_thresholds[Drop] = thresholdFor(config.drop);
+    m_thresholds[Duplicate] = thresholdFor(config.duplicate);
+    m_thresholds[Reorder] = thresholdFor(config.reorder);
+    m_thresholds[Delay] = thresholdFor(config.delay);
+    m_thresholds[PartialWrite] = thresholdFor(config.partialWrite);
+    m_thresholds[Disconnect] = thresholdFor(config.disconnect);
+    std::fill(m_counts, m_counts + FAULT_COUNT, 0);
+
+    m_releaseTimer.setSingleShot(true);
+    m_disconnectTimer.setSingleShot(true);
+    m_disconnectTimer.setInterval(0);
+    connect(&m_releaseTimer, &ClockTimer::timeout, this, &FaultInjectingDevice::releaseDue);
+    connect(&m_disconnectTimer, &ClockTimer::timeout, this, &FaultInjectingDevice::disconnectNow);
+    connect(m_inner, &QIODevice::readyRead, this, &FaultInjectingDevice::handleInnerReadyRead);
+    connect(m_inner, &QIODevice::bytesWritten, this, &FaultInjectingDevice::handleInnerBytesWritten);
+}
+
+FaultInjectingDevice::~FaultInjectingDevice()
+{
+    close();
+}
+
+bool FaultInjectingDevice::parseSpec(const QString &spec, Config *config, QString *errorMessage)
+{
+    Config result = *config;
+    for (const QString &item : spec.split(',', Qt::SkipEmptyParts)) {
+        const QStringList parts = item.split('=');
+        const QString name = parts.first().trimmed();
+        bool ok = parts.size() == 2;
+        const double value = ok ? parts.last().trimmed().toDouble(&ok) : 0;
+        if (!ok) {
+            *errorMessage = QString("Invalid fault %1; expected name=value").arg(item.trimmed());
+            return false;
+        }
+
+        double *probability = nullptr;
+        if (name == "corrupt") {
+            probability = &result.corrupt;
+        } else if (name == "drop") {
+            probability = &result.drop;
+        } else if (name == "duplicate") {
+            probability = &result.duplicate;
+        } else if (name == "reorder") {
+            probability = &result.reorder;
+        } else if (name == "delay") {
+            probability = &result.delay;
+        } else if (name == "partial") {
+            probability = &result.partialWrite;
+        } else if (name == "disconnect") {
+            probability = &result.disconnect;
+        } else if (name == "delay-ms" && value >= 0) {
+            result.delayMs = static_cast<int>(value);
+        } else if (name == "seed" && value >= 0) {
+            result.seed = static_cast<quint32>(value);
+        } else {
+            *errorMessage = QString("Unknown fault %1").arg(item.trimmed());
+            return false;
+        }
+        if (probability) {
+            if (value < 0 || value > 1) {
+                *errorMessage = QString("Fault %1 must be a probability between 0 and 1").arg(name);
+                return false;
+            }
+            *probability = value;
+        }
+    }
+    *config = result;
+    return true;
+}
+
+const char *FaultInjectingDevice::faultName(Fault fault)
+{
+    switch (fault) {
+    case Corrupt:
+        return "corrupt";
+    case Drop:
+        return "drop";
+    case Duplicate:
+        return "duplicate";
+    case Reorder:
+        return "reorder";
+    case Delay:
+        return "delay";
+    case PartialWrite:
+        return "partial";
+    case Disconnect:
+        return "disconnect";
+    case FAULT_COUNT:
+        break;
+    }
+    return "unknown";
+}
+
+QString FaultInjectingDevice::format() const
+{
+    QStringList counts;
+    for (int i = 0; i < FAULT_COUNT; ++i) {
+        counts << QString("%1 %2").arg(QString::fromLatin1(faultName(static_cast<Fault>(i)))).arg(m_counts[i]);
+    }
+    return QString("Faults injected over %1 writes and %2 reads: %3")
+           .arg(m_writes).arg(m_reads).arg(counts.join(", "));
+}
+
+bool FaultInjectingDevice::open(OpenMode mode)
+{
+    if (isOpen()) {
+        return false;
+    }
+    if (!m_inner->isOpen() && !m_inner->open(mode)) {
+        setErrorString(m_inner->errorString());
+        return false;
+    }
+    reset();
+    return QIODevice::open(mode);
+}
+
+void FaultInjectingDevice::close()
+{
+    if (!isOpen()) {
+        return;
+    }
+    QIODevice::close();
+    m_releaseTimer.stop();
+    m_disconnectTimer.stop();
+    reset();
+    if (m_inner->isOpen()) {
+        m_inner->close();
+    }
+}
+
+qint64 FaultInjectingDevice::bytesAvailable() const
+{
+    return m_readBuffer.size() + QIODevice::bytesAvailable();
+}
+
+bool FaultInjectingDevice::waitForReadyRead(int msecs)
+{
+    if (!m_readBuffer.isEmpty()) {
+        return true;
+    }
+    // readyRead from the inner device lands in handleInnerReadyRead
+    m_inner->waitForReadyRead(msecs);
+    return !m_readBuffer.isEmpty();
+}
+
+qint64 FaultInjectingDevice::readData(char *data, qint64 maxSize)
+{
+    const qint64 count = qMin<qint64>(maxSize, m_readBuffer.size());
+    std::memcpy(data, m_readBuffer.constData(), static_cast<size_t>(count));
+    m_readBuffer.remove(0, static_cast<int>(count));
+    return count;
+}
+
+qint64 FaultInjectingDevice::writeData(const char *data, qint64 maxSize)
+{
+    if (!m_inner->isOpen()) {
+        return -1;
+    }
+    m_writes++;
+    qint64 accepted = maxSize;
+    qint64 reported = maxSize;
+    if (maxSize > 1 && hit(PartialWrite)) {
+        accepted = 1 + static_cast<qint64>(m_random() % static_cast<quint32>(maxSize - 1));
+        // TxScheduler does not count a short write as in flight, so nothing is reported for it
+        reported = 0;
+    }
+    inject(Tx, QByteArray(data, static_cast<int>(accepted)), reported);
+
+    // Pulled out after the write, as a cable would be; never from inside it
+    if (!m_disconnectTimer.isActive() && hit(Disconnect)) {
+        m_disconnectTimer.start();
+    }
+    return accepted;
+}
+
+void FaultInjectingDevice::handleInnerReadyRead()
+{
+    if (!isOpen()) {
+        return;
+    }
+    const QByteArray bytes = m_inner->readAll();
+    if (bytes.isEmpty()) {
+        return;
+    }
+    m_reads++;
+    inject(Rx, bytes, 0);
+}
+
+void FaultInjectingDevice::handleInnerBytesWritten(qint64 bytes)
+{
+    if (!isOpen()) {
+        return;
+    }
+    // Report the host's bytes, not the inner ones, once a write is fully out
+    qint64 hostBytes = 0;
+    m_wireWritten += bytes;
+    while (!m_pendingWrites.isEmpty() && m_wireWritten >= m_pendingWrites.head().wireBytes) {
+        m_wireWritten -= m_pendingWrites.head().wireBytes;
+        hostBytes += m_pendingWrites.dequeue().hostBytes;
+    }
+    if (hostBytes > 0) {
+        emit bytesWritten(hostBytes);
+    }
+}
+
+bool FaultInjectingDevice::hit(Fault fault)
+{
+    // Compared against the raw output: mt19937 is fully specified, the std distributions are not
+    if (m_thresholds[fault] == 0 || m_random() >= m_thresholds[fault]) {
+        return false;
+    }
+    m_counts[fault]++;
+    return true;
+}
+
+void FaultInjectingDevice::inject(Direction direction, QByteArray bytes, qint64 hostBytes)
+{
+    Lane &lane = m_lanes[direction];
+    const qint64 now = VirtualClock::monotonicNs();
+
+    if (hit(Drop)) {
+        if (hostBytes > 0) {
+            // Reported from the release timer, not from inside write()
+            m_pendingWrites.enqueue({0, hostBytes});
+            armReleaseTimer();
+        }
+        return;
+    }
+    if (m_thresholds[Corrupt] != 0) {
+        for (int i = 0; i < bytes.size(); ++i) {
+            if (hit(Corrupt)) {
+                bytes[i] = static_cast<char>(bytes.at(i) ^ (1 << (m_random() % 8)));
+            }
+        }
+    }
+    if (hit(Duplicate)) {
+        bytes.append(bytes);
+    }
+
+    Chunk chunk;
+    chunk.bytes = bytes;
+    chunk.hostBytes = hostBytes;
+    chunk.dueNs = hit(Delay) ? now + static_cast<qint64>(m_config.delayMs) * 1000000 : now;
+    chunk.dueNs = qMax(chunk.dueNs, lane.lastDueNs);
+    lane.lastDueNs = chunk.dueNs;
+
+    if (!lane.holding && hit(Reorder)) {
+        lane.holding = true;
+        lane.held = chunk;
+        lane.heldUntilNs = now + static_cast<qint64>(REORDER_HOLD_MS) * 1000000;
+    } else {
+        lane.pending.enqueue(chunk);
+        if (lane.holding) {
+            lane.held.dueNs = chunk.dueNs;
+            lane.pending.enqueue(lane.held);
+            lane.holding = false;
+        }
+    }
+
+    releaseLanes();
+    armReleaseTimer();
+}
+
+void FaultInjectingDevice::deliver(Direction direction, const Chunk &chunk)
+{
+    if (direction == Tx) {
+        // Queued first in case the inner device reports bytesWritten from inside write()
+        m_pendingWrites.enqueue({chunk.bytes.size(), chunk.hostBytes});
+        const qint64 written = m_inner->write(chunk.bytes);
+        if (written != chunk.bytes.size()) {
+            m_pendingWrites.last().wireBytes = qMax<qint64>(0, written);
+        }
+    } else {
+        m_readBuffer.append(chunk.bytes);
+        emit readyRead();
+    }
+}
+
+void FaultInjectingDevice::releaseDue()
+{
+    if (!isOpen()) {
+        return;
+    }
+    releaseLanes();
+    // Settles dropped writes that have no inner bytes to wait for
+    handleInnerBytesWritten(0);
+    armReleaseTimer();
+}
+
+void FaultInjectingDevice::releaseLanes()
+{
+    const qint64 now = VirtualClock::monotonicNs();
+    for (int i = 0; i < DIRECTION_COUNT; ++i) {
+        Lane &lane = m_lanes[i];
+        if (lane.holding && lane.heldUntilNs <= now) {
+            // Nothing came along to swap with
+            lane.pending.enqueue(lane.held);
+            lane.holding = false;
+        }
+        while (!lane.pending.isEmpty() && lane.pending.head().dueNs <= now) {
+            deliver(static_cast<Direction>(i), lane.pending.dequeue());
+        }
+    }
+}
+
+void FaultInjectingDevice::armReleaseTimer()
+{
+    qint64 nextNs = -1;
+    if (!m_pendingWrites.isEmpty() && m_pendingWrites.head().wireBytes == 0) {
+        nextNs = VirtualClock::monotonicNs();
+    }
+    for (const Lane &lane : m_lanes) {
+        if (!lane.pending.isEmpty()) {
+            nextNs = nextNs < 0 ? lane.pending.head().dueNs : qMin(nextNs, lane.pending.head().dueNs);
+        }
+        if (lane.holding) {
+            nextNs = nextNs < 0 ? lane.heldUntilNs : qMin(nextNs, lane.heldUntilNs);
+        }
+    }
+    if (nextNs < 0) {
+        return;
+    }
+    // Round up: firing early would find nothing due and re-arm for 0 ms
+    const qint64 delayNs = qMax<qint64>(0, nextNs - VirtualClock::monotonicNs());
+    const int delayMs = static_cast<int>((delayNs + 999999) / 1000000);
+    if (!m_releaseTimer.isActive() || nextNs < m_releaseAtNs) {
+        m_releaseAtNs = nextNs;
+        m_releaseTimer.start(delayMs);
+    }
+}
+
+void FaultInjectingDevice::disconnectNow()
+{
+    if (!isOpen()) {
+        return;
+    }
+    setErrorString("Injected disconnect");
+    qDebug() << "Fault injection: disconnecting";
+    // SerialCommunication treats aboutToClose as a lost link
+    close();
+}
+
+void FaultInjectingDevice::reset()
+{
+    for (Lane &lane : m_lanes) {
+        lane = Lane();
+    }
+    m_readBuffer.clear();
+    m_pendingWrites.clear();
+    m_wireWritten = 0;
+}
@@ -0,0 +1,132 @@
+#ifndef FAULTINJECTINGDEVICE_H
+#define FAULTINJECTINGDEVICE_H
+
+#include <QIODevice>
+#include <QQueue>
+#include <QStringList>
+#include <random>
+#include "VirtualClock.h"
+
+// Decorator that sits between SerialCommunication and a real or simulated
+// port and misbehaves on purpose: bytes are corrupted, chunks dropped,
+// duplicated, swapped or held back, writes cut short and the line pulled
+// out from under the link. Every fault is drawn from a seeded mt19937, and
+// all timing runs on ClockTimer, so a simulated run with the same seed
+// injects the same faults at the same virtual times.
+class FaultInjectingDevice : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    static const int DEFAULT_DELAY_MS = 200;
+    static const int REORDER_HOLD_MS = 50;     // A held chunk goes out on its own after this
+    static const int RECONNECT_MS = 1000;      // Harnesses reopen the port this long after a disconnect
+
+    enum Fault {
+        Corrupt,                               // Counted per byte
+        Drop,
+        Duplicate,
+        Reorder,
+        Delay,
+        PartialWrite,
+        Disconnect,
+        FAULT_COUNT
+    };
+
+    // Probabilities in [0, 1]. Corruption is drawn per byte, partial writes and
+    // disconnects per write, everything else per chunk in either direction: one
+    // write() on the way out, one read from the inner device on the way in.
+    struct Config {
+        quint32 seed = 1;
+        double corrupt = 0;
+        double drop = 0;
+        double duplicate = 0;
+        double reorder = 0;
+        double delay = 0;
+        int delayMs = DEFAULT_DELAY_MS;        // Latency spike; holds back everything behind it
+        double partialWrite = 0;
+        double disconnect = 0;
+
+        bool isEnabled() const;
+    };
+
+    FaultInjectingDevice(QIODevice *inner, const Config &config, QObject *parent = nullptr);
+    ~FaultInjectingDevice();
+
+    // "drop=0.01,corrupt=0.0001,delay=0.02,delay-ms=300,seed=7"; unnamed fields are left alone
+    static bool parseSpec(const QString &spec, Config *config, QString *errorMessage);
+    static const char *faultName(Fault fault);
+
+    QIODevice *inner() const { return m_inner; }
+    quint64 count(Fault fault) const { return m_counts[fault]; }
+    quint64 writes() const { return m_writes; }
+    quint64 reads() const { return m_reads; }
+    QString format() const;
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override;
+    bool waitForReadyRead(int msecs) override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private slots:
+    void handleInnerReadyRead();
+    void handleInnerBytesWritten(qint64 bytes);
+    void releaseDue();
+    void disconnectNow();
+
+private:
+    enum Direction {
+        Tx,
+        Rx,
+        DIRECTION_COUNT
+    };
+
+    struct Chunk {
+        QByteArray bytes;
+        qint64 dueNs = 0;
+        qint64 hostBytes = 0;                  // Reported in bytesWritten once on the wire; TX only
+    };
+
+    // Chunks of one direction in line order; a chunk is never released ahead of the one before it
+    struct Lane {
+        QQueue<Chunk> pending;
+        qint64 lastDueNs = 0;
+        bool holding = false;                  // A reordered chunk waits for the next one
+        Chunk held;
+        qint64 heldUntilNs = 0;
+    };
+
+    struct PendingWrite {
+        qint64 wireBytes;
+        qint64 hostBytes;
+    };
+
+    QIODevice *m_inner;
+    Config m_config;
+    std::mt19937 m_random;
+    quint32 m_thresholds[FAULT_COUNT];         // Probability scaled to the generator's range
+    quint64 m_counts[FAULT_COUNT];
+    quint64 m_writes;
+    quint64 m_reads;
+    Lane m_lanes[DIRECTION_COUNT];
+    QByteArray m_readBuffer;
+    QQueue<PendingWrite> m_pendingWrites;
+    qint64 m_wireWritten;                      // Inner bytes of the head write already out
+    ClockTimer m_releaseTimer;
+    qint64 m_releaseAtNs;                      // When m_releaseTimer is due
+    ClockTimer m_disconnectTimer;
+
+    bool hit(Fault fault);
+    void inject(Direction direction, QByteArray bytes, qint64 hostBytes);
+    void releaseLanes();
+    void deliver(Direction direction, const Chunk &chunk);
+    void armReleaseTimer();
+    void reset();
+};
+
+#endif // FAULTINJECTINGDEVICE_H
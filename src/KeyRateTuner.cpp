@@ -0,0 +1,374 @@
+#include "KeyRateTuner.h"
+#include "KeypressCommands.h"
+#include "SerialCommunication.h"
+#include "SimulatedVmc.h"
+#include "VmcProfile.h"
+#include <QDebug>
+#include <QEventLoop>
+#include <QLoggingCategory>
+#include <QSettings>
+#include <QTextStream>
+#include <memory>
+
+bool KeyRateTuner::Trial::passed() const
+{
+    return failed == 0 && retried == 0 && acked == keysSent && readBack == expected;
+}
+
+QString KeyRateTuner::Trial::format() const
+{
+    return QString("%1 ms: %2 keys, %3 acked, %4 retried, %5 failed, read back \"%6\" for \"%7\" - %8")
+           .arg(intervalMs, 5).arg(keysSent).arg(acked).arg(retried).arg(failed)
+           .arg(readBack, expected, passed() ? QString("reliable") : QString("unreliable"));
+}
+
+QStringList KeyRateTuner::Result::format() const
+{
+    QStringList lines;
+    lines << QString("Key rate on %1 (profile %2), %3 trials in %4 s")
+             .arg(portName, profileName).arg(trials.size()).arg(durationMs / 1000.0, 0, 'f', 1);
+    for (const Trial &trial : trials) {
+        lines << "  " + trial.format();
+    }
+    if (!isValid()) {
+        lines << "Key rate: " + error;
+        return lines;
+    }
+    if (slowestFailedMs > 0) {
+        lines << QString("Fastest reliable interval %1 ms (%2 ms dropped keys)")
+                 .arg(fastestReliableMs).arg(slowestFailedMs);
+    } else {
+        lines << QString("Fastest reliable interval %1 ms, the fastest tried").arg(fastestReliableMs);
+    }
+    lines << QString("Recommended interval %1 ms, %2 keys/s")
+             .arg(recommendedIntervalMs).arg(1000.0 / recommendedIntervalMs, 0, 'f', 1);
+    return lines;
+}
+
+KeyRateTuner::KeyRateTuner(SerialCommunication *serial, KeypressCommands *keypress, QObject *parent)
+    : QObject(parent)
+    , m_serial(serial)
+    , m_keypress(keypress)
+    , m_autoKeypress(nullptr)
+    , m_state(Idle)
+    , m_startedNs(0)
+    , m_settleDeadlineNs(0)
+    , m_previousReliable(false)
+    , m_previousWindow(1)
+    , m_nextKey(0)
+    , m_fastestPassMs(0)
+    , m_slowestFailMs(0)
+    , m_nextIntervalMs(0)
+{
+    m_waitTimer.setSingleShot(true);
+    connect(&m_keyTimer, &ClockTimer::timeout, this, &KeyRateTuner::sendNextKey);
+    connect(&m_waitTimer, &ClockTimer::timeout, this, &KeyRateTuner::handleWaitTimeout);
+    connect(m_serial, &SerialCommunication::frameReceived, &m_vmcState, &VmcStateCache::handleFrame);
+    connect(m_serial, &SerialCommunication::frameDelivered, this, &KeyRateTuner::handleDelivered);
+    connect(m_serial, &SerialCommunication::frameFailed, this, &KeyRateTuner::handleFailed);
+    connect(m_serial->reliableLink(), &ReliableLink::delivered, this, &KeyRateTuner::handleRetried);
+    connect(m_serial, &SerialCommunication::portStatusChanged, this, [this](bool isOpen) {
+        if (!isOpen && isRunning()) {
+            finish("the port closed");
+        }
+    });
+}
+
+bool KeyRateTuner::start(const Options &options, QString *errorMessage)
+{
+    if (isRunning()) {
+        *errorMessage = "tuning is already in progress";
+        return false;
+    }
+    if (!m_serial->isPortOpen()) {
+        *errorMessage = "the port is not open";
+        return false;
+    }
+    if (m_autoKeypress && m_autoKeypress->isRunning()) {
+        *errorMessage = "Auto Keypress is running; stop it first";
+        return false;
+    }
+    if (m_serial->reliableLink()->pendingCount() > 0) {
+        *errorMessage = QString("%1 frames from another job still await acks; let it finish first")
+                        .arg(m_serial->reliableLink()->pendingCount());
+        return false;
+    }
+
+    m_options = options;
+    m_options.minIntervalMs = qMax(1, m_options.minIntervalMs);
+    m_options.startIntervalMs = qMax(m_options.minIntervalMs, m_options.startIntervalMs);
+    m_options.keysPerTrial = qMax(2, m_options.keysPerTrial);
+    m_options.resolutionMs = qMax(1, m_options.resolutionMs);
+
+    m_result = Result();
+    m_result.portName = m_serial->getCurrentPortName().split(" ").first();
+    m_result.profileName = VmcProfile::current()->name();
+    m_result.startedAt = QDateTime::currentDateTime();
+    m_startedNs = VirtualClock::monotonicNs();
+    m_fastestPassMs = 0;
+    m_slowestFailMs = 0;
+
+    // Pairs of the same digit: a keypad that is still debouncing merges those first
+    m_keys = {"*"};
+    for (int i = 0; i < m_options.keysPerTrial; ++i) {
+        m_keys.append(QString::number((i / 2 + 1) % 10));
+    }
+
+    // Acks are what tell a lost key from a slow one. The whole trial may be in
+    // flight, so keys leave at the trial interval rather than one per round trip.
+    m_previousReliable = m_serial->isReliableDeliveryEnabled();
+    m_serial->setReliableDelivery(true);
+    m_previousWindow = m_serial->reliableLink()->windowSize();
+    m_serial->reliableLink()->setWindowSize(m_keys.size());
+
+    qDebug() << "Tuning key rate on" << m_result.portName << "from" << m_options.startIntervalMs << "ms down to"
+             << m_options.minIntervalMs << "ms";
+    startTrial(m_options.startIntervalMs);
+    return true;
+}
+
+void KeyRateTuner::cancel()
+{
+    if (isRunning()) {
+        finish("cancelled");
+    }
+}
+
+bool KeyRateTuner::isKeyFrame(const QByteArray &frame)
+{
+    return frame.size() == VmcProtocol::FRAME_SIZE
+           && VmcProfile::current()->commandClass(static_cast<quint8>(frame.at(1))) == VmcProfile::KeypadCommand;
+}
+
+void KeyRateTuner::startTrial(int intervalMs)
+{
+    m_trial = Trial();
+    m_trial.intervalMs = intervalMs;
+    for (int i = 1; i < m_keys.size(); ++i) {
+        m_trial.expected += m_keys.at(i);
+    }
+    m_nextKey = 0;
+    m_state = Typing;
+    m_keyTimer.start(intervalMs);
+    sendNextKey();
+}
+
+void KeyRateTuner::sendNextKey()
+{
+    if (m_state != Typing) {
+        return;
+    }
+    if (m_nextKey < m_keys.size()) {
+        m_trial.keysSent++;
+        if (!m_keypress->sendKey(m_keys.at(m_nextKey++), TxPriority::Automation)) {
+            m_trial.failed++;
+        }
+        return;
+    }
+
+    m_keyTimer.stop();
+    m_state = Settling;
+    m_settleDeadlineNs = VirtualClock::monotonicNs() + static_cast<qint64>(m_options.settleMs) * 1000000;
+    m_waitTimer.start(SETTLE_POLL_MS);
+}
+
+void KeyRateTuner::handleWaitTimeout()
+{
+    if (m_state == Settling) {
+        const bool resolved = m_trial.acked + m_trial.failed >= m_trial.keysSent;
+        if (!resolved && VirtualClock::monotonicNs() < m_settleDeadlineNs) {
+            m_waitTimer.start(SETTLE_POLL_MS);
+            return;
+        }
+        finishTrial();
+    } else if (m_state == Resting) {
+        startTrial(m_nextIntervalMs);
+    }
+}
+
+void KeyRateTuner::handleDelivered(const QByteArray &frame)
+{
+    if (m_state == Typing || m_state == Settling) {
+        if (isKeyFrame(frame)) {
+            m_trial.acked++;
+        }
+    }
+}
+
+void KeyRateTuner::handleFailed(const QByteArray &frame)
+{
+    if (m_state == Typing || m_state == Settling) {
+        if (isKeyFrame(frame)) {
+            m_trial.failed++;
+        }
+    }
+}
+
+void KeyRateTuner::handleRetried(const QByteArray &frame, qint64 rttMs, int retries)
+{
+    Q_UNUSED(rttMs);
+    if ((m_state == Typing || m_state == Settling) && retries > 0 && isKeyFrame(frame)) {
+        m_trial.retried++;
+    }
+}
+
+void KeyRateTuner::finishTrial()
+{
+    m_trial.readBack = m_vmcState.selectionEntry();
+    m_result.trials.append(m_trial);
+    qDebug() << "Key rate trial" << m_trial.format();
+    emit trialFinished(m_trial);
+
+    const int interval = m_trial.intervalMs;
+    if (m_trial.passed()) {
+        m_fastestPassMs = interval;
+    } else {
+        m_slowestFailMs = interval;
+    }
+
+    if (m_fastestPassMs == 0) {
+        finish(QString("keys are lost even %1 ms apart; check the link and the keymap first").arg(interval));
+        return;
+    }
+    int next = 0;
+    if (m_slowestFailMs == 0) {
+        // Still ramping down: nothing has failed yet
+        if (m_fastestPassMs > m_options.minIntervalMs) {
+            next = qMax(m_options.minIntervalMs, m_fastestPassMs / 2);
+        }
+    } else if (m_fastestPassMs - m_slowestFailMs > m_options.resolutionMs) {
+        next = (m_fastestPassMs + m_slowestFailMs) / 2;
+    }
+    if (next == 0) {
+        finish(QString());
+        return;
+    }
+
+    // Let the keypad and the link go quiet, so one trial's backlog is not the next one's failure
+    m_nextIntervalMs = next;
+    m_state = Resting;
+    m_waitTimer.start(m_options.settleMs);
+}
+
+void KeyRateTuner::finish(const QString &error)
+{
+    m_keyTimer.stop();
+    m_waitTimer.stop();
+    m_state = Idle;
+    m_serial->reliableLink()->setWindowSize(m_previousWindow);
+    m_serial->setReliableDelivery(m_previousReliable);
+
+    m_result.durationMs = (VirtualClock::monotonicNs() - m_startedNs) / 1000000;
+    m_result.error = error;
+    if (error.isEmpty()) {
+        m_result.fastestReliableMs = m_fastestPassMs;
+        m_result.slowestFailedMs = m_slowestFailMs;
+        // Never slower than the interval that was already known to work
+        m_result.recommendedIntervalMs = qMin(m_options.startIntervalMs,
+                                              (m_fastestPassMs * (100 + m_options.marginPercent) + 99) / 100);
+    }
+    emit finished();
+}
+
+void KeyRateTuner::saveResult(const Result &result)
+{
+    QSettings settings("YourCompany", "asdKeypad");
+    settings.beginGroup(QString("Ports/%1/KeyRate").arg(result.portName));
+    settings.setValue("Time", result.startedAt);
+    settings.setValue("Profile", result.profileName);
+    settings.setValue("FastestReliableMs", result.fastestReliableMs);
+    settings.setValue("SlowestFailedMs", result.slowestFailedMs);
+    settings.setValue("IntervalMs", result.recommendedIntervalMs);
+    settings.endGroup();
+}
+
+int KeyRateTuner::savedInterval(const QString &portName)
+{
+    QSettings settings("YourCompany", "asdKeypad");
+    settings.beginGroup(QString("Ports/%1/KeyRate").arg(portName.split(" ").first()));
+    const int interval = settings.value("IntervalMs", 0).toInt();
+    const QString profile = settings.value("Profile").toString();
+    settings.endGroup();
+
+    // Another VMC model or firmware on the same port may be slower
+    if (interval > 0 && profile != VmcProfile::current()->name()) {
+        qDebug() << "Key rate for" << portName << "was tuned under profile" << profile << "- not used";
+        return 0;
+    }
+    return interval;
+}
+
+int KeyRateTuner::run(const Options &options)
+{
+    QTextStream out(stdout);
+
+    // Per-key debug logging would dominate the run time
+    QLoggingCategory::setFilterRules("default.debug=false");
+
+    const bool simulated = options.port == "SIM";
+    VirtualClock clock;
+    std::unique_ptr<SimulatedVmc> vmc;
+    if (simulated) {
+        VirtualClock::setActive(&clock);
+        SimulatedVmc::Config vmcConfig;
+        vmcConfig.seed = options.seed;
+        vmcConfig.minKeyIntervalMs = options.simulatedKeyIntervalMs;
+        vmc.reset(new SimulatedVmc(&clock, vmcConfig));
+        vmc->open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+    }
+
+    Result result;
+    {
+        SerialCommunication serial;
+        KeypressCommands keypress(&serial);
+
+        const bool opened = simulated ? serial.openDevice(vmc.get(), "SIM")
+                                      : serial.openPort(options.port, SerialCommunication::configForPort(options.port));
+        if (!opened) {
+            out << "Key rate: cannot open " << options.port << ": " << serial.getLastError() << Qt::endl;
+            VirtualClock::setActive(nullptr);
+            return 2;
+        }
+
+        KeyRateTuner tuner(&serial, &keypress);
+        QObject::connect(&tuner, &KeyRateTuner::trialFinished, [&](const Trial &trial) {
+            out << trial.format() << Qt::endl;
+        });
+
+        QString startError;
+        if (!tuner.start(options, &startError)) {
+            out << "Key rate: " << startError << Qt::endl;
+            serial.closePort();
+            VirtualClock::setActive(nullptr);
+            return 2;
+        }
+        if (simulated) {
+            while (tuner.isRunning() && clock.runNext()) {
+            }
+        } else if (tuner.isRunning()) {
+            QEventLoop loop;
+            QObject::connect(&tuner, &KeyRateTuner::finished, &loop, &QEventLoop::quit);
+            loop.exec();
+        }
+
+        serial.disconnect();
+        serial.closePort();
+        result = tuner.result();
+    }
+    VirtualClock::setActive(nullptr);
+
+    out << Qt::endl;
+    const QStringList lines = result.format();
+    // The trials were printed as they finished
+    out << lines.first() << Qt::endl;
+    for (int i = 1 + result.trials.size(); i < lines.size(); ++i) {
+        out << lines.at(i) << Qt::endl;
+    }
+    if (!result.isValid()) {
+        return 1;
+    }
+    if (!simulated) {
+        saveResult(result);
+    }
+    return 0;
+}
@@ -0,0 +1,140 @@
+#ifndef KEYRATETUNER_H
+#define KEYRATETUNER_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QStringList>
+#include <QVector>
+#include "AutoKeypress.h"
+#include "VirtualClock.h"
+#include "VmcStateCache.h"
+
+class KeypressCommands;
+class SerialCommunication;
+
+// Finds the shortest interval between keys a VMC reliably registers. Each
+// trial clears the selection entry with '*' and types a row of digits at the
+// trial interval; it passes when every key is acknowledged first time and the
+// selection entry the VMC echoed back reads exactly the digits typed. The
+// interval is halved until a trial fails, then binary-searched between the
+// fastest pass and the slowest failure. The result, with a safety margin, is
+// saved per port and VMC profile and used by AutoKeypress.
+class KeyRateTuner : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int DEFAULT_MIN_INTERVAL_MS = 20;
+    static const int DEFAULT_KEYS_PER_TRIAL = 16;
+    static const int DEFAULT_RESOLUTION_MS = 5;
+    static const int DEFAULT_SETTLE_MS = 1000;
+    static const int DEFAULT_MARGIN_PERCENT = 20;
+
+    struct Options {
+        QString port;                  // Headless only; "SIM" tunes SimulatedVmc on a virtual clock
+        int startIntervalMs = AutoKeypress::DEFAULT_INTERVAL_MS;  // Must pass, or tuning fails
+        int minIntervalMs = DEFAULT_MIN_INTERVAL_MS;
+        int keysPerTrial = DEFAULT_KEYS_PER_TRIAL;
+        int resolutionMs = DEFAULT_RESOLUTION_MS;
+        int settleMs = DEFAULT_SETTLE_MS;          // Wait for acks after a trial, and quiet time before the next
+        int marginPercent = DEFAULT_MARGIN_PERCENT;
+        int simulatedKeyIntervalMs = 0;            // SIM: see SimulatedVmc::Config::minKeyIntervalMs
+        quint32 seed = 1;
+    };
+
+    struct Trial {
+        int intervalMs = 0;
+        int keysSent = 0;
+        int acked = 0;
+        int failed = 0;                // Send refused, or never acknowledged
+        int retried = 0;               // Acknowledged only after a retransmission
+        QString expected;
+        QString readBack;              // Selection entry echoed by the VMC
+
+        bool passed() const;
+        QString format() const;
+    };
+
+    struct Result {
+        QString portName;
+        QString profileName;
+        QDateTime startedAt;
+        qint64 durationMs = 0;
+        QString error;                 // Set when no reliable interval was found
+        int fastestReliableMs = 0;
+        int slowestFailedMs = 0;       // 0 if even minIntervalMs passed
+        int recommendedIntervalMs = 0; // fastestReliableMs plus the margin
+        QVector<Trial> trials;
+
+        bool isValid() const { return error.isEmpty(); }
+        QStringList format() const;
+    };
+
+    KeyRateTuner(SerialCommunication *serial, KeypressCommands *keypress, QObject *parent = nullptr);
+
+    // Tuning takes over the link's window and ack mode, so it refuses to start
+    // while Auto Keypress runs or other frames are still awaiting acks
+    void setAutomation(AutoKeypress *autoKeypress) { m_autoKeypress = autoKeypress; }
+    bool start(const Options &options, QString *errorMessage);
+    void cancel();
+    bool isRunning() const { return m_state != Idle; }
+    Result result() const { return m_result; }
+
+    // Settings under Ports/<port>/KeyRate
+    static void saveResult(const Result &result);
+    // Saved recommendation for the port, 0 if it was never tuned or was tuned
+    // under a different VMC profile
+    static int savedInterval(const QString &portName);
+
+    // Headless entry point: tunes the port, prints every trial and saves the result
+    static int run(const Options &options);
+
+signals:
+    void trialFinished(const KeyRateTuner::Trial &trial);
+    void finished();
+
+private slots:
+    void sendNextKey();
+    void handleWaitTimeout();
+    void handleDelivered(const QByteArray &frame);
+    void handleFailed(const QByteArray &frame);
+    void handleRetried(const QByteArray &frame, qint64 rttMs, int retries);
+
+private:
+    enum State {
+        Idle,
+        Typing,                        // Sending the trial's keys
+        Settling,                      // Waiting for the last acks
+        Resting                        // Quiet time before the next trial
+    };
+
+    static const int SETTLE_POLL_MS = 20;
+
+    SerialCommunication *m_serial;
+    KeypressCommands *m_keypress;
+    AutoKeypress *m_autoKeypress;
+    VmcStateCache m_vmcState;
+    Options m_options;
+    State m_state;
+    ClockTimer m_keyTimer;
+    ClockTimer m_waitTimer;
+    qint64 m_startedNs;
+    qint64 m_settleDeadlineNs;
+    bool m_previousReliable;
+    int m_previousWindow;
+
+    QVector<QString> m_keys;           // '*' then the digits
+    int m_nextKey;
+    int m_fastestPassMs;               // 0 until a trial passes
+    int m_slowestFailMs;               // 0 until a trial fails
+    int m_nextIntervalMs;              // Trial to run once Resting is over
+    Trial m_trial;
+    Result m_result;
+
+    static bool isKeyFrame(const QByteArray &frame);
+    void startTrial(int intervalMs);
+    void finishTrial();
+    void finish(const QString &error);
+};
+
+#endif // KEYRATETUNER_H
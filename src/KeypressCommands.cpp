@@ -1,4 +1,7 @@
 #include "KeypressCommands.h"
+#include "Metrics.h"
+#include "Tracer.h"
+#include "VmcProfile.h"
 #include <QDebug>
 
 KeypressCommands::KeypressCommands(QObject *serialComm, QObject *parent)
@@ -12,133 +15,100 @@ KeypressCommands::KeypressCommands(QObject *serialComm, QObject *parent)
     }
 }
 
-bool KeypressCommands::sendCommand(const QByteArray &command)
+bool KeypressCommands::sendCommand(const QByteArray &command, TxPriority priority)
 {
     if (m_useMockSerial) {
-        return m_mockSerialComm->sendCommand(command);
+        return m_mockSerialComm->sendCommand(command, priority);
     } else {
-        return m_serialComm->sendCommand(command);
+        return m_serialComm->sendCommand(command, priority);
     }
 }
 
-void KeypressCommands::sendKeypress1()
+QByteArray KeypressCommands::keyFrame(const QString &key)
 {
-    QByteArray command = QByteArray::fromHex("0B0003C8D6");
-    if (sendCommand(command)) {
-        logAction("Simulate Key Press 1");
+    // Flat table lookup in the active VMC profile
+    return key.size() == 1 ? VmcProfile::current()->keyFrame(key.at(0)) : QByteArray();
+}
+
+bool KeypressCommands::sendKey(const QString &key, TxPriority priority)
+{
+    TraceSpan span("KeypressCommands::sendKey");
+    QByteArray command = keyFrame(key);
+    if (command.isEmpty()) {
+        errorLog(QString("Unknown key: %1").arg(key));
+        return false;
+    }
+
+    if (sendCommand(command, priority)) {
+        Metrics::instance().keypresses.add();
+        logAction(QString("Simulate Key Press %1").arg(key));
+        emit keySent(key);
+        return true;
     } else {
-        errorLog("Failed to send Key Press 1");
+        Metrics::instance().keypressFailures.add();
+        errorLog(QString("Failed to send Key Press %1").arg(key));
+        return false;
     }
 }
 
+void KeypressCommands::sendKeypress1()
+{
+    sendKey("1");
+}
+
 void KeypressCommands::sendKeypress2()
 {
-    QByteArray command = QByteArray::fromHex("0B00036467");
-    if (sendCommand(command)) {
-        logAction("Simulate Key Press 2");
-    } else {
-        errorLog("Failed to send Key Press 2");
-    }
+    sendKey("2");
 }
 
 void KeypressCommands::sendKeypress3()
 {
-    QByteArray command = QByteArray::fromHex("0B0102505E");
-    if (sendCommand(command)) {
-        logAction("Simulate Key Press 3");
-    } else {
-        errorLog("Failed to send Key Press 3");
-    }
+    sendKey("3");
 }
 
 void KeypressCommands::sendKeypress4()
 {
-    QByteArray command = QByteArray::fromHex("0B0103505F");
-    if (sendCommand(command)) {
-        logAction("Simulate Key Press 4");
-    } else {
-        errorLog("Failed to send Key Press 4");
-    }
+    sendKey("4");
 }
 
 void KeypressCommands::sendKeypress5()
 {
-    QByteArray command = QByteArray::fromHex("0B0202505F");
-    if (sendCommand(command)) {
-        logAction("Simulate Key Press 5");
-    } else {
-        errorLog("Failed to send Key Press 5");
-    }
+    sendKey("5");
 }
 
 void KeypressCommands::sendKeypress6()
 {
-    QByteArray command = QByteArray::fromHex("0B02035060");
-    if (sendCommand(command)) {
-        logAction("Simulate Key Press 6");
-    } else {
-        errorLog("Failed to send Key Press 6");
-    }
+    sendKey("6");
 }
 
 void KeypressCommands::sendKeypress7()
 {
-    QByteArray command = QByteArray::fromHex("0B03025060");
-    if (sendCommand(command)) {
-        logAction("Simulate Key Press 7");
-    } else {
-        errorLog("Failed to send Key Press 7");
-    }
+    sendKey("7");
 }
 
 void KeypressCommands::sendKeypress8()
 {
-    QByteArray command = QByteArray::fromHex("0B03035061");
-    if (sendCommand(command)) {
-        logAction("Simulate Key Press 8");
-    } else {
-        errorLog("Failed to send Key Press 8");
-    }
+    sendKey("8");
 }
 
 void KeypressCommands::sendKeypress9()
 {
-    QByteArray command = QByteArray::fromHex("0B04025061");
-    if (sendCommand(command)) {
-        logAction("Simulate Key Press 9");
-    } else {
-        errorLog("Failed to send Key Press 9");
-    }
+    sendKey("9");
 }
 
 void KeypressCommands::sendKeypress0()
 {
-    QByteArray command = QByteArray::fromHex("0B04035062");
-    if (sendCommand(command)) {
-        logAction("Simulate Key Press 0");
-    } else {
-        errorLog("Failed to send Key Press 0");
-    }
+    sendKey("0");
 }
 
 void KeypressCommands::sendKeypressStar()
 {
-    QByteArray command = QByteArray::fromHex("0B0400505F");
-    if (sendCommand(command)) {
-        logAction("Simulate Key Press *");
-    } else {
-        errorLog("Failed to send Key Press *");
-    }
+    sendKey("*");
 }
 
 void KeypressCommands::sendKeypressHash()
 {
-    QByteArray command = QByteArray::fromHex("0B04015060");
-    if (sendCommand(command)) {
-        logAction("Simulate Key Press #");
-    } else {
-        errorLog("Failed to send Key Press #");
-    }
+    sendKey("#");
 }
 
 void KeypressCommands::logAction(const QString &action)
@@ -155,12 +125,15 @@ void KeypressCommands::errorLog(const QString &error)
 
 bool KeypressCommands::sendSetPriceCommand(int price)
 {
-    // Assuming the price-setting command is 0x10 followed by the price as a byte
-    QByteArray command;
-    command.append(static_cast<char>(0x10));  // Price-setting command
-    command.append(static_cast<char>(price)); // Price as a byte
+    // Selection 0 applies the price to every selection
+    QByteArray command = VmcProfile::current()->encodePrice(0, price);
+    if (command.isEmpty()) {
+        errorLog(QString("Price out of range: %1 cents").arg(price));
+        return false;
+    }
 
     if (sendCommand(command)) {
+        Metrics::instance().priceCommands.add();
         logAction(QString("Sent Set Price command: %1 cents").arg(price));
         return true;
     } else {
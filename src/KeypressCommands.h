@@ -12,6 +12,9 @@ class KeypressCommands : public QObject
 public:
     explicit KeypressCommands(QObject *serialComm, QObject *parent = nullptr);
 
+    bool sendKey(const QString &key, TxPriority priority = TxPriority::Operator);
+    static QByteArray keyFrame(const QString &key);
+
 public slots:
     void sendKeypress1();
     void sendKeypress2();
@@ -27,13 +30,16 @@ public slots:
     void sendKeypressHash();
     bool sendSetPriceCommand(int price);
 
+signals:
+    void keySent(const QString &key);
+
 private:
     SerialCommunication *m_serialComm;
     MockSerialCommunication *m_mockSerialComm;
     bool m_useMockSerial;
     void logAction(const QString &action);
     void errorLog(const QString &error);
-    bool sendCommand(const QByteArray &command);
+    bool sendCommand(const QByteArray &command, TxPriority priority = TxPriority::Operator);
 };
 
 #endif // KEYPRESSCOMMANDS_H
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include "LatencyHistogram.h"
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::record(qint64 latencyMs)
+{
+    int index = 0;
+    while (index < BUCKET_COUNT - 1 && latencyMs >= bucketUpperBoundMs(index)) {
+        index++;
+    }
+    m_buckets[index].fetch_add(1, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::reset()
+{
+    for (std::atomic<quint64> &bucket : m_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        m_buckets[i].fetch_add(other.bucket(i), std::memory_order_relaxed);
+    }
+}
+
+quint64 LatencyHistogram::count() const
+{
+    quint64 total = 0;
+    for (const std::atomic<quint64> &bucket : m_buckets) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+quint64 LatencyHistogram::bucket(int index) const
+{
+    return m_buckets[index].load(std::memory_order_relaxed);
+}
+
+qint64 LatencyHistogram::percentile(double fraction) const
+{
+    // Reported as the upper bound of the bucket holding the percentile
+    quint64 total = count();
+    if (total == 0) {
+        return 0;
+    }
+
+    quint64 target = static_cast<quint64>(fraction * total);
+    quint64 seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        seen += bucket(i);
+        if (seen > target) {
+            return bucketUpperBoundMs(i);
+        }
+    }
+    return bucketUpperBoundMs(BUCKET_COUNT - 1);
+}
+
+qint64 LatencyHistogram::bucketUpperBoundMs(int index)
+{
+    return Q_INT64_C(1) << index;
+}
@@ -0,0 +1,30 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QtGlobal>
+#include <atomic>
+
+// Lock-free log2 histogram of millisecond latencies. Bucket 0 holds samples
+// below 1 ms, bucket i holds [2^(i-1), 2^i) ms; the last bucket is open-ended.
+class LatencyHistogram
+{
+public:
+    static const int BUCKET_COUNT = 18;
+
+    LatencyHistogram();
+
+    void record(qint64 latencyMs);
+    void reset();
+    void merge(const LatencyHistogram &other);
+
+    quint64 count() const;
+    quint64 bucket(int index) const;
+    qint64 percentile(double fraction) const;
+
+    static qint64 bucketUpperBoundMs(int index);
+
+private:
+    std::atomic<quint64> m_buckets[BUCKET_COUNT];
+};
+
+#endif // LATENCYHISTOGRAM_H
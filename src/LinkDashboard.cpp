@@ -0,0 +1,193 @@
+#include "LinkDashboard.h"
+#include "Colors.h"
+#include <QPainter>
+#include <QPolygonF>
+#include <algorithm>
+
+namespace {
+
+const QColor KEYPRESS_BLUE("#2c4acc");
+
+qint64 percentile(QVector<qint64> &values, double fraction)
+{
+    int index = qMin(values.size() - 1, static_cast<int>(fraction * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values.at(index);
+}
+
+}
+
+LinkDashboard::LinkDashboard(QWidget *parent)
+    : QWidget(parent)
+{
+    setMinimumWidth(260);
+    m_tickTimer.setInterval(1000);
+    connect(&m_tickTimer, &QTimer::timeout, this, &LinkDashboard::advance);
+    m_tickTimer.start();
+}
+
+QSize LinkDashboard::sizeHint() const
+{
+    return QSize(320, 400);
+}
+
+void LinkDashboard::setPort(const QString &portName)
+{
+    m_port = portName;
+    series(m_port);
+    update();
+}
+
+LinkDashboard::Series &LinkDashboard::series(const QString &portName)
+{
+    auto it = m_series.find(portName);
+    if (it == m_series.end()) {
+        Series created;
+        created.ring.resize(HISTORY_SECONDS);
+        created.latencies.reserve(MAX_LATENCIES_PER_SECOND);
+        it = m_series.insert(portName, created);
+    }
+    return it.value();
+}
+
+void LinkDashboard::recordLatency(qint64 latencyMs)
+{
+    Series &current = series(m_port);
+    if (current.latencies.size() < MAX_LATENCIES_PER_SECOND) {
+        current.latencies.append(latencyMs);
+    }
+}
+
+void LinkDashboard::recordKeypress()
+{
+    series(m_port).keypresses++;
+}
+
+void LinkDashboard::recordError()
+{
+    series(m_port).errors++;
+}
+
+void LinkDashboard::advance()
+{
+    for (Series &current : m_series) {
+        Sample &sample = current.ring[current.next];
+        sample = Sample();
+        if (!current.latencies.isEmpty()) {
+            sample.p50 = percentile(current.latencies, 0.50);
+            sample.p95 = percentile(current.latencies, 0.95);
+            sample.p99 = percentile(current.latencies, 0.99);
+        }
+        sample.keypresses = current.keypresses;
+        sample.errors = current.errors;
+
+        current.next = (current.next + 1) % HISTORY_SECONDS;
+        current.latencies.clear();
+        current.keypresses = 0;
+        current.errors = 0;
+    }
+
+    if (isVisible()) {
+        update();
+    }
+}
+
+const LinkDashboard::Sample &LinkDashboard::sampleAt(const Series &series, int age) const
+{
+    // Age 0 is the last completed second
+    return series.ring.at((series.next - 1 - age + 2 * HISTORY_SECONDS) % HISTORY_SECONDS);
+}
+
+void LinkDashboard::paintEvent(QPaintEvent *)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), AppColors::PanelBackground);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+
+    QRect area = rect().adjusted(8, 8, -8, -8);
+    painter.setPen(Qt::white);
+    painter.drawText(area.left(), area.top() + 12,
+                     QString("%1 - last %2 s").arg(m_port.isEmpty() ? QString("No port") : m_port)
+                                              .arg(HISTORY_SECONDS));
+    area.setTop(area.top() + 20);
+
+    auto it = m_series.constFind(m_port);
+    if (it == m_series.constEnd()) {
+        return;
+    }
+
+    const int chartHeight = area.height() / 4;
+    QRect latencyArea(area.left(), area.top(), area.width(), area.height() - 2 * chartHeight);
+    QRect keypressArea(area.left(), latencyArea.bottom() + 1, area.width(), chartHeight);
+    QRect errorArea(area.left(), keypressArea.bottom() + 1, area.width(), chartHeight);
+
+    drawLatencyChart(painter, latencyArea.adjusted(0, 0, 0, -6), it.value());
+    drawRateChart(painter, keypressArea.adjusted(0, 0, 0, -6), it.value(),
+                  &Sample::keypresses, KEYPRESS_BLUE, "Keypresses/s");
+    drawRateChart(painter, errorArea, it.value(), &Sample::errors, AppColors::ErrorRed, "Errors/s");
+}
+
+void LinkDashboard::drawLatencyChart(QPainter &painter, const QRect &area, const Series &series) const
+{
+    const Sample &latest = sampleAt(series, 0);
+    painter.setPen(Qt::white);
+    painter.drawText(area.left(), area.top() + 12,
+                     QString("Ack latency ms  p50 %1  p95 %2  p99 %3")
+                         .arg(latest.p50).arg(latest.p95).arg(latest.p99));
+
+    QRect plot = area.adjusted(0, 18, 0, 0);
+    painter.setPen(AppColors::PanelGrid);
+    painter.drawRect(plot);
+
+    qint64 maxValue = 1;
+    for (int age = 0; age < HISTORY_SECONDS; ++age) {
+        maxValue = qMax(maxValue, sampleAt(series, age).p99);
+    }
+    painter.drawText(plot.adjusted(2, 2, -2, -2), Qt::AlignTop | Qt::AlignRight, QString::number(maxValue));
+
+    const double xStep = static_cast<double>(plot.width()) / (HISTORY_SECONDS - 1);
+    const double yScale = static_cast<double>(plot.height()) / maxValue;
+    qint64 Sample::*fields[] = {&Sample::p50, &Sample::p95, &Sample::p99};
+    const QColor colors[] = {AppColors::Gold, AppColors::Beige, AppColors::ErrorRed};
+
+    QPolygonF line(HISTORY_SECONDS);
+    for (int f = 0; f < 3; ++f) {
+        for (int age = 0; age < HISTORY_SECONDS; ++age) {
+            const double x = plot.right() - age * xStep;
+            const double y = plot.bottom() - sampleAt(series, age).*fields[f] * yScale;
+            line[age] = QPointF(x, y);
+        }
+        painter.setPen(QPen(colors[f], 1.5));
+        painter.drawPolyline(line);
+    }
+}
+
+void LinkDashboard::drawRateChart(QPainter &painter, const QRect &area, const Series &series,
+                                  int Sample::*field, const QColor &color, const QString &title) const
+{
+    painter.setPen(Qt::white);
+    painter.drawText(area.left(), area.top() + 12,
+                     QString("%1  %2").arg(title).arg(sampleAt(series, 0).*field));
+
+    QRect plot = area.adjusted(0, 18, 0, 0);
+    painter.setPen(AppColors::PanelGrid);
+    painter.drawRect(plot);
+
+    int maxValue = 1;
+    for (int age = 0; age < HISTORY_SECONDS; ++age) {
+        maxValue = qMax(maxValue, sampleAt(series, age).*field);
+    }
+    painter.drawText(plot.adjusted(2, 2, -2, -2), Qt::AlignTop | Qt::AlignRight, QString::number(maxValue));
+
+    const double barWidth = static_cast<double>(plot.width()) / HISTORY_SECONDS;
+    const double yScale = static_cast<double>(plot.height()) / maxValue;
+    for (int age = 0; age < HISTORY_SECONDS; ++age) {
+        const int value = sampleAt(series, age).*field;
+        if (value == 0) {
+            continue;
+        }
+        const double height = value * yScale;
+        painter.fillRect(QRectF(plot.right() - (age + 1) * barWidth, plot.bottom() - height,
+                                qMax(1.0, barWidth - 1), height), color);
+    }
+}
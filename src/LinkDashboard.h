@@ -0,0 +1,68 @@
+#ifndef LINKDASHBOARD_H
+#define LINKDASHBOARD_H
+
+#include <QWidget>
+#include <QMap>
+#include <QTimer>
+#include <QVector>
+
+// Rolling per-port view of ack latency percentiles, keypress rate and error
+// rate. Events are counted into the current second; once a second that
+// second is reduced to one sample in a fixed ring and the panel repaints
+// with plain QPainter calls, so cost does not grow with the event rate.
+class LinkDashboard : public QWidget
+{
+    Q_OBJECT
+
+public:
+    static const int HISTORY_SECONDS = 120;
+
+    explicit LinkDashboard(QWidget *parent = nullptr);
+
+    void setPort(const QString &portName);
+    QString port() const { return m_port; }
+
+    QSize sizeHint() const override;
+
+public slots:
+    void recordLatency(qint64 latencyMs);
+    void recordKeypress();
+    void recordError();
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private slots:
+    void advance();
+
+private:
+    struct Sample {
+        qint64 p50 = 0;
+        qint64 p95 = 0;
+        qint64 p99 = 0;
+        int keypresses = 0;
+        int errors = 0;
+    };
+
+    struct Series {
+        QVector<Sample> ring;          // HISTORY_SECONDS entries, preallocated
+        int next = 0;                  // Slot the coming second is written to
+        QVector<qint64> latencies;     // Current second, capacity reserved
+        int keypresses = 0;
+        int errors = 0;
+    };
+
+    static const int MAX_LATENCIES_PER_SECOND = 4096;
+
+    QMap<QString, Series> m_series;
+    QString m_port;
+    QTimer m_tickTimer;
+
+    Series &series(const QString &portName);
+    const Sample &sampleAt(const Series &series, int age) const;
+    void drawLatencyChart(QPainter &painter, const QRect &area, const Series &series) const;
+    void drawRateChart(QPainter &painter, const QRect &area, const Series &series,
+                       int Sample::*field, const QColor &color, const QString &title) const;
+};
+
+#endif // LINKDASHBOARD_H
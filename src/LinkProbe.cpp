@@ -0,0 +1,444 @@
+#include "LinkProbe.h"
+#include "BenchBaseline.h"
+#include "VmcProfile.h"
+#include "VmcProtocol.h"
+#include <QElapsedTimer>
+#include <QQueue>
+#include <QSettings>
+#include <QSysInfo>
+#include <QTextStream>
+#include <QThread>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+
+// Sorted samples; fraction in [0, 1]
+double percentile(const QVector<double> &sorted, double fraction)
+{
+    if (sorted.isEmpty()) {
+        return 0;
+    }
+    const int index = qMin(static_cast<int>(sorted.size()) - 1, static_cast<int>(fraction * sorted.size()));
+    return sorted.at(index);
+}
+
+int roundUpTo(double value, int step)
+{
+    return static_cast<int>(std::ceil(value / step)) * step;
+}
+
+bool cancelled(const std::atomic<bool> *cancel)
+{
+    return cancel && cancel->load(std::memory_order_relaxed);
+}
+
+// One request, one answer. Returns the RTT in ms, or -1 if the answer did
+// not arrive within the timeout. RX left over from earlier transactions is
+// dropped first so a late answer is not taken for this one.
+double transact(QIODevice *device, VmcFrameDecoder &decoder, const QByteArray &request,
+                bool isKeepalive, int timeoutMs)
+{
+    device->readAll();
+
+    QElapsedTimer timer;
+    timer.start();
+    device->write(request);
+    device->waitForBytesWritten(timeoutMs);
+
+    for (;;) {
+        const qint64 remaining = timeoutMs - timer.elapsed();
+        if (remaining <= 0) {
+            return -1;
+        }
+        if (device->bytesAvailable() == 0 && !device->waitForReadyRead(static_cast<int>(remaining))) {
+            return -1;
+        }
+        for (const VmcFrame &frame : decoder.feed(device->readAll())) {
+            if (isKeepalive ? frame.isKeepaliveResponse : frame.acknowledges(request)) {
+                return timer.nsecsElapsed() / 1e6;
+            }
+        }
+    }
+}
+
+}
+
+LinkProbe::LinkProbe(QObject *parent)
+    : QObject(parent)
+    , m_thread(nullptr)
+    , m_cancel(false)
+{
+}
+
+LinkProbe::~LinkProbe()
+{
+    if (m_thread) {
+        m_cancel.store(true);
+        m_thread->wait();
+        delete m_thread;
+    }
+}
+
+bool LinkProbe::start(const Options &options)
+{
+    if (m_thread) {
+        return false;
+    }
+    m_cancel.store(false);
+    m_report = Report();
+
+    m_thread = QThread::create([this, options]() {
+        const Report report = measure(options, &m_cancel, [this](int done, int total) {
+            emit progress(done, total);
+        });
+        if (report.isValid() && !m_cancel.load()) {
+            saveReport(report);
+        }
+        QMetaObject::invokeMethod(this, [this, report]() {
+            m_thread->wait();
+            m_thread->deleteLater();
+            m_thread = nullptr;
+            m_report = report;
+            emit finished();
+        }, Qt::QueuedConnection);
+    });
+    m_thread->setObjectName("LinkProbe");
+    m_thread->start();
+    return true;
+}
+
+QIODevice *LinkProbe::openDevice(const Options &options, QString *errorMessage)
+{
+    QIODevice *device = SerialCommunication::createDevice(options.portName, options.config);
+    if (!device) {
+        *errorMessage = "The native serial backend is only available on Linux";
+        return nullptr;
+    }
+
+    if (!device->open(QIODevice::ReadWrite)) {
+        *errorMessage = QString("Probe: cannot open %1: %2").arg(options.portName, device->errorString());
+        delete device;
+        return nullptr;
+    }
+    return device;
+}
+
+LinkProbe::Report LinkProbe::measure(const Options &options, const std::atomic<bool> *cancel,
+                                     const std::function<void(int, int)> &progress)
+{
+    Report report;
+    report.portName = options.portName.split(" ").first();
+    report.startedAt = QDateTime::currentDateTime();
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    Options portOptions = options;
+    portOptions.portName = report.portName;
+    QIODevice *device = openDevice(portOptions, &report.error);
+    if (!device) {
+        return report;
+    }
+
+    const std::shared_ptr<const VmcProfile> profile = VmcProfile::current();
+    const QByteArray keepalive = profile->keepaliveRequest();
+    const QByteArray noop = options.noopFrame.isEmpty() ? VmcProtocol::encodeFrame(0x00, 0x00, 0x00)
+                                                        : options.noopFrame;
+    VmcFrameDecoder decoder;
+    decoder.setKeepaliveResponse(profile->keepaliveResponse());
+
+    int windowSteps = 0;
+    for (int window = 1; window <= MAX_WINDOW; window *= 2) {
+        ++windowSteps;
+    }
+    const int total = options.transactions + windowSteps;
+
+    // Latency: one transaction at a time, keepalive and no-op alternating
+    QVector<double> rtts;
+    QVector<double> keepaliveRtts;
+    double previousRtt = -1;
+    double jitterSum = 0;
+    int jitterSamples = 0;
+    for (int i = 0; i < options.transactions && !cancelled(cancel); ++i) {
+        const bool isKeepalive = (i % 2) == 0;
+        const double rtt = transact(device, decoder, isKeepalive ? keepalive : noop, isKeepalive, options.timeoutMs);
+        if (isKeepalive) {
+            report.keepalivesSent++;
+        } else {
+            report.noopsSent++;
+        }
+
+        if (rtt < 0) {
+            if (isKeepalive) {
+                report.keepaliveTimeouts++;
+            } else {
+                report.noopTimeouts++;
+            }
+            previousRtt = -1;
+        } else {
+            rtts.append(rtt);
+            if (isKeepalive) {
+                keepaliveRtts.append(rtt);
+            }
+            if (previousRtt >= 0) {
+                jitterSum += std::fabs(rtt - previousRtt);
+                jitterSamples++;
+            }
+            previousRtt = rtt;
+        }
+        if (progress) {
+            progress(i + 1, total);
+        }
+    }
+
+    report.rttSamplesMs = rtts;
+    if (!rtts.isEmpty()) {
+        QVector<double> sorted = rtts;
+        std::sort(sorted.begin(), sorted.end());
+        report.rttMinMs = sorted.first();
+        report.rttP50Ms = percentile(sorted, 0.50);
+        report.rttP90Ms = percentile(sorted, 0.90);
+        report.rttP99Ms = percentile(sorted, 0.99);
+        report.rttMaxMs = sorted.last();
+        report.rttMeanMs = std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size();
+        report.jitterMs = jitterSamples > 0 ? jitterSum / jitterSamples : 0;
+    }
+
+    // Throughput: pipelined no-ops, doubling the window until the rate stops
+    // improving or answers start to go missing
+    int step = 0;
+    for (int window = 1; window <= MAX_WINDOW && !rtts.isEmpty() && !cancelled(cancel); window *= 2) {
+        device->readAll();
+        QQueue<qint64> inFlight;
+        int completed = 0;
+        int timeouts = 0;
+        QElapsedTimer phase;
+        phase.start();
+        while (phase.elapsed() < options.throughputMs && !cancelled(cancel)) {
+            while (inFlight.size() < window) {
+                device->write(noop);
+                inFlight.enqueue(phase.elapsed());
+            }
+            device->waitForBytesWritten(options.timeoutMs);
+
+            if (device->bytesAvailable() == 0 && !device->waitForReadyRead(options.timeoutMs)) {
+                timeouts += inFlight.size();
+                inFlight.clear();
+                continue;
+            }
+            for (const VmcFrame &frame : decoder.feed(device->readAll())) {
+                if (frame.acknowledges(noop) && !inFlight.isEmpty()) {
+                    inFlight.dequeue();
+                    completed++;
+                }
+            }
+        }
+
+        const double rate = completed * 1000.0 / qMax<qint64>(1, phase.elapsed());
+        report.throughputTimeouts += timeouts;
+        if (progress) {
+            progress(options.transactions + ++step, total);
+        }
+
+        // Let the tail of the window land before the next step
+        QElapsedTimer settle;
+        settle.start();
+        while (settle.elapsed() < options.timeoutMs && device->waitForReadyRead(options.timeoutMs)) {
+            device->readAll();
+        }
+
+        if (rate > report.maxRatePerSecond) {
+            const bool improved = rate > report.maxRatePerSecond * 1.05;
+            report.maxRatePerSecond = rate;
+            report.bestWindow = window;
+            if (!improved) {
+                break;
+            }
+        } else {
+            break;
+        }
+        if (timeouts > 0) {
+            break;
+        }
+    }
+
+    report.framesDecoded = decoder.framesDecoded();
+    report.checksumErrors = decoder.checksumErrors();
+    report.discardedBytes = decoder.discardedBytes();
+
+    device->close();
+    delete device;
+
+    report.durationMs = elapsed.elapsed();
+    suggest(&report, keepaliveRtts);
+    return report;
+}
+
+void LinkProbe::suggest(Report *report, const QVector<double> &keepaliveRtts)
+{
+    const int sent = report->keepalivesSent + report->noopsSent;
+    const int timeouts = report->keepaliveTimeouts + report->noopTimeouts;
+    if (sent == 0) {
+        report->findings.append("Probe cancelled before any transaction");
+        return;
+    }
+    if (timeouts == sent) {
+        report->findings.append("No answers at all: wrong port, baud rate or VMC profile, or the VMC is off");
+        return;
+    }
+
+    // Ack timeout: well clear of the p99, and of the median plus a few jitters
+    const double ackBase = qMax(report->rttP99Ms * 2, report->rttP50Ms + 4 * report->jitterMs);
+    report->suggestedAckTimeoutMs = qBound(int(RttEstimator::MIN_RTO_MS), roundUpTo(ackBase, 5),
+                                           int(RttEstimator::MAX_RTO_MS));
+
+    const double keepaliveMax = keepaliveRtts.isEmpty()
+        ? report->rttMaxMs : *std::max_element(keepaliveRtts.begin(), keepaliveRtts.end());
+    report->suggestedKeepaliveTimeoutMs = qBound(100, roundUpTo(keepaliveMax * 3, 50), 5000);
+
+    // Enough retries that a frame is lost outright less than once in a million
+    const double loss = report->lossRate();
+    if (loss <= 0) {
+        report->suggestedMaxRetries = ReliableLink::DEFAULT_MAX_RETRIES;
+    } else {
+        int retries = 1;
+        while (retries < 8 && std::pow(loss, retries + 1) > 1e-6) {
+            ++retries;
+        }
+        report->suggestedMaxRetries = retries;
+    }
+
+    if (loss > 0.01) {
+        report->findings.append(QString("%1% of transactions timed out: suspect the cable or connector")
+                                .arg(loss * 100, 0, 'f', 1));
+    }
+    if (report->checksumErrors > 0) {
+        report->findings.append(QString("%1 checksum errors: suspect noise, grounding or a baud rate mismatch")
+                                .arg(report->checksumErrors));
+    } else if (report->discardedBytes > 0) {
+        report->findings.append(QString("%1 stray bytes between frames").arg(report->discardedBytes));
+    }
+    if (report->jitterMs > qMax(2.0, report->rttP50Ms / 2)) {
+        report->findings.append("High RTT jitter: check the USB adapter's latency timer or hub, "
+                                "or try the native serial backend");
+    }
+    if (report->throughputTimeouts > 0 && report->bestWindow <= 1) {
+        report->findings.append("Answers go missing as soon as frames are pipelined: keep the reliable window at 1");
+    }
+    if (report->findings.isEmpty()) {
+        report->findings.append("Link looks healthy");
+    }
+}
+
+double LinkProbe::Report::lossRate() const
+{
+    const int sent = keepalivesSent + noopsSent;
+    return sent > 0 ? double(keepaliveTimeouts + noopTimeouts) / sent : 0;
+}
+
+double LinkProbe::Report::checksumErrorRate() const
+{
+    const quint64 frames = framesDecoded + checksumErrors;
+    return frames > 0 ? double(checksumErrors) / frames : 0;
+}
+
+QStringList LinkProbe::Report::format() const
+{
+    QStringList lines;
+    lines << QString("Link probe on %1 at %2 (%3 ms)")
+                 .arg(portName, startedAt.toString(Qt::ISODate)).arg(durationMs);
+    if (!isValid()) {
+        lines << error;
+        return lines;
+    }
+    lines << QString("Transactions: %1 keepalive (%2 timed out), %3 no-op (%4 timed out), loss %5%")
+                 .arg(keepalivesSent).arg(keepaliveTimeouts).arg(noopsSent).arg(noopTimeouts)
+                 .arg(lossRate() * 100, 0, 'f', 2);
+    lines << QString("RTT ms: min %1  p50 %2  p90 %3  p99 %4  max %5  mean %6  jitter %7")
+                 .arg(rttMinMs, 0, 'f', 2).arg(rttP50Ms, 0, 'f', 2).arg(rttP90Ms, 0, 'f', 2)
+                 .arg(rttP99Ms, 0, 'f', 2).arg(rttMaxMs, 0, 'f', 2).arg(rttMeanMs, 0, 'f', 2)
+                 .arg(jitterMs, 0, 'f', 2);
+    lines << QString("Frames decoded %1, checksum errors %2 (%3%), stray bytes %4")
+                 .arg(framesDecoded).arg(checksumErrors).arg(checksumErrorRate() * 100, 0, 'f', 2)
+                 .arg(discardedBytes);
+    lines << QString("Max sustained rate: %1 transactions/s at window %2 (%3 timed out)")
+                 .arg(maxRatePerSecond, 0, 'f', 1).arg(bestWindow).arg(throughputTimeouts);
+    if (suggestedAckTimeoutMs > 0) {
+        lines << QString("Suggested: ack timeout %1 ms, keepalive timeout %2 ms, max retries %3")
+                     .arg(suggestedAckTimeoutMs).arg(suggestedKeepaliveTimeoutMs).arg(suggestedMaxRetries);
+    }
+    for (const QString &finding : findings) {
+        lines << QString("- %1").arg(finding);
+    }
+    return lines;
+}
+
+void LinkProbe::saveReport(const Report &report)
+{
+    QSettings settings("YourCompany", "asdKeypad");
+    settings.beginGroup(QString("Ports/%1/Probe").arg(report.portName));
+    settings.setValue("Time", report.startedAt);
+    settings.setValue("Report", report.format());
+    settings.setValue("RttP50Ms", report.rttP50Ms);
+    settings.setValue("RttP99Ms", report.rttP99Ms);
+    settings.setValue("JitterMs", report.jitterMs);
+    settings.setValue("LossRate", report.lossRate());
+    settings.setValue("ChecksumErrorRate", report.checksumErrorRate());
+    settings.setValue("MaxRatePerSecond", report.maxRatePerSecond);
+    settings.setValue("SuggestedAckTimeoutMs", report.suggestedAckTimeoutMs);
+    settings.setValue("SuggestedKeepaliveTimeoutMs", report.suggestedKeepaliveTimeoutMs);
+    settings.setValue("SuggestedMaxRetries", report.suggestedMaxRetries);
+    settings.endGroup();
+}
+
+QStringList LinkProbe::savedReport(const QString &portName)
+{
+    QSettings settings("YourCompany", "asdKeypad");
+    return settings.value(QString("Ports/%1/Probe/Report").arg(portName.split(" ").first())).toStringList();
+}
+
+int LinkProbe::run(const Options &options)
+{
+    QTextStream out(stdout);
+    const Report report = measure(options);
+    for (const QString &line : report.format()) {
+        out << line << Qt::endl;
+    }
+    if (!report.isValid()) {
+        return 2;
+    }
+    saveReport(report);
+
+    BenchBaseline current;
+    current.tool = "asdKeypad --probe";
+    current.label = options.label;
+    current.created = report.startedAt;
+    current.host = QSysInfo::machineHostName();
+    QVector<double> rttNs;
+    for (double rttMs : report.rttSamplesMs) {
+        rttNs.append(rttMs * 1e6);
+    }
+    current.add("probe/rtt", rttNs);
+
+    QString baselineError;
+    if (!options.saveBaselinePath.isEmpty() && !current.save(options.saveBaselinePath, &baselineError)) {
+        out << baselineError << Qt::endl;
+        return 2;
+    }
+    bool regressed = false;
+    if (!options.baselinePath.isEmpty()) {
+        BenchBaseline baseline;
+        if (!BenchBaseline::load(options.baselinePath, &baseline, &baselineError)) {
+            out << baselineError << Qt::endl;
+            return 2;
+        }
+        const QVector<BenchBaseline::Comparison> comparisons =
+            BenchBaseline::compare(baseline, current, options.compare);
+        for (const QString &line : BenchBaseline::format(baseline, current, comparisons)) {
+            out << line << Qt::endl;
+        }
+        regressed = BenchBaseline::hasRegression(comparisons);
+    }
+    return report.lossRate() < 0.01 && report.checksumErrors == 0 && !regressed ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+#ifndef LINKPROBE_H
+#define LINKPROBE_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+#include <functional>
+#include "BenchBaseline.h"
+#include "SerialCommunication.h"
+
+class QIODevice;
+class QThread;
+
+// Characterizes the link to a connected VMC: a burst of keepalive and no-op
+// transactions, one at a time, measures RTT, jitter, timeouts and checksum
+// errors; pipelined no-ops at growing window sizes then find the highest
+// transaction rate the VMC sustains. The probe owns the port while it runs,
+// on a thread of its own, and saves its report under the port's settings.
+class LinkProbe : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int DEFAULT_TRANSACTIONS = 200;
+    static const int DEFAULT_TIMEOUT_MS = 500;
+    static const int DEFAULT_THROUGHPUT_MS = 1000;    // Per window size
+    static const int MAX_WINDOW = 8;
+
+    struct Options {
+        QString portName;
+        SerialCommunication::SerialConfig config;
+        int transactions = DEFAULT_TRANSACTIONS;       // Alternating keepalive and no-op
+        int timeoutMs = DEFAULT_TIMEOUT_MS;
+        int throughputMs = DEFAULT_THROUGHPUT_MS;
+        QByteArray noopFrame;                          // Empty: keypad frame with no key
+        QString saveBaselinePath;                      // Headless: RTT distribution saved here
+        QString baselinePath;                          // Headless: RTT distribution compared against this
+        QString label;                                 // Stored with the saved baseline
+        BenchBaseline::Options compare;                // Regression thresholds for baselinePath
+    };
+
+    struct Report {
+        QString portName;
+        QDateTime startedAt;
+        qint64 durationMs = 0;
+        QString error;                                 // Set when the port could not be used
+
+        int keepalivesSent = 0;
+        int keepaliveTimeouts = 0;
+        int noopsSent = 0;
+        int noopTimeouts = 0;
+
+        double rttMinMs = 0;
+        double rttP50Ms = 0;
+        double rttP90Ms = 0;
+        double rttP99Ms = 0;
+        double rttMaxMs = 0;
+        double rttMeanMs = 0;
+        double jitterMs = 0;                           // Mean |RTT(n) - RTT(n-1)|
+        QVector<double> rttSamplesMs;                  // Every answered transaction, in order
+
+        quint64 framesDecoded = 0;
+        quint64 checksumErrors = 0;
+        quint64 discardedBytes = 0;
+
+        double maxRatePerSecond = 0;                   // Best sustained pipelined rate
+        int bestWindow = 0;
+        int throughputTimeouts = 0;
+
+        int suggestedAckTimeoutMs = 0;
+        int suggestedKeepaliveTimeoutMs = 0;
+        int suggestedMaxRetries = 0;
+        QStringList findings;                          // Plain-language triage hints
+
+        bool isValid() const { return error.isEmpty(); }
+        double lossRate() const;
+        double checksumErrorRate() const;
+        QStringList format() const;
+    };
+
+    explicit LinkProbe(QObject *parent = nullptr);
+    ~LinkProbe();
+
+    // Runs on a worker thread; finished() is emitted on this object's thread
+    bool start(const Options &options);
+    void cancel() { m_cancel.store(true); }
+    bool isRunning() const { return m_thread != nullptr; }
+    Report report() const { return m_report; }
+
+    // Blocking; the port must not be open elsewhere
+    static Report measure(const Options &options, const std::atomic<bool> *cancel = nullptr,
+                          const std::function<void(int done, int total)> &progress = nullptr);
+
+    static void saveReport(const Report &report);
+    static QStringList savedReport(const QString &portName);
+
+    // Headless entry point: probes the port and prints the report
+    static int run(const Options &options);
+
+signals:
+    void progress(int done, int total);
+    void finished();
+
+private:
+    QThread *m_thread;
+    std::atomic<bool> m_cancel;
+    Report m_report;
+
+    static QIODevice *openDevice(const Options &options, QString *errorMessage);
+    static void suggest(Report *report, const QVector<double> &keepaliveRtts);
+};
+
+#endif // LINKPROBE_H
@@ -0,0 +1,409 @@
+#include "LoadGenerator.h"
+#include "KeypressCommands.h"
+#include "SerialCommunication.h"
+#include "SimulatedVmc.h"
+#include <QEventLoop>
+#include <QFile>
+#include <QLoggingCategory>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+namespace {
+
+double percentileMs(const QVector<qint64> &sortedNs, double fraction)
+{
+    if (sortedNs.isEmpty()) {
+        return 0;
+    }
+    const int index = qMin(sortedNs.size() - 1, static_cast<int>(fraction * sortedNs.size()));
+    return sortedNs.at(index) / 1e6;
+}
+
+}
+
+LoadGenerator::LoadGenerator(SerialCommunication *serial, KeypressCommands *keypress,
+                             const Options &options, QObject *parent)
+    : QObject(parent)
+    , m_serial(serial)
+    , m_keypress(keypress)
+    , m_options(options)
+    , m_random(options.seed)
+    , m_running(false)
+    , m_draining(false)
+    , m_step(0)
+    , m_nextKey(0)
+    , m_stepStartNs(0)
+    , m_stepEndNs(0)
+    , m_drainDeadlineNs(0)
+    , m_nextArrivalNs(0)
+    , m_burstRemaining(0)
+{
+    m_arrivalTimer.setSingleShot(true);
+    connect(&m_arrivalTimer, &ClockTimer::timeout, this, &LoadGenerator::issueDue);
+    m_drainTimer.setInterval(DRAIN_POLL_MS);
+    connect(&m_drainTimer, &ClockTimer::timeout, this, &LoadGenerator::checkDrained);
+
+    connect(m_serial, &SerialCommunication::frameDelivered, this, &LoadGenerator::handleDelivered);
+    connect(m_serial, &SerialCommunication::frameFailed, this, &LoadGenerator::handleFailed);
+}
+
+void LoadGenerator::start()
+{
+    if (m_running || m_options.rates.isEmpty() || m_options.keys.isEmpty()) {
+        return;
+    }
+    m_running = true;
+    m_step = 0;
+    m_results.clear();
+    startStep();
+}
+
+void LoadGenerator::startStep()
+{
+    m_current = StepResult();
+    m_current.offeredPerSecond = m_options.rates.at(m_step);
+    m_latenciesNs.clear();
+    m_serviceMs.clear();
+    m_intended.clear();
+    m_draining = false;
+
+    m_stepStartNs = VirtualClock::monotonicNs();
+    m_stepEndNs = m_stepStartNs + static_cast<qint64>(m_options.stepSeconds) * 1000000000LL;
+    m_nextArrivalNs = m_stepStartNs;
+    m_burstRemaining = m_options.burstSize;
+    if (m_options.arrival == PoissonArrival) {
+        // First arrival is itself exponentially distributed
+        std::exponential_distribution<double> gap(m_current.offeredPerSecond);
+        m_nextArrivalNs += static_cast<qint64>(gap(m_random) * 1e9);
+    }
+    issueDue();
+}
+
+void LoadGenerator::advanceArrival()
+{
+    const double rate = m_current.offeredPerSecond;
+    switch (m_options.arrival) {
+    case ConstantArrival:
+        m_nextArrivalNs += static_cast<qint64>(1e9 / rate);
+        break;
+    case PoissonArrival: {
+        std::exponential_distribution<double> gap(rate);
+        m_nextArrivalNs += static_cast<qint64>(gap(m_random) * 1e9);
+        break;
+    }
+    case BurstArrival:
+        // burstSize arrivals at one instant, spaced so the mean rate is still `rate`
+        if (--m_burstRemaining > 0) {
+            break;
+        }
+        m_burstRemaining = m_options.burstSize;
+        m_nextArrivalNs += static_cast<qint64>(m_options.burstSize * 1e9 / rate);
+        break;
+    }
+}
+
+void LoadGenerator::issueDue()
+{
+    if (!m_running || m_draining) {
+        return;
+    }
+
+    // Everything the schedule wanted sent by now goes out now, each stamped
+    // with its own intended time, so a late timer or a blocked loop is charged
+    // to latency rather than silently thinning the load
+    const qint64 now = VirtualClock::monotonicNs();
+    while (m_nextArrivalNs <= now && m_nextArrivalNs < m_stepEndNs) {
+        const QString key = m_options.keys.at(m_nextKey++ % m_options.keys.size());
+        const QByteArray frame = KeypressCommands::keyFrame(key);
+        m_current.issued++;
+
+        QQueue<qint64> &queue = m_intended[frame];
+        queue.enqueue(m_nextArrivalNs);
+        if (!m_keypress->sendKey(key, TxPriority::Automation)) {
+            queue.removeLast();
+            m_current.failed++;
+        }
+        advanceArrival();
+    }
+
+    if (m_nextArrivalNs >= m_stepEndNs) {
+        m_draining = true;
+        m_drainDeadlineNs = m_stepEndNs + static_cast<qint64>(m_options.drainMs) * 1000000LL;
+        m_drainTimer.start();
+        return;
+    }
+    armArrivalTimer();
+}
+
+void LoadGenerator::armArrivalTimer()
+{
+    // Rounded up: firing early would only reschedule, firing late is measured
+    const qint64 waitNs = qMax<qint64>(0, m_nextArrivalNs - VirtualClock::monotonicNs());
+    m_arrivalTimer.start(static_cast<int>((waitNs + 999999) / 1000000));
+}
+
+bool LoadGenerator::popIntended(const QByteArray &frame, qint64 *intendedNs)
+{
+    auto it = m_intended.find(frame);
+    if (it == m_intended.end() || it->isEmpty()) {
+        return false;
+    }
+    // Identical frames are echoed in order, so the oldest is the one answered
+    *intendedNs = it->dequeue();
+    return true;
+}
+
+void LoadGenerator::handleDelivered(const QByteArray &frame, qint64 rttMs)
+{
+    qint64 intendedNs;
+    if (!m_running || !popIntended(frame, &intendedNs)) {
+        return;
+    }
+    m_current.completed++;
+    m_latenciesNs.append(VirtualClock::monotonicNs() - intendedNs);
+    m_serviceMs.append(rttMs);
+}
+
+void LoadGenerator::handleFailed(const QByteArray &frame)
+{
+    qint64 intendedNs;
+    if (!m_running || !popIntended(frame, &intendedNs)) {
+        return;
+    }
+    m_current.failed++;
+}
+
+void LoadGenerator::checkDrained()
+{
+    if (!m_draining) {
+        return;
+    }
+    const quint64 resolved = m_current.completed + m_current.failed;
+    if (resolved < m_current.issued && VirtualClock::monotonicNs() < m_drainDeadlineNs) {
+        return;
+    }
+    finishStep();
+}
+
+void LoadGenerator::finishStep()
+{
+    m_drainTimer.stop();
+    m_arrivalTimer.stop();
+    m_draining = false;
+
+    m_current.unfinished = m_current.issued - m_current.completed - m_current.failed;
+    m_current.achievedPerSecond = static_cast<double>(m_current.completed) / m_options.stepSeconds;
+
+    std::sort(m_latenciesNs.begin(), m_latenciesNs.end());
+    m_current.p50Ms = percentileMs(m_latenciesNs, 0.50);
+    m_current.p90Ms = percentileMs(m_latenciesNs, 0.90);
+    m_current.p99Ms = percentileMs(m_latenciesNs, 0.99);
+    m_current.p999Ms = percentileMs(m_latenciesNs, 0.999);
+    m_current.maxMs = m_latenciesNs.isEmpty() ? 0 : m_latenciesNs.last() / 1e6;
+
+    std::sort(m_serviceMs.begin(), m_serviceMs.end());
+    if (!m_serviceMs.isEmpty()) {
+        m_current.serviceP50Ms = m_serviceMs.at(qMin(m_serviceMs.size() - 1, m_serviceMs.size() / 2));
+        m_current.serviceP99Ms = m_serviceMs.at(qMin(m_serviceMs.size() - 1,
+                                                     static_cast<int>(0.99 * m_serviceMs.size())));
+    }
+
+    // Unanswered frames would otherwise be echoed into the next step's numbers
+    m_intended.clear();
+    if (m_current.unfinished > 0) {
+        m_serial->reliableLink()->reset();
+    }
+
+    m_results.append(m_current);
+    emit stepFinished(m_current);
+
+    if (++m_step < m_options.rates.size()) {
+        startStep();
+        return;
+    }
+    m_running = false;
+    emit finished();
+}
+
+bool LoadGenerator::parseArrival(const QString &name, Arrival *arrival)
+{
+    if (name == "constant") {
+        *arrival = ConstantArrival;
+    } else if (name == "poisson") {
+        *arrival = PoissonArrival;
+    } else if (name == "burst") {
+        *arrival = BurstArrival;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool LoadGenerator::parseRates(const QString &list, QVector<double> *rates)
+{
+    rates->clear();
+    for (const QString &item : list.split(',', Qt::SkipEmptyParts)) {
+        bool ok = false;
+        const double rate = item.trimmed().toDouble(&ok);
+        // A faster rate rounds the arrival gap down to 0 ns, and issueDue() never catches up
+        if (!ok || !std::isfinite(rate) || rate <= 0 || rate > MAX_RATE_PER_SECOND) {
+            return false;
+        }
+        rates->append(rate);
+    }
+    return !rates->isEmpty();
+}
+
+QString LoadGenerator::formatCurve(const QVector<StepResult> &results)
+{
+    QString text;
+    QTextStream out(&text);
+    out << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9\n")
+               .arg("offered/s", 10).arg("achieved/s", 11).arg("p50 ms", 9).arg("p90 ms", 9)
+               .arg("p99 ms", 9).arg("p99.9 ms", 9).arg("max ms", 9).arg("svc p99", 8)
+               .arg("failed/unfinished", 18);
+    for (const StepResult &step : results) {
+        out << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9\n")
+                   .arg(step.offeredPerSecond, 10, 'f', 2)
+                   .arg(step.achievedPerSecond, 11, 'f', 2)
+                   .arg(step.p50Ms, 9, 'f', 1)
+                   .arg(step.p90Ms, 9, 'f', 1)
+                   .arg(step.p99Ms, 9, 'f', 1)
+                   .arg(step.p999Ms, 9, 'f', 1)
+                   .arg(step.maxMs, 9, 'f', 1)
+                   .arg(step.serviceP99Ms, 8, 'f', 0)
+                   .arg(QString("%1/%2").arg(step.failed).arg(step.unfinished), 18);
+    }
+    return text;
+}
+
+QString LoadGenerator::formatCsv(const QVector<StepResult> &results)
+{
+    QString text("offered_per_s,achieved_per_s,issued,completed,failed,unfinished,"
+                 "p50_ms,p90_ms,p99_ms,p999_ms,max_ms,service_p50_ms,service_p99_ms\n");
+    for (const StepResult &step : results) {
+        text += QString("%1,%2,%3,%4,%5,%6,%7,%8,%9,%10,%11,%12,%13\n")
+                    .arg(step.offeredPerSecond).arg(step.achievedPerSecond)
+                    .arg(step.issued).arg(step.completed).arg(step.failed).arg(step.unfinished)
+                    .arg(step.p50Ms).arg(step.p90Ms).arg(step.p99Ms).arg(step.p999Ms).arg(step.maxMs)
+                    .arg(step.serviceP50Ms).arg(step.serviceP99Ms);
+    }
+    return text;
+}
+
+int LoadGenerator::run(const Options &options)
+{
+    QTextStream out(stdout);
+    if (options.rates.isEmpty() || options.keys.isEmpty()) {
+        out << "Load: no rates or keys given" << Qt::endl;
+        return 2;
+    }
+
+    // Per-key debug logging would dominate the run time
+    QLoggingCategory::setFilterRules("default.debug=false");
+
+    const bool simulated = options.port == "SIM";
+    VirtualClock clock;
+    std::unique_ptr<SimulatedVmc> vmc;
+    if (simulated) {
+        VirtualClock::setActive(&clock);
+        SimulatedVmc::Config vmcConfig;
+        vmcConfig.seed = options.seed;
+        vmc.reset(new SimulatedVmc(&clock, vmcConfig));
+        vmc->open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+    }
+    std::unique_ptr<QIODevice> port;
+    std::unique_ptr<FaultInjectingDevice> faultyLine;
+    if (options.faults.isEnabled()) {
+        if (!simulated) {
+            port.reset(SerialCommunication::createDevice(options.port,
+                                                         SerialCommunication::configForPort(options.port)));
+        }
+        QIODevice *inner = simulated ? static_cast<QIODevice *>(vmc.get()) : port.get();
+        if (!inner) {
+            out << "Load: no serial backend for " << options.port << Qt::endl;
+            VirtualClock::setActive(nullptr);
+            return 2;
+        }
+        faultyLine.reset(new FaultInjectingDevice(inner, options.faults));
+    }
+
+    int result = 1;
+    {
+        SerialCommunication serial;
+        KeypressCommands keypress(&serial);
+        serial.setReliableDelivery(true);
+
+        bool opened;
+        if (faultyLine) {
+            opened = serial.openDevice(faultyLine.get(), options.port);
+        } else {
+            opened = simulated ? serial.openDevice(vmc.get(), "SIM")
+                               : serial.openPort(options.port, SerialCommunication::configForPort(options.port));
+        }
+        if (!opened) {
+            out << "Load: cannot open " << options.port << ": " << serial.getLastError() << Qt::endl;
+            VirtualClock::setActive(nullptr);
+            return 2;
+        }
+
+        // An injected disconnect drops the link; plug it back in as an operator would
+        quint64 reconnects = 0;
+        ClockTimer reconnectTimer;
+        reconnectTimer.setSingleShot(true);
+        reconnectTimer.setInterval(FaultInjectingDevice::RECONNECT_MS);
+        QObject::connect(&serial, &SerialCommunication::portStatusChanged, [&](bool isOpen) {
+            if (!isOpen && faultyLine) {
+                reconnectTimer.start();
+            }
+        });
+        QObject::connect(&reconnectTimer, &ClockTimer::timeout, [&]() {
+            if (serial.openDevice(faultyLine.get(), options.port)) {
+                reconnects++;
+            } else {
+                reconnectTimer.start();
+            }
+        });
+
+        LoadGenerator generator(&serial, &keypress, options);
+        QObject::connect(&generator, &LoadGenerator::stepFinished, [&](const StepResult &step) {
+            out << QString("Offered %1/s: %2 issued, %3 completed, p99 %4 ms")
+                       .arg(step.offeredPerSecond).arg(step.issued).arg(step.completed)
+                       .arg(step.p99Ms, 0, 'f', 1) << Qt::endl;
+        });
+
+        generator.start();
+        if (simulated) {
+            while (generator.isRunning() && clock.runNext()) {
+            }
+        } else if (generator.isRunning()) {
+            QEventLoop loop;
+            QObject::connect(&generator, &LoadGenerator::finished, &loop, &QEventLoop::quit);
+            loop.exec();
+        }
+
+        reconnectTimer.stop();
+        serial.disconnect();
+        serial.closePort();
+
+        out << Qt::endl << formatCurve(generator.results());
+        if (faultyLine) {
+            out << faultyLine->format() << Qt::endl;
+            out << QString("Reconnects %1").arg(reconnects) << Qt::endl;
+        }
+        if (!options.curvePath.isEmpty()) {
+            QFile curveFile(options.curvePath);
+            if (curveFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+                curveFile.write(formatCsv(generator.results()).toUtf8());
+            } else {
+                out << "Load: cannot write " << options.curvePath << Qt::endl;
+            }
+        }
+        result = generator.results().size() == options.rates.size() ? 0 : 1;
+    }
+
+    VirtualClock::setActive(nullptr);
+    return result;
+}
@@ -0,0 +1,122 @@
+#ifndef LOADGENERATOR_H
+#define LOADGENERATOR_H
+
+#include <QObject>
+#include <QHash>
+#include <QQueue>
+#include <QVector>
+#include <random>
+#include "FaultInjectingDevice.h"
+#include "VirtualClock.h"
+
+class KeypressCommands;
+class SerialCommunication;
+
+// Open-loop keypress load: transactions are issued on a target arrival
+// schedule whatever the VMC is doing, and each one's latency runs from the
+// time the schedule intended to send it, not from when it actually left.
+// A stalled VMC therefore shows up as queueing delay instead of a pause in
+// the load (no coordinated omission). Each offered rate is one step; the
+// step results form the latency-vs-offered-load curve.
+class LoadGenerator : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Far past any serial link, and keeps every arrival gap at least a microsecond
+    static const int MAX_RATE_PER_SECOND = 1000000;
+
+    enum Arrival {
+        ConstantArrival,
+        PoissonArrival,
+        BurstArrival
+    };
+
+    struct Options {
+        QString port;                  // "SIM" runs against SimulatedVmc on a virtual clock
+        QVector<QString> keys{"1"};    // Cycled through, one key per transaction
+        QVector<double> rates;         // Offered transactions per second, one step each
+        int stepSeconds = 30;
+        Arrival arrival = ConstantArrival;
+        int burstSize = 5;
+        int drainMs = 10000;           // Grace period after a step for answers to arrive
+        quint32 seed = 1;
+        QString curvePath;             // CSV output, optional
+        FaultInjectingDevice::Config faults;  // Between the link and the port when enabled
+    };
+
+    struct StepResult {
+        double offeredPerSecond = 0;
+        double achievedPerSecond = 0;  // Completed transactions over the step
+        quint64 issued = 0;
+        quint64 completed = 0;
+        quint64 failed = 0;
+        quint64 unfinished = 0;        // Still unanswered when the drain period ended
+        double p50Ms = 0;
+        double p90Ms = 0;
+        double p99Ms = 0;
+        double p999Ms = 0;
+        double maxMs = 0;
+        double serviceP50Ms = 0;       // Last transmission to echo, as ReliableLink sees it
+        double serviceP99Ms = 0;
+    };
+
+    LoadGenerator(SerialCommunication *serial, KeypressCommands *keypress,
+                  const Options &options, QObject *parent = nullptr);
+
+    void start();
+    bool isRunning() const { return m_running; }
+    const QVector<StepResult> &results() const { return m_results; }
+
+    static bool parseArrival(const QString &name, Arrival *arrival);
+    static bool parseRates(const QString &list, QVector<double> *rates);   // Each in (0, MAX_RATE_PER_SECOND]
+    static QString formatCurve(const QVector<StepResult> &results);
+    static QString formatCsv(const QVector<StepResult> &results);
+
+    // Headless entry point: runs the whole sweep and prints the curve
+    static int run(const Options &options);
+
+signals:
+    void stepFinished(const LoadGenerator::StepResult &result);
+    void finished();
+
+private slots:
+    void issueDue();
+    void handleDelivered(const QByteArray &frame, qint64 rttMs);
+    void handleFailed(const QByteArray &frame);
+    void checkDrained();
+
+private:
+    SerialCommunication *m_serial;
+    KeypressCommands *m_keypress;
+    Options m_options;
+    std::mt19937_64 m_random;
+    ClockTimer m_arrivalTimer;
+    ClockTimer m_drainTimer;
+    bool m_running;
+    bool m_draining;
+
+    int m_step;
+    int m_nextKey;
+    qint64 m_stepStartNs;
+    qint64 m_stepEndNs;
+    qint64 m_drainDeadlineNs;
+    qint64 m_nextArrivalNs;
+    int m_burstRemaining;
+
+    QHash<QByteArray, QQueue<qint64>> m_intended;  // Frame -> intended send times, FIFO
+    QVector<qint64> m_latenciesNs;
+    QVector<qint64> m_serviceMs;
+    StepResult m_current;
+    QVector<StepResult> m_results;
+
+    static const int DRAIN_POLL_MS = 50;
+
+    void startStep();
+    void finishStep();
+    void advanceArrival();
+    void armArrivalTimer();
+    bool popIntended(const QByteArray &frame, qint64 *intendedNs);
+};
+
+#endif // LOADGENERATOR_H
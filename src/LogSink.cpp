@@ -0,0 +1,429 @@
+#include "LogSink.h"
+#include "MemoryBudget.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+std::atomic<bool> LogSink::s_running{false};
+
+namespace {
+
+struct LogEntry {
+    qint64 timestampMs = 0;
+    quintptr threadId = 0;
+    QtMsgType type = QtDebugMsg;
+    QString message;
+
+    // Charged to MemoryBudget::LogStorage while queued
+    qint64 footprint() const { return static_cast<qint64>(sizeof(LogEntry)) + message.size() * 2; }
+};
+
+// Bounded multi-producer queue (Vyukov). A slot's sequence tells producers
+// whether it is free and the writer whether it is published; neither side
+// ever waits on the other.
+struct LogQueue {
+    struct Slot {
+        std::atomic<quint64> sequence;
+        LogEntry entry;
+    };
+
+    Slot slots[LogSink::QUEUE_CAPACITY];
+    std::atomic<quint64> tail{0};              // Next slot a producer claims
+    quint64 head = 0;                          // Next slot the writer reads; writer only
+
+    LogQueue()
+    {
+        for (quint64 i = 0; i < LogSink::QUEUE_CAPACITY; ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool push(LogEntry &&entry)
+    {
+        quint64 position = tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot &slot = slots[position & (LogSink::QUEUE_CAPACITY - 1)];
+            const quint64 sequence = slot.sequence.load(std::memory_order_acquire);
+            const qint64 difference = static_cast<qint64>(sequence - position);
+            if (difference == 0) {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.entry = std::move(entry);
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;                  // Full
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop(LogEntry *entry)
+    {
+        Slot &slot = slots[head & (LogSink::QUEUE_CAPACITY - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+            return false;
+        }
+        *entry = std::move(slot.entry);
+        slot.entry.message = QString();
+        slot.sequence.store(head + LogSink::QUEUE_CAPACITY, std::memory_order_release);
+        ++head;
+        return true;
+    }
+};
+
+// Outlives every start/stop cycle, so a late producer never touches freed memory
+LogQueue queue;
+std::atomic<quint64> writtenCount{0};
+std::atomic<quint64> droppedCount{0};
+
+const qint64 WRITE_BATCH_BYTES = 256 * 1024;
+const char *const SEGMENT_SUFFIX = ".log";
+const char *const COMPRESSED_SUFFIX = ".log.qz";
+
+// Writer-thread state; start() and stop() own it while the thread is down
+LogSink::Options options;
+QFile segment;
+QDateTime segmentOpened;
+std::mutex currentFileMutex;
+QString currentFileName;
+std::thread writer;
+std::mutex wakeMutex;
+std::condition_variable wake;
+bool stopRequested = false;
+
+QString segmentPattern()
+{
+    return options.baseName + "-*";
+}
+
+bool openSegment(QString *errorMessage)
+{
+    segmentOpened = QDateTime::currentDateTime();
+    const QString stem = options.baseName + '-' + segmentOpened.toString("yyyyMMdd-HHmmss-zzz");
+    QString fileName = QDir(options.directory).filePath(stem + SEGMENT_SUFFIX);
+    for (int n = 1; QFile::exists(fileName) || QFile::exists(fileName + ".qz"); ++n) {
+        fileName = QDir(options.directory).filePath(QString("%1-%2%3").arg(stem).arg(n).arg(SEGMENT_SUFFIX));
+    }
+
+    segment.setFileName(fileName);
+    if (!segment.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        if (errorMessage) {
+            *errorMessage = QString("Log: cannot open %1: %2").arg(fileName, segment.errorString());
+        }
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(currentFileMutex);
+    currentFileName = fileName;
+    return true;
+}
+
+// Replaces a closed segment with its qCompress'd form; the original stays if that fails
+void compressSegment(const QString &fileName)
+{
+    QFile in(fileName);
+    if (!in.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    const QByteArray compressed = qCompress(in.readAll());
+    in.close();
+
+    QFile out(fileName.left(fileName.size() - static_cast<int>(qstrlen(SEGMENT_SUFFIX))) + COMPRESSED_SUFFIX);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)
+            || out.write(compressed) != compressed.size()) {
+        out.remove();
+        return;
+    }
+    out.close();
+    QFile::remove(fileName);
+}
+
+// Deletes the oldest closed segments until everything fits the budget.
+// Names sort by the time their segment was opened.
+void enforceBudget()
+{
+    QDir dir(options.directory);
+    QFileInfoList files = dir.entryInfoList({segmentPattern() + SEGMENT_SUFFIX, segmentPattern() + COMPRESSED_SUFFIX},
+                                            QDir::Files, QDir::Name);
+    qint64 total = 0;
+    for (const QFileInfo &file : files) {
+        total += file.size();
+    }
+    const QString current = QFileInfo(segment.fileName()).fileName();
+    for (const QFileInfo &file : files) {
+        if (total <= options.maxTotalBytes) {
+            break;
+        }
+        if (file.fileName() == current) {
+            continue;
+        }
+        if (QFile::remove(file.absoluteFilePath())) {
+            total -= file.size();
+        }
+    }
+}
+
+void closeSegment()
+{
+    const QString fileName = segment.fileName();
+    segment.close();
+    if (options.compress) {
+        compressSegment(fileName);
+    }
+}
+
+bool segmentExpired()
+{
+    return segment.size() >= options.maxSegmentBytes
+        || segmentOpened.secsTo(QDateTime::currentDateTime()) >= options.maxSegmentSeconds;
+}
+
+void rotate()
+{
+    closeSegment();
+    if (!openSegment(nullptr)) {
+        // Keep draining so producers never back up; entries are lost until a segment opens
+        segment.setFileName(QString());
+    }
+    enforceBudget();
+}
+
+char levelTag(QtMsgType type)
+{
+    switch (type) {
+    case QtDebugMsg:
+        return 'D';
+    case QtInfoMsg:
+        return 'I';
+    case QtWarningMsg:
+        return 'W';
+    case QtCriticalMsg:
+        return 'C';
+    case QtFatalMsg:
+        return 'F';
+    }
+    return '?';
+}
+
+void appendEntry(QByteArray &batch, const LogEntry &entry)
+{
+    batch += QDateTime::fromMSecsSinceEpoch(entry.timestampMs).toString("yyyy-MM-dd HH:mm:ss.zzz").toLatin1();
+    batch += ' ';
+    batch += levelTag(entry.type);
+    batch += " [";
+    batch += QByteArray::number(static_cast<qulonglong>(entry.threadId), 16);
+    batch += "] ";
+    batch += entry.message.toUtf8();
+    batch += '\n';
+}
+
+void writeBatch(QByteArray &batch)
+{
+    if (batch.isEmpty()) {
+        return;
+    }
+    if (segment.isOpen()) {
+        segment.write(batch);
+        segment.flush();
+    }
+    batch.resize(0);                           // Keeps the reserved capacity
+}
+
+// Drains everything queued, in writes of up to WRITE_BATCH_BYTES
+void drain(quint64 *reportedDrops)
+{
+    QByteArray batch;
+    batch.reserve(WRITE_BATCH_BYTES + 4096);
+    LogEntry entry;
+    while (queue.pop(&entry)) {
+        MemoryBudget::release(MemoryBudget::LogStorage, entry.footprint());
+        appendEntry(batch, entry);
+        writtenCount.fetch_add(1, std::memory_order_relaxed);
+        if (batch.size() >= WRITE_BATCH_BYTES) {
+            writeBatch(batch);
+            if (segment.isOpen() && segmentExpired()) {
+                rotate();
+            }
+        }
+    }
+
+    const quint64 drops = droppedCount.load(std::memory_order_relaxed);
+    if (drops != *reportedDrops) {
+        LogEntry note;
+        note.timestampMs = QDateTime::currentMSecsSinceEpoch();
+        note.type = QtWarningMsg;
+        note.message = QString("Log: %1 entries dropped, queue full or over its memory budget").arg(drops - *reportedDrops);
+        appendEntry(batch, note);
+        *reportedDrops = drops;
+    }
+    writeBatch(batch);
+}
+
+void writerLoop()
+{
+    // Segments left uncompressed by a previous run that did not stop cleanly
+    if (options.compress) {
+        const QString current = QFileInfo(segment.fileName()).fileName();
+        for (const QFileInfo &file : QDir(options.directory).entryInfoList({segmentPattern() + SEGMENT_SUFFIX},
+                                                                           QDir::Files, QDir::Name)) {
+            if (file.fileName() != current) {
+                compressSegment(file.absoluteFilePath());
+            }
+        }
+    }
+    enforceBudget();
+
+    quint64 reportedDrops = droppedCount.load(std::memory_order_relaxed);
+    for (;;) {
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wake.wait_for(lock, std::chrono::milliseconds(LogSink::FLUSH_INTERVAL_MS),
+                          [] { return stopRequested; });
+            stopping = stopRequested;
+        }
+
+        drain(&reportedDrops);
+        if (stopping) {
+            break;
+        }
+        if (!segment.isOpen()) {
+            openSegment(nullptr);              // Retry after a failed rotation
+        } else if (segmentExpired()) {
+            if (segment.size() > 0) {
+                rotate();
+            } else {
+                segmentOpened = QDateTime::currentDateTime();
+            }
+        }
+    }
+    closeSegment();
+    enforceBudget();
+}
+
+}
+
+bool LogSink::start(const Options &sinkOptions, QString *errorMessage)
+{
+    if (isRunning()) {
+        if (errorMessage) {
+            *errorMessage = QString("Log: already writing to %1").arg(currentFile());
+        }
+        return false;
+    }
+    if (sinkOptions.directory.isEmpty() || !QDir().mkpath(sinkOptions.directory)) {
+        if (errorMessage) {
+            *errorMessage = QString("Log: cannot create directory %1").arg(sinkOptions.directory);
+        }
+        return false;
+    }
+
+    options = sinkOptions;
+    options.maxSegmentBytes = qMax<qint64>(options.maxSegmentBytes, WRITE_BATCH_BYTES);
+    options.maxSegmentSeconds = qMax(options.maxSegmentSeconds, 1);
+    if (!openSegment(errorMessage)) {
+        return false;
+    }
+
+    // A joinable std::thread left at exit would terminate the process
+    static bool postRoutineAdded = false;
+    if (!postRoutineAdded && QCoreApplication::instance()) {
+        qAddPostRoutine(LogSink::stop);
+        postRoutineAdded = true;
+    }
+
+    stopRequested = false;
+    writer = std::thread(writerLoop);
+    s_running.store(true, std::memory_order_release);
+    return true;
+}
+
+void LogSink::stop()
+{
+    if (!s_running.exchange(false)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopRequested = true;
+    }
+    wake.notify_one();
+    writer.join();
+
+    std::lock_guard<std::mutex> lock(currentFileMutex);
+    currentFileName.clear();
+}
+
+QString LogSink::currentFile()
+{
+    std::lock_guard<std::mutex> lock(currentFileMutex);
+    return currentFileName;
+}
+
+void LogSink::write(QtMsgType type, const QString &message)
+{
+    if (!isRunning()) {
+        return;
+    }
+    LogEntry entry;
+    entry.timestampMs = QDateTime::currentMSecsSinceEpoch();
+    entry.threadId = reinterpret_cast<quintptr>(QThread::currentThreadId());
+    entry.type = type;
+    entry.message = message;
+    const qint64 footprint = entry.footprint();
+    if (!MemoryBudget::tryCharge(MemoryBudget::LogStorage, footprint)) {
+        MemoryBudget::recordEviction(MemoryBudget::LogStorage, footprint);
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (!queue.push(std::move(entry))) {
+        MemoryBudget::release(MemoryBudget::LogStorage, footprint);
+        MemoryBudget::recordEviction(MemoryBudget::LogStorage, footprint);
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+namespace {
+
+QtMessageHandler previousHandler = nullptr;
+
+void sinkMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    LogSink::write(type, message);
+    if (type == QtFatalMsg) {
+        // The process aborts next; get the queue onto disk first
+        LogSink::stop();
+    }
+    if (previousHandler) {
+        previousHandler(type, context, message);
+    }
+}
+
+}
+
+void LogSink::installMessageHandler()
+{
+    QtMessageHandler previous = qInstallMessageHandler(sinkMessageHandler);
+    if (previous != sinkMessageHandler) {
+        previousHandler = previous;
+    }
+}
+
+quint64 LogSink::written()
+{
+    return writtenCount.load(std::memory_order_relaxed);
+}
+
+quint64 LogSink::dropped()
+{
+    return droppedCount.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,46 @@
+#ifndef LOGSINK_H
+#define LOGSINK_H
+
+#include <QString>
+#include <QtGlobal>
+#include <atomic>
+
+// Persistent log on disk. Any thread hands a line to a bounded lock-free
+// queue and returns at once; a background writer drains the queue in large
+// sequential writes, rotates the segment by size and age, compresses closed
+// segments with qCompress and deletes the oldest ones beyond the disk budget.
+// When the queue is full, or its lines would exceed the LogStorage memory
+// budget, the line is dropped and counted, never waited for.
+class LogSink
+{
+public:
+    struct Options {
+        QString directory;
+        QString baseName = "asdKeypad";
+        qint64 maxSegmentBytes = 8 << 20;
+        int maxSegmentSeconds = 3600;
+        qint64 maxTotalBytes = 256 << 20;     // Current segment plus compressed ones
+        bool compress = true;
+    };
+
+    static const int QUEUE_CAPACITY = 1 << 14;
+    static const int FLUSH_INTERVAL_MS = 200;
+
+    static bool start(const Options &options, QString *errorMessage);
+    static void stop();
+    static bool isRunning() { return s_running.load(std::memory_order_relaxed); }
+    static QString currentFile();
+
+    static void write(QtMsgType type, const QString &message);
+
+    // Sends qDebug and friends to the sink, then on to the previous handler
+    static void installMessageHandler();
+
+    static quint64 written();
+    static quint64 dropped();
+
+private:
+    static std::atomic<bool> s_running;
+};
+
+#endif // LOGSINK_H
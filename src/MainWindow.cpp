@@ -9,8 +9,31 @@
 #include "AutoKeypress.h"
 #include "Colors.h"
 #include "SetPriceDialog.h"
+#include "Tracer.h"
+#include "LogSink.h"
+#include "StallWatchdog.h"
+#include "RemoteSerialPort.h"
+#include "MemoryBudget.h"
 #include <QTextEdit>
 #include <QSplitter>
+#include <QFileDialog>
+#include <QTimer>
+#include <QDateTime>
+#include <QSignalBlocker>
+#include <QSettings>
+#include <QInputDialog>
+#include <QMutex>
+
+namespace {
+
+// Console lines from any thread, waiting for the GUI thread. Only one drain
+// is posted at a time, so a logging burst cannot pile up queued events.
+QMutex consoleQueueMutex;
+QStringList consoleQueue;
+int consoleQueueDropped = 0;
+bool consoleDrainPosted = false;
+
+}
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent),
@@ -19,6 +42,17 @@ MainWindow::MainWindow(QWidget *parent)
       m_mockSerialComm(nullptr),
       m_keypressCommands(nullptr),
       m_autoKeypress(nullptr),
+      m_priceTableProgrammer(nullptr),
+      m_vmcState(new VmcStateCache(this)),
+      m_recovery(nullptr),
+      m_metricsServer(new MetricsServer(this)),
+      m_discovery(new VmcDiscovery(this)),
+      m_profileLoader(new VmcProfileLoader(this)),
+      m_linkProbe(new LinkProbe(this)),
+      m_keyRateTuner(nullptr),
+      m_presenter(nullptr),
+      m_dashboard(nullptr),
+      m_memoryPanel(nullptr),
       m_showKeepaliveLogs(false)
 {
     if (m_useMockSerial) {
@@ -27,14 +61,37 @@ MainWindow::MainWindow(QWidget *parent)
     } else {
         m_serialComm = new SerialCommunication(this);
         m_keypressCommands = new KeypressCommands(m_serialComm, this);
+        m_priceTableProgrammer = new PriceTableProgrammer(m_serialComm, this);
+        m_recovery = new VmcRecovery(m_serialComm, this);
+        m_keyRateTuner = new KeyRateTuner(m_serialComm, m_keypressCommands, this);
     }
 
     setupUi();
+    m_presenter = new UiPresenter(m_display, m_consoleOutput, this);
     m_menuBar = new QMenuBar(this);
     setMenuBar(m_menuBar);
     setupMenuBar();
     setupAutoKeypress();
     connectSignalsAndSlots();
+    onVmcStateChanged();
+
+    // Restore the VMC profile from the last session; it is reloaded on change
+    connect(m_profileLoader, &VmcProfileLoader::profileChanged, this, [this](const QString &name) {
+        if (m_serialComm) {
+            m_serialComm->reloadProfile();
+        }
+        logAction(QString("VMC profile %1 active").arg(name));
+    });
+    connect(m_profileLoader, &VmcProfileLoader::loadFailed, this, [this](const QString &error) {
+        errorLog(QString("VMC profile not reloaded: %1").arg(error));
+    });
+    QSettings settings("YourCompany", "asdKeypad");
+    const QString profileFile = settings.value("VmcProfileFile").toString();
+    QString profileError;
+    if (!profileFile.isEmpty()
+        && !m_profileLoader->load(profileFile, settings.value("VmcProfileName").toString(), &profileError)) {
+        errorLog(profileError);
+    }
     qDebug() << "MainWindow constructed";
 }
 
@@ -83,11 +140,16 @@ void MainWindow::setupUi()
     keypadLayout->setSpacing(5);  // Reduce spacing
 
     // Add widgets to splitter
+    m_dashboard = new LinkDashboard(this);
+    m_memoryPanel = new MemoryPanel(this);
+
     m_mainSplitter->addWidget(m_consoleOutput);
     m_mainSplitter->addWidget(keypadWidget);
+    m_mainSplitter->addWidget(m_dashboard);
+    m_mainSplitter->addWidget(m_memoryPanel);
 
     // Set initial sizes to give more space to the keypad
-    m_mainSplitter->setSizes(QList<int>() << 300 << 500);
+    m_mainSplitter->setSizes(QList<int>() << 300 << 500 << 320 << 320);
 
     // Serial port controls
     QHBoxLayout *portLayout = new QHBoxLayout();
@@ -116,6 +178,11 @@ void MainWindow::setupUi()
     m_display->setFixedHeight(40);  // Set a reasonable height
     keypadLayout->addWidget(m_display);
 
+    // Mirrored VMC state, updated from decoded responses
+    m_vmcStateLabel = new QLabel(this);
+    m_vmcStateLabel->setStyleSheet("color: white;");
+    keypadLayout->addWidget(m_vmcStateLabel);
+
     // Keypad
     QGridLayout *numpadLayout = new QGridLayout();
     numpadLayout->setSpacing(5);  // Reduce spacing between buttons
@@ -217,8 +284,31 @@ void MainWindow::setupMenuBar()
     // Add actions to Tools menu
     toolsMenu->addAction(tr("&Clear Log"), this, &MainWindow::onClearLogClicked);
     toolsMenu->addAction(tr("Change &Default Port"), this, &MainWindow::onChangeDefaultPortClicked);
+    toolsMenu->addAction(tr("Add Re&mote Port..."), this, &MainWindow::onAddRemotePortClicked);
+    m_discoverAction = toolsMenu->addAction(tr("Disc&over VMC Ports"), this, &MainWindow::onDiscoverVmcClicked);
+    m_discoverAction->setEnabled(!m_useMockSerial);
+    toolsMenu->addAction(tr("Load VMC P&rofile..."), this, &MainWindow::onLoadProfileClicked);
+    connect(m_discovery, &VmcDiscovery::finished, this, &MainWindow::onDiscoveryFinished);
+    m_probeAction = toolsMenu->addAction(tr("&Probe Link Quality"), this, &MainWindow::onProbeLinkClicked);
+    m_probeAction->setEnabled(!m_useMockSerial);
+    connect(m_linkProbe, &LinkProbe::finished, this, &MainWindow::onLinkProbeFinished);
+    toolsMenu->addAction(tr("Show &Stall Report"), this, &MainWindow::onShowStallReportClicked);
+    connect(m_linkProbe, &LinkProbe::progress, this, [this](int done, int total) {
+        m_probeAction->setText(tr("Cancel Link &Probe (%1%)").arg(done * 100 / qMax(1, total)));
+    });
+    m_tuneKeyRateAction = toolsMenu->addAction(tr("Tune &Keypress Rate"), this, &MainWindow::onTuneKeyRateClicked);
+    m_tuneKeyRateAction->setEnabled(!m_useMockSerial);
+    if (m_keyRateTuner) {
+        connect(m_keyRateTuner, &KeyRateTuner::finished, this, &MainWindow::onKeyRateTuned);
+        connect(m_keyRateTuner, &KeyRateTuner::trialFinished, this, [this](const KeyRateTuner::Trial &trial) {
+            logAction("Key rate trial " + trial.format());
+        });
+    }
     toolsMenu->addAction(tr("Clear VMC &Error"), this, &MainWindow::onClearVMCErrorClicked);
     toolsMenu->addAction(tr("Set VMC &Prices"), this, &MainWindow::onSetVMCPricesClicked);
+    QAction *programPriceTableAction = toolsMenu->addAction(tr("Program Price &Table..."),
+                                                            this, &MainWindow::onProgramPriceTableClicked);
+    programPriceTableAction->setEnabled(!m_useMockSerial);
 
     // Add keepalive mechanism toggle
     m_toggleKeepaliveAction = toolsMenu->addAction(tr("Enable &Keepalive"));
@@ -233,6 +323,67 @@ void MainWindow::setupMenuBar()
     m_showKeepaliveLogsAction->setEnabled(false);  // Disabled by default
     connect(m_showKeepaliveLogsAction, &QAction::toggled, this, &MainWindow::onToggleKeepaliveLogs);
 
+    // Add ack-based reliable delivery toggle
+    m_reliableDeliveryAction = toolsMenu->addAction(tr("&Reliable Delivery"));
+    m_reliableDeliveryAction->setCheckable(true);
+    m_reliableDeliveryAction->setChecked(false);
+    m_reliableDeliveryAction->setEnabled(!m_useMockSerial);
+    connect(m_reliableDeliveryAction, &QAction::toggled, this, &MainWindow::onToggleReliableDelivery);
+
+    // Add automatic clearing of VMC faults, remembered across sessions
+    m_autoRecoveryAction = toolsMenu->addAction(tr("Auto &Recover VMC Faults"));
+    m_autoRecoveryAction->setCheckable(true);
+    m_autoRecoveryAction->setEnabled(!m_useMockSerial);
+    if (m_recovery) {
+        QSettings settings("YourCompany", "asdKeypad");
+        m_autoRecoveryAction->setChecked(settings.value("AutoRecovery", false).toBool());
+        m_recovery->setOptions(VmcRecovery::optionsFromSettings());
+        m_recovery->setEnabled(m_autoRecoveryAction->isChecked());
+    }
+    connect(m_autoRecoveryAction, &QAction::toggled, this, &MainWindow::onToggleAutoRecovery);
+
+    // Add per-port choice of the termios/epoll backend; applies on the next connect
+    m_nativeBackendAction = toolsMenu->addAction(tr("&Native Serial Backend for This Port"));
+    m_nativeBackendAction->setCheckable(true);
+    m_nativeBackendAction->setEnabled(!m_useMockSerial && SerialCommunication::isNativeBackendAvailable());
+    refreshNativeBackendAction();
+    connect(m_nativeBackendAction, &QAction::toggled, this, &MainWindow::onToggleNativeBackend);
+    connect(m_portComboBox, &QComboBox::currentTextChanged, this, &MainWindow::refreshNativeBackendAction);
+
+    // Add binary traffic capture for offline analysis
+    m_captureAction = toolsMenu->addAction(tr("&Capture Traffic..."));
+    m_captureAction->setCheckable(true);
+    m_captureAction->setChecked(false);
+    m_captureAction->setEnabled(!m_useMockSerial);
+    connect(m_captureAction, &QAction::toggled, this, &MainWindow::onToggleCapture);
+
+    // Add Prometheus metrics endpoint, restored from the last session
+    m_metricsAction = toolsMenu->addAction(tr("Serve &Metrics on localhost"));
+    m_metricsAction->setCheckable(true);
+    m_metricsAction->setChecked(false);
+    connect(m_metricsAction, &QAction::toggled, this, &MainWindow::onToggleMetricsEndpoint);
+    m_metricsAction->setChecked(QSettings("YourCompany", "asdKeypad").value("MetricsEndpoint", false).toBool());
+
+    // Add latency/throughput dashboard toggle, restored from the last session
+    m_dashboardAction = toolsMenu->addAction(tr("Show &Dashboard"));
+    m_dashboardAction->setCheckable(true);
+    connect(m_dashboardAction, &QAction::toggled, this, &MainWindow::onToggleDashboard);
+    m_dashboardAction->setChecked(QSettings("YourCompany", "asdKeypad").value("ShowDashboard", true).toBool());
+    m_dashboard->setVisible(m_dashboardAction->isChecked());
+
+    // Add per-subsystem memory usage against budgets, restored from the last session
+    m_memoryPanelAction = toolsMenu->addAction(tr("Show Memory &Usage"));
+    m_memoryPanelAction->setCheckable(true);
+    connect(m_memoryPanelAction, &QAction::toggled, this, &MainWindow::onToggleMemoryPanel);
+    m_memoryPanelAction->setChecked(QSettings("YourCompany", "asdKeypad").value("ShowMemoryPanel", false).toBool());
+    m_memoryPanel->setVisible(m_memoryPanelAction->isChecked());
+
+    // Add keypress path tracing; the trace is saved when it is switched off
+    m_traceAction = toolsMenu->addAction(tr("&Trace Keypress Path"));
+    m_traceAction->setCheckable(true);
+    m_traceAction->setChecked(false);
+    connect(m_traceAction, &QAction::toggled, this, &MainWindow::onToggleTracing);
+
     // Add actions to Help menu
     helpMenu->addAction(tr("&About"), this, &MainWindow::onAboutClicked);
 
@@ -259,6 +410,12 @@ void MainWindow::setupMenuBar()
 void MainWindow::setupAutoKeypress()
 {
     m_autoKeypress = new AutoKeypress(m_keypressCommands, this);
+    if (m_recovery) {
+        m_recovery->setAutomation(m_autoKeypress);
+    }
+    if (m_keyRateTuner) {
+        m_keyRateTuner->setAutomation(m_autoKeypress);
+    }
     
     // The button is now created in setupUi(), so we don't need to create it here
     // Just connect the signals and slots
@@ -270,6 +427,9 @@ void MainWindow::setupAutoKeypress()
 void MainWindow::onAutoKeypressToggled(bool checked)
 {
     if (checked) {
+        // Run as fast as this port's VMC was found to take keys, if it was tuned
+        const int tunedInterval = m_serialComm ? KeyRateTuner::savedInterval(m_serialComm->getCurrentPortName()) : 0;
+        m_autoKeypress->setInterval(tunedInterval > 0 ? tunedInterval : AutoKeypress::DEFAULT_INTERVAL_MS);
         m_autoKeypress->startSequence();
         m_autoKeypressButton->setText("Stop Auto Keypress");
         logAction("Auto Keypress sequence started");
@@ -290,44 +450,47 @@ void MainWindow::onAutoKeypressCompleted()
 void MainWindow::onAutoKeypressKeyPressed(const QString &key)
 {
     // Update the display
-    m_display->setText(m_display->text() + key);
+    m_presenter->appendDisplay(key);
     logAction("Auto Keypress: " + key);
 }
 
 void MainWindow::logAction(const QString &action)
 {
+    LogSink::write(QtInfoMsg, QString("Action: %1").arg(action));
     appendToConsole(QString("Action: %1").arg(action));
 }
 
 void MainWindow::errorLog(const QString &error)
 {
+    LogSink::write(QtCriticalMsg, QString("ERROR: %1").arg(error));
     appendToConsole(QString("ERROR: %1").arg(error));
 }
 
 void MainWindow::onDigitClicked()
 {
+    TraceSpan span("MainWindow::onDigitClicked");
     QPushButton *button = qobject_cast<QPushButton*>(sender());
     if (button) {
-        m_display->setText(m_display->text() + button->text());
+        m_presenter->appendDisplay(button->text());
         logAction("Digit clicked: " + button->text());
     }
 }
 
 void MainWindow::onClearClicked()
 {
-    m_display->clear();
+    m_presenter->clearDisplay();
     logAction("Display cleared");
 }
 
 void MainWindow::onEnterClicked()
 {
-    logAction("Enter clicked, value: " + m_display->text());
+    logAction("Enter clicked, value: " + m_presenter->displayText());
     // Here you would typically send the entered value to the serial port
     if (m_useMockSerial) {
         if (m_mockSerialComm->isPortOpen()) {
-            QByteArray command = m_display->text().toUtf8();
+            QByteArray command = m_presenter->displayText().toUtf8();
             if (m_mockSerialComm->sendCommand(command)) {
-                logAction("Command sent: " + m_display->text());
+                logAction("Command sent: " + m_presenter->displayText());
             } else {
                 errorLog("Failed to send command");
             }
@@ -336,9 +499,9 @@ void MainWindow::onEnterClicked()
         }
     } else {
         if (m_serialComm->isPortOpen()) {
-            QByteArray command = m_display->text().toUtf8();
+            QByteArray command = m_presenter->displayText().toUtf8();
             if (m_serialComm->sendCommand(command)) {
-                logAction("Command sent: " + m_display->text());
+                logAction("Command sent: " + m_presenter->displayText());
             } else {
                 errorLog("Failed to send command");
             }
@@ -346,7 +509,7 @@ void MainWindow::onEnterClicked()
             errorLog("Serial port is not open");
         }
     }
-    m_display->clear();
+    m_presenter->clearDisplay();
 }
 
 void MainWindow::onConnectClicked()
@@ -373,7 +536,7 @@ void MainWindow::onConnectClicked()
                         return;
                     }
 
-                    SerialCommunication::SerialConfig config;
+                    SerialCommunication::SerialConfig config = SerialCommunication::configForPort(portName);
                     if (m_serialComm->openPort(portName, config)) {
                         logAction("Connected to port: " + portName);
                     } else {
@@ -399,13 +562,15 @@ void MainWindow::onConnectClicked()
 
 void MainWindow::onPortStatusChanged(bool isOpen)
 {
-    m_portStatusLabel->setText(isOpen ? "Connected" : "Not Connected");
-    m_connectButton->setText(isOpen ? "Disconnect" : "Connect");
+    m_presenter->schedule("portStatus", [this, isOpen]() {
+        m_portStatusLabel->setText(isOpen ? "Connected" : "Not Connected");
+        m_connectButton->setText(isOpen ? "Disconnect" : "Connect");
+    });
 }
 
 void MainWindow::onClearLogClicked()
 {
-    m_consoleOutput->clear();
+    m_presenter->clearLog();
     logAction("Log cleared");
 }
 
@@ -420,6 +585,225 @@ void MainWindow::onChangeDefaultPortClicked()
     logAction("Default port changed to: " + newDefaultPort);
 }
 
+void MainWindow::onAddRemotePortClicked()
+{
+    if (m_useMockSerial) {
+        return;
+    }
+    bool ok = false;
+    QString address = QInputDialog::getText(this, tr("Add Remote Port"),
+                                            tr("Serial bridge address (host:port):"),
+                                            QLineEdit::Normal, QString(), &ok).trimmed();
+    if (!ok || address.isEmpty()) {
+        return;
+    }
+    if (!RemoteSerialPort::isRemotePortName(address)) {
+        address.prepend("tcp://");
+    }
+    QString host;
+    quint16 port = 0;
+    if (!RemoteSerialPort::parsePortName(address, &host, &port)) {
+        errorLog(QString("Not a bridge address: %1").arg(address));
+        return;
+    }
+
+    SerialCommunication::addRemotePort(address);
+    m_portComboBox->clear();
+    m_portComboBox->addItems(m_serialComm->getAvailablePorts());
+    m_portComboBox->setCurrentText(address);
+    logAction("Remote port added: " + address);
+}
+
+void MainWindow::onDiscoverVmcClicked()
+{
+    if (m_useMockSerial || m_discovery->isRunning()) {
+        return;
+    }
+
+    // The connected port is busy and already known; probe everything else
+    QStringList candidates;
+    const QString connectedPort = m_serialComm->isPortOpen() ? m_serialComm->getCurrentPortName() : QString();
+    for (const QString &port : m_serialComm->getAvailablePorts()) {
+        const QString portName = port.split(" ").first();
+        if (portName != connectedPort) {
+            candidates.append(portName);
+        }
+    }
+    if (candidates.isEmpty()) {
+        logAction("Discovery: no other serial ports to probe");
+        return;
+    }
+
+    QList<qint32> baudRates;
+    const QString baudSetting = QSettings("YourCompany", "asdKeypad").value("DiscoveryBaudRates", "9600").toString();
+    if (!VmcDiscovery::parseBaudRates(baudSetting, &baudRates)) {
+        baudRates = {QSerialPort::Baud9600};
+    }
+    m_discovery->setBaudRates(baudRates);
+
+    m_discoverAction->setEnabled(false);
+    logAction(QString("Discovery: probing %1 ports").arg(candidates.size()));
+    m_discovery->start(candidates);
+}
+
+void MainWindow::onDiscoveryFinished()
+{
+    m_discoverAction->setEnabled(true);
+
+    const QList<VmcDiscovery::Result> vmcs = m_discovery->vmcPorts();
+    logAction(QString("Discovery: %1 VMC port(s) found in %2 ms").arg(vmcs.size()).arg(m_discovery->elapsedMs()));
+    for (const VmcDiscovery::Result &result : vmcs) {
+        logAction(QString("  %1 at %2 baud, answered in %3 ms")
+                  .arg(result.portName).arg(result.baudRate).arg(result.responseMs));
+    }
+    if (vmcs.isEmpty()) {
+        return;
+    }
+
+    // Preselect the fastest responder so Connect goes straight to it
+    m_portComboBox->clear();
+    m_portComboBox->addItems(m_serialComm->getAvailablePorts());
+    for (int i = 0; i < m_portComboBox->count(); ++i) {
+        if (m_portComboBox->itemText(i).split(" ").first() == vmcs.first().portName) {
+            m_portComboBox->setCurrentIndex(i);
+            break;
+        }
+    }
+}
+
+void MainWindow::onProbeLinkClicked()
+{
+    if (m_useMockSerial) {
+        return;
+    }
+    if (m_linkProbe->isRunning()) {
+        m_linkProbe->cancel();
+        logAction("Link probe: cancelling");
+        return;
+    }
+    if (!m_serialComm->isPortOpen()) {
+        errorLog("Link probe: connect to the port to probe first");
+        return;
+    }
+
+    QSettings settings("YourCompany", "asdKeypad");
+    LinkProbe::Options options;
+    options.portName = m_serialComm->getCurrentPortName();
+    options.config = SerialCommunication::configForPort(options.portName);
+    options.transactions = settings.value("ProbeTransactions", LinkProbe::DEFAULT_TRANSACTIONS).toInt();
+    options.timeoutMs = settings.value("ProbeTimeoutMs", LinkProbe::DEFAULT_TIMEOUT_MS).toInt();
+    options.noopFrame = QByteArray::fromHex(settings.value("ProbeNoopFrame").toByteArray());
+
+    // The probe takes the port for itself; the link is reopened when it is done
+    m_serialComm->closePort();
+    m_connectButton->setEnabled(false);
+    m_probeAction->setText(tr("Cancel Link &Probe"));
+    logAction(QString("Link probe: %1 transactions on %2").arg(options.transactions).arg(options.portName));
+    m_linkProbe->start(options);
+}
+
+void MainWindow::onLinkProbeFinished()
+{
+    m_probeAction->setText(tr("&Probe Link Quality"));
+
+    const LinkProbe::Report report = m_linkProbe->report();
+    if (!report.isValid()) {
+        errorLog(report.error);
+    } else {
+        for (const QString &line : report.format()) {
+            logAction(line);
+        }
+    }
+
+    if (m_serialComm->openPort(report.portName, SerialCommunication::configForPort(report.portName))) {
+        logAction("Reconnected to port: " + report.portName);
+    } else {
+        errorLog("Failed to reconnect to port: " + report.portName);
+    }
+    m_connectButton->setEnabled(true);
+}
+
+void MainWindow::onTuneKeyRateClicked()
+{
+    if (!m_keyRateTuner) {
+        return;
+    }
+    if (m_keyRateTuner->isRunning()) {
+        m_keyRateTuner->cancel();
+        return;
+    }
+    if (!m_serialComm->isPortOpen()) {
+        errorLog("Key rate: connect to the port to tune first");
+        return;
+    }
+    QSettings settings("YourCompany", "asdKeypad");
+    KeyRateTuner::Options options;
+    options.minIntervalMs = settings.value("KeyRateMinIntervalMs", KeyRateTuner::DEFAULT_MIN_INTERVAL_MS).toInt();
+    options.keysPerTrial = settings.value("KeyRateKeysPerTrial", KeyRateTuner::DEFAULT_KEYS_PER_TRIAL).toInt();
+    options.marginPercent = settings.value("KeyRateMarginPercent", KeyRateTuner::DEFAULT_MARGIN_PERCENT).toInt();
+
+    QString startError;
+    if (!m_keyRateTuner->start(options, &startError)) {
+        errorLog("Key rate: " + startError);
+        return;
+    }
+    m_autoKeypressButton->setEnabled(false);
+    m_tuneKeyRateAction->setText(tr("Cancel &Keypress Rate Tuning"));
+    logAction(QString("Key rate: tuning %1, keys typed on the VMC will be cleared")
+              .arg(m_serialComm->getCurrentPortName()));
+}
+
+void MainWindow::onKeyRateTuned()
+{
+    m_tuneKeyRateAction->setText(tr("Tune &Keypress Rate"));
+    m_autoKeypressButton->setEnabled(true);
+
+    const KeyRateTuner::Result result = m_keyRateTuner->result();
+    const QStringList lines = result.format();
+    // The trials were logged as they finished
+    logAction(lines.first());
+    for (int i = 1 + result.trials.size(); i < lines.size(); ++i) {
+        if (result.isValid()) {
+            logAction(lines.at(i));
+        } else {
+            errorLog(lines.at(i));
+        }
+    }
+    if (result.isValid()) {
+        KeyRateTuner::saveResult(result);
+        m_autoKeypress->setInterval(result.recommendedIntervalMs);
+    }
+}
+
+void MainWindow::onShowStallReportClicked()
+{
+    if (!StallWatchdog::isRunning()) {
+        logAction("Stall watchdog is off (StallThresholdMs is 0)");
+        return;
+    }
+    for (const QString &line : StallWatchdog::report()) {
+        appendToConsole(line);
+    }
+}
+
+void MainWindow::onLoadProfileClicked()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Load VMC Profile"), QString(),
+                                                    tr("VMC profiles (*.json);;All Files (*)"));
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    // The file's "active" profile is used; VmcProfileName can override it
+    QSettings settings("YourCompany", "asdKeypad");
+    QString loadError;
+    if (!m_profileLoader->load(fileName, settings.value("VmcProfileName").toString(), &loadError)) {
+        errorLog(loadError);
+        return;
+    }
+    settings.setValue("VmcProfileFile", m_profileLoader->fileName());
+}
+
 void MainWindow::onExitClicked()
 {
     QApplication::quit();
@@ -433,8 +817,7 @@ void MainWindow::onAboutClicked()
 void MainWindow::onClearVMCErrorClicked()
 {
     logAction("Clear VMC Error clicked");
-    // Implement the clear VMC error functionality here
-    // For now, we'll just send a placeholder command
+    // The mock only logs what it is sent, so it still gets the placeholder command
     if (m_useMockSerial) {
         if (m_mockSerialComm->isPortOpen()) {
             QByteArray command = "CLEAR_VMC_ERROR";
@@ -448,12 +831,9 @@ void MainWindow::onClearVMCErrorClicked()
         }
     } else {
         if (m_serialComm->isPortOpen()) {
-            QByteArray command = "CLEAR_VMC_ERROR";
-            if (m_serialComm->sendCommand(command)) {
-                logAction("Clear VMC Error command sent");
-            } else {
-                errorLog("Failed to send Clear VMC Error command");
-            }
+            // Same sequence as automatic recovery: clear, verify, resume automation
+            m_recovery->recover();
+            logAction("Clear VMC Error sequence sent");
         } else {
             errorLog("Serial port is not open");
         }
@@ -478,6 +858,40 @@ void MainWindow::showSetPriceDialog()
     }
 }
 
+void MainWindow::onProgramPriceTableClicked()
+{
+    if (!m_serialComm->isPortOpen()) {
+        errorLog("Serial port is not open");
+        return;
+    }
+    if (m_priceTableProgrammer->isRunning()) {
+        errorLog("Price table upload already in progress");
+        return;
+    }
+    if (m_keyRateTuner && m_keyRateTuner->isRunning()) {
+        errorLog("Price table: wait for key rate tuning to finish");
+        return;
+    }
+
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Open Price Table"), QString(),
+                                                    tr("Price tables (*.csv *.txt);;All files (*)"));
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    QMap<int, int> table;
+    QString loadError;
+    if (!PriceTableProgrammer::loadTable(fileName, &table, &loadError)) {
+        errorLog(loadError);
+        return;
+    }
+
+    logAction(QString("Programming price table %1 (%2 selections)").arg(fileName).arg(table.size()));
+    if (!m_priceTableProgrammer->program(table)) {
+        errorLog("Failed to start price table upload");
+    }
+}
+
 void MainWindow::onAutoKeypressClicked()
 {
     m_autoKeypressButton->toggle();
@@ -499,6 +913,20 @@ void MainWindow::connectSignalsAndSlots()
     connect(m_buttons[10], &QPushButton::clicked, m_keypressCommands, &KeypressCommands::sendKeypressStar);
     connect(m_buttons[11], &QPushButton::clicked, m_keypressCommands, &KeypressCommands::sendKeypressHash);
 
+    // Feed the dashboard
+    connect(m_keypressCommands, &KeypressCommands::keySent, m_dashboard, &LinkDashboard::recordKeypress);
+    if (!m_useMockSerial) {
+        connect(m_serialComm, &SerialCommunication::frameDelivered, m_dashboard,
+                [this](const QByteArray &, qint64 rttMs) { m_dashboard->recordLatency(rttMs); });
+        connect(m_serialComm, &SerialCommunication::frameFailed, m_dashboard, &LinkDashboard::recordError);
+        connect(m_serialComm, &SerialCommunication::error, m_dashboard, &LinkDashboard::recordError);
+        connect(m_serialComm, &SerialCommunication::portStatusChanged, m_dashboard, [this](bool isOpen) {
+            if (isOpen) {
+                m_dashboard->setPort(m_serialComm->getCurrentPortName());
+            }
+        });
+    }
+
     // Connect serial port status changes
     if (m_useMockSerial) {
         connect(m_mockSerialComm, &MockSerialCommunication::portStatusChanged, this, &MainWindow::onPortStatusChanged);
@@ -508,10 +936,53 @@ void MainWindow::connectSignalsAndSlots()
 
     // Add these new connections
     if (!m_useMockSerial) {
+        connect(m_serialComm, &SerialCommunication::frameReceived,
+                m_vmcState, &VmcStateCache::handleFrame);
+        connect(m_serialComm, &SerialCommunication::portStatusChanged, m_vmcState, [this](bool isOpen) {
+            if (!isOpen) {
+                m_vmcState->reset();
+            }
+        });
+        connect(m_vmcState, &VmcStateCache::stateChanged, this, &MainWindow::onVmcStateChanged);
+        connect(m_vmcState, &VmcStateCache::errorChanged, this, [this](quint8 code, quint8 flags) {
+            if (flags != 0) {
+                errorLog(QString("VMC reported error %1 (flags 0x%2)").arg(int(code)).arg(int(flags), 2, 16, QChar('0')));
+            } else {
+                logAction("VMC error cleared");
+            }
+        });
+        connect(m_recovery, &VmcRecovery::faultDetected, this, [this](const QString &description, qint64 detectMs) {
+            errorLog(QString("%1; detected in %2 ms, recovering").arg(description).arg(detectMs));
+        });
+        connect(m_recovery, &VmcRecovery::recovered, this, [this](qint64 recoverMs, int attempts) {
+            logAction(QString("VMC recovered in %1 ms (%2 clear attempt%3)")
+                      .arg(recoverMs).arg(attempts).arg(attempts == 1 ? "" : "s"));
+        });
+        connect(m_recovery, &VmcRecovery::recoveryFailed, this, [this](const QString &reason) {
+            errorLog(QString("%1; automation stays paused until the VMC is cleared").arg(reason));
+        });
         connect(m_serialComm, &SerialCommunication::keepaliveMessage, 
                 this, &MainWindow::onKeepaliveMessage);
         connect(m_serialComm, &SerialCommunication::normalMessage, 
                 this, &MainWindow::onNormalMessage);
+        connect(m_serialComm, &SerialCommunication::frameDelivered, this,
+                [this](const QByteArray &frame, qint64 rttMs) {
+            logAction(QString("Ack for %1 in %2 ms").arg(QString(frame.toHex())).arg(rttMs));
+        });
+        connect(m_priceTableProgrammer, &PriceTableProgrammer::finished, this,
+                [this](int programmed, int failed, int unchanged, qint64 elapsedMs) {
+            QString summary = QString("Price table: %1 programmed, %2 failed, %3 unchanged in %4 ms")
+                              .arg(programmed).arg(failed).arg(unchanged).arg(elapsedMs);
+            if (failed > 0) {
+                errorLog(summary);
+            } else {
+                logAction(summary);
+            }
+        });
+        connect(m_serialComm, &SerialCommunication::frameFailed, this,
+                [this](const QByteArray &frame) {
+            errorLog(QString("Frame %1 was not acknowledged").arg(QString(frame.toHex())));
+        });
     }
 }
 
@@ -543,6 +1014,156 @@ void MainWindow::onToggleKeepalive(bool enable)
     }
 }
 
+void MainWindow::onToggleReliableDelivery(bool enable)
+{
+    if (!m_useMockSerial) {
+        m_serialComm->setReliableDelivery(enable);
+        logAction(enable ? "Reliable delivery enabled" : "Reliable delivery disabled");
+    }
+}
+
+void MainWindow::onToggleAutoRecovery(bool enable)
+{
+    if (!m_recovery) {
+        return;
+    }
+    QSettings settings("YourCompany", "asdKeypad");
+    settings.setValue("AutoRecovery", enable);
+    m_recovery->setOptions(VmcRecovery::optionsFromSettings());
+    m_recovery->setEnabled(enable);
+    logAction(enable ? "Automatic VMC fault recovery enabled" : "Automatic VMC fault recovery disabled");
+}
+
+void MainWindow::onToggleNativeBackend(bool enable)
+{
+    const QString portName = m_portComboBox->currentText();
+    if (m_useMockSerial || portName.isEmpty()) {
+        return;
+    }
+
+    SerialCommunication::setPortBackend(portName, enable ? SerialCommunication::SerialConfig::NativeBackend
+                                                         : SerialCommunication::SerialConfig::QtSerialPortBackend);
+    logAction(QString("%1 will use the %2 backend on the next connect")
+              .arg(portName, enable ? "native termios" : "QSerialPort"));
+}
+
+void MainWindow::refreshNativeBackendAction()
+{
+    QSignalBlocker blocker(m_nativeBackendAction);
+    m_nativeBackendAction->setChecked(!m_useMockSerial &&
+        SerialCommunication::configForPort(m_portComboBox->currentText()).backend
+            == SerialCommunication::SerialConfig::NativeBackend);
+}
+
+void MainWindow::onToggleCapture(bool enable)
+{
+    if (m_useMockSerial) {
+        return;
+    }
+
+    if (!enable) {
+        if (m_serialComm->isCapturing()) {
+            m_serialComm->stopCapture();
+            logAction("Traffic capture stopped");
+        }
+        return;
+    }
+
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Capture Traffic To"),
+                                                    QString("capture-%1.asdcap")
+                                                        .arg(QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss")),
+                                                    tr("Captures (*.asdcap);;All files (*)"));
+    if (fileName.isEmpty() || !m_serialComm->startCapture(fileName)) {
+        QSignalBlocker blocker(m_captureAction);
+        m_captureAction->setChecked(false);
+        return;
+    }
+    logAction(QString("Capturing traffic to %1").arg(fileName));
+}
+
+void MainWindow::onToggleMetricsEndpoint(bool enable)
+{
+    QSettings settings("YourCompany", "asdKeypad");
+    if (!enable) {
+        m_metricsServer->stop();
+        settings.setValue("MetricsEndpoint", false);
+        logAction("Metrics endpoint stopped");
+        return;
+    }
+
+    quint16 port = static_cast<quint16>(settings.value("MetricsPort", int(MetricsServer::DEFAULT_PORT)).toUInt());
+    QString startError;
+    if (!m_metricsServer->start(port, &startError)) {
+        errorLog(startError);
+        QSignalBlocker blocker(m_metricsAction);
+        m_metricsAction->setChecked(false);
+        return;
+    }
+    settings.setValue("MetricsEndpoint", true);
+    logAction(QString("Serving metrics on http://127.0.0.1:%1/metrics").arg(port));
+}
+
+void MainWindow::onToggleDashboard(bool show)
+{
+    m_dashboard->setVisible(show);
+    QSettings("YourCompany", "asdKeypad").setValue("ShowDashboard", show);
+}
+
+void MainWindow::onToggleMemoryPanel(bool show)
+{
+    m_memoryPanel->setVisible(show);
+    QSettings("YourCompany", "asdKeypad").setValue("ShowMemoryPanel", show);
+    if (show) {
+        for (const QString &line : MemoryBudget::report()) {
+            appendToConsole(line);
+        }
+    }
+}
+
+void MainWindow::onToggleTracing(bool enable)
+{
+    if (enable) {
+        Tracer::clear();
+        Tracer::setEnabled(true);
+        logAction("Tracing started");
+        return;
+    }
+
+    Tracer::setEnabled(false);
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Save Trace"),
+                                                    QString("trace-%1.json")
+                                                        .arg(QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss")),
+                                                    tr("Chrome trace (*.json);;All files (*)"));
+    if (fileName.isEmpty()) {
+        logAction("Tracing stopped, trace discarded");
+        return;
+    }
+
+    QString exportError;
+    if (!Tracer::exportChromeJson(fileName, &exportError)) {
+        errorLog(exportError);
+        return;
+    }
+    logAction(QString("Trace saved to %1 (open in ui.perfetto.dev or chrome://tracing)").arg(fileName));
+}
+
+void MainWindow::onVmcStateChanged()
+{
+    m_presenter->schedule("vmcState", [this]() { refreshVmcStateLabel(); });
+}
+
+void MainWindow::refreshVmcStateLabel()
+{
+    int credit = m_vmcState->creditCents();
+    QString error = m_vmcState->hasError()
+        ? QString("error %1").arg(int(m_vmcState->errorCode()))
+        : QString("no error");
+    m_vmcStateLabel->setText(QString("VMC entry: %1 | Credit: $%2.%3 | %4")
+        .arg(m_vmcState->selectionEntry().isEmpty() ? QString("-") : m_vmcState->selectionEntry())
+        .arg(credit / 100).arg(credit % 100, 2, 10, QChar('0'))
+        .arg(error));
+}
+
 void MainWindow::messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &msg)
 {
     QString txt;
@@ -561,18 +1182,65 @@ void MainWindow::messageHandler(QtMsgType type, const QMessageLogContext &contex
         break;
     }
 
-    // Use a safer way to post the message
-    QMetaObject::invokeMethod(qApp, [txt]() {
-        for (QWidget *widget : QApplication::topLevelWidgets()) {
-            if (MainWindow *mainWindow = qobject_cast<MainWindow*>(widget)) {
-                mainWindow->appendToConsole(txt);
-                break;
+    LogSink::write(type, msg);
+    if (type == QtFatalMsg) {
+        LogSink::stop();                       // Flush before the abort
+    }
+
+    const bool charged = MemoryBudget::tryCharge(MemoryBudget::LogStorage, txt.size() * 2);
+    if (!charged) {
+        MemoryBudget::recordEviction(MemoryBudget::LogStorage, txt.size() * 2);
+    }
+    bool post = false;
+    {
+        QMutexLocker lock(&consoleQueueMutex);
+        if (charged) {
+            consoleQueue.append(txt);
+        } else {
+            consoleQueueDropped++;
+        }
+        post = !consoleDrainPosted;
+        consoleDrainPosted = true;
+    }
+    if (post) {
+        QMetaObject::invokeMethod(qApp, []() { drainConsoleQueue(); }, Qt::QueuedConnection);
+    }
+}
+
+void MainWindow::drainConsoleQueue()
+{
+    QStringList lines;
+    int dropped = 0;
+    {
+        QMutexLocker lock(&consoleQueueMutex);
+        lines.swap(consoleQueue);
+        dropped = consoleQueueDropped;
+        consoleQueueDropped = 0;
+        consoleDrainPosted = false;
+    }
+    for (const QString &line : lines) {
+        MemoryBudget::release(MemoryBudget::LogStorage, line.size() * 2);
+    }
+
+    for (QWidget *widget : QApplication::topLevelWidgets()) {
+        if (MainWindow *mainWindow = qobject_cast<MainWindow*>(widget)) {
+            if (dropped > 0) {
+                mainWindow->appendToConsole(QString("... %1 log lines dropped, over the log memory budget ...")
+                                            .arg(dropped));
+            }
+            for (const QString &line : lines) {
+                mainWindow->appendToConsole(line);
             }
+            break;
         }
-    }, Qt::QueuedConnection);
+    }
 }
 
 void MainWindow::appendToConsole(const QString &text)
 {
-    m_consoleOutput->append(text);
+    if (m_presenter) {
+        m_presenter->appendLog(text);
+    } else {
+        m_consoleOutput->append(text);
+    }
 }
\ No newline at end of file
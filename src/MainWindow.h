@@ -11,6 +11,17 @@
 #include "KeypressCommands.h"
 #include "MockSerialCommunication.h"
 #include "AutoKeypress.h"
+#include "PriceTableProgrammer.h"
+#include "VmcStateCache.h"
+#include "MetricsServer.h"
+#include "UiPresenter.h"
+#include "LinkDashboard.h"
+#include "MemoryPanel.h"
+#include "VmcDiscovery.h"
+#include "VmcProfile.h"
+#include "LinkProbe.h"
+#include "KeyRateTuner.h"
+#include "VmcRecovery.h"
 #include <QMenuBar>
 #include <QTextEdit>
 #include <QSplitter>
@@ -31,17 +42,38 @@ private slots:
     void onPortStatusChanged(bool isOpen);
     void onClearLogClicked();
     void onChangeDefaultPortClicked();
+    void onAddRemotePortClicked();
+    void onDiscoverVmcClicked();
+    void onDiscoveryFinished();
+    void onProbeLinkClicked();
+    void onLinkProbeFinished();
+    void onTuneKeyRateClicked();
+    void onKeyRateTuned();
+    void onShowStallReportClicked();
+    void onLoadProfileClicked();
     void onExitClicked();
     void onAboutClicked();
     void onClearVMCErrorClicked();
     void onSetVMCPricesClicked();
+    void onProgramPriceTableClicked();
     void onAutoKeypressClicked();
     void onToggleKeepaliveLogs(bool show);
     void onKeepaliveMessage(const QString &message);
     void onNormalMessage(const QString &message);
     void onToggleKeepalive(bool enable);
+    void onToggleReliableDelivery(bool enable);
+    void onToggleAutoRecovery(bool enable);
+    void onToggleNativeBackend(bool enable);
+    void refreshNativeBackendAction();
+    void onToggleCapture(bool enable);
+    void onToggleMetricsEndpoint(bool enable);
+    void onToggleTracing(bool enable);
+    void onToggleDashboard(bool show);
+    void onToggleMemoryPanel(bool show);
+    void onVmcStateChanged();
 
 private:
+    void refreshVmcStateLabel();
     void setupUi();
     void setupMenuBar();
     void logAction(const QString &action);
@@ -56,11 +88,23 @@ private:
     QPushButton *m_connectButton;
     QComboBox *m_portComboBox;
     QLabel *m_portStatusLabel;
+    QLabel *m_vmcStateLabel;
     SerialCommunication *m_serialComm;
     MockSerialCommunication *m_mockSerialComm;
     KeypressCommands *m_keypressCommands;
     bool m_useMockSerial;
     AutoKeypress *m_autoKeypress;
+    PriceTableProgrammer *m_priceTableProgrammer;
+    VmcStateCache *m_vmcState;
+    VmcRecovery *m_recovery;
+    MetricsServer *m_metricsServer;
+    VmcDiscovery *m_discovery;
+    VmcProfileLoader *m_profileLoader;
+    LinkProbe *m_linkProbe;
+    KeyRateTuner *m_keyRateTuner;
+    UiPresenter *m_presenter;
+    LinkDashboard *m_dashboard;
+    MemoryPanel *m_memoryPanel;
     QPushButton *m_autoKeypressButton;
 
     void setupAutoKeypress();
@@ -75,11 +119,23 @@ private:
     bool m_showKeepaliveLogs;
     QAction* m_toggleKeepaliveAction;
     QAction* m_showKeepaliveLogsAction;
+    QAction* m_reliableDeliveryAction;
+    QAction* m_autoRecoveryAction;
+    QAction* m_nativeBackendAction;
+    QAction* m_captureAction;
+    QAction* m_metricsAction;
+    QAction* m_traceAction;
+    QAction* m_dashboardAction;
+    QAction* m_memoryPanelAction;
+    QAction* m_discoverAction;
+    QAction* m_probeAction;
+    QAction* m_tuneKeyRateAction;
 
     QTextEdit *m_consoleOutput;
     QSplitter *m_mainSplitter;
 
     static void messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &msg);
+    static void drainConsoleQueue();
 };
 
 #endif // MAINWINDOW_H
\ No newline at end of file
@@ -0,0 +1,203 @@
+#include "MemoryBudget.h"
+#include <QFile>
+#include <QSettings>
+#include <atomic>
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct Account {
+    std::atomic<qint64> bytes{0};
+    std::atomic<qint64> peakBytes{0};
+    std::atomic<qint64> budgetBytes{0};
+    std::atomic<quint64> refused{0};
+    std::atomic<quint64> evictedBytes{0};
+};
+
+const char *const NAMES[MemoryBudget::SUBSYSTEM_COUNT] = {
+    "serial", "log", "ui", "automation"
+};
+
+const qint64 DEFAULT_BUDGETS[MemoryBudget::SUBSYSTEM_COUNT] = {
+    1 << 20,                                   // Serial buffers, summed over every open link
+    16 << 20,                                  // About 100k queued lines
+    8 << 20,                                   // Console document
+    1 << 20                                    // Tens of thousands of waiting frames
+};
+
+Account *accounts()
+{
+    static Account table[MemoryBudget::SUBSYSTEM_COUNT];
+    static bool initialized = [] {
+        for (int i = 0; i < MemoryBudget::SUBSYSTEM_COUNT; ++i) {
+            table[i].budgetBytes.store(DEFAULT_BUDGETS[i], std::memory_order_relaxed);
+        }
+        return true;
+    }();
+    Q_UNUSED(initialized);
+    return table;
+}
+
+void updatePeak(Account &account, qint64 bytes)
+{
+    qint64 peak = account.peakBytes.load(std::memory_order_relaxed);
+    while (bytes > peak && !account.peakBytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed)) {
+    }
+}
+
+QString formatBytes(qint64 bytes)
+{
+    if (bytes >= 10 << 20) {
+        return QString("%1 MB").arg(bytes >> 20);
+    }
+    if (bytes >= 10 << 10) {
+        return QString("%1 KB").arg(bytes >> 10);
+    }
+    return QString("%1 B").arg(bytes);
+}
+
+}
+
+const char *MemoryBudget::name(Subsystem subsystem)
+{
+    return NAMES[subsystem];
+}
+
+qint64 MemoryBudget::defaultBudget(Subsystem subsystem)
+{
+    return DEFAULT_BUDGETS[subsystem];
+}
+
+void MemoryBudget::setBudget(Subsystem subsystem, qint64 bytes)
+{
+    // Lowering a budget refuses new charges; what is already held drains normally
+    accounts()[subsystem].budgetBytes.store(qMax<qint64>(0, bytes), std::memory_order_relaxed);
+}
+
+qint64 MemoryBudget::budget(Subsystem subsystem)
+{
+    return accounts()[subsystem].budgetBytes.load(std::memory_order_relaxed);
+}
+
+void MemoryBudget::loadSettings()
+{
+    QSettings settings("YourCompany", "asdKeypad");
+    for (int i = 0; i < SUBSYSTEM_COUNT; ++i) {
+        const Subsystem subsystem = static_cast<Subsystem>(i);
+        const QVariant value = settings.value(QString("MemoryBudget/%1").arg(name(subsystem)));
+        setBudget(subsystem, value.isValid() ? value.toLongLong() : defaultBudget(subsystem));
+    }
+}
+
+bool MemoryBudget::tryCharge(Subsystem subsystem, qint64 bytes)
+{
+    Account &account = accounts()[subsystem];
+    const qint64 limit = account.budgetBytes.load(std::memory_order_relaxed);
+    qint64 current = account.bytes.load(std::memory_order_relaxed);
+    do {
+        if (current + bytes > limit) {
+            account.refused.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    } while (!account.bytes.compare_exchange_weak(current, current + bytes, std::memory_order_relaxed));
+    updatePeak(account, current + bytes);
+    return true;
+}
+
+void MemoryBudget::release(Subsystem subsystem, qint64 bytes)
+{
+    accounts()[subsystem].bytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+void MemoryBudget::setUsage(Subsystem subsystem, qint64 bytes)
+{
+    Account &account = accounts()[subsystem];
+    account.bytes.store(bytes, std::memory_order_relaxed);
+    updatePeak(account, bytes);
+}
+
+void MemoryBudget::recordEviction(Subsystem subsystem, qint64 bytes)
+{
+    accounts()[subsystem].evictedBytes.fetch_add(static_cast<quint64>(bytes), std::memory_order_relaxed);
+}
+
+bool MemoryBudget::appendEvictingOldest(Subsystem subsystem, QByteArray *buffer, const QByteArray &data)
+{
+    while (!tryCharge(subsystem, data.size())) {
+        if (buffer->isEmpty()) {
+            recordEviction(subsystem, data.size());
+            return false;
+        }
+        // Make room for at least the new data, or give up the whole buffer
+        const int evicted = qMin(buffer->size(), qMax(data.size(), buffer->size() / 2));
+        buffer->remove(0, evicted);
+        release(subsystem, evicted);
+        recordEviction(subsystem, evicted);
+    }
+    buffer->append(data);
+    return true;
+}
+
+void MemoryBudget::removeFront(Subsystem subsystem, QByteArray *buffer, int count)
+{
+    count = qBound(0, count, buffer->size());
+    buffer->remove(0, count);
+    release(subsystem, count);
+}
+
+void MemoryBudget::clear(Subsystem subsystem, QByteArray *buffer)
+{
+    release(subsystem, buffer->size());
+    buffer->clear();
+}
+
+MemoryBudget::Usage MemoryBudget::usage(Subsystem subsystem)
+{
+    const Account &account = accounts()[subsystem];
+    Usage result;
+    result.bytes = account.bytes.load(std::memory_order_relaxed);
+    result.peakBytes = account.peakBytes.load(std::memory_order_relaxed);
+    result.budgetBytes = account.budgetBytes.load(std::memory_order_relaxed);
+    result.refused = account.refused.load(std::memory_order_relaxed);
+    result.evictedBytes = account.evictedBytes.load(std::memory_order_relaxed);
+    return result;
+}
+
+qint64 MemoryBudget::residentBytes()
+{
+#ifdef Q_OS_LINUX
+    // statm: size resident shared ..., in pages
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.size() < 2) {
+        return -1;
+    }
+    return fields.at(1).toLongLong() * ::sysconf(_SC_PAGESIZE);
+#else
+    return -1;
+#endif
+}
+
+QStringList MemoryBudget::report()
+{
+    QStringList lines;
+    for (int i = 0; i < SUBSYSTEM_COUNT; ++i) {
+        const Subsystem subsystem = static_cast<Subsystem>(i);
+        const Usage current = usage(subsystem);
+        lines << QString("Memory %1: %2 of %3 (peak %4), %5 refused, %6 evicted")
+                 .arg(QString::fromLatin1(name(subsystem)), -10)
+                 .arg(formatBytes(current.bytes), formatBytes(current.budgetBytes), formatBytes(current.peakBytes))
+                 .arg(current.refused)
+                 .arg(formatBytes(static_cast<qint64>(current.evictedBytes)));
+    }
+    const qint64 resident = residentBytes();
+    if (resident >= 0) {
+        lines << QString("Memory resident: %1").arg(formatBytes(resident));
+    }
+    return lines;
+}
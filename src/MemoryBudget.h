@@ -0,0 +1,66 @@
+#ifndef MEMORYBUDGET_H
+#define MEMORYBUDGET_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+// Per-subsystem memory accounting with hard budgets, so a month-long
+// unattended run keeps a flat footprint. Owners of growing structures charge
+// what they hold and release it when they let go. A charge that would take a
+// subsystem over its budget is refused, and the owner applies its policy:
+//   SerialBuffers    RX, decoder and bridge buffers: oldest evicted; TX queues
+//                    and write tails: new data refused; capture: written early
+//   LogStorage       lines queued for the disk log or the console: new lines dropped
+//   UiDocument       console document: oldest blocks evicted
+//   AutomationState  frames waiting for a reliable-delivery slot: new frames refused
+// Counters are relaxed atomics; any thread may charge and release.
+class MemoryBudget
+{
+public:
+    enum Subsystem {
+        SerialBuffers,
+        LogStorage,
+        UiDocument,
+        AutomationState,
+        SUBSYSTEM_COUNT
+    };
+
+    struct Usage {
+        qint64 bytes = 0;
+        qint64 peakBytes = 0;
+        qint64 budgetBytes = 0;
+        quint64 refused = 0;                   // Charges refused
+        quint64 evictedBytes = 0;              // Evicted or dropped to stay within budget
+    };
+
+    static const char *name(Subsystem subsystem);
+    static qint64 defaultBudget(Subsystem subsystem);
+
+    static void setBudget(Subsystem subsystem, qint64 bytes);
+    static qint64 budget(Subsystem subsystem);
+    // MemoryBudget/<name> settings, in bytes; missing ones keep the default
+    static void loadSettings();
+
+    // Adds bytes unless that would exceed the budget; nothing is charged on refusal
+    static bool tryCharge(Subsystem subsystem, qint64 bytes);
+    static void release(Subsystem subsystem, qint64 bytes);
+    // For structures that are measured rather than counted
+    static void setUsage(Subsystem subsystem, qint64 bytes);
+    static void recordEviction(Subsystem subsystem, qint64 bytes);
+
+    // Appends data to a byte buffer charged to subsystem, evicting the
+    // buffer's oldest bytes to make room. Returns false if data does not fit
+    // even in an empty buffer; it is then dropped.
+    static bool appendEvictingOldest(Subsystem subsystem, QByteArray *buffer, const QByteArray &data);
+    // Removes and releases the first count bytes of a charged buffer
+    static void removeFront(Subsystem subsystem, QByteArray *buffer, int count);
+    // Releases everything buffer holds and empties it
+    static void clear(Subsystem subsystem, QByteArray *buffer);
+
+    static Usage usage(Subsystem subsystem);
+    static qint64 residentBytes();             // Process RSS; -1 where unknown
+    static QStringList report();
+};
+
+#endif // MEMORYBUDGET_H
@@ -0,0 +1,129 @@
+#include "MemoryPanel.h"
+#include "Colors.h"
+#include "MemoryBudget.h"
+#include <QPainter>
+#include <QPolygonF>
+
+namespace {
+
+const int ROW_HEIGHT = 34;
+
+QString megabytes(qint64 bytes)
+{
+    return QString::number(bytes / double(1 << 20), 'f', bytes < (10 << 20) ? 2 : 0) + " MB";
+}
+
+}
+
+MemoryPanel::MemoryPanel(QWidget *parent)
+    : QWidget(parent)
+    , m_resident(HISTORY_SECONDS, 0)
+    , m_next(0)
+    , m_samples(0)
+{
+    setMinimumWidth(260);
+    m_sampleTimer.setInterval(1000);
+    connect(&m_sampleTimer, &QTimer::timeout, this, &MemoryPanel::sample);
+    m_sampleTimer.start();
+}
+
+QSize MemoryPanel::sizeHint() const
+{
+    return QSize(320, 340);
+}
+
+void MemoryPanel::sample()
+{
+    m_resident[m_next] = qMax<qint64>(0, MemoryBudget::residentBytes());
+    m_next = (m_next + 1) % HISTORY_SECONDS;
+    m_samples = qMin(m_samples + 1, int(HISTORY_SECONDS));
+    if (isVisible()) {
+        update();
+    }
+}
+
+void MemoryPanel::paintEvent(QPaintEvent *)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), AppColors::PanelBackground);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+
+    QRect area = rect().adjusted(8, 8, -8, -8);
+    painter.setPen(Qt::white);
+    painter.drawText(area.left(), area.top() + 12, "Memory by subsystem");
+    area.setTop(area.top() + 20);
+
+    for (int i = 0; i < MemoryBudget::SUBSYSTEM_COUNT; ++i) {
+        const MemoryBudget::Subsystem subsystem = static_cast<MemoryBudget::Subsystem>(i);
+        const MemoryBudget::Usage usage = MemoryBudget::usage(subsystem);
+        const QRect row(area.left(), area.top() + i * ROW_HEIGHT, area.width(), ROW_HEIGHT - 6);
+
+        painter.setPen(Qt::white);
+        painter.drawText(row.left(), row.top() + 12,
+                         QString("%1  %2 of %3").arg(QString::fromLatin1(MemoryBudget::name(subsystem)),
+                                                     megabytes(usage.bytes), megabytes(usage.budgetBytes)));
+        // Evicting subsystems show bytes given up, back-pressured ones the writes refused
+        QStringList losses;
+        if (usage.evictedBytes > 0) {
+            losses << QString("%1 evicted").arg(megabytes(static_cast<qint64>(usage.evictedBytes)));
+        }
+        if (usage.refused > 0) {
+            losses << QString("%1 refused").arg(usage.refused);
+        }
+        if (!losses.isEmpty()) {
+            painter.setPen(AppColors::ErrorRed);
+            painter.drawText(row, Qt::AlignTop | Qt::AlignRight, losses.join(", "));
+        }
+
+        const QRect bar = row.adjusted(0, 16, 0, 0);
+        painter.setPen(AppColors::PanelGrid);
+        painter.drawRect(bar);
+        const double budget = qMax<qint64>(1, usage.budgetBytes);
+        const double fill = qMin(1.0, usage.bytes / budget);
+        painter.fillRect(QRectF(bar.left(), bar.top(), bar.width() * fill, bar.height()),
+                         fill > 0.9 ? AppColors::ErrorRed : AppColors::Gold);
+        const double peakX = bar.left() + bar.width() * qMin(1.0, usage.peakBytes / budget);
+        painter.setPen(QPen(AppColors::Beige, 2));
+        painter.drawLine(QPointF(peakX, bar.top()), QPointF(peakX, bar.bottom()));
+    }
+
+    area.setTop(area.top() + MemoryBudget::SUBSYSTEM_COUNT * ROW_HEIGHT);
+    drawResident(painter, area);
+}
+
+void MemoryPanel::drawResident(QPainter &painter, const QRect &area) const
+{
+    const qint64 latest = m_samples > 0 ? m_resident.at((m_next - 1 + HISTORY_SECONDS) % HISTORY_SECONDS) : 0;
+    painter.setPen(Qt::white);
+    painter.drawText(area.left(), area.top() + 12,
+                     latest > 0 ? QString("Resident %1 - last %2 s").arg(megabytes(latest)).arg(HISTORY_SECONDS)
+                                : QString("Resident size not available"));
+    if (latest <= 0 || m_samples < 2) {
+        return;
+    }
+
+    QRect plot = area.adjusted(0, 18, 0, 0);
+    painter.setPen(AppColors::PanelGrid);
+    painter.drawRect(plot);
+
+    qint64 minValue = latest;
+    qint64 maxValue = latest;
+    for (int age = 0; age < m_samples; ++age) {
+        const qint64 value = m_resident.at((m_next - 1 - age + 2 * HISTORY_SECONDS) % HISTORY_SECONDS);
+        minValue = qMin(minValue, value);
+        maxValue = qMax(maxValue, value);
+    }
+    // Scaled to the observed range, so a slow climb is visible and not flattened
+    painter.drawText(plot.adjusted(2, 2, -2, -2), Qt::AlignTop | Qt::AlignRight, megabytes(maxValue));
+    painter.drawText(plot.adjusted(2, 2, -2, -2), Qt::AlignBottom | Qt::AlignRight, megabytes(minValue));
+
+    const double xStep = static_cast<double>(plot.width()) / (HISTORY_SECONDS - 1);
+    const double yScale = static_cast<double>(plot.height()) / qMax<qint64>(1, maxValue - minValue);
+    QPolygonF line(m_samples);
+    for (int age = 0; age < m_samples; ++age) {
+        const qint64 value = m_resident.at((m_next - 1 - age + 2 * HISTORY_SECONDS) % HISTORY_SECONDS);
+        line[age] = QPointF(plot.right() - age * xStep, plot.bottom() - (value - minValue) * yScale);
+    }
+    painter.setPen(QPen(AppColors::Gold, 1.5));
+    painter.drawPolyline(line);
+}
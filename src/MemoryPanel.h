@@ -0,0 +1,37 @@
+#ifndef MEMORYPANEL_H
+#define MEMORYPANEL_H
+
+#include <QWidget>
+#include <QTimer>
+#include <QVector>
+
+// Diagnostics view of MemoryBudget: one bar per subsystem showing bytes held
+// against its budget, with the peak marked, and the process RSS over the
+// last HISTORY_SECONDS so a slow leak shows up as a slope.
+class MemoryPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    static const int HISTORY_SECONDS = 600;
+
+    explicit MemoryPanel(QWidget *parent = nullptr);
+
+    QSize sizeHint() const override;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private slots:
+    void sample();
+
+private:
+    QTimer m_sampleTimer;
+    QVector<qint64> m_resident;                // HISTORY_SECONDS entries, preallocated
+    int m_next;                                // Slot the coming sample is written to
+    int m_samples;
+
+    void drawResident(QPainter &painter, const QRect &area) const;
+};
+
+#endif // MEMORYPANEL_H
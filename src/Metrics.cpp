@@ -0,0 +1,205 @@
+#include "Metrics.h"
+#include "MemoryBudget.h"
+#include "VmcProfile.h"
+
+namespace {
+
+const char *const FRAME_TYPE_NAMES[Metrics::FRAME_TYPE_COUNT] = {
+    "keypress", "price", "keepalive", "credit", "error", "other"
+};
+
+const char *const PRIORITY_NAMES[Metrics::PRIORITY_COUNT] = {
+    "operator", "automation", "keepalive"
+};
+
+Metrics::FrameType classifyCommand(quint8 command)
+{
+    switch (VmcProfile::current()->commandClass(command)) {
+    case VmcProfile::KeypadCommand: return Metrics::KeypressFrame;
+    case VmcProfile::PriceCommand: return Metrics::PriceFrame;
+    case VmcProfile::CreditCommand: return Metrics::CreditFrame;
+    case VmcProfile::ErrorCommand: return Metrics::ErrorFrame;
+    default: return Metrics::OtherFrame;
+    }
+}
+
+void writeHeader(QByteArray &out, const char *name, const char *type, const char *help)
+{
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+void writeSample(QByteArray &out, const char *name, const QByteArray &labels, qint64 value)
+{
+    out += name;
+    if (!labels.isEmpty()) {
+        out += '{' + labels + '}';
+    }
+    out += ' ';
+    out += QByteArray::number(value);
+    out += '\n';
+}
+
+void writeCounter(QByteArray &out, const char *name, const char *help, const MetricCounter &counter)
+{
+    writeHeader(out, name, "counter", help);
+    writeSample(out, name, QByteArray(), static_cast<qint64>(counter.value()));
+}
+
+void writeGauge(QByteArray &out, const char *name, const char *help, const MetricGauge &gauge)
+{
+    writeHeader(out, name, "gauge", help);
+    writeSample(out, name, QByteArray(), gauge.value());
+}
+
+void writeFrameCounters(QByteArray &out, const char *name, const char *help,
+                        const MetricCounter (&counters)[Metrics::FRAME_TYPE_COUNT])
+{
+    writeHeader(out, name, "counter", help);
+    for (int i = 0; i < Metrics::FRAME_TYPE_COUNT; ++i) {
+        writeSample(out, name, QByteArray("type=\"") + FRAME_TYPE_NAMES[i] + '"',
+                    static_cast<qint64>(counters[i].value()));
+    }
+}
+
+void writeHistogram(QByteArray &out, const char *name, const char *help, const MetricHistogram &histogram)
+{
+    writeHeader(out, name, "histogram", help);
+
+    // The last LatencyHistogram bucket is open-ended and only shows up in +Inf.
+    // Buckets exclude their upper bound and samples are whole milliseconds,
+    // so bucket i holds exactly the samples <= 2^i - 1.
+    const QByteArray bucketName = QByteArray(name) + "_bucket";
+    quint64 cumulative = 0;
+    for (int i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i) {
+        cumulative += histogram.buckets().bucket(i);
+        if (i < LatencyHistogram::BUCKET_COUNT - 1) {
+            writeSample(out, bucketName.constData(),
+                        "le=\"" + QByteArray::number(LatencyHistogram::bucketUpperBoundMs(i) - 1) + '"',
+                        static_cast<qint64>(cumulative));
+        }
+    }
+    writeSample(out, bucketName.constData(), "le=\"+Inf\"", static_cast<qint64>(cumulative));
+    writeSample(out, (QByteArray(name) + "_sum").constData(), QByteArray(),
+                static_cast<qint64>(histogram.sumMs()));
+    writeSample(out, (QByteArray(name) + "_count").constData(), QByteArray(),
+                static_cast<qint64>(cumulative));
+}
+
+void writeMemory(QByteArray &out, const char *name, const char *type, const char *help,
+                 qint64 MemoryBudget::Usage::*field)
+{
+    writeHeader(out, name, type, help);
+    for (int i = 0; i < MemoryBudget::SUBSYSTEM_COUNT; ++i) {
+        const MemoryBudget::Subsystem subsystem = static_cast<MemoryBudget::Subsystem>(i);
+        writeSample(out, name, QByteArray("subsystem=\"") + MemoryBudget::name(subsystem) + '"',
+                    MemoryBudget::usage(subsystem).*field);
+    }
+}
+
+}
+
+Metrics &Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+Metrics::FrameType Metrics::classify(const QByteArray &frame)
+{
+    if (frame == VmcProfile::current()->keepaliveRequest()) {
+        return KeepaliveFrame;
+    }
+    if (!VmcProtocol::isFrame(frame)) {
+        return OtherFrame;
+    }
+    return classifyCommand(static_cast<quint8>(frame.at(1)));
+}
+
+Metrics::FrameType Metrics::classify(const VmcFrame &frame)
+{
+    if (frame.isKeepaliveResponse) {
+        return KeepaliveFrame;
+    }
+    return classifyCommand(frame.command);
+}
+
+QByteArray Metrics::renderPrometheus() const
+{
+    QByteArray out;
+    out.reserve(8192);
+
+    writeCounter(out, "asd_tx_bytes_total", "Bytes written to the VMC link.", txBytes);
+    writeCounter(out, "asd_rx_bytes_total", "Bytes read from the VMC link.", rxBytes);
+    writeFrameCounters(out, "asd_tx_frames_total", "Frames written, by type.", txFrames);
+    writeFrameCounters(out, "asd_rx_frames_total", "Frames decoded from the VMC, by type.", rxFrames);
+    writeCounter(out, "asd_decode_checksum_errors_total", "RX sync bytes followed by a bad checksum.", checksumErrors);
+    writeCounter(out, "asd_decode_discarded_bytes_total", "RX bytes that were not part of a frame.", discardedBytes);
+    writeCounter(out, "asd_tx_dropped_total", "Frames dropped by a full TX queue or a short write.", txDropped);
+    writeCounter(out, "asd_port_opens_total", "Successful port or device opens.", portOpens);
+    writeCounter(out, "asd_connection_losses_total", "Links closed by an error rather than by request.", connectionLosses);
+    writeCounter(out, "asd_reconnects_total", "Opens that followed a lost connection.", reconnects);
+    writeCounter(out, "asd_keepalives_sent_total", "Keepalive requests queued.", keepalivesSent);
+    writeCounter(out, "asd_keepalive_misses_total", "Keepalives still unanswered when the next one was due.", keepaliveMisses);
+    writeCounter(out, "asd_delivery_failures_total", "Reliable frames that ran out of retries.", deliveryFailures);
+    writeGauge(out, "asd_ports_open", "Links currently open.", portsOpen);
+
+    writeHeader(out, "asd_tx_queue_depth", "gauge", "Frames waiting in the TX queue, by priority.");
+    for (int i = 0; i < PRIORITY_COUNT; ++i) {
+        writeSample(out, "asd_tx_queue_depth", QByteArray("priority=\"") + PRIORITY_NAMES[i] + '"',
+                    queueDepth[i].value());
+    }
+    writeGauge(out, "asd_tx_in_flight_bytes", "Bytes written but not yet reported sent by the driver.", inFlightBytes);
+    writeHistogram(out, "asd_tx_queue_wait_milliseconds", "Time frames spent in the TX queue.", queueWaitMs);
+    writeHistogram(out, "asd_ack_latency_milliseconds", "Reliable frame send-to-echo latency.", ackLatencyMs);
+
+    writeCounter(out, "asd_keypresses_total", "Key presses sent.", keypresses);
+    writeCounter(out, "asd_keypress_failures_total", "Key presses that could not be sent.", keypressFailures);
+    writeCounter(out, "asd_price_commands_total", "Set-price commands sent.", priceCommands);
+
+    writeCounter(out, "asd_auto_sequences_started_total", "Auto keypress sequences started.", autoSequencesStarted);
+    writeCounter(out, "asd_auto_sequences_completed_total", "Auto keypress sequences run to the end.", autoSequencesCompleted);
+    writeCounter(out, "asd_auto_keypresses_total", "Keys pressed by auto keypress.", autoKeypresses);
+    writeGauge(out, "asd_auto_running", "Auto keypress sequences currently running.", autoRunning);
+
+    writeCounter(out, "asd_vmc_faults_total", "VMC error reports and unacknowledged runs that started a recovery.",
+                 vmcFaults);
+    writeCounter(out, "asd_vmc_recoveries_total", "VMC faults cleared and verified.", vmcRecoveries);
+    writeCounter(out, "asd_vmc_recovery_failures_total", "Recoveries that ran out of clear attempts.", vmcRecoveryFailures);
+    writeHistogram(out, "asd_vmc_fault_detect_milliseconds", "Time from the first symptom of a fault to its detection.",
+                   vmcFaultDetectMs);
+    writeHistogram(out, "asd_vmc_recovery_milliseconds", "Time from fault detection to a verified clean VMC.",
+                   vmcRecoveryMs);
+
+    writeMemory(out, "asd_memory_bytes", "gauge", "Bytes held, by subsystem.", &MemoryBudget::Usage::bytes);
+    writeMemory(out, "asd_memory_peak_bytes", "gauge", "Most bytes held at once, by subsystem.",
+                &MemoryBudget::Usage::peakBytes);
+    writeMemory(out, "asd_memory_budget_bytes", "gauge", "Hard budget, by subsystem.", &MemoryBudget::Usage::budgetBytes);
+    writeHeader(out, "asd_memory_evicted_bytes_total", "counter",
+                "Bytes evicted or dropped to stay within budget, by subsystem.");
+    for (int i = 0; i < MemoryBudget::SUBSYSTEM_COUNT; ++i) {
+        const MemoryBudget::Subsystem subsystem = static_cast<MemoryBudget::Subsystem>(i);
+        writeSample(out, "asd_memory_evicted_bytes_total",
+                    QByteArray("subsystem=\"") + MemoryBudget::name(subsystem) + '"',
+                    static_cast<qint64>(MemoryBudget::usage(subsystem).evictedBytes));
+    }
+    const qint64 resident = MemoryBudget::residentBytes();
+    if (resident >= 0) {
+        writeHeader(out, "asd_resident_memory_bytes", "gauge", "Process resident set size.");
+        writeSample(out, "asd_resident_memory_bytes", QByteArray(), resident);
+    }
+
+    writeCounter(out, "asd_event_loop_stalls_total", "Event loop heartbeats late by more than the stall threshold.",
+                 eventLoopStalls);
+    writeHistogram(out, "asd_event_loop_latency_milliseconds", "Time from heartbeat post to the event loop running it.",
+                   eventLoopLatencyMs);
+
+    return out;
+}
@@ -0,0 +1,118 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QByteArray>
+#include <atomic>
+#include "LatencyHistogram.h"
+
+struct VmcFrame;
+
+class MetricCounter
+{
+public:
+    void add(quint64 amount = 1) { m_value.fetch_add(amount, std::memory_order_relaxed); }
+    quint64 value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<quint64> m_value{0};
+};
+
+class MetricGauge
+{
+public:
+    void add(qint64 amount) { m_value.fetch_add(amount, std::memory_order_relaxed); }
+    void set(qint64 value) { m_value.store(value, std::memory_order_relaxed); }
+    qint64 value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<qint64> m_value{0};
+};
+
+class MetricHistogram
+{
+public:
+    void record(qint64 ms)
+    {
+        m_buckets.record(ms);
+        m_sumMs.fetch_add(static_cast<quint64>(qMax<qint64>(0, ms)), std::memory_order_relaxed);
+    }
+    const LatencyHistogram &buckets() const { return m_buckets; }
+    quint64 sumMs() const { return m_sumMs.load(std::memory_order_relaxed); }
+
+private:
+    LatencyHistogram m_buckets;
+    std::atomic<quint64> m_sumMs{0};
+};
+
+// Process-wide link metrics. Every field is a relaxed atomic, so any thread
+// (GUI, campaign workers) updates them without locks and MetricsServer reads
+// them from its own thread. Values from all open links are summed.
+class Metrics
+{
+public:
+    enum FrameType {
+        KeypressFrame,
+        PriceFrame,
+        KeepaliveFrame,
+        CreditFrame,
+        ErrorFrame,
+        OtherFrame,
+        FRAME_TYPE_COUNT
+    };
+
+    static const int PRIORITY_COUNT = 3;
+
+    static Metrics &instance();
+    static FrameType classify(const QByteArray &frame);
+    static FrameType classify(const VmcFrame &frame);
+
+    QByteArray renderPrometheus() const;
+
+    // SerialCommunication and its TX path
+    MetricCounter txBytes;
+    MetricCounter rxBytes;
+    MetricCounter txFrames[FRAME_TYPE_COUNT];
+    MetricCounter rxFrames[FRAME_TYPE_COUNT];
+    MetricCounter checksumErrors;
+    MetricCounter discardedBytes;
+    MetricCounter txDropped;
+    MetricCounter portOpens;
+    MetricCounter connectionLosses;
+    MetricCounter reconnects;
+    MetricCounter keepalivesSent;
+    MetricCounter keepaliveMisses;
+    MetricCounter deliveryFailures;
+    MetricGauge portsOpen;
+    MetricGauge queueDepth[PRIORITY_COUNT];
+    MetricGauge inFlightBytes;
+    MetricHistogram queueWaitMs;
+    MetricHistogram ackLatencyMs;
+
+    // KeypressCommands
+    MetricCounter keypresses;
+    MetricCounter keypressFailures;
+    MetricCounter priceCommands;
+
+    // AutoKeypress
+    MetricCounter autoSequencesStarted;
+    MetricCounter autoSequencesCompleted;
+    MetricCounter autoKeypresses;
+    MetricGauge autoRunning;
+
+    // VmcRecovery
+    MetricCounter vmcFaults;
+    MetricCounter vmcRecoveries;
+    MetricCounter vmcRecoveryFailures;
+    MetricHistogram vmcFaultDetectMs;
+    MetricHistogram vmcRecoveryMs;
+
+    // StallWatchdog
+    MetricCounter eventLoopStalls;
+    MetricHistogram eventLoopLatencyMs;
+
+private:
+    Metrics() = default;
+    Q_DISABLE_COPY(Metrics)
+};
+
+#endif // METRICS_H
@@ -0,0 +1,109 @@
+#include "MetricsServer.h"
+#include "Metrics.h"
+#include <QDebug>
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+MetricsServer::MetricsServer(QObject *parent)
+    : QObject(parent)
+    , m_server(nullptr)
+    , m_port(0)
+{
+    m_thread.setObjectName("MetricsServer");
+}
+
+MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+bool MetricsServer::start(quint16 port, QString *errorMessage)
+{
+    stop();
+
+    m_server = new QTcpServer;
+    m_server->moveToThread(&m_thread);
+    m_thread.start();
+
+    // listen() runs on the server thread so its socket notifier belongs there
+    bool listening = false;
+    QString listenError;
+    QTcpServer *server = m_server;
+    QMetaObject::invokeMethod(server, [server, port, &listening, &listenError]() {
+        listening = server->listen(QHostAddress::LocalHost, port);
+        if (!listening) {
+            listenError = server->errorString();
+            return;
+        }
+        QObject::connect(server, &QTcpServer::newConnection, server, [server]() {
+            while (QTcpSocket *socket = server->nextPendingConnection()) {
+                QObject::connect(socket, &QTcpSocket::readyRead, socket, [socket]() { handleRequest(socket); });
+                QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            }
+        });
+    }, Qt::BlockingQueuedConnection);
+
+    if (!listening) {
+        *errorMessage = QString("Cannot serve metrics on port %1: %2").arg(port).arg(listenError);
+        stop();
+        return false;
+    }
+
+    m_port = port;
+    qDebug() << "Serving metrics on http://127.0.0.1:" << port << "/metrics";
+    return true;
+}
+
+void MetricsServer::stop()
+{
+    if (!m_server) {
+        return;
+    }
+
+    // Open connections are children of the server and go with it
+    if (m_thread.isRunning()) {
+        QTcpServer *server = m_server;
+        QMetaObject::invokeMethod(server, [server]() {
+            server->close();
+            server->deleteLater();
+        }, Qt::BlockingQueuedConnection);
+        m_thread.quit();
+        m_thread.wait();
+    } else {
+        delete m_server;
+    }
+    m_server = nullptr;
+    m_port = 0;
+}
+
+void MetricsServer::handleRequest(QTcpSocket *socket)
+{
+    // Wait for the complete request head; the body of a GET is ignored
+    QByteArray head = socket->peek(MAX_REQUEST_BYTES);
+    if (!head.contains("\r\n\r\n")) {
+        if (head.size() >= MAX_REQUEST_BYTES) {
+            socket->abort();
+        }
+        return;
+    }
+    socket->readAll();
+
+    QList<QByteArray> requestLine = head.left(head.indexOf("\r\n")).split(' ');
+    QByteArray status = "200 OK";
+    QByteArray body;
+    if (requestLine.size() < 2 || requestLine.at(0) != "GET") {
+        status = "405 Method Not Allowed";
+    } else if (requestLine.at(1) != "/metrics" && !requestLine.at(1).startsWith("/metrics?")) {
+        status = "404 Not Found";
+    } else {
+        body = Metrics::instance().renderPrometheus();
+    }
+
+    QByteArray response = "HTTP/1.1 " + status + "\r\n"
+        "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+        "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+        "Connection: close\r\n\r\n" + body;
+    socket->write(response);
+    socket->disconnectFromHost();
+}
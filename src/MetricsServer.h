@@ -0,0 +1,38 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QObject>
+#include <QThread>
+
+class QTcpServer;
+class QTcpSocket;
+
+// Serves Metrics::renderPrometheus() as "GET /metrics" on 127.0.0.1. The
+// listener and its connections live on a dedicated thread, so a scrape never
+// waits on (or stalls) the GUI event loop.
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const quint16 DEFAULT_PORT = 9464;
+
+    explicit MetricsServer(QObject *parent = nullptr);
+    ~MetricsServer();
+
+    bool start(quint16 port, QString *errorMessage);
+    void stop();
+    bool isRunning() const { return m_thread.isRunning(); }
+    quint16 port() const { return m_port; }
+
+private:
+    QThread m_thread;
+    QTcpServer *m_server;
+    quint16 m_port;
+
+    static const int MAX_REQUEST_BYTES = 8192;
+
+    static void handleRequest(QTcpSocket *socket);
+};
+
+#endif // METRICSSERVER_H
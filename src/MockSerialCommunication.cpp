@@ -32,10 +32,11 @@ void MockSerialCommunication::closePort()
     }
 }
 
-bool MockSerialCommunication::sendCommand(const QByteArray &command)
+bool MockSerialCommunication::sendCommand(const QByteArray &command, TxPriority priority)
 {
     if (m_isOpen) {
-        qDebug() << "Mock: Sending command" << command.toHex();
+        qDebug() << "Mock: Sending command" << command.toHex()
+                 << "priority" << static_cast<int>(priority);
         return true;
     }
     return false;
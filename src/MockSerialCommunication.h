@@ -4,6 +4,7 @@
 #include <QObject>
 #include <QStringList>
 #include <QTimer>
+#include "TxScheduler.h"
 
 class MockSerialCommunication : public QObject
 {
@@ -15,7 +16,7 @@ public:
 
     bool openPort(const QString &portName);
     void closePort();
-    bool sendCommand(const QByteArray &command);
+    bool sendCommand(const QByteArray &command, TxPriority priority = TxPriority::Operator);
     QStringList getAvailablePorts();
     QString getDefaultPort();
     void setDefaultPort(const QString &portName);
@@ -0,0 +1,467 @@
+#include "NativeSerialPort.h"
+#include "MemoryBudget.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMetaObject>
+#include <QSocketNotifier>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/serial.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+
+speed_t speedFor(qint32 baudRate)
+{
+    switch (baudRate) {
+    case 1200: return B1200;
+    case 2400: return B2400;
+    case 4800: return B4800;
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    case 1000000: return B1000000;
+    case 2000000: return B2000000;
+    default: return 0;
+    }
+}
+
+}
+
+NativeSerialPort::NativeSerialPort(QObject *parent)
+    : QIODevice(parent)
+    , m_baudRate(QSerialPort::Baud9600)
+    , m_dataBits(QSerialPort::Data8)
+    , m_parity(QSerialPort::NoParity)
+    , m_stopBits(QSerialPort::OneStop)
+    , m_flowControl(QSerialPort::NoFlowControl)
+    , m_fd(-1)
+    , m_epollFd(-1)
+    , m_notifier(nullptr)
+    , m_lowLatency(false)
+    , m_wantWrite(false)
+    , m_pendingWritten(0)
+{
+}
+
+NativeSerialPort::~NativeSerialPort()
+{
+    close();
+}
+
+bool NativeSerialPort::open(OpenMode mode)
+{
+    if (isOpen()) {
+        setErrorString("Port is already open");
+        return false;
+    }
+
+    const QByteArray path = m_portName.startsWith('/') ? m_portName.toLocal8Bit()
+                                                       : ("/dev/" + m_portName).toLocal8Bit();
+    m_fd = ::open(path.constData(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (m_fd < 0) {
+        setErrorString(QString("open %1: %2").arg(QString::fromLocal8Bit(path), strerror(errno)));
+        return false;
+    }
+    if (::ioctl(m_fd, TIOCEXCL) < 0) {
+        qDebug() << "NativeSerialPort: TIOCEXCL failed:" << strerror(errno);
+    }
+    if (!configure()) {
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    m_epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = m_fd;
+    if (m_epollFd < 0 || ::epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_fd, &event) < 0) {
+        setErrorString(QString("epoll: %1").arg(strerror(errno)));
+        if (m_epollFd >= 0) {
+            ::close(m_epollFd);
+            m_epollFd = -1;
+        }
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    m_wantWrite = false;
+
+    // The epoll fd is itself readable whenever the tty has pending events,
+    // so one notifier in the Qt event loop covers both directions
+    m_notifier = new QSocketNotifier(m_epollFd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &NativeSerialPort::handleActivated);
+
+    ::tcflush(m_fd, TCIOFLUSH);
+
+    // Unbuffered: bytes stay in m_readBuffer only, QIODevice keeps no second copy
+    return QIODevice::open(mode | QIODevice::Unbuffered);
+}
+
+bool NativeSerialPort::configure()
+{
+    termios tio;
+    if (::tcgetattr(m_fd, &tio) < 0) {
+        setErrorString(QString("tcgetattr: %1").arg(strerror(errno)));
+        return false;
+    }
+
+    ::cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+
+    tio.c_cflag &= ~CSIZE;
+    switch (m_dataBits) {
+    case QSerialPort::Data5: tio.c_cflag |= CS5; break;
+    case QSerialPort::Data6: tio.c_cflag |= CS6; break;
+    case QSerialPort::Data7: tio.c_cflag |= CS7; break;
+    default: tio.c_cflag |= CS8; break;
+    }
+
+    tio.c_cflag &= ~(PARENB | PARODD | CMSPAR);
+    switch (m_parity) {
+    case QSerialPort::EvenParity: tio.c_cflag |= PARENB; break;
+    case QSerialPort::OddParity: tio.c_cflag |= PARENB | PARODD; break;
+    case QSerialPort::SpaceParity: tio.c_cflag |= PARENB | CMSPAR; break;
+    case QSerialPort::MarkParity: tio.c_cflag |= PARENB | CMSPAR | PARODD; break;
+    default: break;
+    }
+
+    if (m_stopBits == QSerialPort::TwoStop) {
+        tio.c_cflag |= CSTOPB;
+    } else {
+        tio.c_cflag &= ~CSTOPB;
+    }
+
+    tio.c_cflag &= ~CRTSCTS;
+    tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+    if (m_flowControl == QSerialPort::HardwareControl) {
+        tio.c_cflag |= CRTSCTS;
+    } else if (m_flowControl == QSerialPort::SoftwareControl) {
+        tio.c_iflag |= IXON | IXOFF;
+    }
+
+    // A read returns as soon as one byte is in; the fd is non-blocking and
+    // driven by epoll, so there is no inter-byte timer holding data back
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+
+    const speed_t speed = speedFor(m_baudRate);
+    if (speed == 0) {
+        setErrorString(QString("Unsupported baud rate %1").arg(m_baudRate));
+        return false;
+    }
+    ::cfsetispeed(&tio, speed);
+    ::cfsetospeed(&tio, speed);
+
+    if (::tcsetattr(m_fd, TCSANOW, &tio) < 0) {
+        setErrorString(QString("tcsetattr: %1").arg(strerror(errno)));
+        return false;
+    }
+
+    // USB-serial and 8250 drivers otherwise batch RX for up to 16 ms.
+    // Ptys and many adapters do not implement this; that is not an error.
+    serial_struct serial;
+    m_lowLatency = false;
+    if (::ioctl(m_fd, TIOCGSERIAL, &serial) == 0) {
+        serial.flags |= ASYNC_LOW_LATENCY;
+        m_lowLatency = ::ioctl(m_fd, TIOCSSERIAL, &serial) == 0;
+    }
+    qDebug() << "NativeSerialPort:" << m_portName << "low latency" << m_lowLatency;
+    return true;
+}
+
+void NativeSerialPort::close()
+{
+    if (!isOpen()) {
+        return;
+    }
+
+    // aboutToClose goes out while the fd is still valid
+    QIODevice::close();
+
+    // May be running inside the notifier's own activated() signal
+    m_notifier->setEnabled(false);
+    m_notifier->deleteLater();
+    m_notifier = nullptr;
+    ::close(m_epollFd);
+    m_epollFd = -1;
+    ::close(m_fd);
+    m_fd = -1;
+
+    MemoryBudget::clear(MemoryBudget::SerialBuffers, &m_readBuffer);
+    MemoryBudget::clear(MemoryBudget::SerialBuffers, &m_writeBuffer);
+    m_pendingWritten = 0;
+}
+
+qint64 NativeSerialPort::bytesAvailable() const
+{
+    return m_readBuffer.size() + QIODevice::bytesAvailable();
+}
+
+qint64 NativeSerialPort::bytesToWrite() const
+{
+    return m_writeBuffer.size();
+}
+
+qint64 NativeSerialPort::readData(char *data, qint64 maxSize)
+{
+    if (m_readBuffer.isEmpty() && m_fd >= 0) {
+        readFromFd();
+    }
+    const qint64 count = qMin<qint64>(maxSize, m_readBuffer.size());
+    memcpy(data, m_readBuffer.constData(), count);
+    MemoryBudget::removeFront(MemoryBudget::SerialBuffers, &m_readBuffer, static_cast<int>(count));
+    return count;
+}
+
+qint64 NativeSerialPort::writeData(const char *data, qint64 maxSize)
+{
+    if (m_fd < 0) {
+        return -1;
+    }
+
+    // Straight to the driver unless an earlier tail is still waiting;
+    // only what it refuses is copied
+    qint64 written = 0;
+    if (m_writeBuffer.isEmpty()) {
+        const ssize_t result = ::write(m_fd, data, static_cast<size_t>(maxSize));
+        if (result < 0 && errno != EAGAIN && errno != EINTR) {
+            fail("write");
+            return -1;
+        }
+        written = qMax<qint64>(0, result);
+    }
+    // Over the serial budget the tail is refused and the write comes back short
+    qint64 accepted = maxSize;
+    if (written < maxSize) {
+        if (MemoryBudget::tryCharge(MemoryBudget::SerialBuffers, maxSize - written)) {
+            m_writeBuffer.append(data + written, static_cast<int>(maxSize - written));
+        } else {
+            accepted = written;
+        }
+        updateWriteInterest(!m_writeBuffer.isEmpty());
+    }
+
+    if (written > 0) {
+        if (m_pendingWritten == 0) {
+            queueBytesWritten();
+        }
+        m_pendingWritten += written;
+    }
+    return accepted;
+}
+
+void NativeSerialPort::queueBytesWritten()
+{
+    // Queued like QSerialPort: callers expect bytesWritten after write() returns
+    QMetaObject::invokeMethod(this, [this]() { reportBytesWritten(); }, Qt::QueuedConnection);
+}
+
+void NativeSerialPort::reportBytesWritten()
+{
+    const qint64 written = m_pendingWritten;
+    m_pendingWritten = 0;
+    if (written > 0 && isOpen()) {
+        emit bytesWritten(written);
+    }
+}
+
+bool NativeSerialPort::readFromFd()
+{
+    bool gotData = false;
+    char chunk[READ_CHUNK_BYTES];
+    for (;;) {
+        const ssize_t result = ::read(m_fd, chunk, sizeof(chunk));
+        if (result > 0) {
+            // Unread bytes over the serial budget push out the oldest ones
+            MemoryBudget::appendEvictingOldest(MemoryBudget::SerialBuffers, &m_readBuffer,
+                                               QByteArray::fromRawData(chunk, static_cast<int>(result)));
+            gotData = true;
+            if (result < static_cast<ssize_t>(sizeof(chunk))) {
+                break;
+            }
+        } else if (result == 0 || errno == EAGAIN) {
+            break;
+        } else if (errno != EINTR) {
+            fail("read");
+            break;
+        }
+    }
+    return gotData;
+}
+
+bool NativeSerialPort::flushWriteBuffer()
+{
+    while (!m_writeBuffer.isEmpty()) {
+        const ssize_t result = ::write(m_fd, m_writeBuffer.constData(), m_writeBuffer.size());
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN) {
+                fail("write");
+                return false;
+            }
+            break;
+        }
+        MemoryBudget::removeFront(MemoryBudget::SerialBuffers, &m_writeBuffer, static_cast<int>(result));
+        m_pendingWritten += result;
+    }
+    updateWriteInterest(!m_writeBuffer.isEmpty());
+    return true;
+}
+
+void NativeSerialPort::updateWriteInterest(bool wantWrite)
+{
+    if (wantWrite == m_wantWrite || m_epollFd < 0) {
+        return;
+    }
+    epoll_event event = {};
+    event.events = EPOLLIN | (wantWrite ? EPOLLOUT : 0);
+    event.data.fd = m_fd;
+    ::epoll_ctl(m_epollFd, EPOLL_CTL_MOD, m_fd, &event);
+    m_wantWrite = wantWrite;
+}
+
+bool NativeSerialPort::poll(int msecs, bool *readable, bool *writable)
+{
+    *readable = false;
+    *writable = false;
+
+    // Signals such as StallWatchdog's stack capture interrupt the wait; resume
+    // it for whatever is left rather than report a timeout that never happened
+    epoll_event events[1];
+    QElapsedTimer timer;
+    timer.start();
+    int count;
+    int remaining = msecs;
+    while ((count = ::epoll_wait(m_epollFd, events, 1, remaining)) < 0 && errno == EINTR) {
+        if (msecs > 0) {
+            remaining = qMax(0, msecs - static_cast<int>(timer.elapsed()));
+        }
+    }
+    if (count < 0) {
+        fail("epoll_wait");
+        return false;
+    }
+    if (count == 0) {
+        return false;
+    }
+    if (events[0].events & (EPOLLERR | EPOLLHUP)) {
+        errno = 0;
+        fail("hangup");
+        return false;
+    }
+    *readable = events[0].events & EPOLLIN;
+    *writable = events[0].events & EPOLLOUT;
+    return true;
+}
+
+void NativeSerialPort::handleActivated()
+{
+    bool readable;
+    bool writable;
+    if (!poll(0, &readable, &writable)) {
+        return;
+    }
+
+    if (writable) {
+        const qint64 before = m_pendingWritten;
+        if (flushWriteBuffer() && m_pendingWritten > before) {
+            reportBytesWritten();
+        }
+    }
+    if (readable && readFromFd()) {
+        emit readyRead();
+    }
+}
+
+bool NativeSerialPort::waitForReadyRead(int msecs)
+{
+    if (!isOpen()) {
+        return false;
+    }
+    if (!m_readBuffer.isEmpty()) {
+        return true;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    for (;;) {
+        const int remaining = msecs < 0 ? -1 : qMax<qint64>(0, msecs - timer.elapsed());
+        bool readable;
+        bool writable;
+        if (!poll(remaining, &readable, &writable)) {
+            return false;
+        }
+        if (writable) {
+            // A report is already queued unless this flush is the first to write since the last one
+            const qint64 before = m_pendingWritten;
+            if (flushWriteBuffer() && before == 0 && m_pendingWritten > 0) {
+                queueBytesWritten();
+            }
+        }
+        if (readable && readFromFd()) {
+            emit readyRead();
+            return true;
+        }
+        if (!isOpen() || remaining == 0) {
+            return false;
+        }
+    }
+}
+
+bool NativeSerialPort::waitForBytesWritten(int msecs)
+{
+    if (!isOpen()) {
+        return false;
+    }
+    if (m_writeBuffer.isEmpty()) {
+        return m_pendingWritten > 0;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    while (!m_writeBuffer.isEmpty()) {
+        const int remaining = msecs < 0 ? -1 : qMax<qint64>(0, msecs - timer.elapsed());
+        bool readable;
+        bool writable;
+        if (!poll(remaining, &readable, &writable)) {
+            return false;
+        }
+        if (readable) {
+            readFromFd();
+        }
+        if (writable) {
+            const qint64 before = m_pendingWritten;
+            if (!flushWriteBuffer()) {
+                return false;
+            }
+            if (before == 0 && m_pendingWritten > 0) {
+                queueBytesWritten();
+            }
+        }
+        if (!isOpen() || remaining == 0) {
+            break;
+        }
+    }
+    return m_writeBuffer.isEmpty();
+}
+
+void NativeSerialPort::fail(const QString &what)
+{
+    setErrorString(QString("%1: %2").arg(what, errno ? QString(strerror(errno)) : QString("device lost")));
+    qDebug() << "NativeSerialPort:" << m_portName << errorString();
+    // Closing emits aboutToClose, which SerialCommunication treats as a lost link
+    close();
+}
@@ -0,0 +1,74 @@
+#ifndef NATIVESERIALPORT_H
+#define NATIVESERIALPORT_H
+
+#include <QIODevice>
+#include <QSerialPort>
+
+class QSocketNotifier;
+
+// Linux tty backend that skips QSerialPort: the port is configured with
+// termios, readiness comes from an epoll set watched by one QSocketNotifier,
+// and reads and writes go straight between the fd and our own buffers.
+// ASYNC_LOW_LATENCY is requested where the driver supports it.
+class NativeSerialPort : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    explicit NativeSerialPort(QObject *parent = nullptr);
+    ~NativeSerialPort();
+
+    void setPortName(const QString &portName) { m_portName = portName; }
+    QString portName() const { return m_portName; }
+    void setBaudRate(qint32 baudRate) { m_baudRate = baudRate; }
+    void setDataBits(QSerialPort::DataBits dataBits) { m_dataBits = dataBits; }
+    void setParity(QSerialPort::Parity parity) { m_parity = parity; }
+    void setStopBits(QSerialPort::StopBits stopBits) { m_stopBits = stopBits; }
+    void setFlowControl(QSerialPort::FlowControl flowControl) { m_flowControl = flowControl; }
+    bool isLowLatency() const { return m_lowLatency; }
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override;
+    qint64 bytesToWrite() const override;
+    bool waitForReadyRead(int msecs) override;
+    bool waitForBytesWritten(int msecs) override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private slots:
+    void handleActivated();
+
+private:
+    QString m_portName;
+    qint32 m_baudRate;
+    QSerialPort::DataBits m_dataBits;
+    QSerialPort::Parity m_parity;
+    QSerialPort::StopBits m_stopBits;
+    QSerialPort::FlowControl m_flowControl;
+
+    int m_fd;
+    int m_epollFd;
+    QSocketNotifier *m_notifier;
+    bool m_lowLatency;
+    bool m_wantWrite;
+    qint64 m_pendingWritten;      // Written to the driver, not yet reported
+    QByteArray m_readBuffer;
+    QByteArray m_writeBuffer;     // Tail the driver could not take yet
+
+    static const int READ_CHUNK_BYTES = 4096;
+
+    bool configure();
+    bool poll(int msecs, bool *readable, bool *writable);
+    bool readFromFd();
+    bool flushWriteBuffer();
+    void updateWriteInterest(bool wantWrite);
+    void queueBytesWritten();
+    void reportBytesWritten();
+    void fail(const QString &what);
+};
+
+#endif // NATIVESERIALPORT_H
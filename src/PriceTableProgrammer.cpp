@@ -0,0 +1,209 @@
+#include "PriceTableProgrammer.h"
+#include "VmcProfile.h"
+#include <QDebug>
+#include <QFile>
+#include <QRegularExpression>
+#include <QSettings>
+#include <QTextStream>
+
+PriceTableProgrammer::PriceTableProgrammer(SerialCommunication *serialComm, QObject *parent)
+    : QObject(parent)
+    , m_serialComm(serialComm)
+    , m_total(0)
+    , m_programmed(0)
+    , m_failed(0)
+    , m_unchanged(0)
+{
+    connect(m_serialComm, &SerialCommunication::frameDelivered, this, &PriceTableProgrammer::handleDelivered);
+    connect(m_serialComm, &SerialCommunication::frameFailed, this, &PriceTableProgrammer::handleFailed);
+}
+
+bool PriceTableProgrammer::loadTable(const QString &fileName, QMap<int, int> *table, QString *errorMessage)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        *errorMessage = QString("Cannot open %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+
+    // One "selection,price" pair per line; '#' starts a comment
+    static const QRegularExpression separator("[,;=\\s]+");
+    QTextStream in(&file);
+    QMap<int, int> result;
+    int lineNumber = 0;
+    const std::shared_ptr<const VmcProfile> profile = VmcProfile::current();
+
+    while (!in.atEnd()) {
+        QString line = in.readLine();
+        lineNumber++;
+
+        int comment = line.indexOf('#');
+        if (comment >= 0) {
+            line.truncate(comment);
+        }
+        line = line.trimmed();
+        if (line.isEmpty()) {
+            continue;
+        }
+
+        QStringList fields = line.split(separator, Qt::SkipEmptyParts);
+        bool selectionOk = false;
+        bool priceOk = false;
+        int selection = fields.size() == 2 ? fields.at(0).toInt(&selectionOk) : 0;
+        int price = fields.size() == 2 ? fields.at(1).toInt(&priceOk) : 0;
+
+        if (!selectionOk || !priceOk) {
+            *errorMessage = QString("Line %1: expected \"selection,price\"").arg(lineNumber);
+            return false;
+        }
+        if (selection < 1 || selection > profile->maxSelection()) {
+            *errorMessage = QString("Line %1: selection %2 out of range 1-%3")
+                            .arg(lineNumber).arg(selection).arg(profile->maxSelection());
+            return false;
+        }
+        if (price < 0 || price > profile->maxPrice()) {
+            *errorMessage = QString("Line %1: price %2 out of range 0-%3")
+                            .arg(lineNumber).arg(price).arg(profile->maxPrice());
+            return false;
+        }
+        if (result.contains(selection)) {
+            *errorMessage = QString("Line %1: selection %2 listed twice").arg(lineNumber).arg(selection);
+            return false;
+        }
+
+        result.insert(selection, price);
+    }
+
+    *table = result;
+    return true;
+}
+
+QMap<int, int> PriceTableProgrammer::cachedTable(const QString &vmcId) const
+{
+    QMap<int, int> table;
+    QSettings settings("YourCompany", "asdKeypad");
+    settings.beginGroup(QString("PriceTables/%1").arg(vmcId));
+    for (const QString &key : settings.childKeys()) {
+        table.insert(key.toInt(), settings.value(key).toInt());
+    }
+    settings.endGroup();
+    return table;
+}
+
+void PriceTableProgrammer::clearCachedTable(const QString &vmcId)
+{
+    QSettings settings("YourCompany", "asdKeypad");
+    settings.remove(QString("PriceTables/%1").arg(vmcId));
+}
+
+QString PriceTableProgrammer::currentVmcId() const
+{
+    // Different models behind the same adapter keep separate tables
+    return QString("%1/%2").arg(VmcProfile::current()->name(), m_serialComm->deviceIdentity());
+}
+
+bool PriceTableProgrammer::program(const QMap<int, int> &table)
+{
+    if (isRunning()) {
+        qDebug() << "Price table upload already in progress";
+        return false;
+    }
+    if (!m_serialComm->isPortOpen()) {
+        qDebug() << "Cannot program price table - port not open";
+        return false;
+    }
+
+    m_vmcId = currentVmcId();
+    m_cache = cachedTable(m_vmcId);
+    m_programmed = 0;
+    m_failed = 0;
+    m_unchanged = 0;
+    m_timer.start();
+
+    // One profile for the whole upload, even if it is reloaded meanwhile
+    const std::shared_ptr<const VmcProfile> profile = VmcProfile::current();
+    const int window = profile->priceWindow();
+    QList<QByteArray> frames;
+    for (auto it = table.constBegin(); it != table.constEnd(); ++it) {
+        if (m_cache.value(it.key(), -1) == it.value()) {
+            m_unchanged++;
+            continue;
+        }
+        QByteArray frame = profile->encodePrice(it.key(), it.value());
+        m_pending.insert(frame, it.key());
+        frames.append(frame);
+    }
+
+    m_total = frames.size();
+    qDebug() << "Programming" << m_total << "of" << table.size()
+             << "prices on" << m_vmcId << "with window" << window;
+
+    if (frames.isEmpty()) {
+        emit finished(0, 0, m_unchanged, 0);
+        return true;
+    }
+
+    // Pipeline the upload: keep up to `window` of our frames awaiting acks.
+    // The link's own window, used by every other sender, is left alone.
+    for (const QByteArray &frame : frames) {
+        if (!m_serialComm->sendReliable(frame, TxPriority::Automation, window)) {
+            handleFailed(frame);
+        }
+    }
+    return true;
+}
+
+void PriceTableProgrammer::handleDelivered(const QByteArray &frame)
+{
+    if (!m_pending.contains(frame)) {
+        return;
+    }
+
+    int selection = m_pending.take(frame);
+    int ackedSelection = 0;
+    int ackedPrice = 0;
+    if (VmcProfile::current()->decodePrice(frame, &ackedSelection, &ackedPrice)) {
+        m_cache.insert(selection, ackedPrice);
+    }
+    m_programmed++;
+
+    emit progress(m_programmed + m_failed, m_total);
+    finishIfDone();
+}
+
+void PriceTableProgrammer::handleFailed(const QByteArray &frame)
+{
+    if (!m_pending.contains(frame)) {
+        return;
+    }
+
+    // The VMC may or may not have applied it; force a resend next time
+    int selection = m_pending.take(frame);
+    m_cache.remove(selection);
+    m_failed++;
+
+    emit progress(m_programmed + m_failed, m_total);
+    finishIfDone();
+}
+
+void PriceTableProgrammer::saveCache() const
+{
+    QSettings settings("YourCompany", "asdKeypad");
+    QString group = QString("PriceTables/%1").arg(m_vmcId);
+    settings.remove(group);
+    settings.beginGroup(group);
+    for (auto it = m_cache.constBegin(); it != m_cache.constEnd(); ++it) {
+        settings.setValue(QString::number(it.key()), it.value());
+    }
+    settings.endGroup();
+}
+
+void PriceTableProgrammer::finishIfDone()
+{
+    if (!m_pending.isEmpty()) {
+        return;
+    }
+
+    saveCache();
+    emit finished(m_programmed, m_failed, m_unchanged, m_timer.elapsed());
+}
@@ -0,0 +1,52 @@
+#ifndef PRICETABLEPROGRAMMER_H
+#define PRICETABLEPROGRAMMER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMap>
+#include "SerialCommunication.h"
+
+// Uploads a full selection -> price table, sending only entries that differ
+// from the last table acknowledged by the same VMC. The VMC is identified by
+// its profile and the adapter it is cabled to, not by the port name.
+class PriceTableProgrammer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PriceTableProgrammer(SerialCommunication *serialComm, QObject *parent = nullptr);
+
+    static bool loadTable(const QString &fileName, QMap<int, int> *table, QString *errorMessage);
+
+    QMap<int, int> cachedTable(const QString &vmcId) const;
+    void clearCachedTable(const QString &vmcId);
+
+    QString currentVmcId() const;
+    bool program(const QMap<int, int> &table);
+    bool isRunning() const { return !m_pending.isEmpty(); }
+
+signals:
+    void progress(int done, int total);
+    void finished(int programmed, int failed, int unchanged, qint64 elapsedMs);
+
+private slots:
+    void handleDelivered(const QByteArray &frame);
+    void handleFailed(const QByteArray &frame);
+
+private:
+    SerialCommunication *m_serialComm;
+    QString m_vmcId;
+    QMap<int, int> m_cache;
+    QHash<QByteArray, int> m_pending;  // Frame -> selection awaiting ack
+    QElapsedTimer m_timer;
+    int m_total;
+    int m_programmed;
+    int m_failed;
+    int m_unchanged;
+
+    void saveCache() const;
+    void finishIfDone();
+};
+
+#endif // PRICETABLEPROGRAMMER_H
@@ -0,0 +1,274 @@
+#include "ReliableLink.h"
+#include "MemoryBudget.h"
+#include <QDebug>
+#include <QtMath>
+
+RttEstimator::RttEstimator()
+    : m_hasSample(false)
+    , m_srtt(0.0)
+    , m_rttVar(0.0)
+    , m_backoff(1)
+{
+}
+
+void RttEstimator::addSample(qint64 rttMs)
+{
+    double sample = static_cast<double>(rttMs);
+    if (!m_hasSample) {
+        m_srtt = sample;
+        m_rttVar = sample / 2.0;
+        m_hasSample = true;
+    } else {
+        m_rttVar = 0.75 * m_rttVar + 0.25 * qAbs(m_srtt - sample);
+        m_srtt = 0.875 * m_srtt + 0.125 * sample;
+    }
+    m_backoff = 1;
+}
+
+void RttEstimator::backoff()
+{
+    m_backoff = qMin(m_backoff * 2, 64);
+}
+
+qint64 RttEstimator::rto() const
+{
+    double base = m_hasSample
+        ? m_srtt + qMax(1.0, 4.0 * m_rttVar)
+        : static_cast<double>(INITIAL_RTO_MS);
+    qint64 rto = qRound64(base * m_backoff);
+    return qBound<qint64>(MIN_RTO_MS, rto, MAX_RTO_MS);
+}
+
+ReliableLink::ReliableLink(QObject *parent)
+    : QObject(parent)
+    , m_windowSize(1)
+    , m_maxRetries(DEFAULT_MAX_RETRIES)
+    , m_retransmissions(0)
+    , m_duplicateAcks(0)
+{
+    m_retransmitTimer.setSingleShot(true);
+    connect(&m_retransmitTimer, &ClockTimer::timeout, this, &ReliableLink::checkTimeouts);
+}
+
+ReliableLink::~ReliableLink()
+{
+    for (const Pending &entry : m_waiting) {
+        MemoryBudget::release(MemoryBudget::AutomationState, footprint(entry));
+    }
+}
+
+qint64 ReliableLink::footprint(const Pending &entry)
+{
+    return static_cast<qint64>(sizeof(Pending)) + entry.frame.size();
+}
+
+bool ReliableLink::submit(const QByteArray &frame, TxPriority priority, int window)
+{
+    // A late echo of an earlier identical frame can no longer be told apart
+    // from this one's; handleFrame() gives it to this frame
+    for (int i = 0; i < m_shadows.size(); ) {
+        if (m_shadows.at(i).frame == frame) {
+            m_shadows.removeAt(i);
+        } else {
+            ++i;
+        }
+    }
+
+    if (m_waiting.isEmpty() && m_outstanding.size() < windowFor(window)) {
+        Outstanding entry{frame, priority, 0, false, 0};
+        m_outstanding.append(entry);
+        transmitOutstanding(m_outstanding.last());
+    } else {
+        // The window is full; frames queued behind it count against the automation budget
+        Pending pending{frame, priority, window};
+        if (!MemoryBudget::tryCharge(MemoryBudget::AutomationState, footprint(pending))) {
+            MemoryBudget::recordEviction(MemoryBudget::AutomationState, footprint(pending));
+            qDebug() << "Frame" << frame.toHex() << "refused:" << m_waiting.size()
+                     << "frames already wait for an ack slot";
+            return false;
+        }
+        m_waiting.enqueue(pending);
+    }
+    return true;
+}
+
+void ReliableLink::handleDispatched(const QByteArray &frame)
+{
+    // Time the RTT from the actual write, not from when the frame was queued
+    for (Outstanding &entry : m_outstanding) {
+        if (!entry.dispatched && entry.frame == frame) {
+            entry.dispatched = true;
+            entry.sentAtMs = VirtualClock::monotonicMs();
+            armTimer();
+            return;
+        }
+    }
+}
+
+void ReliableLink::handleFrame(const VmcFrame &frame)
+{
+    if (frame.isKeepaliveResponse) {
+        return;
+    }
+
+    // Frames in flight come first: a shadow outlives a retransmission whose
+    // first copy was really lost, and must not eat the next identical frame's echo
+    for (int i = 0; i < m_outstanding.size(); ++i) {
+        if (!frame.acknowledges(m_outstanding.at(i).frame)) {
+            continue;
+        }
+
+        Outstanding entry = m_outstanding.takeAt(i);
+        qint64 now = VirtualClock::monotonicMs();
+        qint64 rtt = now - entry.sentAtMs;
+
+        // Karn's rule: a retransmitted frame's ack is ambiguous, so no sample
+        if (entry.retries == 0) {
+            m_estimator.addSample(rtt);
+        } else {
+            AckShadow shadow{entry.frame, entry.retries, now + m_estimator.rto()};
+            m_shadows.append(shadow);
+        }
+
+        emit delivered(entry.frame, rtt, entry.retries);
+        fillWindow();
+        armTimer();
+        return;
+    }
+
+    // Nothing in flight matches: a stale echo of a retransmitted frame
+    consumeShadow(frame);
+}
+
+void ReliableLink::reset()
+{
+    m_retransmitTimer.stop();
+
+    QList<Outstanding> outstanding = m_outstanding;
+    QQueue<Pending> waiting = m_waiting;
+    m_outstanding.clear();
+    m_waiting.clear();
+    m_shadows.clear();
+
+    for (const Outstanding &entry : outstanding) {
+        emit failed(entry.frame, entry.retries + 1);
+    }
+    for (const Pending &entry : waiting) {
+        MemoryBudget::release(MemoryBudget::AutomationState, footprint(entry));
+        emit failed(entry.frame, 0);
+    }
+}
+
+void ReliableLink::setWindowSize(int frames)
+{
+    m_windowSize = qMax(1, frames);
+    fillWindow();
+}
+
+void ReliableLink::checkTimeouts()
+{
+    qint64 now = VirtualClock::monotonicMs();
+    qint64 rto = m_estimator.rto();
+
+    QList<Outstanding> expired;
+    QList<Outstanding> resend;
+
+    for (int i = 0; i < m_outstanding.size(); ) {
+        Outstanding &entry = m_outstanding[i];
+        if (now - entry.sentAtMs < rto) {
+            ++i;
+            continue;
+        }
+
+        if (entry.retries >= m_maxRetries) {
+            expired.append(m_outstanding.takeAt(i));
+            continue;
+        }
+
+        entry.retries++;
+        entry.sentAtMs = now;
+        entry.dispatched = false;
+        resend.append(entry);
+        ++i;
+    }
+
+    if (!expired.isEmpty() || !resend.isEmpty()) {
+        m_estimator.backoff();
+    }
+
+    for (const Outstanding &entry : resend) {
+        m_retransmissions++;
+        qDebug() << "Retransmitting frame" << entry.frame.toHex()
+                 << "attempt" << entry.retries + 1;
+        emit transmit(entry.frame, entry.priority);
+    }
+
+    for (const Outstanding &entry : expired) {
+        qDebug() << "No ack for frame" << entry.frame.toHex()
+                 << "after" << entry.retries + 1 << "attempts";
+        emit failed(entry.frame, entry.retries + 1);
+    }
+
+    fillWindow();
+    armTimer();
+}
+
+void ReliableLink::transmitOutstanding(Outstanding &entry)
+{
+    entry.sentAtMs = VirtualClock::monotonicMs();
+    entry.dispatched = false;
+
+    // Copy before emitting; the receiver may re-enter and touch m_outstanding
+    QByteArray frame = entry.frame;
+    TxPriority priority = entry.priority;
+    emit transmit(frame, priority);
+    armTimer();
+}
+
+void ReliableLink::fillWindow()
+{
+    // In order: a frame with a wider window never overtakes one waiting ahead of it
+    while (!m_waiting.isEmpty() && m_outstanding.size() < windowFor(m_waiting.head().window)) {
+        Pending next = m_waiting.dequeue();
+        MemoryBudget::release(MemoryBudget::AutomationState, footprint(next));
+        Outstanding entry{next.frame, next.priority, 0, false, 0};
+        m_outstanding.append(entry);
+        transmitOutstanding(m_outstanding.last());
+    }
+}
+
+void ReliableLink::armTimer()
+{
+    if (m_outstanding.isEmpty()) {
+        m_retransmitTimer.stop();
+        return;
+    }
+
+    qint64 earliest = m_outstanding.first().sentAtMs;
+    for (const Outstanding &entry : m_outstanding) {
+        earliest = qMin(earliest, entry.sentAtMs);
+    }
+
+    qint64 remaining = earliest + m_estimator.rto() - VirtualClock::monotonicMs();
+    m_retransmitTimer.start(static_cast<int>(qMax<qint64>(0, remaining)));
+}
+
+bool ReliableLink::consumeShadow(const VmcFrame &frame)
+{
+    qint64 now = VirtualClock::monotonicMs();
+    for (int i = 0; i < m_shadows.size(); ) {
+        if (m_shadows.at(i).expiresAtMs < now) {
+            m_shadows.removeAt(i);
+            continue;
+        }
+        if (frame.acknowledges(m_shadows.at(i).frame)) {
+            m_duplicateAcks++;
+            if (--m_shadows[i].remaining <= 0) {
+                m_shadows.removeAt(i);
+            }
+            return true;
+        }
+        ++i;
+    }
+    return false;
+}
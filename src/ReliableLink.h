@@ -0,0 +1,116 @@
+#ifndef RELIABLELINK_H
+#define RELIABLELINK_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QList>
+#include <QQueue>
+#include "TxScheduler.h"
+#include "VirtualClock.h"
+#include "VmcProtocol.h"
+
+// Smoothed RTT / RTT-variance estimator in the style of TCP's RTO (RFC 6298)
+class RttEstimator
+{
+public:
+    static const int INITIAL_RTO_MS = 250;
+    static const int MIN_RTO_MS = 20;
+    static const int MAX_RTO_MS = 2000;
+
+    RttEstimator();
+
+    void addSample(qint64 rttMs);
+    void backoff();
+    qint64 rto() const;
+
+    bool hasSample() const { return m_hasSample; }
+    double srttMs() const { return m_srtt; }
+    double rttVarMs() const { return m_rttVar; }
+
+private:
+    bool m_hasSample;
+    double m_srtt;
+    double m_rttVar;
+    int m_backoff;
+};
+
+// Ack-based delivery: each frame is held until the VMC echoes it, and is
+// retransmitted on RTO expiry up to a capped number of retries.
+class ReliableLink : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int DEFAULT_MAX_RETRIES = 3;
+
+    explicit ReliableLink(QObject *parent = nullptr);
+    ~ReliableLink();
+
+    // window > 0 lets this frame go out while fewer than window frames are
+    // unacked, without changing the window other frames are held to
+    bool submit(const QByteArray &frame, TxPriority priority, int window = 0);
+    void handleDispatched(const QByteArray &frame);
+    void handleFrame(const VmcFrame &frame);
+    void reset();
+
+    void setWindowSize(int frames);
+    int windowSize() const { return m_windowSize; }
+    void setMaxRetries(int retries) { m_maxRetries = retries; }
+    int maxRetries() const { return m_maxRetries; }
+    int pendingCount() const { return m_outstanding.size() + m_waiting.size(); }
+
+    void setEstimator(const RttEstimator &estimator) { m_estimator = estimator; }
+    const RttEstimator &estimator() const { return m_estimator; }
+
+    quint64 retransmissions() const { return m_retransmissions; }
+    quint64 duplicateAcks() const { return m_duplicateAcks; }
+
+signals:
+    void transmit(const QByteArray &frame, TxPriority priority);
+    void delivered(const QByteArray &frame, qint64 rttMs, int retries);
+    void failed(const QByteArray &frame, int attempts);
+
+private slots:
+    void checkTimeouts();
+
+private:
+    struct Outstanding {
+        QByteArray frame;
+        TxPriority priority;
+        qint64 sentAtMs;
+        bool dispatched;
+        int retries;
+    };
+
+    struct Pending {
+        QByteArray frame;
+        TxPriority priority;
+        int window;
+    };
+
+    // Echoes still expected for a frame that was acked after retransmission
+    struct AckShadow {
+        QByteArray frame;
+        int remaining;
+        qint64 expiresAtMs;
+    };
+
+    QList<Outstanding> m_outstanding;
+    QQueue<Pending> m_waiting;
+    QList<AckShadow> m_shadows;
+    ClockTimer m_retransmitTimer;
+    RttEstimator m_estimator;
+    int m_windowSize;
+    int m_maxRetries;
+    quint64 m_retransmissions;
+    quint64 m_duplicateAcks;
+
+    static qint64 footprint(const Pending &entry);  // Charged to MemoryBudget::AutomationState
+    int windowFor(int window) const { return window > 0 ? window : m_windowSize; }
+    void transmitOutstanding(Outstanding &entry);
+    void fillWindow();
+    void armTimer();
+    bool consumeShadow(const VmcFrame &frame);
+};
+
+#endif // RELIABLELINK_H
@@ -0,0 +1,281 @@
+#include "RemoteSerialPort.h"
+#include "MemoryBudget.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QTcpSocket>
+#include <QUrl>
+#include <cstring>
+
+RemoteSerialPort::RemoteSerialPort(QObject *parent)
+    : QIODevice(parent)
+    , m_baudRate(QSerialPort::Baud9600)
+    , m_dataBits(QSerialPort::Data8)
+    , m_parity(QSerialPort::NoParity)
+    , m_stopBits(QSerialPort::OneStop)
+    , m_flowControl(QSerialPort::NoFlowControl)
+    , m_confirmedBaudRate(0)
+    , m_socket(nullptr)
+    , m_receivedTotal(0)
+    , m_wireWritten(0)
+{
+    m_connectTimer.setSingleShot(true);
+    m_connectTimer.setInterval(CONNECT_TIMEOUT_MS);
+    connect(&m_connectTimer, &QTimer::timeout, this, [this]() {
+        fail(QString("no connection after %1 ms").arg(CONNECT_TIMEOUT_MS));
+    });
+}
+
+RemoteSerialPort::~RemoteSerialPort()
+{
+    close();
+}
+
+bool RemoteSerialPort::isRemotePortName(const QString &portName)
+{
+    return portName.startsWith("tcp://", Qt::CaseInsensitive);
+}
+
+bool RemoteSerialPort::parsePortName(const QString &portName, QString *host, quint16 *port)
+{
+    const QUrl url(portName.split(" ").first());
+    if (url.scheme().compare("tcp", Qt::CaseInsensitive) != 0 || url.host().isEmpty() || url.port() <= 0) {
+        return false;
+    }
+    *host = url.host();
+    *port = static_cast<quint16>(url.port());
+    return true;
+}
+
+bool RemoteSerialPort::open(OpenMode mode)
+{
+    if (isOpen()) {
+        return false;
+    }
+
+    QString host;
+    quint16 port = 0;
+    if (!parsePortName(m_portName, &host, &port)) {
+        setErrorString(QString("%1 is not a remote port; expected tcp://host:port").arg(m_portName));
+        return false;
+    }
+
+    // Not waited for: open() runs on the GUI thread, and a bridge that is down
+    // would freeze it for the whole connect timeout
+    m_socket = new QTcpSocket(this);
+    connect(m_socket, &QTcpSocket::connected, this, &RemoteSerialPort::handleSocketConnected);
+    connect(m_socket, &QTcpSocket::errorOccurred, this, &RemoteSerialPort::handleSocketError);
+    connect(m_socket, &QTcpSocket::readyRead, this, &RemoteSerialPort::handleSocketReadyRead);
+    connect(m_socket, &QTcpSocket::bytesWritten, this, &RemoteSerialPort::handleSocketBytesWritten);
+    connect(m_socket, &QTcpSocket::disconnected, this, &RemoteSerialPort::handleSocketDisconnected);
+
+    m_decoder.reset();
+    MemoryBudget::clear(MemoryBudget::SerialBuffers, &m_readBuffer);
+    releasePendingWrites();
+    m_wireWritten = 0;
+    m_confirmedBaudRate = 0;
+    m_socket->connectToHost(host, port);
+    if (m_socket->state() == QAbstractSocket::UnconnectedState) {
+        setErrorString(m_socket->errorString());
+        delete m_socket;
+        m_socket = nullptr;
+        return false;
+    }
+    QIODevice::open(mode | QIODevice::Unbuffered);
+    m_connectTimer.start();
+
+    // Line settings ride ahead of any payload; they are not counted as written.
+    // The socket holds them until it connects.
+    const QByteArray setup = Rfc2217::negotiation(Rfc2217::WILL, Rfc2217::BINARY_OPTION)
+                           + Rfc2217::negotiation(Rfc2217::DO, Rfc2217::BINARY_OPTION)
+                           + Rfc2217::negotiation(Rfc2217::DO, Rfc2217::COM_PORT_OPTION)
+                           + Rfc2217::comPortCommand(Rfc2217::SET_BAUDRATE, Rfc2217::encodeBaudRate(m_baudRate))
+                           + Rfc2217::comPortCommand(Rfc2217::SET_DATASIZE, QByteArray(1, static_cast<char>(m_dataBits)))
+                           + Rfc2217::comPortCommand(Rfc2217::SET_PARITY,
+                                                     QByteArray(1, static_cast<char>(Rfc2217::encodeParity(m_parity))))
+                           + Rfc2217::comPortCommand(Rfc2217::SET_STOPSIZE,
+                                                     QByteArray(1, static_cast<char>(Rfc2217::encodeStopBits(m_stopBits))))
+                           + Rfc2217::comPortCommand(Rfc2217::SET_CONTROL,
+                                                     QByteArray(1, static_cast<char>(Rfc2217::encodeFlowControl(m_flowControl))))
+                           + Rfc2217::comPortCommand(Rfc2217::PURGE_DATA, QByteArray(1, 3));
+    m_socket->write(setup);
+    m_pendingWrites.enqueue({setup.size(), 0});
+    return true;
+}
+
+void RemoteSerialPort::close()
+{
+    if (!isOpen()) {
+        return;
+    }
+    QIODevice::close();
+    m_connectTimer.stop();
+    if (m_socket) {
+        m_socket->disconnect(this);
+        m_socket->abort();
+        // May be inside one of the socket's own signals
+        m_socket->deleteLater();
+        m_socket = nullptr;
+    }
+    MemoryBudget::clear(MemoryBudget::SerialBuffers, &m_readBuffer);
+    releasePendingWrites();
+}
+
+void RemoteSerialPort::releasePendingWrites()
+{
+    // Payload writes are charged until the socket has sent them; the setup is not
+    for (const PendingWrite &write : m_pendingWrites) {
+        if (write.payloadBytes > 0) {
+            MemoryBudget::release(MemoryBudget::SerialBuffers, write.wireBytes);
+        }
+    }
+    m_pendingWrites.clear();
+}
+
+qint64 RemoteSerialPort::bytesAvailable() const
+{
+    return m_readBuffer.size() + QIODevice::bytesAvailable();
+}
+
+qint64 RemoteSerialPort::bytesToWrite() const
+{
+    return m_socket ? m_socket->bytesToWrite() : 0;
+}
+
+bool RemoteSerialPort::waitForReadyRead(int msecs)
+{
+    if (!m_socket) {
+        return false;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    const quint64 before = m_receivedTotal;
+    while (m_receivedTotal == before) {
+        const int remaining = msecs < 0 ? -1 : msecs - static_cast<int>(timer.elapsed());
+        if ((msecs >= 0 && remaining <= 0) || !m_socket || !m_socket->waitForReadyRead(remaining)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool RemoteSerialPort::waitForBytesWritten(int msecs)
+{
+    return m_socket && m_socket->waitForBytesWritten(msecs);
+}
+
+qint64 RemoteSerialPort::readData(char *data, qint64 maxSize)
+{
+    const qint64 count = qMin<qint64>(maxSize, m_readBuffer.size());
+    std::memcpy(data, m_readBuffer.constData(), static_cast<size_t>(count));
+    MemoryBudget::removeFront(MemoryBudget::SerialBuffers, &m_readBuffer, static_cast<int>(count));
+    return count;
+}
+
+qint64 RemoteSerialPort::writeData(const char *data, qint64 maxSize)
+{
+    if (!m_socket) {
+        return -1;
+    }
+    const QByteArray escaped = Rfc2217::escape(QByteArray(data, static_cast<int>(maxSize)));
+    // The socket buffers whatever the bridge has not taken; over the serial budget nothing is accepted
+    if (!MemoryBudget::tryCharge(MemoryBudget::SerialBuffers, escaped.size())) {
+        return 0;
+    }
+    if (m_socket->write(escaped) != escaped.size()) {
+        MemoryBudget::release(MemoryBudget::SerialBuffers, escaped.size());
+        setErrorString(m_socket->errorString());
+        return -1;
+    }
+    m_pendingWrites.enqueue({escaped.size(), maxSize});
+    return maxSize;
+}
+
+void RemoteSerialPort::handleSocketConnected()
+{
+    m_connectTimer.stop();
+    // Frames are a few bytes; Nagle would hold each one back for an ack
+    m_socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    qDebug() << "Remote port" << m_portName << "connected";
+}
+
+void RemoteSerialPort::handleSocketError()
+{
+    // Once connected, a lost connection is reported through disconnected
+    if (m_socket && m_socket->state() != QAbstractSocket::ConnectedState && m_connectTimer.isActive()) {
+        fail(QString("cannot connect: %1").arg(m_socket->errorString()));
+    }
+}
+
+void RemoteSerialPort::handleSocketReadyRead()
+{
+    if (processSocketData()) {
+        emit readyRead();
+    }
+}
+
+// Unescapes payload into the read buffer and consumes the server's replies.
+// Returns true if there is new payload.
+bool RemoteSerialPort::processSocketData()
+{
+    QByteArray data;
+    QList<Rfc2217::Subnegotiation> replies;
+    QList<QPair<quint8, quint8>> negotiations;
+    m_decoder.feed(m_socket->readAll(), &data, &replies, &negotiations);
+
+    for (const Rfc2217::Subnegotiation &reply : replies) {
+        if (reply.option != Rfc2217::COM_PORT_OPTION) {
+            continue;
+        }
+        if (reply.command == Rfc2217::SET_BAUDRATE + Rfc2217::SERVER_OFFSET) {
+            m_confirmedBaudRate = Rfc2217::decodeBaudRate(reply.value);
+            if (m_confirmedBaudRate != m_baudRate) {
+                qDebug() << "Remote port" << m_portName << "runs at" << m_confirmedBaudRate
+                         << "baud, not" << m_baudRate;
+            }
+        }
+    }
+    for (const QPair<quint8, quint8> &negotiation : negotiations) {
+        if (negotiation.first == Rfc2217::WONT && negotiation.second == Rfc2217::COM_PORT_OPTION) {
+            qDebug() << "Remote port" << m_portName << "does not accept line settings";
+        }
+    }
+
+    if (data.isEmpty()) {
+        return false;
+    }
+    // Unread bytes over the serial budget push out the oldest ones
+    MemoryBudget::appendEvictingOldest(MemoryBudget::SerialBuffers, &m_readBuffer, data);
+    m_receivedTotal += data.size();
+    return true;
+}
+
+void RemoteSerialPort::handleSocketBytesWritten(qint64 bytes)
+{
+    // Report payload bytes, not the escaped wire bytes, once a write is fully out
+    qint64 payload = 0;
+    m_wireWritten += bytes;
+    while (!m_pendingWrites.isEmpty() && m_wireWritten >= m_pendingWrites.head().wireBytes) {
+        const PendingWrite write = m_pendingWrites.dequeue();
+        m_wireWritten -= write.wireBytes;
+        payload += write.payloadBytes;
+        if (write.payloadBytes > 0) {
+            MemoryBudget::release(MemoryBudget::SerialBuffers, write.wireBytes);
+        }
+    }
+    if (payload > 0) {
+        emit bytesWritten(payload);
+    }
+}
+
+void RemoteSerialPort::handleSocketDisconnected()
+{
+    fail("bridge closed the connection");
+}
+
+void RemoteSerialPort::fail(const QString &what)
+{
+    setErrorString(QString("%1: %2").arg(m_portName, what));
+    qDebug() << "Remote port:" << errorString();
+    // SerialCommunication treats aboutToClose as a lost link
+    close();
+}
@@ -0,0 +1,89 @@
+#ifndef REMOTESERIALPORT_H
+#define REMOTESERIALPORT_H
+
+#include <QIODevice>
+#include <QQueue>
+#include <QSerialPort>
+#include <QTimer>
+#include "SerialBridge.h"
+
+class QTcpSocket;
+
+// Client side of SerialBridgeServer: a serial port on another machine,
+// named tcp://host:port. Line settings are sent with RFC 2217 when the
+// port opens; payload bytes are IAC-escaped on the way out and unescaped
+// on the way in, so SerialCommunication sees the same bytes as locally.
+// open() does not wait for the connection: writes made meanwhile are held by
+// the socket until it connects, and a connection that fails or takes longer
+// than CONNECT_TIMEOUT_MS closes the port like a lost link.
+class RemoteSerialPort : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    static const int CONNECT_TIMEOUT_MS = 3000;
+
+    explicit RemoteSerialPort(QObject *parent = nullptr);
+    ~RemoteSerialPort();
+
+    static bool isRemotePortName(const QString &portName);
+    static bool parsePortName(const QString &portName, QString *host, quint16 *port);
+
+    void setPortName(const QString &portName) { m_portName = portName; }
+    QString portName() const { return m_portName; }
+    void setBaudRate(qint32 baudRate) { m_baudRate = baudRate; }
+    void setDataBits(QSerialPort::DataBits dataBits) { m_dataBits = dataBits; }
+    void setParity(QSerialPort::Parity parity) { m_parity = parity; }
+    void setStopBits(QSerialPort::StopBits stopBits) { m_stopBits = stopBits; }
+    void setFlowControl(QSerialPort::FlowControl flowControl) { m_flowControl = flowControl; }
+
+    // Settings as last confirmed by the server; 0 until it answers
+    qint32 confirmedBaudRate() const { return m_confirmedBaudRate; }
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override;
+    qint64 bytesToWrite() const override;
+    bool waitForReadyRead(int msecs) override;
+    bool waitForBytesWritten(int msecs) override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private slots:
+    void handleSocketConnected();
+    void handleSocketError();
+    void handleSocketReadyRead();
+    void handleSocketBytesWritten(qint64 bytes);
+    void handleSocketDisconnected();
+
+private:
+    struct PendingWrite {
+        qint64 wireBytes;                      // After IAC escaping
+        qint64 payloadBytes;
+    };
+
+    QString m_portName;
+    qint32 m_baudRate;
+    QSerialPort::DataBits m_dataBits;
+    QSerialPort::Parity m_parity;
+    QSerialPort::StopBits m_stopBits;
+    QSerialPort::FlowControl m_flowControl;
+    qint32 m_confirmedBaudRate;
+
+    QTcpSocket *m_socket;
+    QTimer m_connectTimer;
+    Rfc2217::Decoder m_decoder;
+    QByteArray m_readBuffer;
+    quint64 m_receivedTotal;                   // Payload bytes ever received, for waitForReadyRead
+    QQueue<PendingWrite> m_pendingWrites;
+    qint64 m_wireWritten;                      // Wire bytes of the head write already sent
+
+    bool processSocketData();
+    void releasePendingWrites();
+    void fail(const QString &what);
+};
+
+#endif // REMOTESERIALPORT_H
@@ -0,0 +1,441 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QLoggingCategory>
+#include <QSerialPort>
+#include <QSysInfo>
+#include <QTextStream>
+#include <QTimer>
+#include <QVector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+#include "BenchBaseline.h"
+#include "NativeSerialPort.h"
+#include "RemoteSerialPort.h"
+#include "SerialBridge.h"
+#include "SerialCommunication.h"
+#include "VmcProtocol.h"
+
+// Round-trip benchmark of the QSerialPort and native backends over a pty
+// pair: a thread echoes every byte written to the slave side back from the
+// master, and the client side times write-to-full-echo for one VMC frame.
+// With --bridge the same pty is also reached through SerialBridgeServer and
+// RemoteSerialPort on localhost. Frame encode, decode and the whole
+// SerialCommunication RX path are timed in process first. Every
+// distribution can be saved as a baseline and compared against a later run.
+
+namespace {
+
+const QByteArray FRAME = QByteArray::fromHex("0B0001000C");
+const int BATCH = 64;          // Encodes or decoded frames per encode/decode sample
+
+// Hands bytes to SerialCommunication as if they had just arrived from a port
+class InjectDevice : public QIODevice
+{
+public:
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override { return m_pending.size() + QIODevice::bytesAvailable(); }
+
+    void inject(const QByteArray &bytes)
+    {
+        m_pending.append(bytes);
+        emit readyRead();
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        const qint64 count = qMin<qint64>(maxSize, m_pending.size());
+        std::copy(m_pending.constBegin(), m_pending.constBegin() + count, data);
+        m_pending.remove(0, static_cast<int>(count));
+        return count;
+    }
+    qint64 writeData(const char *, qint64 size) override { return size; }
+
+private:
+    QByteArray m_pending;
+};
+
+struct PtyEcho {
+    int master = -1;
+    int slave = -1;
+    QString slavePath;
+    std::atomic<bool> stop{false};
+    std::thread thread;
+
+    bool start()
+    {
+        char name[128];
+        termios raw;
+        ::cfmakeraw(&raw);
+        if (::openpty(&master, &slave, name, &raw, nullptr) < 0) {
+            return false;
+        }
+        // The backend under test opens the slave by name; this fd keeps the
+        // master from reporting a hangup between runs
+        slavePath = QString::fromLocal8Bit(name);
+
+        thread = std::thread([this]() {
+            char buffer[256];
+            pollfd pfd = {master, POLLIN, 0};
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (::poll(&pfd, 1, 50) <= 0 || !(pfd.revents & POLLIN)) {
+                    continue;
+                }
+                const ssize_t count = ::read(master, buffer, sizeof(buffer));
+                if (count > 0 && ::write(master, buffer, count) != count) {
+                    break;
+                }
+            }
+        });
+        return true;
+    }
+
+    ~PtyEcho()
+    {
+        stop = true;
+        if (thread.joinable()) {
+            thread.join();
+        }
+        if (slave >= 0) {
+            ::close(slave);
+        }
+        if (master >= 0) {
+            ::close(master);
+        }
+    }
+};
+
+struct Result {
+    QVector<qint64> rttNs;
+    qint64 totalNs = 0;
+    int timeouts = 0;
+};
+
+bool roundTrip(QIODevice *port, QElapsedTimer &clock, qint64 *rttNs)
+{
+    QByteArray echoed;
+    QEventLoop loop;
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    QObject::connect(&timeout, &QTimer::timeout, &loop, &QEventLoop::quit);
+    QObject::connect(port, &QIODevice::readyRead, &loop, [&]() {
+        echoed += port->readAll();
+        if (echoed.size() >= FRAME.size()) {
+            loop.quit();
+        }
+    });
+
+    const qint64 start = clock.nsecsElapsed();
+    port->write(FRAME);
+    timeout.start(1000);
+    loop.exec();
+    *rttNs = clock.nsecsElapsed() - start;
+    return echoed.size() >= FRAME.size();
+}
+
+Result run(QIODevice *port, int warmup, int iterations)
+{
+    Result result;
+    result.rttNs.reserve(iterations);
+    QElapsedTimer clock;
+    clock.start();
+
+    qint64 rtt;
+    for (int i = 0; i < warmup; ++i) {
+        roundTrip(port, clock, &rtt);
+    }
+    const qint64 start = clock.nsecsElapsed();
+    for (int i = 0; i < iterations; ++i) {
+        if (roundTrip(port, clock, &rtt)) {
+            result.rttNs.append(rtt);
+        } else {
+            result.timeouts++;
+        }
+    }
+    result.totalNs = clock.nsecsElapsed() - start;
+    return result;
+}
+
+// Nanoseconds per encoded frame, one sample per batch
+QVector<double> encodeSamples(int samples)
+{
+    QVector<double> result;
+    result.reserve(samples);
+    QElapsedTimer clock;
+    clock.start();
+    // Every frame's checksum is stored, so no encode can be optimized away
+    volatile char sink = 0;
+    for (int i = 0; i < samples; ++i) {
+        const qint64 start = clock.nsecsElapsed();
+        for (int j = 0; j < BATCH; ++j) {
+            sink = VmcProtocol::encodeFrame(0x00, static_cast<quint8>(j), 0x0C).at(4);
+        }
+        result.append(static_cast<double>(clock.nsecsElapsed() - start) / BATCH);
+    }
+    return result;
+}
+
+// Nanoseconds per decoded frame, one sample per batch fed in one chunk
+QVector<double> decodeSamples(int samples)
+{
+    QVector<double> result;
+    result.reserve(samples);
+    const QByteArray chunk = FRAME.repeated(BATCH);
+    VmcFrameDecoder decoder;
+    QElapsedTimer clock;
+    clock.start();
+    int decoded = 0;
+    for (int i = 0; i < samples; ++i) {
+        const qint64 start = clock.nsecsElapsed();
+        decoded += static_cast<int>(decoder.feed(chunk).size());
+        result.append(static_cast<double>(clock.nsecsElapsed() - start) / BATCH);
+    }
+    if (decoded != samples * BATCH) {
+        result.clear();
+    }
+    return result;
+}
+
+// Nanoseconds from readyRead to frameReceived for one frame, through
+// SerialCommunication's decoder, metrics, reliable link and logging
+QVector<double> rxPathSamples(int samples)
+{
+    QVector<double> result;
+    result.reserve(samples);
+    InjectDevice device;
+    device.open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+    SerialCommunication serial;
+    if (!serial.openDevice(&device, "bench")) {
+        return result;
+    }
+    int received = 0;
+    QObject::connect(&serial, &SerialCommunication::frameReceived, [&]() { received++; });
+
+    QElapsedTimer clock;
+    clock.start();
+    for (int i = 0; i < samples; ++i) {
+        const qint64 start = clock.nsecsElapsed();
+        device.inject(FRAME);
+        result.append(static_cast<double>(clock.nsecsElapsed() - start));
+    }
+    serial.disconnect();
+    serial.closePort();
+    if (received != samples) {
+        result.clear();
+    }
+    return result;
+}
+
+QVector<double> toDistribution(const QVector<qint64> &values)
+{
+    QVector<double> result;
+    result.reserve(values.size());
+    for (qint64 value : values) {
+        result.append(static_cast<double>(value));
+    }
+    return result;
+}
+
+void reportMicro(QTextStream &out, const QString &name, QVector<double> samples)
+{
+    if (samples.isEmpty()) {
+        out << name << ": no samples\n";
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double fraction) {
+        return samples.at(qMin(static_cast<int>(samples.size()) - 1, static_cast<int>(fraction * samples.size())));
+    };
+    out << QString("%1  n=%2  p50 %3 ns  p99 %4 ns  max %5 ns\n")
+               .arg(name, -12)
+               .arg(samples.size())
+               .arg(at(0.50), 0, 'f', 1)
+               .arg(at(0.99), 0, 'f', 1)
+               .arg(samples.last(), 0, 'f', 1);
+}
+
+void report(QTextStream &out, const QString &backend, Result &result)
+{
+    if (result.rttNs.isEmpty()) {
+        out << backend << ": no round trips completed\n";
+        return;
+    }
+    std::sort(result.rttNs.begin(), result.rttNs.end());
+    auto us = [&](double fraction) {
+        const int index = qMin(result.rttNs.size() - 1, static_cast<int>(fraction * result.rttNs.size()));
+        return result.rttNs.at(index) / 1000.0;
+    };
+    qint64 sum = 0;
+    for (qint64 value : result.rttNs) {
+        sum += value;
+    }
+    out << QString("%1  n=%2  mean %3 us  p50 %4 us  p99 %5 us  max %6 us  %7 frames/s  timeouts %8\n")
+               .arg(backend, -12)
+               .arg(result.rttNs.size())
+               .arg(sum / 1000.0 / result.rttNs.size(), 0, 'f', 1)
+               .arg(us(0.50), 0, 'f', 1)
+               .arg(us(0.99), 0, 'f', 1)
+               .arg(result.rttNs.last() / 1000.0, 0, 'f', 1)
+               .arg(result.rttNs.size() * 1e9 / qMax<qint64>(1, result.totalNs), 0, 'f', 0)
+               .arg(result.timeouts);
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("asdSerialBench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Compares QSerialPort, the native serial backend and the TCP bridge over pty pairs.");
+    parser.addHelpOption();
+    QCommandLineOption iterationsOption("iterations", "Timed round trips per backend.", "count", "10000");
+    QCommandLineOption warmupOption("warmup", "Untimed round trips first.", "count", "200");
+    QCommandLineOption baudOption("baud", "Baud rate set on both backends.", "rate", "9600");
+    QCommandLineOption bridgeOption("bridge", "Also run through the TCP serial bridge on localhost.");
+    QCommandLineOption microOption("micro-samples", "Encode, decode and RX-path samples.", "count", "5000");
+    QCommandLineOption saveOption("save-baseline", "Save every latency distribution of this run to <file>.", "file");
+    QCommandLineOption labelOption("label", "Label stored with --save-baseline, e.g. the commit.", "text");
+    QCommandLineOption baselineOption("baseline", "Compare this run, or the saved run given as argument, "
+                                                  "against the baseline in <file>.", "file");
+    QCommandLineOption thresholdOption("threshold", "Median slowdown flagged as a regression.", "percent", "5");
+    QCommandLineOption alphaOption("alpha", "Significance level of the Mann-Whitney U test.", "p", "0.01");
+    parser.addOptions({iterationsOption, warmupOption, baudOption, bridgeOption, microOption,
+                       saveOption, labelOption, baselineOption, thresholdOption, alphaOption});
+    parser.addPositionalArgument("run", "Saved run to compare against --baseline instead of benchmarking.", "[run]");
+    parser.process(app);
+
+    BenchBaseline::Options compareOptions;
+    compareOptions.thresholdPercent = parser.value(thresholdOption).toDouble();
+    compareOptions.alpha = parser.value(alphaOption).toDouble();
+    if (parser.isSet(baselineOption) && !parser.positionalArguments().isEmpty()) {
+        return BenchBaseline::run(parser.value(baselineOption), parser.positionalArguments().first(), compareOptions);
+    }
+
+    const int iterations = qMax(1, parser.value(iterationsOption).toInt());
+    const int warmup = qMax(0, parser.value(warmupOption).toInt());
+    const qint32 baud = parser.value(baudOption).toInt();
+    const int microSamples = qMax(1, parser.value(microOption).toInt());
+    QTextStream out(stdout);
+
+    BenchBaseline current;
+    current.tool = "asdSerialBench";
+    current.label = parser.value(labelOption);
+    current.created = QDateTime::currentDateTime();
+    current.host = QSysInfo::machineHostName();
+
+    {
+        // RX-path logging would be timed along with the path otherwise
+        QLoggingCategory::setFilterRules("default.debug=false");
+        current.add("encode", encodeSamples(microSamples));
+        current.add("decode", decodeSamples(microSamples));
+        current.add("rx-path", rxPathSamples(microSamples));
+        QLoggingCategory::setFilterRules(QString());
+        reportMicro(out, "encode", current.distributions.value("encode"));
+        reportMicro(out, "decode", current.distributions.value("decode"));
+        reportMicro(out, "rx path", current.distributions.value("rx-path"));
+    }
+
+    {
+        PtyEcho echo;
+        if (!echo.start()) {
+            out << "openpty failed\n";
+            return 1;
+        }
+        QSerialPort port;
+        port.setPortName(echo.slavePath);
+        port.setBaudRate(baud);
+        port.setReadBufferSize(1024);  // As in SerialCommunication::openPort
+        if (!port.open(QIODevice::ReadWrite)) {
+            out << "QSerialPort: " << port.errorString() << "\n";
+            return 1;
+        }
+        Result result = run(&port, warmup, iterations);
+        current.add("rtt/qserialport", toDistribution(result.rttNs));
+        report(out, "QSerialPort", result);
+        port.close();
+    }
+
+    {
+        PtyEcho echo;
+        if (!echo.start()) {
+            out << "openpty failed\n";
+            return 1;
+        }
+        NativeSerialPort port;
+        port.setPortName(echo.slavePath);
+        port.setBaudRate(baud);
+        if (!port.open(QIODevice::ReadWrite)) {
+            out << "NativeSerialPort: " << port.errorString() << "\n";
+            return 1;
+        }
+        Result result = run(&port, warmup, iterations);
+        current.add("rtt/native", toDistribution(result.rttNs));
+        report(out, "native", result);
+        port.close();
+    }
+
+    if (parser.isSet(bridgeOption)) {
+        PtyEcho echo;
+        if (!echo.start()) {
+            out << "openpty failed\n";
+            return 1;
+        }
+        SerialBridgeServer bridge;
+        QString bridgeError;
+        if (!bridge.listen(echo.slavePath, "127.0.0.1", 0, &bridgeError)) {
+            out << bridgeError << "\n";
+            return 1;
+        }
+        RemoteSerialPort port;
+        port.setPortName(QString("tcp://127.0.0.1:%1").arg(bridge.serverPort()));
+        port.setBaudRate(baud);
+        if (!port.open(QIODevice::ReadWrite)) {
+            out << "RemoteSerialPort: " << port.errorString() << "\n";
+            return 1;
+        }
+        Result result = run(&port, warmup, iterations);
+        current.add("rtt/tcp-bridge", toDistribution(result.rttNs));
+        report(out, "tcp bridge", result);
+        port.close();
+
+        const SerialBridgeServer::Stats stats = bridge.stats();
+        out << QString("bridge: %1 bytes to the port in %2 writes, %3 bytes back in %4 writes\n")
+                   .arg(stats.toSerialBytes).arg(stats.toSerialWrites)
+                   .arg(stats.toClientBytes).arg(stats.toClientWrites);
+    }
+
+    QString baselineError;
+    if (parser.isSet(saveOption)) {
+        if (!current.save(parser.value(saveOption), &baselineError)) {
+            out << baselineError << "\n";
+            return 1;
+        }
+        out << "Saved baseline " << parser.value(saveOption) << "\n";
+    }
+    if (parser.isSet(baselineOption)) {
+        BenchBaseline baseline;
+        if (!BenchBaseline::load(parser.value(baselineOption), &baseline, &baselineError)) {
+            out << baselineError << "\n";
+            return 2;
+        }
+        const QVector<BenchBaseline::Comparison> comparisons = BenchBaseline::compare(baseline, current, compareOptions);
+        out << "\n";
+        for (const QString &line : BenchBaseline::format(baseline, current, comparisons)) {
+            out << line << "\n";
+        }
+        return BenchBaseline::hasRegression(comparisons) ? 1 : 0;
+    }
+
+    return 0;
+}
@@ -0,0 +1,497 @@
+#include "SerialBridge.h"
+#include "MemoryBudget.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTextStream>
+#include <QTimer>
+#include <QtEndian>
+
+QByteArray Rfc2217::escape(const QByteArray &data)
+{
+    if (!data.contains(static_cast<char>(IAC))) {
+        return data;
+    }
+    QByteArray escaped;
+    escaped.reserve(data.size() + 8);
+    for (char c : data) {
+        escaped += c;
+        if (static_cast<quint8>(c) == IAC) {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+QByteArray Rfc2217::negotiation(quint8 verb, quint8 option)
+{
+    QByteArray bytes;
+    bytes += static_cast<char>(IAC);
+    bytes += static_cast<char>(verb);
+    bytes += static_cast<char>(option);
+    return bytes;
+}
+
+QByteArray Rfc2217::comPortCommand(quint8 command, const QByteArray &value)
+{
+    QByteArray bytes;
+    bytes += static_cast<char>(IAC);
+    bytes += static_cast<char>(SB);
+    bytes += static_cast<char>(COM_PORT_OPTION);
+    bytes += static_cast<char>(command);
+    bytes += escape(value);
+    bytes += static_cast<char>(IAC);
+    bytes += static_cast<char>(SE);
+    return bytes;
+}
+
+QByteArray Rfc2217::encodeBaudRate(qint32 baudRate)
+{
+    QByteArray value(4, '\0');
+    qToBigEndian<quint32>(static_cast<quint32>(baudRate), reinterpret_cast<uchar *>(value.data()));
+    return value;
+}
+
+qint32 Rfc2217::decodeBaudRate(const QByteArray &value)
+{
+    if (value.size() < 4) {
+        return 0;
+    }
+    return static_cast<qint32>(qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(value.constData())));
+}
+
+quint8 Rfc2217::encodeParity(QSerialPort::Parity parity)
+{
+    switch (parity) {
+    case QSerialPort::OddParity:
+        return 2;
+    case QSerialPort::EvenParity:
+        return 3;
+    case QSerialPort::MarkParity:
+        return 4;
+    case QSerialPort::SpaceParity:
+        return 5;
+    default:
+        return 1;
+    }
+}
+
+QSerialPort::Parity Rfc2217::decodeParity(quint8 value)
+{
+    switch (value) {
+    case 2:
+        return QSerialPort::OddParity;
+    case 3:
+        return QSerialPort::EvenParity;
+    case 4:
+        return QSerialPort::MarkParity;
+    case 5:
+        return QSerialPort::SpaceParity;
+    default:
+        return QSerialPort::NoParity;
+    }
+}
+
+quint8 Rfc2217::encodeStopBits(QSerialPort::StopBits stopBits)
+{
+    switch (stopBits) {
+    case QSerialPort::TwoStop:
+        return 2;
+    case QSerialPort::OneAndHalfStop:
+        return 3;
+    default:
+        return 1;
+    }
+}
+
+QSerialPort::StopBits Rfc2217::decodeStopBits(quint8 value)
+{
+    switch (value) {
+    case 2:
+        return QSerialPort::TwoStop;
+    case 3:
+        return QSerialPort::OneAndHalfStop;
+    default:
+        return QSerialPort::OneStop;
+    }
+}
+
+quint8 Rfc2217::encodeFlowControl(QSerialPort::FlowControl flowControl)
+{
+    switch (flowControl) {
+    case QSerialPort::SoftwareControl:
+        return 2;
+    case QSerialPort::HardwareControl:
+        return 3;
+    default:
+        return 1;
+    }
+}
+
+QSerialPort::FlowControl Rfc2217::decodeFlowControl(quint8 value)
+{
+    switch (value) {
+    case 2:
+        return QSerialPort::SoftwareControl;
+    case 3:
+        return QSerialPort::HardwareControl;
+    default:
+        return QSerialPort::NoFlowControl;
+    }
+}
+
+void Rfc2217::Decoder::feed(const QByteArray &input, QByteArray *data,
+                            QList<Subnegotiation> *subnegotiations, QList<QPair<quint8, quint8>> *negotiations)
+{
+    for (char c : input) {
+        const quint8 byte = static_cast<quint8>(c);
+        switch (m_state) {
+        case DataState:
+            if (byte == IAC) {
+                m_state = IacState;
+            } else {
+                *data += c;
+            }
+            break;
+        case IacState:
+            if (byte == IAC) {
+                *data += c;
+                m_state = DataState;
+            } else if (byte == SB) {
+                m_subnegotiation.clear();
+                m_state = SubnegotiationState;
+            } else if (byte >= WILL && byte <= DONT) {
+                m_verb = byte;
+                m_state = VerbState;
+            } else {
+                m_state = DataState;           // NOP, GA and the like carry nothing for us
+            }
+            break;
+        case VerbState:
+            negotiations->append(qMakePair(m_verb, byte));
+            m_state = DataState;
+            break;
+        case SubnegotiationState:
+            if (byte == IAC) {
+                m_state = SubnegotiationIacState;
+            } else {
+                m_subnegotiation += c;
+            }
+            break;
+        case SubnegotiationIacState:
+            if (byte == SE) {
+                if (m_subnegotiation.size() >= 2) {
+                    Subnegotiation sub;
+                    sub.option = static_cast<quint8>(m_subnegotiation.at(0));
+                    sub.command = static_cast<quint8>(m_subnegotiation.at(1));
+                    sub.value = m_subnegotiation.mid(2);
+                    subnegotiations->append(sub);
+                }
+                m_state = DataState;
+            } else {
+                m_subnegotiation += c;         // IAC IAC inside the value
+                m_state = SubnegotiationState;
+            }
+            break;
+        }
+    }
+}
+
+void Rfc2217::Decoder::reset()
+{
+    m_state = DataState;
+    m_subnegotiation.clear();
+}
+
+SerialBridgeServer::SerialBridgeServer(QObject *parent)
+    : QObject(parent)
+    , m_server(new QTcpServer(this))
+    , m_client(nullptr)
+    , m_serial(nullptr)
+    , m_flushScheduled(false)
+{
+    connect(m_server, &QTcpServer::newConnection, this, &SerialBridgeServer::handleNewConnection);
+}
+
+SerialBridgeServer::~SerialBridgeServer()
+{
+    close();
+}
+
+bool SerialBridgeServer::listen(const QString &serialPort, const QString &address, quint16 port,
+                                QString *errorMessage)
+{
+    m_serialName = serialPort.split(" ").first();
+    m_config = SerialCommunication::configForPort(m_serialName);
+
+    // The bridge has no authentication, so other machines only reach it when asked for
+    QHostAddress host = address.isEmpty() ? QHostAddress(QHostAddress::LocalHost) : QHostAddress(address);
+    if (!m_server->listen(host, port)) {
+        *errorMessage = QString("Bridge: cannot listen on %1:%2: %3")
+                            .arg(host.toString()).arg(port).arg(m_server->errorString());
+        return false;
+    }
+    qDebug() << "Bridge:" << m_serialName << "on" << host.toString() << m_server->serverPort();
+    return true;
+}
+
+void SerialBridgeServer::close()
+{
+    if (m_client) {
+        m_client->disconnect(this);
+        m_client->abort();
+        m_client->deleteLater();
+        m_client = nullptr;
+    }
+    closeSerial();
+    m_server->close();
+    MemoryBudget::clear(MemoryBudget::SerialBuffers, &m_toClient);
+    MemoryBudget::clear(MemoryBudget::SerialBuffers, &m_toSerial);
+}
+
+quint16 SerialBridgeServer::serverPort() const
+{
+    return m_server->serverPort();
+}
+
+bool SerialBridgeServer::openSerial(QString *errorMessage)
+{
+    m_serial = SerialCommunication::createDevice(m_serialName, m_config, this);
+    if (!m_serial) {
+        *errorMessage = QString("Bridge: no backend for %1").arg(m_serialName);
+        return false;
+    }
+    if (!m_serial->open(QIODevice::ReadWrite)) {
+        *errorMessage = QString("Bridge: cannot open %1: %2").arg(m_serialName, m_serial->errorString());
+        delete m_serial;
+        m_serial = nullptr;
+        return false;
+    }
+    connect(m_serial, &QIODevice::readyRead, this, &SerialBridgeServer::handleSerialReadyRead);
+    return true;
+}
+
+void SerialBridgeServer::closeSerial()
+{
+    if (!m_serial) {
+        return;
+    }
+    m_serial->disconnect(this);
+    m_serial->close();
+    m_serial->deleteLater();
+    m_serial = nullptr;
+}
+
+void SerialBridgeServer::handleNewConnection()
+{
+    while (QTcpSocket *socket = m_server->nextPendingConnection()) {
+        const QString peer = QString("%1:%2").arg(socket->peerAddress().toString()).arg(socket->peerPort());
+        if (m_client) {
+            qDebug() << "Bridge: refusing" << peer << "- a client is already connected";
+            socket->abort();
+            socket->deleteLater();
+            continue;
+        }
+
+        QString openError;
+        if (!openSerial(&openError)) {
+            qWarning().noquote() << openError;
+            socket->abort();
+            socket->deleteLater();
+            continue;
+        }
+
+        m_client = socket;
+        m_client->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        m_decoder.reset();
+        MemoryBudget::clear(MemoryBudget::SerialBuffers, &m_toClient);
+        MemoryBudget::clear(MemoryBudget::SerialBuffers, &m_toSerial);
+        connect(m_client, &QTcpSocket::readyRead, this, &SerialBridgeServer::handleClientReadyRead);
+        connect(m_client, &QTcpSocket::disconnected, this, &SerialBridgeServer::handleClientDisconnected);
+
+        m_client->write(Rfc2217::negotiation(Rfc2217::WILL, Rfc2217::BINARY_OPTION)
+                        + Rfc2217::negotiation(Rfc2217::DO, Rfc2217::BINARY_OPTION)
+                        + Rfc2217::negotiation(Rfc2217::WILL, Rfc2217::COM_PORT_OPTION));
+        qDebug() << "Bridge: client" << peer << "connected to" << m_serialName;
+        emit clientConnected(peer);
+    }
+}
+
+void SerialBridgeServer::handleClientDisconnected()
+{
+    if (!m_client) {
+        return;
+    }
+    const QString peer = QString("%1:%2").arg(m_client->peerAddress().toString()).arg(m_client->peerPort());
+    MemoryBudget::clear(MemoryBudget::SerialBuffers, &m_toClient);
+    m_client->disconnect(this);
+    m_client->deleteLater();
+    m_client = nullptr;
+    closeSerial();
+    qDebug() << "Bridge: client" << peer << "left;" << m_stats.toSerialBytes << "bytes to"
+             << m_serialName << "in" << m_stats.toSerialWrites << "writes," << m_stats.toClientBytes
+             << "bytes back in" << m_stats.toClientWrites << "writes";
+    emit clientDisconnected(peer);
+}
+
+void SerialBridgeServer::handleClientReadyRead()
+{
+    QByteArray data;
+    QList<Rfc2217::Subnegotiation> settings;
+    QList<QPair<quint8, quint8>> negotiations;
+    m_decoder.feed(m_client->readAll(), &data, &settings, &negotiations);
+
+    // Both directions hold at most one event loop pass; a stalled flush evicts the oldest bytes
+    MemoryBudget::appendEvictingOldest(MemoryBudget::SerialBuffers, &m_toSerial, data);
+    for (const Rfc2217::Subnegotiation &setting : settings) {
+        if (setting.option == Rfc2217::COM_PORT_OPTION) {
+            applySetting(setting);
+        }
+    }
+    scheduleFlush();
+}
+
+void SerialBridgeServer::handleSerialReadyRead()
+{
+    MemoryBudget::appendEvictingOldest(MemoryBudget::SerialBuffers, &m_toClient, m_serial->readAll());
+    scheduleFlush();
+}
+
+void SerialBridgeServer::applySetting(const Rfc2217::Subnegotiation &setting)
+{
+    const quint8 value = setting.value.isEmpty() ? 0 : static_cast<quint8>(setting.value.at(0));
+    QByteArray reply;
+    bool changed = false;
+
+    switch (setting.command) {
+    case Rfc2217::SET_BAUDRATE: {
+        const qint32 baudRate = Rfc2217::decodeBaudRate(setting.value);
+        if (baudRate > 0 && baudRate != m_config.baudRate) {
+            m_config.baudRate = static_cast<QSerialPort::BaudRate>(baudRate);
+            changed = true;
+        }
+        reply = Rfc2217::encodeBaudRate(m_config.baudRate);
+        break;
+    }
+    case Rfc2217::SET_DATASIZE:
+        if (value >= 5 && value <= 8 && value != m_config.dataBits) {
+            m_config.dataBits = static_cast<QSerialPort::DataBits>(value);
+            changed = true;
+        }
+        reply = QByteArray(1, static_cast<char>(m_config.dataBits));
+        break;
+    case Rfc2217::SET_PARITY:
+        if (value != 0 && Rfc2217::decodeParity(value) != m_config.parity) {
+            m_config.parity = Rfc2217::decodeParity(value);
+            changed = true;
+        }
+        reply = QByteArray(1, static_cast<char>(Rfc2217::encodeParity(m_config.parity)));
+        break;
+    case Rfc2217::SET_STOPSIZE:
+        if (value != 0 && Rfc2217::decodeStopBits(value) != m_config.stopBits) {
+            m_config.stopBits = Rfc2217::decodeStopBits(value);
+            changed = true;
+        }
+        reply = QByteArray(1, static_cast<char>(Rfc2217::encodeStopBits(m_config.stopBits)));
+        break;
+    case Rfc2217::SET_CONTROL:
+        // Only the outbound flow control values: 0 asks for the setting, 1-3
+        // set it. The rest is not bridged and is echoed back.
+        if (value >= 1 && value <= 3 && Rfc2217::decodeFlowControl(value) != m_config.flowControl) {
+            m_config.flowControl = Rfc2217::decodeFlowControl(value);
+            changed = true;
+        }
+        reply = QByteArray(1, static_cast<char>(value <= 3
+                                                    ? Rfc2217::encodeFlowControl(m_config.flowControl)
+                                                    : value));
+        break;
+    case Rfc2217::PURGE_DATA:
+        if (QSerialPort *port = qobject_cast<QSerialPort *>(m_serial)) {
+            port->clear(value == 1 ? QSerialPort::Input : value == 2 ? QSerialPort::Output : QSerialPort::AllDirections);
+        }
+        if (value != 2) {
+            MemoryBudget::clear(MemoryBudget::SerialBuffers, &m_toClient);
+        }
+        reply = QByteArray(1, static_cast<char>(value));
+        break;
+    default:
+        return;                                // Not implemented; RFC 2217 lets us stay silent
+    }
+
+    if (changed) {
+        m_stats.settingsApplied++;
+        if (QSerialPort *port = qobject_cast<QSerialPort *>(m_serial)) {
+            port->setBaudRate(m_config.baudRate);
+            port->setDataBits(m_config.dataBits);
+            port->setParity(m_config.parity);
+            port->setStopBits(m_config.stopBits);
+            port->setFlowControl(m_config.flowControl);
+        } else if (m_serial) {
+            // The other backends take their settings when they open
+            QString openError;
+            closeSerial();
+            if (!openSerial(&openError)) {
+                qWarning().noquote() << openError;
+                m_client->abort();
+                return;
+            }
+        }
+    }
+    if (m_client) {
+        m_client->write(Rfc2217::comPortCommand(setting.command + Rfc2217::SERVER_OFFSET, reply));
+    }
+}
+
+void SerialBridgeServer::scheduleFlush()
+{
+    // Everything that arrives in this event loop pass goes out in one write
+    if (m_flushScheduled) {
+        return;
+    }
+    m_flushScheduled = true;
+    QTimer::singleShot(0, this, &SerialBridgeServer::flush);
+}
+
+void SerialBridgeServer::flush()
+{
+    m_flushScheduled = false;
+    if (!m_toSerial.isEmpty() && m_serial) {
+        m_serial->write(m_toSerial);
+        m_stats.toSerialBytes += m_toSerial.size();
+        m_stats.toSerialWrites++;
+    }
+    MemoryBudget::clear(MemoryBudget::SerialBuffers, &m_toSerial);
+    if (!m_toClient.isEmpty() && m_client) {
+        m_client->write(Rfc2217::escape(m_toClient));
+        m_stats.toClientBytes += m_toClient.size();
+        m_stats.toClientWrites++;
+    }
+    MemoryBudget::clear(MemoryBudget::SerialBuffers, &m_toClient);
+}
+
+int SerialBridgeServer::run(const QString &serialPort, const QString &address, quint16 port)
+{
+    QTextStream out(stdout);
+    SerialBridgeServer bridge;
+    QString listenError;
+    if (!bridge.listen(serialPort, address, port, &listenError)) {
+        out << listenError << Qt::endl;
+        return 2;
+    }
+    if (address.isEmpty()) {
+        out << QString("Bridging %1 on 127.0.0.1:%2 only; --bind 0.0.0.0 serves other machines")
+                   .arg(serialPort).arg(bridge.serverPort()) << Qt::endl;
+    } else {
+        out << QString("Bridging %1 on %2:%3; clients connect to tcp://<this host>:%3")
+                   .arg(serialPort, address).arg(bridge.serverPort()) << Qt::endl;
+    }
+    QObject::connect(&bridge, &SerialBridgeServer::clientConnected, [&out](const QString &peer) {
+        out << "Client " << peer << " connected" << Qt::endl;
+    });
+    QObject::connect(&bridge, &SerialBridgeServer::clientDisconnected, [&out](const QString &peer) {
+        out << "Client " << peer << " disconnected" << Qt::endl;
+    });
+    return QCoreApplication::exec();
+}
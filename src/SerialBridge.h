@@ -0,0 +1,141 @@
+#ifndef SERIALBRIDGE_H
+#define SERIALBRIDGE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QList>
+#include <QSerialPort>
+#include "SerialCommunication.h"
+
+class QTcpServer;
+class QTcpSocket;
+
+// The subset of RFC 2217 (Telnet COM-PORT-OPTION) the bridge speaks: data
+// is 8-bit clean with IAC (0xFF) doubled, and line settings travel in
+// IAC SB 44 <command> <value> IAC SE. The server answers each setting with
+// command + 100 and the value now in effect; value 0 only asks for it.
+namespace Rfc2217 {
+    const quint8 IAC = 255;
+    const quint8 DONT = 254;
+    const quint8 DO = 253;
+    const quint8 WONT = 252;
+    const quint8 WILL = 251;
+    const quint8 SB = 250;
+    const quint8 SE = 240;
+
+    const quint8 BINARY_OPTION = 0;
+    const quint8 COM_PORT_OPTION = 44;
+
+    const quint8 SET_BAUDRATE = 1;
+    const quint8 SET_DATASIZE = 2;
+    const quint8 SET_PARITY = 3;
+    const quint8 SET_STOPSIZE = 4;
+    const quint8 SET_CONTROL = 5;
+    const quint8 PURGE_DATA = 12;
+    const quint8 SERVER_OFFSET = 100;
+
+    struct Subnegotiation {
+        quint8 option = 0;
+        quint8 command = 0;
+        QByteArray value;
+    };
+
+    QByteArray escape(const QByteArray &data);
+    QByteArray negotiation(quint8 verb, quint8 option);
+    QByteArray comPortCommand(quint8 command, const QByteArray &value);
+
+    QByteArray encodeBaudRate(qint32 baudRate);
+    qint32 decodeBaudRate(const QByteArray &value);
+    quint8 encodeParity(QSerialPort::Parity parity);
+    QSerialPort::Parity decodeParity(quint8 value);
+    quint8 encodeStopBits(QSerialPort::StopBits stopBits);
+    QSerialPort::StopBits decodeStopBits(quint8 value);
+    quint8 encodeFlowControl(QSerialPort::FlowControl flowControl);
+    QSerialPort::FlowControl decodeFlowControl(quint8 value);
+
+    // Splits a Telnet stream into data and commands; keeps partial sequences
+    // across calls
+    class Decoder
+    {
+    public:
+        void feed(const QByteArray &input, QByteArray *data,
+                  QList<Subnegotiation> *subnegotiations, QList<QPair<quint8, quint8>> *negotiations);
+        void reset();
+
+    private:
+        enum State {
+            DataState,
+            IacState,
+            VerbState,
+            SubnegotiationState,
+            SubnegotiationIacState
+        };
+
+        State m_state = DataState;
+        quint8 m_verb = 0;
+        QByteArray m_subnegotiation;
+    };
+}
+
+// Exposes a locally attached serial port over TCP. One client at a time;
+// the port is opened when the client connects and closed when it leaves,
+// so a local application can use it in between. Bytes read on either side
+// during one event loop pass are forwarded together in a single write, and
+// Nagle is off so a batch leaves at once.
+class SerialBridgeServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const quint16 DEFAULT_PORT = 7000;
+
+    struct Stats {
+        quint64 toClientBytes = 0;
+        quint64 toSerialBytes = 0;
+        quint64 toClientWrites = 0;
+        quint64 toSerialWrites = 0;
+        quint64 settingsApplied = 0;
+    };
+
+    explicit SerialBridgeServer(QObject *parent = nullptr);
+    ~SerialBridgeServer();
+
+    bool listen(const QString &serialPort, const QString &address, quint16 port, QString *errorMessage);
+    void close();
+    quint16 serverPort() const;
+    bool hasClient() const { return m_client != nullptr; }
+    Stats stats() const { return m_stats; }
+
+    // Headless entry point: bridges until interrupted
+    static int run(const QString &serialPort, const QString &address, quint16 port);
+
+signals:
+    void clientConnected(const QString &peer);
+    void clientDisconnected(const QString &peer);
+
+private slots:
+    void handleNewConnection();
+    void handleClientReadyRead();
+    void handleSerialReadyRead();
+    void handleClientDisconnected();
+
+private:
+    QTcpServer *m_server;
+    QTcpSocket *m_client;
+    QIODevice *m_serial;
+    QString m_serialName;
+    SerialCommunication::SerialConfig m_config;
+    Rfc2217::Decoder m_decoder;
+    QByteArray m_toClient;
+    QByteArray m_toSerial;
+    bool m_flushScheduled;
+    Stats m_stats;
+
+    bool openSerial(QString *errorMessage);
+    void closeSerial();
+    void applySetting(const Rfc2217::Subnegotiation &setting);
+    void scheduleFlush();
+    void flush();
+};
+
+#endif // SERIALBRIDGE_H
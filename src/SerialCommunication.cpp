@@ -1,4 +1,11 @@
 #include "SerialCommunication.h"
+#include "Metrics.h"
+#include "Tracer.h"
+#include "VmcProfile.h"
+#ifdef Q_OS_LINUX
+#include "NativeSerialPort.h"
+#endif
+#include "RemoteSerialPort.h"
 #include <QSerialPortInfo>
 #include <QSettings>
 #include <QDebug>
@@ -6,21 +13,55 @@
 #include <QElapsedTimer>
 #include <QCoreApplication>
 #include <QThread>
-#include <numeric>
 #include <algorithm>
 
 SerialCommunication::SerialCommunication(QObject *parent)
     : QObject(parent)
     , m_serialPort(new QSerialPort(this))
+    , m_device(m_serialPort)
+    , m_ownedDevice(nullptr)
+    , m_txScheduler(new TxScheduler(this))
+    , m_reliableLink(new ReliableLink(this))
+    , m_reliableDelivery(false)
     , m_keepaliveEnabled(false)
+    , m_isOpening(false)
+    , m_linkUp(false)
+    , m_connectionLost(false)
+    , m_keepalivePending(false)
+    , m_traceAwaitingRx(0)
 {
     m_defaultPort = getDefaultPort();
     
     connect(m_serialPort, &QSerialPort::readyRead, this, &SerialCommunication::handleReadyRead);
     connect(m_serialPort, &QSerialPort::errorOccurred, this, &SerialCommunication::handleError);
+    connect(m_txScheduler, &TxScheduler::writeFailed, this, &SerialCommunication::logError);
+    m_txScheduler->setDevice(m_serialPort);
+
+    connect(m_reliableLink, &ReliableLink::transmit, m_txScheduler, &TxScheduler::enqueue);
+    connect(m_txScheduler, &TxScheduler::frameDispatched, m_reliableLink,
+            [this](const QByteArray &frame) { m_reliableLink->handleDispatched(frame); });
+    connect(m_txScheduler, &TxScheduler::frameDispatched, this,
+            [this](const QByteArray &frame) {
+        m_capture.record(CaptureFormat::Tx, frame);
+        if (Tracer::isEnabled() && VmcProtocol::isFrame(frame)) {
+            m_traceAwaitingRx = Tracer::frameId(frame);
+        }
+        emit frameDispatched(frame);
+    });
+    connect(m_reliableLink, &ReliableLink::delivered, this, [this](const QByteArray &frame, qint64 rttMs) {
+        Metrics::instance().ackLatencyMs.record(rttMs);
+        emit frameDelivered(frame, rttMs);
+    });
+    connect(m_reliableLink, &ReliableLink::failed, this, [this](const QByteArray &frame, int attempts) {
+        Metrics::instance().deliveryFailures.add();
+        logError(QString("No ack for frame %1 after %2 attempts")
+                 .arg(QString(frame.toHex())).arg(attempts));
+        emit frameFailed(frame);
+    });
     
     setupWatchdog();
     setupKeepalive();
+    reloadProfile();
 }
 
 SerialCommunication::~SerialCommunication()
@@ -32,14 +73,18 @@ SerialCommunication::~SerialCommunication()
 void SerialCommunication::setupWatchdog()
 {
     m_watchdogTimer.setInterval(WATCHDOG_TIMEOUT_MS);
-    connect(&m_watchdogTimer, &QTimer::timeout, [this]() {
-        if (m_serialPort->isOpen()) {
+    connect(&m_watchdogTimer, &ClockTimer::timeout, [this]() {
+        if (m_device->isOpen()) {
             // Simple status check instead of sending command
-            if (!m_serialPort->isWritable() || !m_serialPort->isReadable()) {
+            if (!m_device->isWritable() || !m_device->isReadable()) {
                 qDebug() << "Watchdog: Port no longer accessible";
+                recordConnectionLost();
                 closePort();
                 emit error("Connection lost - port not accessible");
             }
+        } else if (m_device != m_serialPort) {
+            // Closed without its queued aboutToClose arriving, as on a virtual clock
+            handleDeviceClosed();
         }
     });
 }
@@ -47,14 +92,20 @@ void SerialCommunication::setupWatchdog()
 void SerialCommunication::setupKeepalive()
 {
     m_keepaliveTimer.setInterval(KEEPALIVE_INTERVAL_MS);
-    connect(&m_keepaliveTimer, &QTimer::timeout, this, &SerialCommunication::sendKeepalive);
+    connect(&m_keepaliveTimer, &ClockTimer::timeout, this, &SerialCommunication::sendKeepalive);
 }
 
 void SerialCommunication::sendKeepalive()
 {
-    if (m_serialPort->isOpen()) {
-        QByteArray keepalive("00");
-        m_serialPort->write(keepalive);
+    if (m_device->isOpen()) {
+        Metrics &metrics = Metrics::instance();
+        if (m_keepalivePending) {
+            metrics.keepaliveMisses.add();
+        }
+        metrics.keepalivesSent.add();
+        m_keepalivePending = true;
+
+        m_txScheduler->enqueue(m_keepaliveRequest, TxPriority::Keepalive);
         emit keepaliveMessage(QString("%1 - Sent keepalive")
             .arg(QDateTime::currentDateTime().toString()));
     }
@@ -65,7 +116,36 @@ void SerialCommunication::closePort()
     m_watchdogTimer.stop();
     m_keepaliveTimer.stop();
     
-    if (m_serialPort->isOpen()) {
+    // Anything still queued is stale once the port goes away
+    m_txScheduler->clear();
+    if (m_device->isOpen() || m_device != m_serialPort) {
+        m_rttEstimators[getCurrentPortName()] = m_reliableLink->estimator();
+    }
+    m_reliableLink->reset();
+    m_decoder.reset();
+    m_capture.flush();
+    m_keepalivePending = false;
+    if (m_linkUp) {
+        Metrics::instance().portsOpen.add(-1);
+        m_linkUp = false;
+    }
+
+    if (m_device != m_serialPort) {
+        // Simulated or other non-QSerialPort device: close it and fall back
+        disconnect(m_device, nullptr, this, nullptr);
+        if (m_device->isOpen()) {
+            m_device->close();
+        }
+        qDebug() << "Closed device:" << m_deviceName;
+        if (m_device == m_ownedDevice) {
+            m_ownedDevice->deleteLater();
+            m_ownedDevice = nullptr;
+        }
+
+        m_device = m_serialPort;
+        m_deviceName.clear();
+        m_txScheduler->setDevice(m_serialPort);
+    } else if (m_serialPort->isOpen()) {
         try {
             // Ensure all data is written before closing
             if (!m_serialPort->flush()) {
@@ -87,9 +167,6 @@ void SerialCommunication::closePort()
             
             qDebug() << QDateTime::currentDateTime().toString()
                      << "- Closed port:" << m_serialPort->portName();
-                     
-            // Clear any remaining data in our buffer
-            m_responseBuffer.clear();
             
         } catch (const std::exception& e) {
             qDebug() << "Exception during port closure:" << e.what();
@@ -101,18 +178,19 @@ void SerialCommunication::closePort()
     emit portStatusChanged(false);
 }
 
-bool SerialCommunication::sendCommand(const QByteArray &command)
+bool SerialCommunication::sendCommand(const QByteArray &command, TxPriority priority)
 {
-    if (!m_serialPort->isOpen()) {
+    if (!m_device->isOpen()) {
         logError("Cannot send command - port not open");
         return false;
     }
 
-    // Store the command type
-    m_lastCommand = command;
+    if (m_reliableDelivery && VmcProtocol::isFrame(command)) {
+        return sendReliable(command, priority);
+    }
 
     // If this is a keepalive command, emit through keepaliveMessage
-    if (command == "00") {
+    if (command == m_keepaliveRequest) {
         emit keepaliveMessage(QString("%1 - Sending command: %2")
             .arg(QDateTime::currentDateTime().toString())
             .arg(QString(command.toHex())));
@@ -122,17 +200,45 @@ bool SerialCommunication::sendCommand(const QByteArray &command)
             .arg(QString(command.toHex())));
     }
 
-    qint64 bytesWritten = m_serialPort->write(command);
-    return bytesWritten == command.size();
+    // Queued behind higher-priority traffic and paced by bytesWritten
+    return m_txScheduler->enqueue(command, priority);
+}
+
+TxScheduler::Metrics SerialCommunication::txMetrics() const
+{
+    return m_txScheduler->metrics();
+}
+
+bool SerialCommunication::sendReliable(const QByteArray &frame, TxPriority priority, int window)
+{
+    if (!m_device->isOpen()) {
+        logError("Cannot send command - port not open");
+        return false;
+    }
+
+    emit normalMessage(QString("%1 - Sending command (ack required): %2")
+        .arg(QDateTime::currentDateTime().toString())
+        .arg(QString(frame.toHex())));
+
+    return m_reliableLink->submit(frame, priority, window);
+}
+
+void SerialCommunication::setReliableDelivery(bool enable)
+{
+    m_reliableDelivery = enable;
 }
 
 bool SerialCommunication::waitForResponse(int timeout)
 {
-    if (!m_serialPort->isOpen()) {
+    if (!m_device->isOpen()) {
         logError("Cannot wait for response - port not open");
         return false;
     }
 
+    if (timeout < 0) {
+        timeout = static_cast<int>(m_reliableLink->estimator().rto());
+    }
+
     QElapsedTimer timer;
     timer.start();
     
@@ -140,16 +246,16 @@ bool SerialCommunication::waitForResponse(int timeout)
 
     while (timer.elapsed() < timeout) {
         // Check if port is still valid
-        if (!m_serialPort->isOpen() || !m_serialPort->isReadable()) {
+        if (!m_device->isOpen() || !m_device->isReadable()) {
             logError("Port became inaccessible while waiting for response");
             return false;
         }
 
         // Wait for data with shorter timeout
-        if (m_serialPort->waitForReadyRead(10)) {
-            QByteArray newData = m_serialPort->readAll();
+        if (m_device->waitForReadyRead(10)) {
+            QByteArray newData = m_device->readAll();
             if (!newData.isEmpty()) {
-                m_responseBuffer.append(newData);
+                recordReceived(newData);
                 qDebug() << "Response received in" << timer.elapsed() 
                          << "ms, data:" << newData.toHex();
                 return true;
@@ -191,22 +297,43 @@ QStringList SerialCommunication::getAvailablePorts()
         qDebug() << "  Serial Number:" << portInfo.serialNumber();
         qDebug() << "  System Location:" << portInfo.systemLocation();
     }
-    
+
+    // Ports on other machines, reached through a SerialBridgeServer
+    ports << remotePorts();
     return ports;
 }
 
 bool SerialCommunication::openPort(const QString &portName, const SerialConfig &config)
 {
-    static bool isOpening = false;
-    if (isOpening) return false;
-    isOpening = true;
+    // Per instance: campaign workers open their own ports concurrently
+    if (m_isOpening) return false;
+    m_isOpening = true;
 
     try {
-        if (m_serialPort->isOpen()) {
+        if (isPortOpen()) {
             closePort();
         }
 
         QString actualPortName = portName.split(" ").first();
+
+        if (config.backend == SerialConfig::NativeBackend || RemoteSerialPort::isRemotePortName(actualPortName)) {
+            QIODevice *device = createDevice(actualPortName, config, this);
+            if (!device) {
+                logError("The native serial backend is only available on Linux");
+                m_isOpening = false;
+                return false;
+            }
+            m_ownedDevice = device;
+
+            // Same bookkeeping as any other device from here on
+            bool opened = openDevice(device, actualPortName);
+            if (!opened) {
+                m_ownedDevice = nullptr;
+                device->deleteLater();
+            }
+            m_isOpening = false;
+            return opened;
+        }
         
         // Configure port
         m_serialPort->setPortName(actualPortName);
@@ -222,7 +349,7 @@ bool SerialCommunication::openPort(const QString &portName, const SerialConfig &
             QString errorMsg = QString("Failed to open port %1: %2")
                              .arg(actualPortName, m_serialPort->errorString());
             logError(errorMsg);
-            isOpening = false;
+            m_isOpening = false;
             return false;
         }
 
@@ -231,7 +358,7 @@ bool SerialCommunication::openPort(const QString &portName, const SerialConfig &
         
         if (!m_serialPort->isOpen()) {
             logError("Port closed unexpectedly after opening");
-            isOpening = false;
+            m_isOpening = false;
             return false;
         }
 
@@ -242,7 +369,11 @@ bool SerialCommunication::openPort(const QString &portName, const SerialConfig &
         
         m_serialPort->clear();
         m_serialPort->flush();
+
+        // Resume from this port's RTT history rather than the fixed initial RTO
+        m_reliableLink->setEstimator(m_rttEstimators.value(actualPortName));
         
+        recordOpened();
         emit normalMessage(QString("Successfully opened port %1").arg(actualPortName));
         emit portStatusChanged(true);
         
@@ -251,7 +382,7 @@ bool SerialCommunication::openPort(const QString &portName, const SerialConfig &
         }
         m_watchdogTimer.start();
         
-        isOpening = false;
+        m_isOpening = false;
         return true;
 
     } catch (const std::exception& e) {
@@ -260,7 +391,7 @@ bool SerialCommunication::openPort(const QString &portName, const SerialConfig &
         logError("Unknown exception while opening port");
     }
 
-    isOpening = false;
+    m_isOpening = false;
     emit portStatusChanged(false);
     return false;
 }
@@ -278,34 +409,230 @@ void SerialCommunication::setDefaultPort(const QString &portName)
     m_defaultPort = portName;
 }
 
+SerialCommunication::SerialConfig SerialCommunication::configForPort(const QString &portName)
+{
+    SerialConfig config;
+    QSettings settings("YourCompany", "asdKeypad");
+    const QString key = QString("Ports/%1/Backend").arg(portName.split(" ").first());
+    if (settings.value(key).toString() == "native" && isNativeBackendAvailable()) {
+        config.backend = SerialConfig::NativeBackend;
+    }
+    return config;
+}
+
+void SerialCommunication::setPortBackend(const QString &portName, SerialConfig::Backend backend)
+{
+    QSettings settings("YourCompany", "asdKeypad");
+    settings.setValue(QString("Ports/%1/Backend").arg(portName.split(" ").first()),
+                      backend == SerialConfig::NativeBackend ? "native" : "qt");
+}
+
+QIODevice *SerialCommunication::createDevice(const QString &portName, const SerialConfig &config, QObject *parent)
+{
+    if (RemoteSerialPort::isRemotePortName(portName)) {
+        RemoteSerialPort *remote = new RemoteSerialPort(parent);
+        remote->setPortName(portName);
+        remote->setBaudRate(config.baudRate);
+        remote->setDataBits(config.dataBits);
+        remote->setParity(config.parity);
+        remote->setStopBits(config.stopBits);
+        remote->setFlowControl(config.flowControl);
+        return remote;
+    }
+
+    if (config.backend == SerialConfig::NativeBackend) {
+#ifdef Q_OS_LINUX
+        NativeSerialPort *native = new NativeSerialPort(parent);
+        native->setPortName(portName);
+        native->setBaudRate(config.baudRate);
+        native->setDataBits(config.dataBits);
+        native->setParity(config.parity);
+        native->setStopBits(config.stopBits);
+        native->setFlowControl(config.flowControl);
+        return native;
+#else
+        return nullptr;
+#endif
+    }
+
+    QSerialPort *port = new QSerialPort(parent);
+    port->setPortName(portName);
+    port->setBaudRate(config.baudRate);
+    port->setDataBits(config.dataBits);
+    port->setParity(config.parity);
+    port->setStopBits(config.stopBits);
+    port->setFlowControl(config.flowControl);
+    return port;
+}
+
+QStringList SerialCommunication::remotePorts()
+{
+    QSettings settings("YourCompany", "asdKeypad");
+    return settings.value("RemotePorts").toStringList();
+}
+
+void SerialCommunication::addRemotePort(const QString &portName)
+{
+    QSettings settings("YourCompany", "asdKeypad");
+    QStringList ports = settings.value("RemotePorts").toStringList();
+    if (!ports.contains(portName)) {
+        ports.append(portName);
+        settings.setValue("RemotePorts", ports);
+    }
+}
+
+bool SerialCommunication::isNativeBackendAvailable()
+{
+#ifdef Q_OS_LINUX
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool SerialCommunication::openDevice(QIODevice *device, const QString &name)
+{
+    if (isPortOpen()) {
+        closePort();
+    }
+
+    if (!device->isOpen() && !device->open(QIODevice::ReadWrite)) {
+        logError(QString("Failed to open device %1: %2").arg(name, device->errorString()));
+        return false;
+    }
+
+    m_device = device;
+    m_deviceName = name;
+    connect(m_device, &QIODevice::readyRead, this, &SerialCommunication::handleReadyRead);
+    // Queued: closePort() must not run from inside the device's own close()
+    connect(m_device, &QIODevice::aboutToClose, this, &SerialCommunication::handleDeviceClosed,
+            Qt::QueuedConnection);
+    m_txScheduler->setDevice(m_device);
+    m_reliableLink->setEstimator(m_rttEstimators.value(name));
+
+    recordOpened();
+    emit normalMessage(QString("Successfully opened device %1").arg(name));
+    emit portStatusChanged(true);
+
+    if (m_keepaliveEnabled) {
+        m_keepaliveTimer.start();
+    }
+    m_watchdogTimer.start();
+    return true;
+}
+
 bool SerialCommunication::isPortOpen() const
 {
-    return m_serialPort->isOpen();
+    return m_device->isOpen();
 }
 
 QString SerialCommunication::getCurrentPortName() const
 {
-    return m_serialPort->portName();
+    return m_device == m_serialPort ? m_serialPort->portName() : m_deviceName;
+}
+
+QString SerialCommunication::deviceIdentity() const
+{
+    // The VMC cannot be asked who it is; the USB adapter cabled to it can
+    const QString portName = getCurrentPortName();
+    if (!RemoteSerialPort::isRemotePortName(portName)) {
+        for (const QSerialPortInfo &info : QSerialPortInfo::availablePorts()) {
+            bool samePort = info.portName() == portName || info.systemLocation() == portName;
+            if (samePort && !info.serialNumber().isEmpty()) {
+                return QString("usb-%1:%2-%3")
+                    .arg(info.vendorIdentifier(), 4, 16, QChar('0'))
+                    .arg(info.productIdentifier(), 4, 16, QChar('0'))
+                    .arg(info.serialNumber());
+            }
+        }
+    }
+    return portName;
+}
+
+void SerialCommunication::handleDeviceClosed()
+{
+    if (m_device != m_serialPort && !m_device->isOpen()) {
+        logError(QString("Device %1 closed").arg(m_deviceName));
+        recordConnectionLost();
+        closePort();
+    }
+}
+
+void SerialCommunication::reloadProfile()
+{
+    // Copied out once per profile change so the RX/TX paths never consult it
+    const std::shared_ptr<const VmcProfile> profile = VmcProfile::current();
+    m_keepaliveRequest = profile->keepaliveRequest();
+    m_keepaliveResponse = profile->keepaliveResponse();
+    m_decoder.setKeepaliveResponse(m_keepaliveResponse);
+    m_keepaliveTimer.setInterval(profile->keepaliveIntervalMs());
+    m_reliableLink->setMaxRetries(profile->maxRetries());
+}
+
+void SerialCommunication::recordOpened()
+{
+    Metrics &metrics = Metrics::instance();
+    metrics.portOpens.add();
+    if (m_connectionLost) {
+        metrics.reconnects.add();
+        m_connectionLost = false;
+    }
+    if (!m_linkUp) {
+        metrics.portsOpen.add(1);
+        m_linkUp = true;
+    }
+}
+
+void SerialCommunication::recordConnectionLost()
+{
+    if (m_linkUp) {
+        Metrics::instance().connectionLosses.add();
+        m_connectionLost = true;
+    }
+}
+
+void SerialCommunication::recordReceived(const QByteArray &data)
+{
+    Metrics::instance().rxBytes.add(data.size());
+    m_capture.record(CaptureFormat::Rx, data);
+}
+
+bool SerialCommunication::startCapture(const QString &fileName)
+{
+    QString errorMessage;
+    if (!m_capture.open(fileName, &errorMessage)) {
+        logError(errorMessage);
+        return false;
+    }
+    return true;
+}
+
+void SerialCommunication::stopCapture()
+{
+    m_capture.close();
 }
 
 void SerialCommunication::handleReadyRead()
 {
-    if (!m_serialPort->isOpen()) {
+    if (!m_device->isOpen()) {
         return;
     }
     
-    QByteArray data = m_serialPort->readAll();
+    QByteArray data = m_device->readAll();
     if (!data.isEmpty()) {
-        m_responseBuffer.append(data);
+        if (m_traceAwaitingRx) {
+            Tracer::asyncStep("firstRxByte", m_traceAwaitingRx);
+            m_traceAwaitingRx = 0;
+        }
+        recordReceived(data);
         
         QString message = QString("%1 - Received data (hex): %2 ascii: %3")
             .arg(QDateTime::currentDateTime().toString())
             .arg(QString(data.toHex()))
             .arg(QString(data));
 
-        // Check if this is a keepalive response (0B0FFA)
-        bool isKeepaliveResponse = data.contains("0B0FFA") || 
-                                 data.toHex().contains("304230464641");
+        // Check if this is a keepalive response (0B0FFA for the built-in profile)
+        bool isKeepaliveResponse = data.contains(m_keepaliveResponse);
 
         if (isKeepaliveResponse) {
             emit keepaliveMessage(message);
@@ -314,6 +641,22 @@ void SerialCommunication::handleReadyRead()
         }
         
         emit dataReceived(data);
+
+        Metrics &metrics = Metrics::instance();
+        const quint64 checksumErrors = m_decoder.checksumErrors();
+        const quint64 discardedBytes = m_decoder.discardedBytes();
+        for (const VmcFrame &frame : m_decoder.feed(data)) {
+            metrics.rxFrames[Metrics::classify(frame)].add();
+            if (frame.isKeepaliveResponse) {
+                m_keepalivePending = false;
+            } else if (Tracer::isEnabled()) {
+                Tracer::asyncEnd("frame", Tracer::frameId(frame.raw));
+            }
+            m_reliableLink->handleFrame(frame);
+            emit frameReceived(frame);
+        }
+        metrics.checksumErrors.add(m_decoder.checksumErrors() - checksumErrors);
+        metrics.discardedBytes.add(m_decoder.discardedBytes() - discardedBytes);
     }
 }
 
@@ -331,6 +674,7 @@ void SerialCommunication::handleError(QSerialPort::SerialPortError error)
     logError(errorString);
     
     if (error != QSerialPort::NotOpenError) {
+        recordConnectionLost();
         closePort();
     }
 }
@@ -343,50 +687,10 @@ void SerialCommunication::logError(const QString &error)
     emit this->error(error);
 }
 
-#ifdef QT_DEBUG
-bool SerialCommunication::testResponseTimes()
-{
-    QElapsedTimer totalTimer;
-    totalTimer.start();
-    
-    const int TEST_ITERATIONS = 10;
-    int successCount = 0;
-    QVector<qint64> responseTimes;
-
-    for (int i = 0; i < TEST_ITERATIONS; i++) {
-        QElapsedTimer commandTimer;
-        commandTimer.start();
-        
-        // Send a simple command
-        if (sendCommand(QByteArray::fromHex("0B0003C8D6"))) {
-            responseTimes.append(commandTimer.elapsed());
-            successCount++;
-        }
-        
-        QThread::msleep(100); // Brief pause between tests
-    }
-
-    // Calculate statistics
-    if (!responseTimes.isEmpty()) {
-        qint64 avgTime = std::accumulate(responseTimes.begin(), responseTimes.end(), 0LL) / responseTimes.size();
-        qint64 maxTime = *std::max_element(responseTimes.begin(), responseTimes.end());
-        qint64 minTime = *std::min_element(responseTimes.begin(), responseTimes.end());
-        
-        qDebug() << "Response Time Statistics:";
-        qDebug() << "  Average:" << avgTime << "ms";
-        qDebug() << "  Maximum:" << maxTime << "ms";
-        qDebug() << "  Minimum:" << minTime << "ms";
-        qDebug() << "  Success Rate:" << (successCount * 100 / TEST_ITERATIONS) << "%";
-    }
-
-    return successCount > 0;
-}
-#endif
-
 void SerialCommunication::enableKeepalive(bool enable)
 {
     m_keepaliveEnabled = enable;
-    if (enable && m_serialPort->isOpen()) {
+    if (enable && m_device->isOpen()) {
         m_keepaliveTimer.start();
     } else {
         m_keepaliveTimer.stop();
@@ -401,6 +705,9 @@ bool SerialCommunication::isKeepaliveEnabled() const
 bool SerialCommunication::isPortAvailable(const QString &portName) const
 {
     QString actualPortName = portName.split(" ").first();
+    if (RemoteSerialPort::isRemotePortName(actualPortName)) {
+        return true;   // Only connecting tells; openPort reports why it failed
+    }
     for (const QSerialPortInfo &info : QSerialPortInfo::availablePorts()) {
         if (info.portName() == actualPortName) {
             return checkPortAccess(actualPortName);
@@ -4,7 +4,12 @@
 #include <QObject>
 #include <QSerialPort>
 #include <QStringList>
-#include <QTimer>
+#include <QMap>
+#include "CaptureFile.h"
+#include "TxScheduler.h"
+#include "VirtualClock.h"
+#include "ReliableLink.h"
+#include "VmcProtocol.h"
 
 class SerialCommunication : public QObject
 {
@@ -12,6 +17,11 @@ class SerialCommunication : public QObject
 
 public:
     struct SerialConfig {
+        enum Backend {
+            QtSerialPortBackend,   // QSerialPort, every platform
+            NativeBackend          // NativeSerialPort: termios + epoll, Linux only
+        };
+
         SerialConfig() {
             // Default configuration that works with most hardware
             baudRate = QSerialPort::Baud9600;
@@ -19,6 +29,7 @@ public:
             parity = QSerialPort::NoParity;
             stopBits = QSerialPort::OneStop;
             flowControl = QSerialPort::NoFlowControl;
+            backend = QtSerialPortBackend;
         }
 
         QSerialPort::BaudRate baudRate;
@@ -26,23 +37,45 @@ public:
         QSerialPort::Parity parity;
         QSerialPort::StopBits stopBits;
         QSerialPort::FlowControl flowControl;
+        Backend backend;
     };
 
     explicit SerialCommunication(QObject *parent = nullptr);
     ~SerialCommunication();
 
     bool openPort(const QString &portName, const SerialConfig &config = SerialConfig());
+    bool openDevice(QIODevice *device, const QString &name);
+    QIODevice *device() const { return m_device; }
     void closePort();
-    bool sendCommand(const QByteArray &command);
+    bool sendCommand(const QByteArray &command, TxPriority priority = TxPriority::Operator);
     QStringList getAvailablePorts();
     QString getDefaultPort();
     void setDefaultPort(const QString &portName);
+    static SerialConfig configForPort(const QString &portName);
+    static void setPortBackend(const QString &portName, SerialConfig::Backend backend);
+    static bool isNativeBackendAvailable();
+    // Unopened device for a port: RemoteSerialPort for tcp://host:port, else by backend
+    static QIODevice *createDevice(const QString &portName, const SerialConfig &config, QObject *parent = nullptr);
+    static QStringList remotePorts();
+    static void addRemotePort(const QString &portName);
     bool isPortOpen() const;
     QString getLastError() const { return m_lastError; }
     QString getCurrentPortName() const;
+    QString deviceIdentity() const;   // Stable across re-enumeration where the adapter has a serial number
     void enableKeepalive(bool enable);
     bool isKeepaliveEnabled() const;
     bool isPortAvailable(const QString &portName) const;
+    TxScheduler::Metrics txMetrics() const;
+    bool sendReliable(const QByteArray &frame, TxPriority priority = TxPriority::Operator, int window = 0);
+    void setReliableDelivery(bool enable);
+    bool isReliableDeliveryEnabled() const { return m_reliableDelivery; }
+    ReliableLink *reliableLink() const { return m_reliableLink; }
+    bool startCapture(const QString &fileName);
+    void stopCapture();
+    bool isCapturing() const { return m_capture.isOpen(); }
+
+public slots:
+    void reloadProfile();
 
 signals:
     void portStatusChanged(bool isOpen);
@@ -50,35 +83,52 @@ signals:
     void error(const QString &errorMessage);
     void keepaliveMessage(const QString &message);
     void normalMessage(const QString &message);
+    void frameReceived(const VmcFrame &frame);
+    void frameDelivered(const QByteArray &frame, qint64 rttMs);
+    void frameFailed(const QByteArray &frame);
+    void frameDispatched(const QByteArray &frame);   // Written to the device by the scheduler
 
 private slots:
     void handleReadyRead();
     void handleError(QSerialPort::SerialPortError error);
+    void handleDeviceClosed();
 
 private:
     QSerialPort *m_serialPort;
+    QIODevice *m_device;       // m_serialPort, or a device handed to openDevice()
+    QIODevice *m_ownedDevice;  // Native backend port, deleted on close
+    QString m_deviceName;
+    TxScheduler *m_txScheduler;
+    ReliableLink *m_reliableLink;
+    VmcFrameDecoder m_decoder;
+    CaptureWriter m_capture;
+    QMap<QString, RttEstimator> m_rttEstimators;  // Per-port RTT history
+    bool m_reliableDelivery;
     QString m_defaultPort;
     QString m_lastError;
-    QTimer m_watchdogTimer;
-    QTimer m_keepaliveTimer;
+    ClockTimer m_watchdogTimer;
+    ClockTimer m_keepaliveTimer;
     bool m_keepaliveEnabled;
+    bool m_isOpening;
+    bool m_linkUp;             // Counted in Metrics::portsOpen
+    bool m_connectionLost;     // Next open counts as a reconnect
+    bool m_keepalivePending;   // Last keepalive not yet answered
+    quint64 m_traceAwaitingRx; // Traced frame waiting for its first RX byte
     static const int COMMAND_TIMEOUT_MS = 100;     // Time to wait for command to be written
-    static const int RESPONSE_TIMEOUT_MS = 250;    // Time to wait for response
     static const int WATCHDOG_TIMEOUT_MS = 1000;   // Watchdog interval
     static const int KEEPALIVE_INTERVAL_MS = 5000;  // 5 seconds
-    QByteArray m_responseBuffer;
-    bool waitForResponse(int timeout = RESPONSE_TIMEOUT_MS);
+    QByteArray m_keepaliveRequest;    // From the active VmcProfile
+    QByteArray m_keepaliveResponse;
+    bool waitForResponse(int timeout = -1);  // -1 waits one RTO for this port
 
     void setupWatchdog();
     void logError(const QString &error);
     void setupKeepalive();
     void sendKeepalive();
+    void recordOpened();
+    void recordConnectionLost();
+    void recordReceived(const QByteArray &data);
 
-#ifdef QT_DEBUG
-    bool testResponseTimes();
-#endif
-
-    QByteArray m_lastCommand;  // Add this to track command type
     bool checkPortAccess(const QString &portName) const;
 };
 
@@ -4,6 +4,7 @@
 #include <QLabel>
 #include <QPushButton>
 #include <QMessageBox>
+#include "VmcProtocol.h"
 
 SetPriceDialog::SetPriceDialog(QWidget *parent)
     : QDialog(parent), m_price(0)
@@ -38,10 +39,12 @@ void SetPriceDialog::onOkClicked()
 {
     bool ok;
     int price = m_priceInput->text().toInt(&ok);
-    if (ok && price >= 0 && price <= 999) {
+    if (ok && price >= 0 && price <= VmcProtocol::MAX_PRICE) {
         m_price = price;
         accept();
     } else {
-        QMessageBox::warning(this, "Invalid Input", "Please enter a valid price between 0 and 999 cents.");
+        QMessageBox::warning(this, "Invalid Input",
+                             QString("Please enter a valid price between 0 and %1 cents.")
+                             .arg(VmcProtocol::MAX_PRICE));
     }
 }
\ No newline at end of file
@@ -0,0 +1,158 @@
+#include "SimulatedVmc.h"
+#include "VmcProfile.h"
+#include <cstring>
+
+SimulatedVmc::SimulatedVmc(VirtualClock *clock, const Config &config, QObject *parent)
+    : QIODevice(parent)
+    , m_clock(clock)
+    , m_config(config)
+    , m_random(config.seed)
+    , m_txLineFreeAtNs(0)
+    , m_rxLineFreeAtNs(0)
+    , m_transcript(nullptr)
+    , m_digest(QCryptographicHash::Sha256)
+    , m_framesReceived(0)
+    , m_keepalivesAnswered(0)
+    , m_faulted(false)
+    , m_faultsRaised(0)
+    , m_framesIgnored(0)
+    , m_lastKeyNs(-1)
+    , m_keysLost(0)
+{
+}
+
+qint64 SimulatedVmc::bytesAvailable() const
+{
+    return m_rxBuffer.size() + QIODevice::bytesAvailable();
+}
+
+QByteArray SimulatedVmc::transcriptDigest() const
+{
+    return m_digest.result();
+}
+
+qint64 SimulatedVmc::readData(char *data, qint64 maxSize)
+{
+    qint64 count = qMin<qint64>(maxSize, m_rxBuffer.size());
+    if (count > 0) {
+        std::memcpy(data, m_rxBuffer.constData(), static_cast<size_t>(count));
+        m_rxBuffer.remove(0, static_cast<int>(count));
+    }
+    return count;
+}
+
+qint64 SimulatedVmc::writeData(const char *data, qint64 size)
+{
+    QByteArray bytes(data, static_cast<int>(size));
+    record("TX", bytes);
+
+    // Bytes leave the host back to back at line rate
+    qint64 now = m_clock->nowNs();
+    qint64 start = qMax(now, m_txLineFreeAtNs);
+    m_txLineFreeAtNs = start + size * byteTimeNs();
+
+    m_clock->schedule(m_txLineFreeAtNs - now, [this, bytes]() {
+        emit bytesWritten(bytes.size());
+        receiveFromHost(bytes);
+    });
+    return size;
+}
+
+qint64 SimulatedVmc::byteTimeNs() const
+{
+    // 8N1: ten bit times per byte
+    return Q_INT64_C(10000000000) / m_config.baudRate;
+}
+
+void SimulatedVmc::receiveFromHost(const QByteArray &bytes)
+{
+    m_hostBuffer.append(bytes);
+    // Answers with the active profile's signatures, like the VMC model it stands in for
+    const std::shared_ptr<const VmcProfile> profile = VmcProfile::current();
+    const QByteArray &keepaliveRequest = profile->keepaliveRequest();
+
+    while (!m_hostBuffer.isEmpty()) {
+        if (m_hostBuffer.at(0) == VmcProtocol::SYNC) {
+            if (m_hostBuffer.size() < VmcProtocol::FRAME_SIZE) {
+                return;
+            }
+            QByteArray frame = m_hostBuffer.left(VmcProtocol::FRAME_SIZE);
+            m_hostBuffer.remove(0, VmcProtocol::FRAME_SIZE);
+            m_framesReceived++;
+            receiveFrame(frame);
+        } else if (m_hostBuffer.startsWith(keepaliveRequest)) {
+            m_hostBuffer.remove(0, keepaliveRequest.size());
+            m_keepalivesAnswered++;
+            respond(profile->keepaliveResponse());
+        } else if (m_hostBuffer.size() < keepaliveRequest.size()
+                   && keepaliveRequest.startsWith(m_hostBuffer)) {
+            return;
+        } else {
+            // Anything else is line noise to the VMC
+            m_hostBuffer.remove(0, 1);
+        }
+    }
+}
+
+void SimulatedVmc::receiveFrame(const QByteArray &frame)
+{
+    const quint8 command = static_cast<quint8>(frame.at(1));
+    if (command == VmcProtocol::ERROR_COMMAND) {
+        // The host clears an error by sending it back with the flags zeroed.
+        // The echo only acks the frame; a status report follows it.
+        if (static_cast<quint8>(frame.at(3)) == 0) {
+            m_faulted = false;
+        }
+        respond(frame);
+        respond(VmcProtocol::encodeFrame(VmcProtocol::ERROR_COMMAND, static_cast<quint8>(frame.at(2)),
+                                         m_faulted ? 0x01 : 0x00));
+        return;
+    }
+    if (m_faulted) {
+        m_framesIgnored++;
+        return;
+    }
+    if (m_config.faultEveryFrames > 0 && m_framesReceived % m_config.faultEveryFrames == 0) {
+        m_faulted = true;
+        m_faultsRaised++;
+        m_framesIgnored++;
+        respond(VmcProtocol::encodeFrame(VmcProtocol::ERROR_COMMAND, m_config.faultCode, 0x01));
+        return;
+    }
+    if (m_config.minKeyIntervalMs > 0
+        && VmcProfile::current()->commandClass(command) == VmcProfile::KeypadCommand) {
+        const qint64 now = m_clock->nowNs();
+        if (m_lastKeyNs >= 0 && now - m_lastKeyNs < m_config.minKeyIntervalMs * Q_INT64_C(1000000)) {
+            m_keysLost++;
+            return;
+        }
+        m_lastKeyNs = now;
+    }
+    // Keypad and price frames are acknowledged by echoing them
+    respond(frame);
+}
+
+void SimulatedVmc::respond(const QByteArray &response)
+{
+    // mt19937's output is fully specified, unlike the std distributions
+    quint32 span = static_cast<quint32>(qMax(0, m_config.maxResponseMs - m_config.minResponseMs)) + 1;
+    qint64 processingMs = m_config.minResponseMs + static_cast<qint64>(m_random() % span);
+    qint64 now = m_clock->nowNs();
+    qint64 start = qMax(now + processingMs * 1000000, m_rxLineFreeAtNs);
+    m_rxLineFreeAtNs = start + response.size() * byteTimeNs();
+
+    m_clock->schedule(m_rxLineFreeAtNs - now, [this, response]() {
+        record("RX", response);
+        m_rxBuffer.append(response);
+        emit readyRead();
+    });
+}
+
+void SimulatedVmc::record(const char *direction, const QByteArray &bytes)
+{
+    QByteArray line = QByteArray::number(m_clock->nowNs()) + ' ' + direction + ' ' + bytes.toHex() + '\n';
+    m_digest.addData(line);
+    if (m_transcript) {
+        *m_transcript << line;
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef SIMULATEDVMC_H
+#define SIMULATEDVMC_H
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QIODevice>
+#include <QTextStream>
+#include <random>
+#include "VirtualClock.h"
+#include "VmcProtocol.h"
+
+// In-process VMC model exposed as a serial device. Bytes are paced at the
+// configured line rate and answered after a seeded processing delay, all on
+// a VirtualClock, so identical inputs always give identical transcripts.
+class SimulatedVmc : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    struct Config {
+        int baudRate = 9600;
+        int minResponseMs = 3;
+        int maxResponseMs = 8;
+        quint32 seed = 1;
+        // Every Nth frame raises error faultCode instead of being echoed; the
+        // VMC then ignores frames until the error is cleared. 0 never faults.
+        int faultEveryFrames = 0;
+        quint8 faultCode = 1;
+        // Keypad frames arriving sooner than this after the last registered
+        // key are lost without an echo, as on a keypad still debouncing. 0 never.
+        int minKeyIntervalMs = 0;
+    };
+
+    SimulatedVmc(VirtualClock *clock, const Config &config, QObject *parent = nullptr);
+
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override;
+
+    void setTranscript(QTextStream *transcript) { m_transcript = transcript; }
+    QByteArray transcriptDigest() const;
+
+    quint64 framesReceived() const { return m_framesReceived; }
+    quint64 keepalivesAnswered() const { return m_keepalivesAnswered; }
+    quint64 faultsRaised() const { return m_faultsRaised; }
+    quint64 framesIgnored() const { return m_framesIgnored; }
+    quint64 keysLost() const { return m_keysLost; }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 size) override;
+
+private:
+    VirtualClock *m_clock;
+    Config m_config;
+    std::mt19937 m_random;
+    QByteArray m_hostBuffer;   // Host -> VMC bytes not yet parsed
+    QByteArray m_rxBuffer;     // VMC -> host, waiting to be read
+    qint64 m_txLineFreeAtNs;   // When each direction of the line is idle again
+    qint64 m_rxLineFreeAtNs;
+    QTextStream *m_transcript;
+    QCryptographicHash m_digest;
+    quint64 m_framesReceived;
+    quint64 m_keepalivesAnswered;
+    bool m_faulted;
+    quint64 m_faultsRaised;
+    quint64 m_framesIgnored;
+    qint64 m_lastKeyNs;        // When the last keypad frame was registered, -1 if none
+    quint64 m_keysLost;
+
+    qint64 byteTimeNs() const;
+    void receiveFromHost(const QByteArray &bytes);
+    void receiveFrame(const QByteArray &frame);
+    void respond(const QByteArray &response);
+    void record(const char *direction, const QByteArray &bytes);
+};
+
+#endif // SIMULATEDVMC_H
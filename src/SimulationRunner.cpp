@@ -0,0 +1,145 @@
+#include "SimulationRunner.h"
+#include "AutoKeypress.h"
+#include "FaultInjectingDevice.h"
+#include "KeypressCommands.h"
+#include "LatencyHistogram.h"
+#include "SerialCommunication.h"
+#include "SimulatedVmc.h"
+#include "VirtualClock.h"
+#include "VmcRecovery.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QLoggingCategory>
+#include <QTextStream>
+
+int SimulationRunner::run(const Options &options)
+{
+    QTextStream out(stdout);
+    if (options.keys.isEmpty()) {
+        out << "Simulation: empty script" << Qt::endl;
+        return 2;
+    }
+
+    // Per-key debug logging would dominate the run time
+    QLoggingCategory::setFilterRules("default.debug=false");
+
+    VirtualClock clock;
+    VirtualClock::setActive(&clock);
+    QElapsedTimer wallTimer;
+    wallTimer.start();
+
+    SimulatedVmc::Config vmcConfig;
+    vmcConfig.seed = options.seed;
+    vmcConfig.faultEveryFrames = options.faultEveryFrames;
+    SimulatedVmc vmc(&clock, vmcConfig);
+    vmc.open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+    FaultInjectingDevice faultyLine(&vmc, options.faults);
+    QIODevice *device = &vmc;
+    if (options.faults.isEnabled()) {
+        faultyLine.open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+        device = &faultyLine;
+    }
+
+    QFile transcriptFile(options.transcriptPath);
+    QTextStream transcript;
+    if (!options.transcriptPath.isEmpty()) {
+        if (!transcriptFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            out << "Simulation: cannot write " << options.transcriptPath << Qt::endl;
+            VirtualClock::setActive(nullptr);
+            return 2;
+        }
+        transcript.setDevice(&transcriptFile);
+        vmc.setTranscript(&transcript);
+    }
+
+    SerialCommunication serial;
+    KeypressCommands keypress(&serial);
+    AutoKeypress autoKeypress(&keypress);
+    VmcRecovery recovery(&serial);
+    recovery.setAutomation(&autoKeypress);
+    recovery.setEnabled(options.autoRecover);
+    serial.setReliableDelivery(true);
+    serial.enableKeepalive(options.keepalive);
+    if (!options.capturePath.isEmpty() && !serial.startCapture(options.capturePath)) {
+        out << "Simulation: cannot write " << options.capturePath << Qt::endl;
+        VirtualClock::setActive(nullptr);
+        return 2;
+    }
+    serial.openDevice(device, "SIM");
+
+    const qint64 endNs = static_cast<qint64>(options.durationHours * 3600.0 * 1e9);
+    quint64 keysSent = 0;
+    quint64 acked = 0;
+    quint64 failed = 0;
+    quint64 iterations = 0;
+    LatencyHistogram latency;
+    LatencyHistogram recoveryLatency;
+
+    QObject::connect(&autoKeypress, &AutoKeypress::keyPressed, [&]() { keysSent++; });
+    QObject::connect(&serial, &SerialCommunication::frameDelivered, [&](const QByteArray &, qint64 rttMs) {
+        acked++;
+        latency.record(rttMs);
+    });
+    QObject::connect(&serial, &SerialCommunication::frameFailed, [&]() { failed++; });
+    QObject::connect(&recovery, &VmcRecovery::recovered, [&](qint64 recoverMs) {
+        recoveryLatency.record(recoverMs);
+    });
+    // An injected disconnect drops the link; plug it back in as an operator would
+    quint64 reconnects = 0;
+    ClockTimer reconnectTimer;
+    reconnectTimer.setSingleShot(true);
+    reconnectTimer.setInterval(FaultInjectingDevice::RECONNECT_MS);
+    QObject::connect(&serial, &SerialCommunication::portStatusChanged, [&](bool isOpen) {
+        if (!isOpen) {
+            reconnectTimer.start();
+        }
+    });
+    QObject::connect(&reconnectTimer, &ClockTimer::timeout, [&]() {
+        if (serial.openDevice(device, "SIM")) {
+            reconnects++;
+        } else {
+            reconnectTimer.start();
+        }
+    });
+    QObject::connect(&autoKeypress, &AutoKeypress::sequenceCompleted, [&]() {
+        iterations++;
+        if (clock.nowNs() < endNs) {
+            autoKeypress.startSequence();
+        }
+    });
+
+    autoKeypress.setSequence(options.keys);
+    autoKeypress.setInterval(options.intervalMs);
+    autoKeypress.startSequence();
+    clock.runUntil(endNs);
+
+    quint64 retransmissions = serial.reliableLink()->retransmissions();
+    autoKeypress.stopSequence();
+    reconnectTimer.stop();
+    serial.disconnect();
+    serial.closePort();
+    serial.stopCapture();
+    transcript.flush();
+    VirtualClock::setActive(nullptr);
+
+    out << QString("Simulated %1 h in %2 ms wall time (%3 events)")
+           .arg(options.durationHours).arg(wallTimer.elapsed()).arg(clock.eventsRun()) << Qt::endl;
+    out << QString("Iterations %1, keys %2, acked %3, failed %4, retransmissions %5, keepalives %6")
+           .arg(iterations).arg(keysSent).arg(acked).arg(failed)
+           .arg(retransmissions).arg(vmc.keepalivesAnswered()) << Qt::endl;
+    out << QString("Ack latency p50 <%1 ms, p99 <%2 ms")
+           .arg(latency.percentile(0.50)).arg(latency.percentile(0.99)) << Qt::endl;
+    if (options.faultEveryFrames > 0) {
+        out << QString("VMC faults %1, recovered %2, recovery failures %3, frames ignored %4, recovery p50 <%5 ms, p99 <%6 ms")
+               .arg(vmc.faultsRaised()).arg(recovery.recoveries()).arg(recovery.failures())
+               .arg(vmc.framesIgnored())
+               .arg(recoveryLatency.percentile(0.50)).arg(recoveryLatency.percentile(0.99)) << Qt::endl;
+    }
+    if (options.faults.isEnabled()) {
+        out << faultyLine.format() << Qt::endl;
+        out << QString("Reconnects %1").arg(reconnects) << Qt::endl;
+    }
+    out << "Transcript SHA-256: " << vmc.transcriptDigest().toHex() << Qt::endl;
+
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,29 @@
+#ifndef SIMULATIONRUNNER_H
+#define SIMULATIONRUNNER_H
+
+#include <QString>
+#include <QVector>
+#include "FaultInjectingDevice.h"
+
+// Runs an automation script against SimulatedVmc on a VirtualClock: hours of
+// keypress and keepalive traffic complete in well under a second of wall time.
+class SimulationRunner
+{
+public:
+    struct Options {
+        QVector<QString> keys;
+        double durationHours = 1.0;
+        int intervalMs = 1000;
+        bool keepalive = true;
+        quint32 seed = 1;
+        int faultEveryFrames = 0;   // See SimulatedVmc::Config
+        bool autoRecover = false;
+        FaultInjectingDevice::Config faults;   // Between the link and the simulated VMC when enabled
+        QString transcriptPath;
+        QString capturePath;
+    };
+
+    static int run(const Options &options);
+};
+
+#endif // SIMULATIONRUNNER_H
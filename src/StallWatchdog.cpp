@@ -0,0 +1,319 @@
+#include "StallWatchdog.h"
+#include "Metrics.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QObject>
+#include <QThread>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef Q_OS_LINUX
+#include <cxxabi.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#include <cstdlib>
+#endif
+
+std::atomic<bool> StallWatchdog::s_running{false};
+
+namespace {
+
+qint64 nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Watched {
+    QString name;
+    QThread *thread = nullptr;
+    QObject *heartbeat = nullptr;              // Lives in the watched thread
+#ifdef Q_OS_LINUX
+    pthread_t nativeThread;
+#endif
+    qint64 pingSentNs = 0;                     // 0 when no heartbeat is outstanding
+    QDateTime pingSentAt;
+    bool stackCaptured = false;
+    QStringList stack;
+};
+
+// Guards the watch list and every Watched's fields
+std::mutex watchMutex;
+std::vector<std::shared_ptr<Watched>> watchList;
+
+std::mutex stallMutex;
+QList<StallWatchdog::Stall> stallHistory;
+
+std::atomic<int> thresholdMs{StallWatchdog::DEFAULT_THRESHOLD_MS};
+std::thread sideThread;
+std::mutex wakeMutex;
+std::condition_variable wake;
+bool stopRequested = false;
+
+#ifdef Q_OS_LINUX
+// Stack capture: the side thread signals the blocked thread, whose handler
+// records its own return addresses. One capture at a time.
+const int STACK_SIGNAL_OFFSET = 5;             // SIGRTMIN + 5
+const int MAX_FRAMES = 48;
+const int CAPTURE_WAIT_MS = 100;
+void *capturedFrames[MAX_FRAMES];
+std::atomic<int> capturedDepth{0};
+std::atomic<bool> captureDone{false};
+
+void stackSignalHandler(int)
+{
+    capturedDepth.store(backtrace(capturedFrames, MAX_FRAMES), std::memory_order_relaxed);
+    captureDone.store(true, std::memory_order_release);
+}
+
+void installStackHandler()
+{
+    static bool installed = false;
+    if (installed) {
+        return;
+    }
+    // backtrace() loads libgcc on first use, which is not safe inside a handler
+    void *warmup[1];
+    backtrace(warmup, 1);
+
+    struct sigaction action = {};
+    action.sa_handler = stackSignalHandler;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGRTMIN + STACK_SIGNAL_OFFSET, &action, nullptr);
+    installed = true;
+}
+
+QString demangle(const char *symbol)
+{
+    // "binary(_ZN3Foo3barEv+0x1c) [0x...]"
+    const QByteArray line(symbol);
+    const int open = line.indexOf('(');
+    const int plus = line.indexOf('+', open);
+    if (open < 0 || plus < 0 || plus == open + 1) {
+        return QString::fromLocal8Bit(line);
+    }
+    const QByteArray mangled = line.mid(open + 1, plus - open - 1);
+    int status = 0;
+    char *name = abi::__cxa_demangle(mangled.constData(), nullptr, nullptr, &status);
+    if (status != 0 || !name) {
+        return QString::fromLocal8Bit(line);
+    }
+    const QString result = QString::fromLocal8Bit(line.left(open + 1)) + QString::fromLocal8Bit(name)
+                         + QString::fromLocal8Bit(line.mid(plus));
+    std::free(name);
+    return result;
+}
+
+QStringList captureStack(pthread_t thread)
+{
+    captureDone.store(false, std::memory_order_relaxed);
+    if (pthread_kill(thread, SIGRTMIN + STACK_SIGNAL_OFFSET) != 0) {
+        return {"(thread could not be signalled)"};
+    }
+    const qint64 deadline = nowNs() + qint64(CAPTURE_WAIT_MS) * 1000000;
+    while (!captureDone.load(std::memory_order_acquire)) {
+        if (nowNs() > deadline) {
+            return {"(thread did not answer the stack capture signal)"};
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    const int depth = capturedDepth.load(std::memory_order_relaxed);
+    QStringList stack;
+    char **symbols = backtrace_symbols(capturedFrames, depth);
+    // Frame 0 is the handler and frame 1 the signal trampoline
+    for (int i = 2; i < depth; ++i) {
+        stack.append(symbols ? demangle(symbols[i]) : QString("0x%1").arg(quintptr(capturedFrames[i]), 0, 16));
+    }
+    std::free(symbols);
+    return stack;
+}
+#endif
+
+void recordStall(const std::shared_ptr<Watched> &watched, qint64 latencyNs)
+{
+    StallWatchdog::Stall stall;
+    {
+        std::lock_guard<std::mutex> lock(watchMutex);
+        stall.thread = watched->name;
+        stall.startedAt = watched->pingSentAt;
+        stall.stack = watched->stack;
+    }
+    stall.durationMs = latencyNs / 1000000;
+    Metrics::instance().eventLoopStalls.add();
+
+    QString message = QString("Stall: %1 event loop blocked for %2 ms").arg(stall.thread).arg(stall.durationMs);
+    if (stall.stack.isEmpty()) {
+        message += " (ended before its stack was captured)";
+    }
+    for (int i = 0; i < stall.stack.size(); ++i) {
+        message += QString("\n  #%1 %2").arg(i).arg(stall.stack.at(i));
+    }
+    qWarning().noquote() << message;
+
+    std::lock_guard<std::mutex> lock(stallMutex);
+    stallHistory.append(stall);
+    while (stallHistory.size() > StallWatchdog::MAX_STALLS) {
+        stallHistory.removeFirst();
+    }
+}
+
+// Runs on the watched thread when its loop gets to the heartbeat
+void heartbeatArrived(const std::shared_ptr<Watched> &watched)
+{
+    qint64 sentNs;
+    {
+        std::lock_guard<std::mutex> lock(watchMutex);
+        sentNs = watched->pingSentNs;
+    }
+    const qint64 latencyNs = nowNs() - sentNs;
+    Metrics::instance().eventLoopLatencyMs.record(latencyNs / 1000000);
+    if (latencyNs / 1000000 >= thresholdMs.load(std::memory_order_relaxed)) {
+        recordStall(watched, latencyNs);
+    }
+
+    std::lock_guard<std::mutex> lock(watchMutex);
+    watched->pingSentNs = 0;
+    watched->stackCaptured = false;
+    watched->stack.clear();
+}
+
+void sideLoop()
+{
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            if (wake.wait_for(lock, std::chrono::milliseconds(StallWatchdog::HEARTBEAT_INTERVAL_MS),
+                              [] { return stopRequested; })) {
+                return;
+            }
+        }
+
+        const qint64 now = nowNs();
+        const qint64 limitNs = qint64(thresholdMs.load(std::memory_order_relaxed)) * 1000000;
+        // Posting and capturing under the lock: unwatch cannot delete a
+        // heartbeat, or let its thread finish, in the middle of either
+        std::lock_guard<std::mutex> lock(watchMutex);
+        for (const std::shared_ptr<Watched> &watched : watchList) {
+            if (watched->pingSentNs == 0) {
+                watched->pingSentNs = now;
+                watched->pingSentAt = QDateTime::currentDateTime();
+                std::shared_ptr<Watched> target = watched;
+                QMetaObject::invokeMethod(watched->heartbeat, [target]() { heartbeatArrived(target); },
+                                          Qt::QueuedConnection);
+            } else if (!watched->stackCaptured && now - watched->pingSentNs > limitNs) {
+                watched->stackCaptured = true;
+#ifdef Q_OS_LINUX
+                watched->stack = captureStack(watched->nativeThread);
+#else
+                watched->stack = QStringList{"(stack capture is only available on Linux)"};
+#endif
+                // A loop that never comes back would otherwise go unreported
+                qWarning().noquote() << QString("Stall: %1 event loop blocked for over %2 ms so far")
+                                            .arg(watched->name).arg((now - watched->pingSentNs) / 1000000);
+            }
+        }
+    }
+}
+
+}
+
+bool StallWatchdog::start(int threshold)
+{
+    if (isRunning()) {
+        return false;
+    }
+    thresholdMs.store(qMax(HEARTBEAT_INTERVAL_MS, threshold), std::memory_order_relaxed);
+#ifdef Q_OS_LINUX
+    installStackHandler();
+#endif
+
+    // A joinable std::thread left at exit would terminate the process
+    static bool postRoutineAdded = false;
+    if (!postRoutineAdded && QCoreApplication::instance()) {
+        qAddPostRoutine(StallWatchdog::stop);
+        postRoutineAdded = true;
+    }
+
+    stopRequested = false;
+    sideThread = std::thread(sideLoop);
+    s_running.store(true, std::memory_order_release);
+    return true;
+}
+
+void StallWatchdog::stop()
+{
+    if (!s_running.exchange(false)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopRequested = true;
+    }
+    wake.notify_one();
+    sideThread.join();
+}
+
+int StallWatchdog::threshold()
+{
+    return thresholdMs.load(std::memory_order_relaxed);
+}
+
+void StallWatchdog::watchCurrentThread(const QString &name)
+{
+    std::shared_ptr<Watched> watched = std::make_shared<Watched>();
+    watched->name = name;
+    watched->thread = QThread::currentThread();
+    watched->heartbeat = new QObject;
+#ifdef Q_OS_LINUX
+    watched->nativeThread = pthread_self();
+#endif
+
+    std::lock_guard<std::mutex> lock(watchMutex);
+    watchList.push_back(watched);
+}
+
+void StallWatchdog::unwatchCurrentThread()
+{
+    QThread *thread = QThread::currentThread();
+    QObject *heartbeat = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(watchMutex);
+        for (auto it = watchList.begin(); it != watchList.end(); ++it) {
+            if ((*it)->thread == thread) {
+                heartbeat = (*it)->heartbeat;
+                watchList.erase(it);
+                break;
+            }
+        }
+    }
+    // Deleting it on its own thread drops a heartbeat still in the queue
+    delete heartbeat;
+}
+
+QList<StallWatchdog::Stall> StallWatchdog::stalls()
+{
+    std::lock_guard<std::mutex> lock(stallMutex);
+    return stallHistory;
+}
+
+QStringList StallWatchdog::report()
+{
+    QStringList lines;
+    const QList<Stall> history = stalls();
+    lines << QString("%1 event loop stalls over %2 ms recorded").arg(history.size()).arg(threshold());
+    for (const Stall &stall : history) {
+        lines << QString("%1  %2  %3 ms").arg(stall.startedAt.toString("yyyy-MM-dd HH:mm:ss.zzz"),
+                                              stall.thread).arg(stall.durationMs);
+        for (int i = 0; i < stall.stack.size(); ++i) {
+            lines << QString("    #%1 %2").arg(i).arg(stall.stack.at(i));
+        }
+    }
+    return lines;
+}
@@ -0,0 +1,46 @@
+#ifndef STALLWATCHDOG_H
+#define STALLWATCHDOG_H
+
+#include <QDateTime>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <atomic>
+
+// Watches event loops for stalls from a side thread. Every watched loop is
+// sent a heartbeat; the time until the loop runs it is its heartbeat latency.
+// A heartbeat still waiting past the threshold means the loop is blocked:
+// the blocked thread's stack is captured (Linux), and once the loop runs
+// again the stall is recorded with its duration, logged and counted.
+class StallWatchdog
+{
+public:
+    static const int HEARTBEAT_INTERVAL_MS = 50;
+    static const int DEFAULT_THRESHOLD_MS = 200;
+    static const int MAX_STALLS = 32;          // Kept for the report, newest last
+
+    struct Stall {
+        QString thread;
+        QDateTime startedAt;
+        qint64 durationMs = 0;
+        QStringList stack;                     // Innermost frame first; empty if not captured
+    };
+
+    static bool start(int thresholdMs = DEFAULT_THRESHOLD_MS);
+    static void stop();
+    static bool isRunning() { return s_running.load(std::memory_order_relaxed); }
+    static int threshold();
+
+    // Called on the thread whose event loop is watched, before it runs the
+    // loop and after it has left it
+    static void watchCurrentThread(const QString &name);
+    static void unwatchCurrentThread();
+
+    static QList<Stall> stalls();
+    static QStringList report();
+
+private:
+    static std::atomic<bool> s_running;
+};
+
+#endif // STALLWATCHDOG_H
@@ -0,0 +1,412 @@
+#include "SyncInjector.h"
+#include "KeypressCommands.h"
+#include "SerialCommunication.h"
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QFile>
+#include <QLoggingCategory>
+#include <QSerialPort>
+#include <QTextStream>
+#include <QThread>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#ifdef Q_OS_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+qint64 steadyNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool pinCurrentThread(int cpu)
+{
+#ifdef Q_OS_LINUX
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    Q_UNUSED(cpu);
+    return false;
+#endif
+}
+
+// Barrier state shared by the coordinator and every worker. A release time
+// of 0 means the barrier is still closed for the current generation. The
+// counters carry their generation in the high half, so a worker still busy
+// with an earlier event can never count towards the current one.
+struct Barrier {
+    std::atomic<int> generation{0};
+    std::atomic<qint64> arrived{0};
+    std::atomic<qint64> done{0};
+    std::atomic<qint64> releaseAtNs{0};
+
+    static qint64 start(int generation) { return static_cast<qint64>(generation) << 32; }
+
+    // False if the counter has moved on to another generation
+    static bool countIn(std::atomic<qint64> &counter, int generation)
+    {
+        qint64 value = counter.load();
+        do {
+            if ((value >> 32) != generation) {
+                return false;
+            }
+        } while (!counter.compare_exchange_weak(value, value + 1));
+        return true;
+    }
+
+    static int count(const std::atomic<qint64> &counter) { return static_cast<int>(counter.load() & 0xffffffff); }
+};
+
+class Worker
+{
+public:
+    Worker(const QString &port, int cpu, Barrier *barrier)
+        : m_port(port), m_cpu(cpu), m_barrier(barrier)
+    {
+    }
+
+    ~Worker()
+    {
+        stop();
+    }
+
+    // Opens the port on a new thread; false if it could not be opened
+    bool start(bool pin, QString *errorMessage)
+    {
+        m_thread.reset(QThread::create([this, pin]() { threadMain(pin); }));
+        m_thread->setObjectName(QString("sync %1").arg(m_port));
+        m_thread->start();
+        while (m_state.load() == Starting) {
+            QThread::usleep(100);
+        }
+        if (m_state.load() != Ready) {
+            *errorMessage = QString("Sync: cannot open %1: %2").arg(m_port, m_openError);
+            m_thread->wait();
+            return false;
+        }
+        return true;
+    }
+
+    void stop()
+    {
+        if (m_thread && m_state.load() == Ready) {
+            QEventLoop *loop = m_loop;
+            QMetaObject::invokeMethod(m_serial, [loop]() { loop->quit(); }, Qt::QueuedConnection);
+        }
+        if (m_thread) {
+            m_thread->wait();
+            m_thread.reset();
+        }
+    }
+
+    // Runs on the worker's thread once the coordinator has opened a new generation
+    void stage(int generation, const QString &key)
+    {
+        QMetaObject::invokeMethod(m_serial, [this, generation, key]() {
+            m_sentNs.store(fire(generation, key));
+            m_sentGeneration.store(generation);
+            Barrier::countIn(m_barrier->done, generation);
+        }, Qt::QueuedConnection);
+    }
+
+    QString port() const { return m_port; }
+    bool isPinned() const { return m_pinned; }
+    int cpu() const { return m_cpu; }
+    // When this port's key for the event was written, -1 if it missed the event
+    qint64 sentNs(int generation) const
+    {
+        return m_sentGeneration.load() == generation ? m_sentNs.load() : -1;
+    }
+    quint64 acked() const { return m_acked.load(); }
+    quint64 failed() const { return m_failed.load(); }
+
+private:
+    enum State {
+        Starting,
+        Ready,
+        Failed
+    };
+
+    QString m_port;
+    int m_cpu;
+    Barrier *m_barrier;
+    std::unique_ptr<QThread> m_thread;
+    std::atomic<int> m_state{Starting};
+    QString m_openError;
+    bool m_pinned = false;
+    SerialCommunication *m_serial = nullptr;   // Lives on the worker's thread
+    KeypressCommands *m_keypress = nullptr;
+    QEventLoop *m_loop = nullptr;
+    std::atomic<qint64> m_sentNs{-1};
+    std::atomic<int> m_sentGeneration{0};
+    QByteArray m_armedFrame;                   // Key frame whose dispatch time is wanted
+    qint64 m_dispatchedNs = -1;
+    std::atomic<quint64> m_acked{0};
+    std::atomic<quint64> m_failed{0};
+
+    void threadMain(bool pin)
+    {
+        m_pinned = pin && pinCurrentThread(m_cpu);
+
+        SerialCommunication serial;
+        KeypressCommands keypress(&serial);
+        QEventLoop loop;
+        serial.setReliableDelivery(true);
+        // A keepalive in flight at the release would hold the key back
+        serial.enableKeepalive(false);
+        QObject::connect(&serial, &SerialCommunication::frameDelivered, [this]() { m_acked.fetch_add(1); });
+        QObject::connect(&serial, &SerialCommunication::frameFailed, [this]() { m_failed.fetch_add(1); });
+        QObject::connect(&serial, &SerialCommunication::frameDispatched, [this](const QByteArray &frame) {
+            if (m_dispatchedNs < 0 && frame == m_armedFrame) {
+                m_dispatchedNs = steadyNs();
+            }
+        });
+
+        if (!serial.openPort(m_port, SerialCommunication::configForPort(m_port))) {
+            m_openError = serial.getLastError();
+            m_state.store(Failed);
+            return;
+        }
+        m_serial = &serial;
+        m_keypress = &keypress;
+        m_loop = &loop;
+        m_state.store(Ready);
+        loop.exec();
+
+        serial.disconnect();
+        serial.closePort();
+    }
+
+    // Stages the key, waits at the barrier and sends at the release time.
+    // Returns when the scheduler wrote the frame, or -1 if the event was missed.
+    qint64 fire(int generation, const QString &key)
+    {
+        const qint64 deadline = steadyNs() + static_cast<qint64>(SyncInjector::STAGE_TIMEOUT_MS) * 1000000;
+
+        // Let earlier traffic leave and be acked: with the link's window full,
+        // sendKey() would only queue the key instead of writing it
+        auto isBusy = [this]() {
+            return m_serial->txMetrics().inFlightBytes > 0 || m_serial->reliableLink()->pendingCount() > 0;
+        };
+        while (isBusy() && steadyNs() < deadline) {
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 1);
+        }
+        if (isBusy() || !Barrier::countIn(m_barrier->arrived, generation)) {
+            return -1;
+        }
+        qint64 releaseAtNs = 0;
+        while ((releaseAtNs = m_barrier->releaseAtNs.load()) == 0) {
+            if (m_barrier->generation.load() != generation || steadyNs() >= deadline) {
+                return -1;
+            }
+            std::this_thread::yield();
+        }
+        if (m_barrier->generation.load() != generation) {
+            return -1;
+        }
+        // Spin, not sleep: a sleeping thread wakes up tens of microseconds late
+        while (steadyNs() < releaseAtNs) {
+        }
+
+        // The scheduler writes on enqueue, so the frame is dispatched inside sendKey() or not at all
+        m_armedFrame = KeypressCommands::keyFrame(key);
+        m_dispatchedNs = -1;
+        const bool sent = m_keypress->sendKey(key, TxPriority::Operator);
+        const qint64 dispatchedNs = m_dispatchedNs;
+        m_armedFrame.clear();
+        if (!sent || dispatchedNs < 0) {
+            return -1;
+        }
+        // QSerialPort otherwise writes from its notifier on the next loop pass
+        if (QSerialPort *serialPort = qobject_cast<QSerialPort *>(m_serial->device())) {
+            serialPort->flush();
+        }
+        return dispatchedNs;
+    }
+};
+
+QString formatUs(qint64 ns)
+{
+    return QString("%1 us").arg(ns / 1000.0, 0, 'f', 0);
+}
+
+}
+
+bool SyncInjector::parsePorts(const QString &list, QStringList *ports)
+{
+    ports->clear();
+    for (const QString &item : list.split(',', Qt::SkipEmptyParts)) {
+        const QString port = item.trimmed();
+        if (port.isEmpty() || ports->contains(port)) {
+            return false;
+        }
+        ports->append(port);
+    }
+    return ports->size() >= 2;
+}
+
+QString SyncInjector::formatCsv(const QStringList &ports, const QVector<Event> &events)
+{
+    QString text;
+    QTextStream out(&text);
+    out << "event,key,skew_us";
+    for (const QString &port : ports) {
+        out << ",offset_us " << port;
+    }
+    out << "\n";
+    for (const Event &event : events) {
+        out << event.index << "," << event.key << ","
+            << (event.skewNs >= 0 ? QString::number(event.skewNs / 1000.0, 'f', 1) : QString());
+        for (qint64 offset : event.offsetNs) {
+            out << "," << (offset >= 0 ? QString::number(offset / 1000.0, 'f', 1) : QString());
+        }
+        out << "\n";
+    }
+    return text;
+}
+
+int SyncInjector::run(const Options &options)
+{
+    QTextStream out(stdout);
+    if (options.ports.size() < 2 || options.keys.isEmpty()) {
+        out << "Sync: needs at least two ports and one key" << Qt::endl;
+        return 2;
+    }
+
+    // Per-key debug logging from every worker would dominate the timing
+    QLoggingCategory::setFilterRules("default.debug=false");
+
+    // Core 0 is left to the coordinator and interrupts where there are enough cores
+    const int cores = qMax(1, QThread::idealThreadCount());
+    Barrier barrier;
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (int i = 0; i < options.ports.size(); ++i) {
+        const int cpu = cores > options.ports.size() ? i + 1 : i % cores;
+        workers.emplace_back(new Worker(options.ports.at(i), cpu, &barrier));
+        QString errorMessage;
+        if (!workers.back()->start(options.pinThreads, &errorMessage)) {
+            out << errorMessage << Qt::endl;
+            return 2;
+        }
+    }
+    for (const std::unique_ptr<Worker> &worker : workers) {
+        out << QString("Sync: %1 on %2").arg(worker->port())
+               .arg(worker->isPinned() ? QString("cpu %1").arg(worker->cpu()) : QString("an unpinned thread"))
+            << Qt::endl;
+    }
+
+    const int portCount = static_cast<int>(workers.size());
+    QVector<Event> events;
+    for (int i = 0; i < options.events; ++i) {
+        Event event;
+        event.index = i;
+        event.key = options.keys.at(i % options.keys.size());
+
+        const int generation = barrier.generation.load() + 1;
+        barrier.releaseAtNs.store(0);
+        barrier.arrived.store(Barrier::start(generation));
+        barrier.done.store(Barrier::start(generation));
+        barrier.generation.store(generation);
+        for (const std::unique_ptr<Worker> &worker : workers) {
+            worker->stage(generation, event.key);
+        }
+
+        // Release only when every worker is staged; a straggler past the
+        // timeout misses the event instead of holding back the others
+        const qint64 stageDeadline = steadyNs() + static_cast<qint64>(STAGE_TIMEOUT_MS) * 1000000;
+        while (Barrier::count(barrier.arrived) < portCount && steadyNs() < stageDeadline) {
+            std::this_thread::yield();
+        }
+        const qint64 releaseAtNs = steadyNs() + static_cast<qint64>(RELEASE_LEAD_US) * 1000;
+        barrier.releaseAtNs.store(releaseAtNs);
+        while (Barrier::count(barrier.done) < portCount && steadyNs() < stageDeadline + 1000000000LL) {
+            QThread::usleep(50);
+        }
+
+        // Each port's offset stands on its own; the skew needs every port
+        qint64 earliest = -1;
+        qint64 latest = -1;
+        bool complete = true;
+        for (const std::unique_ptr<Worker> &worker : workers) {
+            const qint64 sentNs = worker->sentNs(generation);
+            event.offsetNs.append(sentNs >= 0 ? sentNs - releaseAtNs : -1);
+            if (sentNs < 0) {
+                complete = false;
+                continue;
+            }
+            earliest = earliest < 0 ? sentNs : qMin(earliest, sentNs);
+            latest = qMax(latest, sentNs);
+        }
+        event.skewNs = complete ? latest - earliest : -1;
+        events.append(event);
+
+        QThread::msleep(static_cast<unsigned long>(qMax(0, options.intervalMs)));
+    }
+
+    QThread::msleep(DRAIN_MS);
+    for (const std::unique_ptr<Worker> &worker : workers) {
+        worker->stop();
+    }
+
+    QVector<qint64> skews;
+    for (const Event &event : events) {
+        if (event.skewNs >= 0) {
+            skews.append(event.skewNs);
+        }
+    }
+    std::sort(skews.begin(), skews.end());
+    const int withinTarget = static_cast<int>(std::count_if(skews.begin(), skews.end(), [](qint64 skew) {
+        return skew < static_cast<qint64>(TARGET_SKEW_US) * 1000;
+    }));
+
+    out << QString("Sync: %1 ports, %2 events, %3 released on every port")
+           .arg(portCount).arg(events.size()).arg(skews.size()) << Qt::endl;
+    if (!skews.isEmpty()) {
+        auto at = [&](double fraction) {
+            return skews.at(qMin(static_cast<int>(skews.size()) - 1, static_cast<int>(fraction * skews.size())));
+        };
+        out << QString("Skew p50 %1, p99 %2, max %3; %4 of %5 under %6")
+               .arg(formatUs(at(0.50)), formatUs(at(0.99)), formatUs(skews.last()))
+               .arg(withinTarget).arg(skews.size()).arg(formatUs(static_cast<qint64>(TARGET_SKEW_US) * 1000))
+            << Qt::endl;
+    }
+    quint64 failed = 0;
+    for (int i = 0; i < portCount; ++i) {
+        qint64 offsetSum = 0;
+        int offsets = 0;
+        for (const Event &event : events) {
+            if (event.offsetNs.at(i) >= 0) {
+                offsetSum += event.offsetNs.at(i);
+                offsets++;
+            }
+        }
+        const Worker &worker = *workers.at(i);
+        failed += worker.failed();
+        out << QString("  %1: mean offset from release %2, %3 missed, %4 acked, %5 failed")
+               .arg(worker.port(), -16)
+               .arg(formatUs(offsets > 0 ? offsetSum / offsets : 0))
+               .arg(events.size() - offsets).arg(worker.acked()).arg(worker.failed()) << Qt::endl;
+    }
+
+    if (!options.csvPath.isEmpty()) {
+        QFile csvFile(options.csvPath);
+        if (csvFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+            csvFile.write(formatCsv(options.ports, events).toUtf8());
+        } else {
+            out << "Sync: cannot write " << options.csvPath << Qt::endl;
+        }
+    }
+
+    const bool passed = skews.size() == events.size() && withinTarget == skews.size() && failed == 0;
+    return passed ? 0 : 1;
+}
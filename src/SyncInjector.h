@@ -0,0 +1,50 @@
+#ifndef SYNCINJECTOR_H
+#define SYNCINJECTOR_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Sends one keypress to several VMCs at nearly the same instant, to
+// reproduce contention on shared-bus vending banks. Each port is owned by a
+// worker thread pinned to a core of its own, with its own SerialCommunication
+// and event loop. For every event the workers wait until their last key is
+// acked and the line is idle, and meet at a barrier; the coordinator then
+// publishes a release time slightly ahead, and every worker spins until it and
+// sends through KeypressCommands. A port's send time is when TxScheduler
+// dispatched the frame to the device; a key that was only queued misses the
+// event. The event's skew is the spread of those times across ports.
+class SyncInjector
+{
+public:
+    static const int DEFAULT_EVENTS = 100;
+    static const int DEFAULT_INTERVAL_MS = 500;
+    static const int TARGET_SKEW_US = 1000;
+    static const int RELEASE_LEAD_US = 500;    // Release time published this far ahead
+    static const int STAGE_TIMEOUT_MS = 1000;  // For every worker to reach the barrier
+    static const int DRAIN_MS = 2000;          // For the last acks before the ports close
+
+    struct Options {
+        QStringList ports;
+        QVector<QString> keys{"1"};            // Cycled through, one key per event
+        int events = DEFAULT_EVENTS;
+        int intervalMs = DEFAULT_INTERVAL_MS;
+        bool pinThreads = true;
+        QString csvPath;                       // Per-event skew and offsets, optional
+    };
+
+    struct Event {
+        int index = 0;
+        QString key;
+        QVector<qint64> offsetNs;              // Per port, send time minus release time; -1 if missed
+        qint64 skewNs = -1;                    // Latest minus earliest send; -1 if a port missed it
+    };
+
+    static bool parsePorts(const QString &list, QStringList *ports);
+    static QString formatCsv(const QStringList &ports, const QVector<Event> &events);
+
+    // Headless entry point: runs every event and prints the skew distribution
+    static int run(const Options &options);
+};
+
+#endif // SYNCINJECTOR_H
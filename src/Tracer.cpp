@@ -0,0 +1,299 @@
+#include "Tracer.h"
+#include <QCoreApplication>
+#include <QFile>
+#include <QThread>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Tracer::s_enabled{false};
+
+namespace {
+
+struct TraceEvent {
+    const char *name;
+    quint64 id;
+    qint64 timestampNs;
+    qint64 durationNs;
+    char phase;
+};
+
+// The sequence is odd while the owning thread writes the slot and 2 * (index + 1)
+// once event index is in it, so a reader can tell a torn or overwritten slot
+struct TraceSlot {
+    std::atomic<quint64> sequence{0};
+    TraceEvent event;
+};
+
+// Single-producer ring: only the owning thread writes, and publishes each
+// event by advancing head. The oldest events are overwritten when full.
+// clear() only bumps the global epoch; the owner drops its events on its
+// next record, so no other thread ever writes into the ring.
+struct TraceBuffer {
+    static const quint64 CAPACITY = 1 << 16;
+
+    TraceSlot slots[CAPACITY];
+    std::atomic<quint64> head{0};
+    std::atomic<quint64> begin{0};             // First event since the last clear
+    std::atomic<quint64> epoch{0};
+    int threadId = 0;
+    QByteArray threadName;
+};
+
+struct ThreadEvents {
+    int threadId = 0;
+    QByteArray threadName;
+    std::vector<TraceEvent> events;
+};
+
+std::atomic<quint64> clearEpoch{0};
+
+std::mutex registryMutex;
+std::vector<std::unique_ptr<TraceBuffer>> registry;
+// Events of threads that have exited, copied out so the ring can be freed and
+// finished campaign workers still export
+std::vector<ThreadEvents> retired;
+int nextThreadId = 1;
+
+// Published events of a ring, oldest first; slots being rewritten are skipped
+ThreadEvents snapshot(const TraceBuffer &buffer)
+{
+    ThreadEvents result;
+    result.threadId = buffer.threadId;
+    result.threadName = buffer.threadName;
+    if (buffer.epoch.load(std::memory_order_acquire) != clearEpoch.load(std::memory_order_acquire)) {
+        return result;                         // Nothing recorded since the last clear
+    }
+    const quint64 head = buffer.head.load(std::memory_order_acquire);
+    const quint64 oldest = head > TraceBuffer::CAPACITY ? head - TraceBuffer::CAPACITY : 0;
+    const quint64 first = qMax(oldest, buffer.begin.load(std::memory_order_acquire));
+    result.events.reserve(static_cast<size_t>(head - qMin(head, first)));
+    for (quint64 i = first; i < head; ++i) {
+        const TraceSlot &slot = buffer.slots[i & (TraceBuffer::CAPACITY - 1)];
+        const quint64 expected = 2 * (i + 1);
+        if (slot.sequence.load(std::memory_order_acquire) != expected) {
+            continue;
+        }
+        const TraceEvent event = slot.event;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == expected) {
+            result.events.push_back(event);
+        }
+    }
+    return result;
+}
+
+// Owns the calling thread's ring and hands it back when the thread exits
+struct BufferOwner {
+    TraceBuffer *buffer = nullptr;
+
+    ~BufferOwner()
+    {
+        if (!buffer) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(registryMutex);
+        ThreadEvents events = snapshot(*buffer);
+        if (!events.events.empty()) {
+            events.events.shrink_to_fit();
+            retired.push_back(std::move(events));
+        }
+        for (auto it = registry.begin(); it != registry.end(); ++it) {
+            if (it->get() == buffer) {
+                registry.erase(it);
+                break;
+            }
+        }
+    }
+};
+
+thread_local BufferOwner threadBuffer;
+
+TraceBuffer *currentBuffer()
+{
+    if (!threadBuffer.buffer) {
+        std::unique_ptr<TraceBuffer> buffer(new TraceBuffer);
+        QThread *thread = QThread::currentThread();
+        buffer->threadName = thread->objectName().toUtf8();
+        if (buffer->threadName.isEmpty()) {
+            bool isMain = QCoreApplication::instance() && thread == QCoreApplication::instance()->thread();
+            buffer->threadName = isMain ? "main" : "worker";
+        }
+        buffer->epoch.store(clearEpoch.load(std::memory_order_acquire), std::memory_order_release);
+
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffer->threadId = nextThreadId++;
+        threadBuffer.buffer = buffer.get();
+        registry.push_back(std::move(buffer));
+    }
+    return threadBuffer.buffer;
+}
+
+void appendEscaped(QByteArray &out, const QByteArray &text)
+{
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += (static_cast<uchar>(c) < 0x20) ? ' ' : c;
+    }
+}
+
+// Chrome timestamps are microseconds; three decimals keep the nanoseconds
+QByteArray microseconds(qint64 ns)
+{
+    return QByteArray::number(ns / 1000) + '.' + QByteArray::number(ns % 1000).rightJustified(3, '0');
+}
+
+}
+
+void Tracer::setEnabled(bool enable)
+{
+    s_enabled.store(enable, std::memory_order_relaxed);
+}
+
+void Tracer::clear()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    retired.clear();
+    clearEpoch.fetch_add(1, std::memory_order_acq_rel);
+}
+
+qint64 Tracer::nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+quint64 Tracer::frameId(const QByteArray &frame)
+{
+    // Up to eight frame bytes packed together; an echo gets its frame's id
+    quint64 id = 0;
+    for (int i = 0; i < frame.size() && i < 8; ++i) {
+        id = (id << 8) | static_cast<quint8>(frame.at(i));
+    }
+    return id;
+}
+
+void Tracer::complete(const char *name, qint64 startNs, qint64 endNs)
+{
+    record('X', name, 0, startNs, endNs - startNs);
+}
+
+void Tracer::instant(const char *name)
+{
+    if (isEnabled()) {
+        record('i', name, 0, nowNs(), 0);
+    }
+}
+
+void Tracer::asyncBegin(const char *name, quint64 id)
+{
+    if (isEnabled()) {
+        record('b', name, id, nowNs(), 0);
+    }
+}
+
+void Tracer::asyncStep(const char *name, quint64 id)
+{
+    if (isEnabled()) {
+        record('n', name, id, nowNs(), 0);
+    }
+}
+
+void Tracer::asyncEnd(const char *name, quint64 id)
+{
+    if (isEnabled()) {
+        record('e', name, id, nowNs(), 0);
+    }
+}
+
+void Tracer::record(char phase, const char *name, quint64 id, qint64 timestampNs, qint64 durationNs)
+{
+    TraceBuffer *buffer = currentBuffer();
+    const quint64 head = buffer->head.load(std::memory_order_relaxed);
+    const quint64 epoch = clearEpoch.load(std::memory_order_acquire);
+    if (buffer->epoch.load(std::memory_order_relaxed) != epoch) {
+        // Cleared since our last event: start over from here
+        buffer->begin.store(head, std::memory_order_release);
+        buffer->epoch.store(epoch, std::memory_order_release);
+    }
+
+    TraceSlot &slot = buffer->slots[head & (TraceBuffer::CAPACITY - 1)];
+    slot.sequence.store(2 * head + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.event.name = name;
+    slot.event.id = id;
+    slot.event.timestampNs = timestampNs;
+    slot.event.durationNs = durationNs;
+    slot.event.phase = phase;
+    slot.sequence.store(2 * (head + 1), std::memory_order_release);
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+bool Tracer::exportChromeJson(const QString &fileName, QString *errorMessage)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        *errorMessage = QString("Cannot write %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+
+    const bool wasEnabled = isEnabled();
+    setEnabled(false);
+
+    const QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+    QByteArray out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    bool first = true;
+
+    // Copied under the lock, so threads may come and go while the file is written
+    std::vector<ThreadEvents> threads;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        threads = retired;
+        for (const auto &buffer : registry) {
+            threads.push_back(snapshot(*buffer));
+        }
+    }
+
+    for (const ThreadEvents &thread : threads) {
+        const QByteArray tid = QByteArray::number(thread.threadId);
+        out += first ? "" : ",\n";
+        first = false;
+        out += "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" + pid + ",\"tid\":" + tid
+             + ",\"args\":{\"name\":\"";
+        appendEscaped(out, thread.threadName);
+        out += "\"}}";
+
+        for (const TraceEvent &event : thread.events) {
+            out += ",\n{\"ph\":\"";
+            out += event.phase;
+            out += "\",\"cat\":\"asd\",\"name\":\"";
+            out += event.name;
+            out += "\",\"pid\":" + pid + ",\"tid\":" + tid + ",\"ts\":" + microseconds(event.timestampNs);
+            if (event.phase == 'X') {
+                out += ",\"dur\":" + microseconds(event.durationNs);
+            } else if (event.phase == 'i') {
+                out += ",\"s\":\"t\"";
+            } else {
+                out += ",\"id\":\"0x" + QByteArray::number(event.id, 16) + '"';
+            }
+            out += '}';
+
+            if (out.size() > (1 << 20)) {
+                file.write(out);
+                out.clear();
+            }
+        }
+    }
+    out += "\n]}\n";
+    file.write(out);
+
+    setEnabled(wasEnabled);
+    if (file.error() != QFileDevice::NoError) {
+        *errorMessage = QString("Failed writing %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,65 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QByteArray>
+#include <QString>
+#include <atomic>
+
+// Span tracing for the keypress path, exported as Chrome trace-event JSON
+// (chrome://tracing, ui.perfetto.dev). Each thread records into its own
+// ring buffer with nanosecond timestamps; when tracing is off every call
+// below costs one relaxed atomic load. Names must be string literals.
+class Tracer
+{
+public:
+    static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enable);
+    static void clear();
+
+    static qint64 nowNs();
+    static quint64 frameId(const QByteArray &frame);
+
+    // Complete span on the calling thread
+    static void complete(const char *name, qint64 startNs, qint64 endNs);
+    static void instant(const char *name);
+
+    // Async track keyed by id, for a frame crossing threads and callbacks
+    static void asyncBegin(const char *name, quint64 id);
+    static void asyncStep(const char *name, quint64 id);
+    static void asyncEnd(const char *name, quint64 id);
+
+    // Tracing is paused while the buffers are written out
+    static bool exportChromeJson(const QString &fileName, QString *errorMessage);
+
+private:
+    static void record(char phase, const char *name, quint64 id, qint64 timestampNs, qint64 durationNs);
+
+    static std::atomic<bool> s_enabled;
+};
+
+// Records the enclosing scope as a complete span
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name)
+        : m_name(Tracer::isEnabled() ? name : nullptr)
+        , m_startNs(m_name ? Tracer::nowNs() : 0)
+    {
+    }
+
+    ~TraceSpan()
+    {
+        if (m_name) {
+            Tracer::complete(m_name, m_startNs, Tracer::nowNs());
+        }
+    }
+
+private:
+    const char *m_name;
+    qint64 m_startNs;
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+};
+
+#endif // TRACER_H
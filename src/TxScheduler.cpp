@@ -0,0 +1,191 @@
+#include "TxScheduler.h"
+#include "MemoryBudget.h"
+#include "Metrics.h"
+#include "Tracer.h"
+#include "VmcProtocol.h"
+#include "VirtualClock.h"
+#include <QDebug>
+
+TxScheduler::TxScheduler(QObject *parent)
+    : QObject(parent)
+    , m_device(nullptr)
+    , m_inFlightBytes(0)
+    , m_pumping(false)
+    , m_lastWaitMs(0)
+    , m_maxWaitMs(0)
+    , m_totalWaitMs(0)
+    , m_framesSent(0)
+    , m_framesDropped(0)
+    , m_keepalivesCollapsed(0)
+{
+}
+
+TxScheduler::~TxScheduler()
+{
+    clear();
+}
+
+qint64 TxScheduler::footprint(const Entry &entry)
+{
+    return static_cast<qint64>(sizeof(Entry)) + entry.frame.size();
+}
+
+void TxScheduler::setDevice(QIODevice *device)
+{
+    if (m_device) {
+        disconnect(m_device, nullptr, this, nullptr);
+    }
+
+    clear();
+    m_device = device;
+
+    if (m_device) {
+        connect(m_device, &QIODevice::bytesWritten, this, &TxScheduler::handleBytesWritten);
+    }
+}
+
+bool TxScheduler::enqueue(const QByteArray &frame, TxPriority priority)
+{
+    if (!m_device || !m_device->isOpen()) {
+        return false;
+    }
+
+    QQueue<Entry> &queue = m_queues[static_cast<int>(priority)];
+
+    // One pending keepalive is as good as several
+    if (priority == TxPriority::Keepalive && !queue.isEmpty()) {
+        m_keepalivesCollapsed++;
+        return true;
+    }
+
+    if (queue.size() >= MAX_QUEUE_DEPTH) {
+        m_framesDropped++;
+        Metrics::instance().txDropped.add();
+        qDebug() << "TX queue full for priority" << static_cast<int>(priority)
+                 << "- dropping frame:" << frame.toHex();
+        return false;
+    }
+
+    // Queued frames count against the serial budget; over it, new frames are refused
+    Entry entry{frame, VirtualClock::monotonicMs()};
+    if (!MemoryBudget::tryCharge(MemoryBudget::SerialBuffers, footprint(entry))) {
+        MemoryBudget::recordEviction(MemoryBudget::SerialBuffers, footprint(entry));
+        m_framesDropped++;
+        Metrics::instance().txDropped.add();
+        qDebug() << "TX queue over the serial memory budget - dropping frame:" << frame.toHex();
+        return false;
+    }
+    queue.enqueue(entry);
+    Metrics::instance().queueDepth[static_cast<int>(priority)].add(1);
+    if (Tracer::isEnabled() && VmcProtocol::isFrame(frame)) {
+        Tracer::asyncBegin("frame", Tracer::frameId(frame));
+    }
+    pump();
+    return true;
+}
+
+void TxScheduler::clear()
+{
+    Metrics &metrics = Metrics::instance();
+    for (int i = 0; i < PRIORITY_COUNT; ++i) {
+        metrics.queueDepth[i].add(-m_queues[i].size());
+        for (const Entry &entry : m_queues[i]) {
+            MemoryBudget::release(MemoryBudget::SerialBuffers, footprint(entry));
+        }
+        m_queues[i].clear();
+    }
+    metrics.inFlightBytes.add(-m_inFlightBytes);
+    m_inFlightBytes = 0;
+}
+
+int TxScheduler::queueDepth() const
+{
+    int depth = 0;
+    for (const QQueue<Entry> &queue : m_queues) {
+        depth += queue.size();
+    }
+    return depth;
+}
+
+TxScheduler::Metrics TxScheduler::metrics() const
+{
+    Metrics metrics;
+    for (int i = 0; i < PRIORITY_COUNT; ++i) {
+        metrics.queueDepth[i] = m_queues[i].size();
+    }
+    metrics.inFlightBytes = m_inFlightBytes;
+    metrics.lastWaitMs = m_lastWaitMs;
+    metrics.maxWaitMs = m_maxWaitMs;
+    metrics.avgWaitMs = m_framesSent > 0
+        ? static_cast<double>(m_totalWaitMs) / m_framesSent : 0.0;
+    metrics.framesSent = m_framesSent;
+    metrics.framesDropped = m_framesDropped;
+    metrics.keepalivesCollapsed = m_keepalivesCollapsed;
+    return metrics;
+}
+
+void TxScheduler::handleBytesWritten(qint64 bytes)
+{
+    Tracer::instant("QIODevice::bytesWritten");
+    qint64 remaining = qMax<qint64>(0, m_inFlightBytes - bytes);
+    Metrics::instance().inFlightBytes.add(remaining - m_inFlightBytes);
+    m_inFlightBytes = remaining;
+    pump();
+}
+
+void TxScheduler::pump()
+{
+    // bytesWritten may be emitted from inside write() on some devices
+    if (m_pumping || !m_device || !m_device->isOpen()) {
+        return;
+    }
+    m_pumping = true;
+    Metrics &metrics = Metrics::instance();
+
+    for (int i = 0; i < PRIORITY_COUNT; ++i) {
+        QQueue<Entry> &queue = m_queues[i];
+        while (!queue.isEmpty()) {
+            const QByteArray &frame = queue.head().frame;
+
+            // Frames are never split; an oversized frame goes out on an idle line
+            if (m_inFlightBytes > 0 && m_inFlightBytes + frame.size() > MAX_IN_FLIGHT_BYTES) {
+                m_pumping = false;
+                return;
+            }
+
+            Entry entry = queue.dequeue();
+            MemoryBudget::release(MemoryBudget::SerialBuffers, footprint(entry));
+            metrics.queueDepth[i].add(-1);
+            if (Tracer::isEnabled() && VmcProtocol::isFrame(entry.frame)) {
+                Tracer::asyncStep("dispatch", Tracer::frameId(entry.frame));
+            }
+            qint64 written;
+            {
+                TraceSpan span("QIODevice::write");
+                written = m_device->write(entry.frame);
+            }
+            if (written != entry.frame.size()) {
+                m_framesDropped++;
+                metrics.txDropped.add();
+                emit writeFailed(QString("Short write: %1 of %2 bytes")
+                                 .arg(written).arg(entry.frame.size()));
+                continue;
+            }
+
+            qint64 waitMs = VirtualClock::monotonicMs() - entry.enqueuedAtMs;
+            m_inFlightBytes += written;
+            m_lastWaitMs = waitMs;
+            m_maxWaitMs = qMax(m_maxWaitMs, waitMs);
+            m_totalWaitMs += waitMs;
+            m_framesSent++;
+            metrics.txBytes.add(written);
+            metrics.txFrames[Metrics::classify(entry.frame)].add();
+            metrics.inFlightBytes.add(written);
+            metrics.queueWaitMs.record(waitMs);
+
+            emit frameDispatched(entry.frame, static_cast<TxPriority>(i), waitMs);
+        }
+    }
+
+    m_pumping = false;
+}
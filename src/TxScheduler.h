@@ -0,0 +1,75 @@
+#ifndef TXSCHEDULER_H
+#define TXSCHEDULER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QIODevice>
+#include <QQueue>
+
+// Transmit priority classes, highest first
+enum class TxPriority {
+    Operator = 0,    // Keypresses from the operator
+    Automation = 1,  // AutoKeypress and scripted traffic
+    Keepalive = 2    // Link keepalives
+};
+
+class TxScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int PRIORITY_COUNT = 3;
+
+    struct Metrics {
+        int queueDepth[PRIORITY_COUNT] = {0, 0, 0};
+        qint64 inFlightBytes = 0;
+        qint64 lastWaitMs = 0;
+        qint64 maxWaitMs = 0;
+        double avgWaitMs = 0.0;
+        quint64 framesSent = 0;
+        quint64 framesDropped = 0;
+        quint64 keepalivesCollapsed = 0;
+    };
+
+    explicit TxScheduler(QObject *parent = nullptr);
+    ~TxScheduler() override;
+
+    void setDevice(QIODevice *device);
+    bool enqueue(const QByteArray &frame, TxPriority priority);
+    void clear();
+    int queueDepth() const;
+    Metrics metrics() const;
+
+signals:
+    void frameDispatched(const QByteArray &frame, TxPriority priority, qint64 waitMs);
+    void writeFailed(const QString &errorMessage);
+
+private slots:
+    void handleBytesWritten(qint64 bytes);
+
+private:
+    struct Entry {
+        QByteArray frame;
+        qint64 enqueuedAtMs;
+    };
+
+    static const int MAX_IN_FLIGHT_BYTES = 32;   // ~33 ms of line time at 9600 baud
+    static const int MAX_QUEUE_DEPTH = 256;      // Per priority class
+
+    QIODevice *m_device;
+    QQueue<Entry> m_queues[PRIORITY_COUNT];
+    qint64 m_inFlightBytes;
+    bool m_pumping;
+
+    qint64 m_lastWaitMs;
+    qint64 m_maxWaitMs;
+    qint64 m_totalWaitMs;
+    quint64 m_framesSent;
+    quint64 m_framesDropped;
+    quint64 m_keepalivesCollapsed;
+
+    static qint64 footprint(const Entry &entry);
+    void pump();
+};
+
+#endif // TXSCHEDULER_H
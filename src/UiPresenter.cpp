@@ -0,0 +1,135 @@
+#include "UiPresenter.h"
+#include "MemoryBudget.h"
+#include <QLineEdit>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTextEdit>
+
+UiPresenter::UiPresenter(QLineEdit *display, QTextEdit *console, QObject *parent)
+    : QObject(parent)
+    , m_display(display)
+    , m_console(console)
+    , m_displayText(display->text())
+    , m_displayDirty(false)
+    , m_droppedLines(0)
+    , m_clearConsole(false)
+    , m_updatesRequested(0)
+    , m_framesApplied(0)
+{
+    m_frameTimer.setSingleShot(true);
+    m_frameTimer.setInterval(1000 / FRAME_RATE_HZ);
+    connect(&m_frameTimer, &QTimer::timeout, this, &UiPresenter::flush);
+
+    // Bounded so a long soak run does not grow the document without limit
+    m_console->document()->setMaximumBlockCount(MAX_CONSOLE_LINES);
+}
+
+void UiPresenter::appendDisplay(const QString &text)
+{
+    m_displayText += text;
+    m_displayDirty = true;
+    requestFrame();
+}
+
+void UiPresenter::clearDisplay()
+{
+    m_displayText.clear();
+    m_displayDirty = true;
+    requestFrame();
+}
+
+void UiPresenter::appendLog(const QString &line)
+{
+    // Lines that would scroll out of the console within this frame are never drawn
+    if (m_pendingLines.size() >= MAX_CONSOLE_LINES) {
+        m_pendingLines.removeFirst();
+        m_droppedLines++;
+    }
+    m_pendingLines.append(line);
+    requestFrame();
+}
+
+void UiPresenter::clearLog()
+{
+    m_pendingLines.clear();
+    m_droppedLines = 0;
+    m_clearConsole = true;
+    requestFrame();
+}
+
+void UiPresenter::schedule(const QString &key, const std::function<void()> &apply)
+{
+    m_pendingUpdates.insert(key, apply);
+    requestFrame();
+}
+
+void UiPresenter::requestFrame()
+{
+    m_updatesRequested++;
+    if (!m_frameTimer.isActive()) {
+        m_frameTimer.start();
+    }
+}
+
+void UiPresenter::flush()
+{
+    m_frameTimer.stop();
+
+    if (m_displayDirty) {
+        m_display->setText(m_displayText);
+        m_displayDirty = false;
+    }
+
+    if (m_clearConsole) {
+        m_console->clear();
+        m_clearConsole = false;
+    }
+    if (m_droppedLines > 0) {
+        m_console->append(QString("... %1 log lines skipped ...").arg(m_droppedLines));
+        m_droppedLines = 0;
+    }
+    if (!m_pendingLines.isEmpty()) {
+        // One append, one layout and one repaint for the whole frame
+        m_console->append(m_pendingLines.join('\n'));
+        m_pendingLines.clear();
+    }
+    enforceConsoleBudget();
+
+    // Taken first: an update may schedule another one for the next frame
+    QMap<QString, std::function<void()>> updates;
+    updates.swap(m_pendingUpdates);
+    for (const std::function<void()> &apply : updates) {
+        apply();
+    }
+
+    m_framesApplied++;
+}
+
+qint64 UiPresenter::consoleBytes() const
+{
+    const QTextDocument *document = m_console->document();
+    return document->characterCount() * 2 + static_cast<qint64>(document->blockCount()) * BLOCK_OVERHEAD_BYTES;
+}
+
+void UiPresenter::enforceConsoleBudget()
+{
+    // Long lines can outgrow the budget well before MAX_CONSOLE_LINES does
+    qint64 bytes = consoleBytes();
+    const qint64 budget = MemoryBudget::budget(MemoryBudget::UiDocument);
+    QTextDocument *document = m_console->document();
+    if (bytes > budget && document->blockCount() > 1) {
+        // Trim to three quarters of the budget in one edit, so trimming stays rare
+        const qint64 excess = bytes - budget * 3 / 4;
+        const int blocks = document->blockCount();
+        const int removed = static_cast<int>(qBound<qint64>(1, blocks * excess / bytes + 1, blocks - 1));
+        QTextCursor cursor(document);
+        cursor.movePosition(QTextCursor::Start);
+        cursor.movePosition(QTextCursor::NextBlock, QTextCursor::KeepAnchor, removed);
+        cursor.removeSelectedText();
+
+        const qint64 trimmed = consoleBytes();
+        MemoryBudget::recordEviction(MemoryBudget::UiDocument, bytes - trimmed);
+        bytes = trimmed;
+    }
+    MemoryBudget::setUsage(MemoryBudget::UiDocument, bytes);
+}
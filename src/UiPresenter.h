@@ -0,0 +1,62 @@
+#ifndef UIPRESENTER_H
+#define UIPRESENTER_H
+
+#include <QObject>
+#include <QMap>
+#include <QStringList>
+#include <QTimer>
+#include <functional>
+
+class QLineEdit;
+class QTextEdit;
+
+// Collects UI changes from the engine and applies them at most once per
+// frame, so the widgets repaint at FRAME_RATE_HZ however fast keys, log lines
+// and status signals arrive. Intermediate values of a keyed update are dropped.
+class UiPresenter : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int FRAME_RATE_HZ = 30;
+    static const int MAX_CONSOLE_LINES = 5000;
+    static const int BLOCK_OVERHEAD_BYTES = 256;   // Layout and fragment bookkeeping per console line, roughly
+
+    UiPresenter(QLineEdit *display, QTextEdit *console, QObject *parent = nullptr);
+
+    void appendDisplay(const QString &text);
+    void clearDisplay();
+    QString displayText() const { return m_displayText; }
+
+    void appendLog(const QString &line);
+    void clearLog();
+
+    // Runs apply on the next frame; a later call with the same key replaces it
+    void schedule(const QString &key, const std::function<void()> &apply);
+
+    void flush();
+
+    quint64 updatesRequested() const { return m_updatesRequested; }
+    quint64 framesApplied() const { return m_framesApplied; }
+
+private:
+    QLineEdit *m_display;
+    QTextEdit *m_console;
+    QTimer m_frameTimer;
+
+    QString m_displayText;
+    bool m_displayDirty;
+    QStringList m_pendingLines;
+    int m_droppedLines;
+    bool m_clearConsole;
+    QMap<QString, std::function<void()>> m_pendingUpdates;
+
+    quint64 m_updatesRequested;
+    quint64 m_framesApplied;
+
+    void requestFrame();
+    qint64 consoleBytes() const;
+    void enforceConsoleBudget();
+};
+
+#endif // UIPRESENTER_H
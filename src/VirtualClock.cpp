@@ -0,0 +1,157 @@
+#include "VirtualClock.h"
+#include <QElapsedTimer>
+#include <atomic>
+
+namespace {
+std::atomic<VirtualClock *> activeClock{nullptr};
+}
+
+VirtualClock::VirtualClock()
+    : m_nowNs(0)
+    , m_nextId(1)
+    , m_eventsRun(0)
+{
+}
+
+VirtualClock::~VirtualClock()
+{
+    VirtualClock *self = this;
+    activeClock.compare_exchange_strong(self, nullptr);
+}
+
+VirtualClock *VirtualClock::active()
+{
+    return activeClock.load(std::memory_order_acquire);
+}
+
+void VirtualClock::setActive(VirtualClock *clock)
+{
+    activeClock.store(clock, std::memory_order_release);
+}
+
+qint64 VirtualClock::monotonicNs()
+{
+    if (VirtualClock *clock = active()) {
+        return clock->nowNs();
+    }
+
+    static QElapsedTimer wallClock;
+    static bool started = (wallClock.start(), true);
+    Q_UNUSED(started);
+    return wallClock.nsecsElapsed();
+}
+
+quint64 VirtualClock::schedule(qint64 delayNs, Callback callback)
+{
+    quint64 id = m_nextId++;
+    qint64 deadline = m_nowNs + qMax<qint64>(0, delayNs);
+    m_events.emplace(Key(deadline, id), std::move(callback));
+    m_deadlines.emplace(id, deadline);
+    return id;
+}
+
+void VirtualClock::cancel(quint64 id)
+{
+    auto it = m_deadlines.find(id);
+    if (it == m_deadlines.end()) {
+        return;
+    }
+    m_events.erase(Key(it->second, id));
+    m_deadlines.erase(it);
+}
+
+bool VirtualClock::runNext()
+{
+    if (m_events.empty()) {
+        return false;
+    }
+
+    auto next = m_events.begin();
+    m_nowNs = next->first.first;
+    Callback callback = std::move(next->second);
+    m_deadlines.erase(next->first.second);
+    m_events.erase(next);
+
+    m_eventsRun++;
+    callback();
+    return true;
+}
+
+void VirtualClock::runUntil(qint64 deadlineNs)
+{
+    while (!m_events.empty() && m_events.begin()->first.first <= deadlineNs) {
+        runNext();
+    }
+    m_nowNs = qMax(m_nowNs, deadlineNs);
+}
+
+ClockTimer::ClockTimer(QObject *parent)
+    : QObject(parent)
+    , m_clock(nullptr)
+    , m_eventId(0)
+    , m_intervalMs(0)
+    , m_singleShot(false)
+{
+    connect(&m_timer, &QTimer::timeout, this, &ClockTimer::timeout);
+}
+
+ClockTimer::~ClockTimer()
+{
+    stop();
+}
+
+void ClockTimer::setInterval(int msec)
+{
+    m_intervalMs = msec;
+    m_timer.setInterval(msec);
+}
+
+void ClockTimer::setSingleShot(bool singleShot)
+{
+    m_singleShot = singleShot;
+    m_timer.setSingleShot(singleShot);
+}
+
+bool ClockTimer::isActive() const
+{
+    return m_eventId != 0 || m_timer.isActive();
+}
+
+void ClockTimer::start()
+{
+    stop();
+    if (VirtualClock::active()) {
+        scheduleVirtual();
+    } else {
+        m_timer.start();
+    }
+}
+
+void ClockTimer::start(int msec)
+{
+    setInterval(msec);
+    start();
+}
+
+void ClockTimer::stop()
+{
+    m_timer.stop();
+    if (m_eventId != 0 && m_clock) {
+        m_clock->cancel(m_eventId);
+    }
+    m_eventId = 0;
+    m_clock = nullptr;
+}
+
+void ClockTimer::scheduleVirtual()
+{
+    m_clock = VirtualClock::active();
+    m_eventId = m_clock->schedule(static_cast<qint64>(m_intervalMs) * 1000000, [this]() {
+        m_eventId = 0;
+        if (!m_singleShot) {
+            // Re-arm first so a slot calling stop() cancels the next tick
+            scheduleVirtual();
+        }
+        emit timeout();
+    });
+}
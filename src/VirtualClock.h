@@ -0,0 +1,78 @@
+#ifndef VIRTUALCLOCK_H
+#define VIRTUALCLOCK_H
+
+#include <QObject>
+#include <QTimer>
+#include <functional>
+#include <map>
+#include <utility>
+
+// Discrete-event clock for simulation runs. While a VirtualClock is active,
+// ClockTimer and monotonicMs() follow virtual time, and run*() jumps straight
+// to the next deadline instead of waiting for it.
+class VirtualClock
+{
+public:
+    using Callback = std::function<void()>;
+
+    VirtualClock();
+    ~VirtualClock();
+
+    static VirtualClock *active();
+    static void setActive(VirtualClock *clock);
+
+    // Virtual time when a clock is active, steady wall-clock time otherwise
+    static qint64 monotonicNs();
+    static qint64 monotonicMs() { return monotonicNs() / 1000000; }
+
+    qint64 nowNs() const { return m_nowNs; }
+    quint64 schedule(qint64 delayNs, Callback callback);
+    void cancel(quint64 id);
+
+    bool runNext();
+    void runUntil(qint64 deadlineNs);
+    quint64 eventsRun() const { return m_eventsRun; }
+
+private:
+    // Ordered by deadline, then by scheduling order, so runs are deterministic
+    using Key = std::pair<qint64, quint64>;
+    std::map<Key, Callback> m_events;
+    std::map<quint64, qint64> m_deadlines;  // id -> deadline, for cancel()
+    qint64 m_nowNs;
+    quint64 m_nextId;
+    quint64 m_eventsRun;
+};
+
+// QTimer replacement that runs on the active VirtualClock when there is one
+class ClockTimer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ClockTimer(QObject *parent = nullptr);
+    ~ClockTimer();
+
+    void setInterval(int msec);
+    int interval() const { return m_intervalMs; }
+    void setSingleShot(bool singleShot);
+    bool isSingleShot() const { return m_singleShot; }
+    bool isActive() const;
+
+    void start();
+    void start(int msec);
+    void stop();
+
+signals:
+    void timeout();
+
+private:
+    QTimer m_timer;
+    VirtualClock *m_clock;  // Clock the pending virtual event lives on
+    quint64 m_eventId;
+    int m_intervalMs;
+    bool m_singleShot;
+
+    void scheduleVirtual();
+};
+
+#endif // VIRTUALCLOCK_H
@@ -0,0 +1,216 @@
+#include "VmcDiscovery.h"
+#include "VmcProfile.h"
+#include <QDebug>
+#include <QEventLoop>
+#include <QSerialPort>
+#include <QSerialPortInfo>
+#include <QTextStream>
+#include <algorithm>
+
+VmcDiscovery::VmcDiscovery(QObject *parent)
+    : QObject(parent)
+    , m_baudRates{QSerialPort::Baud9600}
+    , m_deadlineMs(DEFAULT_DEADLINE_MS)
+{
+}
+
+VmcDiscovery::~VmcDiscovery()
+{
+    cancel();
+}
+
+void VmcDiscovery::start(const QStringList &portNames)
+{
+    cancel();
+    m_results.clear();
+    m_elapsed.start();
+
+    const std::shared_ptr<const VmcProfile> profile = VmcProfile::current();
+    m_keepaliveRequest = profile->keepaliveRequest();
+    m_keepaliveResponse = profile->keepaliveResponse();
+
+    QList<QSerialPortInfo> candidates;
+    for (const QSerialPortInfo &info : QSerialPortInfo::availablePorts()) {
+        if (portNames.isEmpty() || portNames.contains(info.portName())) {
+            candidates.append(info);
+        }
+    }
+
+    for (const QSerialPortInfo &info : candidates) {
+        Probe *probe = new Probe;
+        probe->result.portName = info.portName();
+        probe->result.description = info.description();
+
+        probe->port = new QSerialPort(info, this);
+        probe->port->setBaudRate(m_baudRates.value(0, QSerialPort::Baud9600));
+        probe->port->setDataBits(QSerialPort::Data8);
+        probe->port->setParity(QSerialPort::NoParity);
+        probe->port->setStopBits(QSerialPort::OneStop);
+        probe->port->setFlowControl(QSerialPort::NoFlowControl);
+        if (!probe->port->open(QIODevice::ReadWrite)) {
+            probe->result.error = probe->port->errorString();
+            m_results.append(probe->result);
+            delete probe->port;
+            delete probe;
+            continue;
+        }
+
+        probe->deadline = new QTimer(this);
+        probe->deadline->setSingleShot(true);
+        connect(probe->deadline, &QTimer::timeout, this, [this, probe]() { handleDeadline(probe); });
+        connect(probe->port, &QSerialPort::readyRead, this, [this, probe]() { handleReadyRead(probe); });
+        m_probes.append(probe);
+    }
+
+    // Every port is open before the first keepalive goes out, so the
+    // deadlines all run concurrently
+    const QList<Probe *> probes = m_probes;
+    for (Probe *probe : probes) {
+        sendProbe(probe);
+    }
+
+    if (m_probes.isEmpty()) {
+        rankResults();
+        emit finished();
+    }
+}
+
+void VmcDiscovery::cancel()
+{
+    const QList<Probe *> probes = m_probes;
+    m_probes.clear();
+    for (Probe *probe : probes) {
+        disconnect(probe->port, nullptr, this, nullptr);
+        disconnect(probe->deadline, nullptr, this, nullptr);
+        probe->deadline->stop();
+        probe->port->close();
+        probe->port->deleteLater();
+        probe->deadline->deleteLater();
+        delete probe;
+    }
+}
+
+void VmcDiscovery::sendProbe(Probe *probe)
+{
+    probe->result.baudRate = m_baudRates.value(probe->baudIndex, QSerialPort::Baud9600);
+    probe->port->setBaudRate(probe->result.baudRate);
+    probe->port->clear();
+    probe->received.clear();
+
+    probe->sent.start();
+    probe->port->write(m_keepaliveRequest);
+    probe->deadline->start(m_deadlineMs);
+}
+
+void VmcDiscovery::handleReadyRead(Probe *probe)
+{
+    probe->received += probe->port->readAll();
+    if (!probe->received.contains(m_keepaliveResponse)) {
+        return;
+    }
+    probe->result.responseMs = probe->sent.elapsed();
+    finishProbe(probe);
+}
+
+void VmcDiscovery::handleDeadline(Probe *probe)
+{
+    if (++probe->baudIndex < m_baudRates.size()) {
+        sendProbe(probe);
+        return;
+    }
+    finishProbe(probe);
+}
+
+void VmcDiscovery::finishProbe(Probe *probe)
+{
+    m_probes.removeOne(probe);
+    disconnect(probe->port, nullptr, this, nullptr);
+    disconnect(probe->deadline, nullptr, this, nullptr);
+    probe->deadline->stop();
+    probe->port->close();
+    // Still inside one of the port's or timer's own signals
+    probe->port->deleteLater();
+    probe->deadline->deleteLater();
+
+    qDebug() << "Discovery:" << probe->result.portName
+             << (probe->result.isVmc() ? QString("VMC at %1 baud in %2 ms")
+                                             .arg(probe->result.baudRate).arg(probe->result.responseMs)
+                                       : QString("no answer"));
+    m_results.append(probe->result);
+    emit portProbed(probe->result);
+    delete probe;
+
+    if (m_probes.isEmpty()) {
+        rankResults();
+        emit finished();
+    }
+}
+
+void VmcDiscovery::rankResults()
+{
+    std::stable_sort(m_results.begin(), m_results.end(), [](const Result &a, const Result &b) {
+        if (a.isVmc() != b.isVmc()) {
+            return a.isVmc();
+        }
+        if (a.isVmc() && a.responseMs != b.responseMs) {
+            return a.responseMs < b.responseMs;
+        }
+        return a.portName < b.portName;
+    });
+}
+
+QList<VmcDiscovery::Result> VmcDiscovery::vmcPorts() const
+{
+    QList<Result> vmcs;
+    for (const Result &result : m_results) {
+        if (result.isVmc()) {
+            vmcs.append(result);
+        }
+    }
+    return vmcs;
+}
+
+bool VmcDiscovery::parseBaudRates(const QString &list, QList<qint32> *baudRates)
+{
+    baudRates->clear();
+    for (const QString &item : list.split(',', Qt::SkipEmptyParts)) {
+        bool ok = false;
+        const qint32 baudRate = item.trimmed().toInt(&ok);
+        if (!ok || baudRate <= 0) {
+            return false;
+        }
+        baudRates->append(baudRate);
+    }
+    return !baudRates->isEmpty();
+}
+
+int VmcDiscovery::run(const QList<qint32> &baudRates, int deadlineMs)
+{
+    QTextStream out(stdout);
+    VmcDiscovery discovery;
+    discovery.setBaudRates(baudRates);
+    discovery.setDeadline(deadlineMs);
+
+    QEventLoop loop;
+    QObject::connect(&discovery, &VmcDiscovery::finished, &loop, &QEventLoop::quit);
+    discovery.start();
+    if (discovery.isRunning()) {
+        loop.exec();
+    }
+
+    const QList<Result> results = discovery.results();
+    out << QString("Probed %1 ports in %2 ms").arg(results.size()).arg(discovery.elapsedMs()) << Qt::endl;
+    int rank = 0;
+    for (const Result &result : results) {
+        if (result.isVmc()) {
+            out << QString("%1. %2  %3 baud  %4 ms  %5")
+                       .arg(++rank).arg(result.portName).arg(result.baudRate)
+                       .arg(result.responseMs).arg(result.description) << Qt::endl;
+        } else {
+            out << QString("-  %1  %2").arg(result.portName,
+                                            result.error.isEmpty() ? QString("no answer") : result.error)
+                << Qt::endl;
+        }
+    }
+    return rank > 0 ? 0 : 1;
+}
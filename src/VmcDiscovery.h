@@ -0,0 +1,85 @@
+#ifndef VMCDISCOVERY_H
+#define VMCDISCOVERY_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QList>
+#include <QStringList>
+#include <QTimer>
+
+class QSerialPort;
+
+// Finds VMCs by probing every candidate port at once: each port is opened a
+// single time, sent a keepalive, and watched for the profile's answer within
+// a short deadline. Further baud rates are tried on the same open port.
+// Everything runs on the caller's event loop; no probe blocks another.
+class VmcDiscovery : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int DEFAULT_DEADLINE_MS = 200;
+
+    struct Result {
+        QString portName;
+        QString description;
+        qint32 baudRate = 0;
+        qint64 responseMs = -1;    // -1 when the port never answered
+        QString error;             // Why the port could not be probed, if it could not
+
+        bool isVmc() const { return responseMs >= 0; }
+    };
+
+    explicit VmcDiscovery(QObject *parent = nullptr);
+    ~VmcDiscovery();
+
+    void setBaudRates(const QList<qint32> &baudRates) { m_baudRates = baudRates; }
+    QList<qint32> baudRates() const { return m_baudRates; }
+    void setDeadline(int msec) { m_deadlineMs = msec; }
+    int deadline() const { return m_deadlineMs; }
+
+    // Probes the given ports, or every port QSerialPortInfo reports
+    void start(const QStringList &portNames = QStringList());
+    void cancel();
+    bool isRunning() const { return !m_probes.isEmpty(); }
+
+    // VMCs first, fastest answer first; then ports that did not answer
+    QList<Result> results() const { return m_results; }
+    QList<Result> vmcPorts() const;
+    qint64 elapsedMs() const { return m_elapsed.elapsed(); }
+
+    static bool parseBaudRates(const QString &list, QList<qint32> *baudRates);
+
+    // Headless entry point: probes and prints the ranked list
+    static int run(const QList<qint32> &baudRates, int deadlineMs);
+
+signals:
+    void portProbed(const VmcDiscovery::Result &result);
+    void finished();
+
+private:
+    struct Probe {
+        QSerialPort *port = nullptr;
+        QTimer *deadline = nullptr;
+        QElapsedTimer sent;
+        QByteArray received;
+        int baudIndex = 0;
+        Result result;
+    };
+
+    QList<qint32> m_baudRates;
+    int m_deadlineMs;
+    QList<Probe *> m_probes;
+    QList<Result> m_results;
+    QElapsedTimer m_elapsed;
+    QByteArray m_keepaliveRequest;     // From the active VmcProfile
+    QByteArray m_keepaliveResponse;
+
+    void sendProbe(Probe *probe);
+    void handleReadyRead(Probe *probe);
+    void handleDeadline(Probe *probe);
+    void finishProbe(Probe *probe);
+    void rankResults();
+};
+
+#endif // VMCDISCOVERY_H
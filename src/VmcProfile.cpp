@@ -0,0 +1,373 @@
+#include "VmcProfile.h"
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <atomic>
+#include <cstring>
+
+namespace {
+
+const char VALID_KEYS[] = "0123456789*#";
+
+// Frames of the keypad model this program was written against
+const struct {
+    char key;
+    const char *hex;
+} BUILT_IN_KEYS[] = {
+    {'1', "0B0003C8D6"},
+    {'2', "0B00036467"},
+    {'3', "0B0102505E"},
+    {'4', "0B0103505F"},
+    {'5', "0B0202505F"},
+    {'6', "0B02035060"},
+    {'7', "0B03025060"},
+    {'8', "0B03035061"},
+    {'9', "0B04025061"},
+    {'0', "0B04035062"},
+    {'*', "0B0400505F"},
+    {'#', "0B04015060"},
+};
+
+std::shared_ptr<const VmcProfile> &activeProfile()
+{
+    static std::shared_ptr<const VmcProfile> profile = VmcProfile::builtIn();
+    return profile;
+}
+
+// Accepts 16, "16" or "0x10"
+bool readByte(const QJsonValue &value, quint8 *byte)
+{
+    int parsed = -1;
+    if (value.isDouble()) {
+        parsed = value.toInt(-1);
+    } else if (value.isString()) {
+        bool ok = false;
+        parsed = value.toString().toInt(&ok, 0);
+        if (!ok) {
+            return false;
+        }
+    }
+    if (parsed < 0 || parsed > 0xFF) {
+        return false;
+    }
+    *byte = static_cast<quint8>(parsed);
+    return true;
+}
+
+}
+
+VmcProfile::VmcProfile()
+    : m_priceCommand(VmcProtocol::PRICE_COMMAND)
+    , m_priceHighMask(0x03)
+    , m_selectionInArg(true)
+    , m_maxPrice(VmcProtocol::MAX_PRICE)
+    , m_maxSelection(VmcProtocol::MAX_SELECTION)
+    , m_keepaliveRequest(VmcProtocol::KEEPALIVE_REQUEST)
+    , m_keepaliveResponse(VmcProtocol::KEEPALIVE_RESPONSE)
+    , m_keepaliveIntervalMs(5000)
+    , m_maxRetries(3)
+    , m_priceWindow(4)
+{
+    memset(m_keyFrames, 0, sizeof(m_keyFrames));
+    memset(m_hasKey, 0, sizeof(m_hasKey));
+    std::fill(std::begin(m_commandClass), std::end(m_commandClass), OtherCommand);
+}
+
+std::shared_ptr<const VmcProfile> VmcProfile::current()
+{
+    return std::atomic_load(&activeProfile());
+}
+
+void VmcProfile::setCurrent(std::shared_ptr<const VmcProfile> profile)
+{
+    // Readers holding the old profile keep it alive until they are done
+    std::atomic_store(&activeProfile(), std::move(profile));
+}
+
+std::shared_ptr<const VmcProfile> VmcProfile::builtIn()
+{
+    QString error;
+    std::shared_ptr<const VmcProfile> profile = compile(QJsonObject{{"name", "built-in"}}, &error);
+    Q_ASSERT(profile);
+    return profile;
+}
+
+quint32 VmcProfile::payloadKey(quint8 command, quint8 arg, quint8 value)
+{
+    return ((static_cast<quint32>(command) << 16) | (arg << 8) | value) + 1;
+}
+
+bool VmcProfile::addKey(char key, const QByteArray &frame, QString *errorMessage)
+{
+    if (!strchr(VALID_KEYS, key) || key == 0) {
+        *errorMessage = QString("invalid key '%1'").arg(QLatin1Char(key));
+        return false;
+    }
+    if (!VmcProtocol::isFrame(frame) || !VmcProtocol::hasValidChecksum(frame.constData())) {
+        *errorMessage = QString("key '%1': %2 is not a valid frame").arg(QLatin1Char(key)).arg(QString(frame.toHex()));
+        return false;
+    }
+
+    const quint8 command = static_cast<quint8>(frame.at(1));
+    const quint32 payload = payloadKey(command, static_cast<quint8>(frame.at(2)), static_cast<quint8>(frame.at(3)));
+
+    int index = (payload * 2654435761u) >> 27;
+    for (int probes = 0; m_keyDecode[index].payload != 0; ++probes) {
+        if (m_keyDecode[index].payload == payload || probes == DECODE_TABLE_SIZE) {
+            *errorMessage = QString("key '%1' has the same frame as key '%2'")
+                            .arg(QLatin1Char(key)).arg(QLatin1Char(m_keyDecode[index].key));
+            return false;
+        }
+        index = (index + 1) & (DECODE_TABLE_SIZE - 1);
+    }
+    m_keyDecode[index].payload = payload;
+    m_keyDecode[index].key = key;
+
+    memcpy(m_keyFrames[static_cast<int>(key)], frame.constData(), VmcProtocol::FRAME_SIZE);
+    m_hasKey[static_cast<int>(key)] = true;
+    m_commandClass[command] = KeypadCommand;
+    return true;
+}
+
+std::shared_ptr<const VmcProfile> VmcProfile::compile(const QJsonObject &definition, QString *errorMessage)
+{
+    std::shared_ptr<VmcProfile> profile(new VmcProfile);
+    profile->m_name = definition.value("name").toString();
+    if (profile->m_name.isEmpty()) {
+        *errorMessage = "profile has no name";
+        return nullptr;
+    }
+
+    // Anything the definition leaves out comes from the built-in model
+    QMap<char, QByteArray> keymap;
+    for (const auto &entry : BUILT_IN_KEYS) {
+        keymap.insert(entry.key, QByteArray::fromHex(entry.hex));
+    }
+    const QJsonObject keys = definition.value("keys").toObject();
+    for (auto it = keys.constBegin(); it != keys.constEnd(); ++it) {
+        if (it.key().size() != 1) {
+            *errorMessage = QString("invalid key '%1'").arg(it.key());
+            return nullptr;
+        }
+        keymap.insert(it.key().at(0).toLatin1(), QByteArray::fromHex(it.value().toString().toLatin1()));
+    }
+    for (auto it = keymap.constBegin(); it != keymap.constEnd(); ++it) {
+        if (!profile->addKey(it.key(), it.value(), errorMessage)) {
+            return nullptr;
+        }
+    }
+
+    const QJsonObject price = definition.value("price").toObject();
+    if (price.contains("command") && !readByte(price.value("command"), &profile->m_priceCommand)) {
+        *errorMessage = "price.command is not a byte";
+        return nullptr;
+    }
+    const int highBits = price.value("highBits").toInt(2);
+    if (highBits < 0 || highBits > 7) {
+        *errorMessage = "price.highBits must be 0-7";
+        return nullptr;
+    }
+    profile->m_priceHighMask = static_cast<quint8>((1 << highBits) - 1);
+    profile->m_priceCommand &= static_cast<quint8>(~profile->m_priceHighMask);
+    profile->m_selectionInArg = price.value("selection").toString("arg") == "arg";
+    profile->m_maxPrice = price.value("maxPrice").toInt(VmcProtocol::MAX_PRICE);
+    profile->m_maxSelection = price.value("maxSelection").toInt(VmcProtocol::MAX_SELECTION);
+    if (profile->m_maxPrice < 0 || profile->m_maxPrice >= (256 << highBits)
+        || profile->m_maxSelection < 0 || profile->m_maxSelection > 255) {
+        *errorMessage = "price.maxPrice or price.maxSelection does not fit the frame layout";
+        return nullptr;
+    }
+
+    // Command classes, most specific last: status frames, price range, keypad
+    quint8 creditCommand = VmcProtocol::CREDIT_COMMAND;
+    quint8 errorCommand = VmcProtocol::ERROR_COMMAND;
+    if ((definition.contains("creditCommand") && !readByte(definition.value("creditCommand"), &creditCommand))
+        || (definition.contains("errorCommand") && !readByte(definition.value("errorCommand"), &errorCommand))) {
+        *errorMessage = "creditCommand or errorCommand is not a byte";
+        return nullptr;
+    }
+    std::fill(std::begin(profile->m_commandClass), std::end(profile->m_commandClass), OtherCommand);
+    profile->m_commandClass[creditCommand] = CreditCommand;
+    profile->m_commandClass[errorCommand] = ErrorCommand;
+    for (int high = 0; high <= profile->m_priceHighMask; ++high) {
+        profile->m_commandClass[profile->m_priceCommand | high] = PriceCommand;
+    }
+    for (int key = 0; key < KEY_TABLE_SIZE; ++key) {
+        if (profile->m_hasKey[key]) {
+            const quint8 command = static_cast<quint8>(profile->m_keyFrames[key][1]);
+            if (profile->m_commandClass[command] != OtherCommand) {
+                *errorMessage = QString("key '%1' uses command byte 0x%2, which is already taken")
+                                .arg(QLatin1Char(static_cast<char>(key))).arg(command, 2, 16, QChar('0'));
+                return nullptr;
+            }
+        }
+    }
+    for (int key = 0; key < KEY_TABLE_SIZE; ++key) {
+        if (profile->m_hasKey[key]) {
+            profile->m_commandClass[static_cast<quint8>(profile->m_keyFrames[key][1])] = KeypadCommand;
+        }
+    }
+
+    const QJsonObject keepalive = definition.value("keepalive").toObject();
+    profile->m_keepaliveRequest = keepalive.value("request").toString(VmcProtocol::KEEPALIVE_REQUEST).toLatin1();
+    profile->m_keepaliveResponse = keepalive.value("response").toString(VmcProtocol::KEEPALIVE_RESPONSE).toLatin1();
+    profile->m_keepaliveIntervalMs = keepalive.value("intervalMs").toInt(profile->m_keepaliveIntervalMs);
+    if (profile->m_keepaliveRequest.isEmpty() || profile->m_keepaliveResponse.isEmpty()
+        || profile->m_keepaliveIntervalMs <= 0) {
+        *errorMessage = "keepalive needs a request, a response and a positive intervalMs";
+        return nullptr;
+    }
+
+    const QJsonObject ack = definition.value("ack").toObject();
+    profile->m_maxRetries = ack.value("maxRetries").toInt(profile->m_maxRetries);
+    if (profile->m_maxRetries < 0) {
+        *errorMessage = "ack.maxRetries must not be negative";
+        return nullptr;
+    }
+    profile->m_priceWindow = ack.value("priceWindow").toInt(profile->m_priceWindow);
+    if (profile->m_priceWindow < 1) {
+        *errorMessage = "ack.priceWindow must be at least 1";
+        return nullptr;
+    }
+
+    return profile;
+}
+
+std::shared_ptr<const VmcProfile> VmcProfile::loadFile(const QString &fileName, const QString &name,
+                                                       QString *errorMessage)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *errorMessage = QString("Cannot open %1: %2").arg(fileName, file.errorString());
+        return nullptr;
+    }
+
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (parseError.error != QJsonParseError::NoError) {
+        *errorMessage = QString("%1: %2").arg(fileName, parseError.errorString());
+        return nullptr;
+    }
+
+    const QString wanted = name.isEmpty() ? document.object().value("active").toString() : name;
+    const QJsonArray profiles = document.object().value("profiles").toArray();
+    for (const QJsonValue &entry : profiles) {
+        const QJsonObject definition = entry.toObject();
+        if (!wanted.isEmpty() && definition.value("name").toString() != wanted) {
+            continue;
+        }
+        QString compileError;
+        std::shared_ptr<const VmcProfile> profile = compile(definition, &compileError);
+        if (!profile) {
+            *errorMessage = QString("%1: profile %2: %3").arg(fileName, definition.value("name").toString(),
+                                                             compileError);
+        }
+        return profile;
+    }
+
+    *errorMessage = wanted.isEmpty() ? QString("%1: no profiles").arg(fileName)
+                                     : QString("%1: no profile named %2").arg(fileName, wanted);
+    return nullptr;
+}
+
+QByteArray VmcProfile::keyFrame(QChar key) const
+{
+    const ushort code = key.unicode();
+    if (code >= KEY_TABLE_SIZE || !m_hasKey[code]) {
+        return QByteArray();
+    }
+    return QByteArray(m_keyFrames[code], VmcProtocol::FRAME_SIZE);
+}
+
+QChar VmcProfile::keyForFrame(quint8 command, quint8 arg, quint8 value) const
+{
+    if (m_commandClass[command] != KeypadCommand) {
+        return QChar();
+    }
+    const quint32 payload = payloadKey(command, arg, value);
+    int index = (payload * 2654435761u) >> 27;
+    for (int probes = 0; probes < DECODE_TABLE_SIZE && m_keyDecode[index].payload != 0; ++probes) {
+        if (m_keyDecode[index].payload == payload) {
+            return QLatin1Char(m_keyDecode[index].key);
+        }
+        index = (index + 1) & (DECODE_TABLE_SIZE - 1);
+    }
+    return QChar();
+}
+
+QByteArray VmcProfile::encodePrice(int selection, int price) const
+{
+    if (selection < 0 || selection > m_maxSelection || price < 0 || price > m_maxPrice) {
+        return QByteArray();
+    }
+    const quint8 command = static_cast<quint8>(m_priceCommand | ((price >> 8) & m_priceHighMask));
+    const quint8 low = static_cast<quint8>(price & 0xFF);
+    return m_selectionInArg ? VmcProtocol::encodeFrame(command, static_cast<quint8>(selection), low)
+                            : VmcProtocol::encodeFrame(command, low, static_cast<quint8>(selection));
+}
+
+bool VmcProfile::decodePrice(const QByteArray &frame, int *selection, int *price) const
+{
+    if (!VmcProtocol::isFrame(frame)) {
+        return false;
+    }
+    const quint8 command = static_cast<quint8>(frame.at(1));
+    if (m_commandClass[command] != PriceCommand) {
+        return false;
+    }
+    const quint8 arg = static_cast<quint8>(frame.at(2));
+    const quint8 value = static_cast<quint8>(frame.at(3));
+    *selection = m_selectionInArg ? arg : value;
+    *price = ((command & m_priceHighMask) << 8) | (m_selectionInArg ? value : arg);
+    return true;
+}
+
+VmcProfileLoader::VmcProfileLoader(QObject *parent)
+    : QObject(parent)
+{
+    connect(&m_watcher, &QFileSystemWatcher::fileChanged, this, &VmcProfileLoader::handleFileChanged);
+}
+
+bool VmcProfileLoader::load(const QString &fileName, const QString &profileName, QString *errorMessage)
+{
+    std::shared_ptr<const VmcProfile> profile = VmcProfile::loadFile(fileName, profileName, errorMessage);
+    if (!profile) {
+        return false;
+    }
+
+    if (!m_fileName.isEmpty()) {
+        m_watcher.removePath(m_fileName);
+    }
+    m_fileName = QFileInfo(fileName).absoluteFilePath();
+    m_profileName = profileName;
+    m_watcher.addPath(m_fileName);
+
+    VmcProfile::setCurrent(profile);
+    qDebug() << "VMC profile" << profile->name() << "loaded from" << m_fileName;
+    emit profileChanged(profile->name());
+    return true;
+}
+
+void VmcProfileLoader::handleFileChanged(const QString &path)
+{
+    // Editors that save by rename drop the watch; put it back
+    if (!m_watcher.files().contains(path) && QFile::exists(path)) {
+        m_watcher.addPath(path);
+    }
+
+    QString error;
+    std::shared_ptr<const VmcProfile> profile = VmcProfile::loadFile(path, m_profileName, &error);
+    if (!profile) {
+        qDebug() << "VMC profile reload failed, keeping" << VmcProfile::current()->name() << ":" << error;
+        emit loadFailed(error);
+        return;
+    }
+
+    VmcProfile::setCurrent(profile);
+    qDebug() << "VMC profile" << profile->name() << "reloaded from" << path;
+    emit profileChanged(profile->name());
+}
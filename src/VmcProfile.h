@@ -0,0 +1,113 @@
+#ifndef VMCPROFILE_H
+#define VMCPROFILE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QFileSystemWatcher>
+#include <QString>
+#include <memory>
+#include "VmcProtocol.h"
+
+class QJsonObject;
+
+// One VMC model's wire details: keymap, price frame layout, keepalive
+// signature and link timeouts. A profile is compiled once into flat tables
+// and never changes afterwards; the active one is swapped as a whole, so a
+// frame is always encoded and decoded against a single consistent profile.
+class VmcProfile
+{
+public:
+    enum CommandClass : quint8 {
+        OtherCommand,
+        KeypadCommand,
+        PriceCommand,
+        CreditCommand,
+        ErrorCommand
+    };
+
+    static std::shared_ptr<const VmcProfile> current();
+    static void setCurrent(std::shared_ptr<const VmcProfile> profile);
+    static std::shared_ptr<const VmcProfile> builtIn();
+
+    // A profile file holds {"active": name, "profiles": [...]}; name overrides "active"
+    static std::shared_ptr<const VmcProfile> loadFile(const QString &fileName, const QString &name,
+                                                      QString *errorMessage);
+    static std::shared_ptr<const VmcProfile> compile(const QJsonObject &definition, QString *errorMessage);
+
+    QString name() const { return m_name; }
+
+    QByteArray keyFrame(QChar key) const;
+    QChar keyForFrame(quint8 command, quint8 arg, quint8 value) const;
+
+    QByteArray encodePrice(int selection, int price) const;
+    bool decodePrice(const QByteArray &frame, int *selection, int *price) const;
+    int maxPrice() const { return m_maxPrice; }
+    int maxSelection() const { return m_maxSelection; }
+
+    CommandClass commandClass(quint8 command) const { return m_commandClass[command]; }
+
+    const QByteArray &keepaliveRequest() const { return m_keepaliveRequest; }
+    const QByteArray &keepaliveResponse() const { return m_keepaliveResponse; }
+    int keepaliveIntervalMs() const { return m_keepaliveIntervalMs; }
+    int maxRetries() const { return m_maxRetries; }
+    int priceWindow() const { return m_priceWindow; }   // Price frames in flight during an upload
+
+private:
+    VmcProfile();
+
+    static const int KEY_TABLE_SIZE = 128;     // Indexed by the key's ASCII code
+    static const int DECODE_TABLE_SIZE = 32;   // Open addressing, power of two
+
+    struct KeySlot {
+        quint32 payload = 0;                   // (command << 16 | arg << 8 | value) + 1; 0 is empty
+        char key = 0;
+    };
+
+    QString m_name;
+    char m_keyFrames[KEY_TABLE_SIZE][VmcProtocol::FRAME_SIZE];
+    bool m_hasKey[KEY_TABLE_SIZE];
+    KeySlot m_keyDecode[DECODE_TABLE_SIZE];
+    CommandClass m_commandClass[256];
+
+    quint8 m_priceCommand;
+    quint8 m_priceHighMask;                    // Price bits carried in the command byte
+    bool m_selectionInArg;                     // Otherwise selection is in value, price low byte in arg
+    int m_maxPrice;
+    int m_maxSelection;
+
+    QByteArray m_keepaliveRequest;
+    QByteArray m_keepaliveResponse;
+    int m_keepaliveIntervalMs;
+    int m_maxRetries;
+    int m_priceWindow;
+
+    bool addKey(char key, const QByteArray &frame, QString *errorMessage);
+    static quint32 payloadKey(quint8 command, quint8 arg, quint8 value);
+};
+
+// Loads the active profile from a file and reloads it when the file changes.
+// A file that fails to load or compile leaves the running profile in place.
+class VmcProfileLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit VmcProfileLoader(QObject *parent = nullptr);
+
+    bool load(const QString &fileName, const QString &profileName, QString *errorMessage);
+    QString fileName() const { return m_fileName; }
+
+signals:
+    void profileChanged(const QString &name);
+    void loadFailed(const QString &errorMessage);
+
+private slots:
+    void handleFileChanged(const QString &path);
+
+private:
+    QFileSystemWatcher m_watcher;
+    QString m_fileName;
+    QString m_profileName;
+};
+
+#endif // VMCPROFILE_H
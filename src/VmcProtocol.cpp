@@ -0,0 +1,156 @@
+#include "VmcProtocol.h"
+#include "MemoryBudget.h"
+#include "VmcProfile.h"
+
+quint8 VmcProtocol::checksum(const char *data, int length)
+{
+    quint8 sum = 0;
+    for (int i = 0; i < length; ++i) {
+        sum = static_cast<quint8>(sum + static_cast<quint8>(data[i]));
+    }
+    return sum;
+}
+
+bool VmcProtocol::hasValidChecksum(const char *frame)
+{
+    quint8 expected = static_cast<quint8>(frame[4]);
+    return checksum(frame, 4) == expected || checksum(frame + 1, 3) == expected;
+}
+
+QByteArray VmcProtocol::encodeFrame(quint8 command, quint8 arg, quint8 value)
+{
+    QByteArray frame;
+    frame.reserve(FRAME_SIZE);
+    frame.append(SYNC);
+    frame.append(static_cast<char>(command));
+    frame.append(static_cast<char>(arg));
+    frame.append(static_cast<char>(value));
+    frame.append(static_cast<char>(checksum(frame.constData(), 4)));
+    return frame;
+}
+
+QByteArray VmcProtocol::encodePriceFrame(int selection, int price)
+{
+    if (selection < 0 || selection > MAX_SELECTION || price < 0 || price > MAX_PRICE) {
+        return QByteArray();
+    }
+    return encodeFrame(static_cast<quint8>(PRICE_COMMAND | (price >> 8)),
+                       static_cast<quint8>(selection),
+                       static_cast<quint8>(price & 0xFF));
+}
+
+bool VmcProtocol::decodePriceFrame(const QByteArray &frame, int *selection, int *price)
+{
+    if (!isFrame(frame)) {
+        return false;
+    }
+
+    quint8 command = static_cast<quint8>(frame.at(1));
+    if ((command & 0xFC) != PRICE_COMMAND) {
+        return false;
+    }
+
+    *selection = static_cast<quint8>(frame.at(2));
+    *price = ((command & 0x03) << 8) | static_cast<quint8>(frame.at(3));
+    return true;
+}
+
+bool VmcProtocol::isFrame(const QByteArray &data)
+{
+    return data.size() == FRAME_SIZE && data.at(0) == SYNC;
+}
+
+bool VmcFrame::acknowledges(const QByteArray &sent) const
+{
+    if (isKeepaliveResponse) {
+        return sent == VmcProfile::current()->keepaliveRequest();
+    }
+    return VmcProtocol::isFrame(sent)
+        && static_cast<quint8>(sent.at(1)) == command
+        && static_cast<quint8>(sent.at(2)) == arg
+        && static_cast<quint8>(sent.at(3)) == value;
+}
+
+VmcFrameDecoder::VmcFrameDecoder()
+    : m_keepaliveResponse(VmcProtocol::KEEPALIVE_RESPONSE)
+    , m_framesDecoded(0)
+    , m_checksumErrors(0)
+    , m_discardedBytes(0)
+{
+}
+
+VmcFrameDecoder::~VmcFrameDecoder()
+{
+    MemoryBudget::release(MemoryBudget::SerialBuffers, m_buffer.size());
+}
+
+void VmcFrameDecoder::reset()
+{
+    MemoryBudget::clear(MemoryBudget::SerialBuffers, &m_buffer);
+}
+
+QVector<VmcFrame> VmcFrameDecoder::feed(const QByteArray &data)
+{
+    QVector<VmcFrame> frames;
+    // Unparsed bytes are charged to the serial budget; over it the oldest are discarded
+    const int before = m_buffer.size();
+    MemoryBudget::appendEvictingOldest(MemoryBudget::SerialBuffers, &m_buffer, data);
+    m_discardedBytes += before + data.size() - m_buffer.size();
+    const int held = m_buffer.size();
+
+    const QByteArray &keepaliveResponse = m_keepaliveResponse;
+
+    while (!m_buffer.isEmpty()) {
+        int sync = m_buffer.indexOf(VmcProtocol::SYNC);
+        int signature = m_buffer.indexOf(keepaliveResponse);
+
+        if (signature >= 0 && (sync < 0 || signature < sync)) {
+            VmcFrame frame;
+            frame.isKeepaliveResponse = true;
+            frame.raw = keepaliveResponse;
+            frames.append(frame);
+            m_framesDecoded++;
+            m_discardedBytes += signature;
+            m_buffer.remove(0, signature + keepaliveResponse.size());
+            continue;
+        }
+
+        if (sync < 0) {
+            // Hold back a possible partial keepalive signature
+            int keep = qMin(m_buffer.size(), keepaliveResponse.size() - 1);
+            m_discardedBytes += m_buffer.size() - keep;
+            m_buffer.remove(0, m_buffer.size() - keep);
+            break;
+        }
+
+        if (sync > 0) {
+            m_discardedBytes += sync;
+            m_buffer.remove(0, sync);
+        }
+
+        if (m_buffer.size() < VmcProtocol::FRAME_SIZE) {
+            break;
+        }
+
+        const char *bytes = m_buffer.constData();
+        if (!VmcProtocol::hasValidChecksum(bytes)) {
+            // Drop the false sync and look for the next one
+            m_checksumErrors++;
+            m_discardedBytes++;
+            m_buffer.remove(0, 1);
+            continue;
+        }
+
+        VmcFrame frame;
+        frame.command = static_cast<quint8>(bytes[1]);
+        frame.arg = static_cast<quint8>(bytes[2]);
+        frame.value = static_cast<quint8>(bytes[3]);
+        frame.raw = m_buffer.left(VmcProtocol::FRAME_SIZE);
+        frames.append(frame);
+        m_framesDecoded++;
+        m_buffer.remove(0, VmcProtocol::FRAME_SIZE);
+    }
+
+    MemoryBudget::release(MemoryBudget::SerialBuffers, held - m_buffer.size());
+    return frames;
+}
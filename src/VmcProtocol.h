@@ -0,0 +1,78 @@
+#ifndef VMCPROTOCOL_H
+#define VMCPROTOCOL_H
+
+#include <QByteArray>
+#include <QMetaType>
+#include <QVector>
+
+// VMC binary frames are five bytes: 0x0B <command> <arg> <value> <checksum>,
+// where the checksum is the low byte of the sum of the first four bytes.
+// The VMC acknowledges a frame by echoing it back.
+namespace VmcProtocol {
+    const char SYNC = 0x0B;
+    const int FRAME_SIZE = 5;
+
+    // Keepalive is ASCII "00"; the VMC answers with ASCII "0B0FFA"
+    const char KEEPALIVE_REQUEST[] = "00";
+    const char KEEPALIVE_RESPONSE[] = "0B0FFA";
+
+    // Price frames carry the top two bits of the price in the command byte:
+    // 0x10 | (price >> 8), selection, price & 0xFF. Selection 0 means all.
+    const quint8 PRICE_COMMAND = 0x10;
+    const int MAX_PRICE = 999;
+    const int MAX_SELECTION = 255;
+
+    // Unsolicited status frames from the VMC
+    const quint8 CREDIT_COMMAND = 0x20;  // arg = credit high byte, value = low byte (cents)
+    const quint8 ERROR_COMMAND = 0x30;   // arg = error code, value = flags (0 when cleared)
+
+    quint8 checksum(const char *data, int length);
+    // Some firmware leaves the sync byte out of the sum (see the key 2 frame)
+    bool hasValidChecksum(const char *frame);
+    QByteArray encodeFrame(quint8 command, quint8 arg, quint8 value);
+    QByteArray encodePriceFrame(int selection, int price);
+    bool decodePriceFrame(const QByteArray &frame, int *selection, int *price);
+    bool isFrame(const QByteArray &data);
+}
+
+struct VmcFrame {
+    quint8 command = 0;
+    quint8 arg = 0;
+    quint8 value = 0;
+    bool isKeepaliveResponse = false;
+    QByteArray raw;
+
+    // True when this frame is the VMC's echo of a frame we sent
+    bool acknowledges(const QByteArray &sent) const;
+};
+
+Q_DECLARE_METATYPE(VmcFrame)
+
+// Streaming decoder: accepts arbitrary RX chunks and returns complete frames
+class VmcFrameDecoder
+{
+public:
+    VmcFrameDecoder();
+    ~VmcFrameDecoder();
+
+    QVector<VmcFrame> feed(const QByteArray &data);
+    void reset();
+
+    // Defaults to KEEPALIVE_RESPONSE; VMC models with another signature set theirs
+    void setKeepaliveResponse(const QByteArray &signature) { m_keepaliveResponse = signature; }
+
+    quint64 framesDecoded() const { return m_framesDecoded; }
+    quint64 checksumErrors() const { return m_checksumErrors; }
+    quint64 discardedBytes() const { return m_discardedBytes; }
+
+private:
+    Q_DISABLE_COPY(VmcFrameDecoder)
+
+    QByteArray m_buffer;
+    QByteArray m_keepaliveResponse;
+    quint64 m_framesDecoded;
+    quint64 m_checksumErrors;
+    quint64 m_discardedBytes;
+};
+
+#endif // VMCPROTOCOL_H
@@ -0,0 +1,246 @@
+#include "VmcRecovery.h"
+#include "AutoKeypress.h"
+#include "Metrics.h"
+#include "SerialCommunication.h"
+#include "VmcProfile.h"
+#include <QDebug>
+#include <QSettings>
+#include <QStringList>
+
+VmcRecovery::VmcRecovery(SerialCommunication *serialComm, QObject *parent)
+    : QObject(parent)
+    , m_serialComm(serialComm)
+    , m_autoKeypress(nullptr)
+    , m_enabled(false)
+    , m_state(Idle)
+    , m_errorCode(0)
+    , m_errorFlags(0)
+    , m_consecutiveFailures(0)
+    , m_firstSymptomNs(0)
+    , m_detectedNs(0)
+    , m_clearSentNs(0)
+    , m_attempts(0)
+    , m_pausedAutomation(false)
+    , m_faults(0)
+    , m_recoveries(0)
+    , m_failures(0)
+{
+    m_verifyTimer.setSingleShot(true);
+    connect(&m_verifyTimer, &ClockTimer::timeout, this, &VmcRecovery::handleVerifyTimeout);
+    connect(m_serialComm, &SerialCommunication::frameReceived, this, &VmcRecovery::handleFrame);
+    connect(m_serialComm, &SerialCommunication::frameDelivered, this, &VmcRecovery::handleFrameDelivered);
+    connect(m_serialComm, &SerialCommunication::frameFailed, this, &VmcRecovery::handleFrameFailed);
+    connect(m_serialComm, &SerialCommunication::portStatusChanged, this, [this](bool isOpen) {
+        if (!isOpen) {
+            reset();
+            // Keys sent into a closed link are lost; hold automation until the VMC is back
+            if (m_enabled && m_autoKeypress && m_autoKeypress->isRunning() && !m_autoKeypress->isPaused()) {
+                m_autoKeypress->pauseSequence();
+                m_pausedAutomation = true;
+            }
+        } else if (m_pausedAutomation) {
+            // Automation waited out the outage; the VMC's state is checked before it resumes
+            recover();
+        }
+    });
+}
+
+QByteArray VmcRecovery::clearFrame(quint8 errorCode)
+{
+    return VmcProtocol::encodeFrame(VmcProtocol::ERROR_COMMAND, errorCode, 0);
+}
+
+bool VmcRecovery::parseFrames(const QString &text, QList<QByteArray> *frames, QString *errorMessage)
+{
+    QList<QByteArray> result;
+    const QStringList tokens = text.split(' ', Qt::SkipEmptyParts);
+    for (const QString &token : tokens) {
+        const QByteArray hex = token.toLatin1();
+        const QByteArray frame = QByteArray::fromHex(hex);
+        if (frame.isEmpty() || frame.toHex() != hex.toLower()) {
+            *errorMessage = QString("'%1' is not a hex frame").arg(token);
+            return false;
+        }
+        result.append(frame);
+    }
+    *frames = result;
+    return true;
+}
+
+VmcRecovery::Options VmcRecovery::optionsFromSettings()
+{
+    Options options;
+    QSettings settings("YourCompany", "asdKeypad");
+    QString parseError;
+    if (!parseFrames(settings.value("RecoveryClearFrames").toString(), &options.clearFrames, &parseError)) {
+        qWarning() << "RecoveryClearFrames:" << parseError << "- using the default clear frame";
+    }
+    options.verifyTimeoutMs = qMax(1, settings.value("RecoveryVerifyTimeoutMs", DEFAULT_VERIFY_TIMEOUT_MS).toInt());
+    options.maxAttempts = qMax(1, settings.value("RecoveryMaxAttempts", DEFAULT_MAX_ATTEMPTS).toInt());
+    options.failureThreshold = qMax(0, settings.value("RecoveryFailureThreshold", DEFAULT_FAILURE_THRESHOLD).toInt());
+    options.rewindSteps = qMax(0, settings.value("RecoveryRewindSteps", 0).toInt());
+    return options;
+}
+
+void VmcRecovery::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+    m_consecutiveFailures = 0;
+    m_firstSymptomNs = 0;
+}
+
+void VmcRecovery::recover()
+{
+    if (m_state == Verifying) {
+        return;
+    }
+    m_detectedNs = VirtualClock::monotonicNs();
+    if (m_autoKeypress && m_autoKeypress->isRunning() && !m_autoKeypress->isPaused()) {
+        m_autoKeypress->pauseSequence();
+        m_pausedAutomation = true;
+    }
+    m_attempts = 0;
+    sendClearSequence();
+}
+
+void VmcRecovery::reset()
+{
+    m_verifyTimer.stop();
+    m_state = Idle;
+    m_errorFlags = 0;
+    m_consecutiveFailures = 0;
+    m_firstSymptomNs = 0;
+    m_awaitingEcho.clear();
+    // The link is gone; reconnecting is SerialCommunication's job, not ours. Automation
+    // we paused stays paused, and the error code is kept for the clear after a reconnect.
+}
+
+void VmcRecovery::handleFrame(const VmcFrame &frame)
+{
+    const bool isError = !frame.isKeepaliveResponse
+                         && VmcProfile::current()->commandClass(frame.command) == VmcProfile::ErrorCommand;
+    if (!isError) {
+        return;
+    }
+    // The VMC acks our clear frames by echoing them; an echo says nothing about its state
+    for (int i = 0; i < m_awaitingEcho.size(); ++i) {
+        if (frame.acknowledges(m_awaitingEcho.at(i))) {
+            m_awaitingEcho.removeAt(i);
+            return;
+        }
+    }
+    m_errorCode = frame.arg;
+    m_errorFlags = frame.value;
+
+    switch (m_state) {
+    case Idle:
+        if (m_enabled && m_errorFlags != 0) {
+            startRecovery(QString("VMC reported error %1 (flags 0x%2)")
+                          .arg(int(m_errorCode)).arg(int(m_errorFlags), 2, 16, QLatin1Char('0')));
+        }
+        break;
+    case Verifying:
+    case Failed:
+        // A clean status report after the echoes is the VMC confirming the
+        // clear; in Failed it means someone cleared it at the machine
+        if (m_errorFlags == 0) {
+            finishRecovery();
+        }
+        break;
+    }
+}
+
+void VmcRecovery::handleFrameDelivered()
+{
+    // While verifying, an ack only shows the link is up; the state comes from a status report
+    if (m_state == Idle) {
+        m_consecutiveFailures = 0;
+        m_firstSymptomNs = 0;
+    }
+}
+
+void VmcRecovery::handleFrameFailed()
+{
+    if (m_state != Idle) {
+        return;
+    }
+    if (m_consecutiveFailures++ == 0) {
+        m_firstSymptomNs = VirtualClock::monotonicNs();
+    }
+    if (m_enabled && m_options.failureThreshold > 0 && m_consecutiveFailures >= m_options.failureThreshold) {
+        startRecovery(QString("%1 frames in a row were not acknowledged").arg(m_consecutiveFailures));
+    }
+}
+
+void VmcRecovery::handleVerifyTimeout()
+{
+    if (m_attempts < m_options.maxAttempts) {
+        qDebug() << "VMC recovery: no clean state after attempt" << m_attempts << "- clearing again";
+        sendClearSequence();
+        return;
+    }
+
+    m_state = Failed;
+    m_failures++;
+    Metrics::instance().vmcRecoveryFailures.add();
+    const QString reason = QString("VMC still faulted after %1 clear attempts").arg(m_attempts);
+    qWarning() << "VMC recovery:" << reason;
+    emit recoveryFailed(reason);
+}
+
+void VmcRecovery::startRecovery(const QString &description)
+{
+    m_detectedNs = VirtualClock::monotonicNs();
+    // Measured from the first unacknowledged frame when the fault showed up that way first
+    const qint64 detectMs = m_firstSymptomNs > 0 ? (m_detectedNs - m_firstSymptomNs) / 1000000 : 0;
+    m_faults++;
+    Metrics::instance().vmcFaults.add();
+    Metrics::instance().vmcFaultDetectMs.record(detectMs);
+    qWarning() << "VMC fault:" << description << "- detected in" << detectMs << "ms, recovering";
+    emit faultDetected(description, detectMs);
+
+    if (m_autoKeypress && m_autoKeypress->isRunning() && !m_autoKeypress->isPaused()) {
+        m_autoKeypress->pauseSequence();
+        m_pausedAutomation = true;
+    }
+    m_attempts = 0;
+    sendClearSequence();
+}
+
+void VmcRecovery::sendClearSequence()
+{
+    m_attempts++;
+    const QList<QByteArray> frames = m_options.clearFrames.isEmpty()
+                                     ? QList<QByteArray>{clearFrame(m_errorCode)}
+                                     : m_options.clearFrames;
+    m_awaitingEcho = frames;
+    for (const QByteArray &frame : frames) {
+        // A failed send is retried by the verify timeout like an ignored one
+        m_serialComm->sendCommand(frame, TxPriority::Operator);
+    }
+    m_clearSentNs = VirtualClock::monotonicNs();
+    m_state = Verifying;
+    m_verifyTimer.start(m_options.verifyTimeoutMs);
+}
+
+void VmcRecovery::finishRecovery()
+{
+    m_verifyTimer.stop();
+    m_awaitingEcho.clear();
+    if (m_pausedAutomation && m_autoKeypress) {
+        m_autoKeypress->resumeSequence(m_options.rewindSteps);
+    }
+    m_pausedAutomation = false;
+
+    const qint64 recoverMs = (VirtualClock::monotonicNs() - m_detectedNs) / 1000000;
+    m_recoveries++;
+    Metrics::instance().vmcRecoveries.add();
+    Metrics::instance().vmcRecoveryMs.record(recoverMs);
+    qDebug() << "VMC recovered in" << recoverMs << "ms after" << m_attempts << "clear attempt(s),"
+             << (VirtualClock::monotonicNs() - m_clearSentNs) / 1000000 << "ms after the last";
+
+    m_state = Idle;
+    m_consecutiveFailures = 0;
+    m_firstSymptomNs = 0;
+    emit recovered(recoverMs, m_attempts);
+}
@@ -0,0 +1,106 @@
+#ifndef VMCRECOVERY_H
+#define VMCRECOVERY_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QList>
+#include "VirtualClock.h"
+#include "VmcProtocol.h"
+
+class AutoKeypress;
+class SerialCommunication;
+
+// Detects VMC faults in the RX stream and recovers without an operator:
+// automation is paused, the clear sequence is sent, the VMC must then report
+// a clean state within the verify timeout, and automation resumes where it
+// stopped. The report is a clean error frame arriving after the echoes of the
+// clear frames, never the echo itself. A fault is an error frame with nonzero
+// flags, or a run of frames the VMC never acknowledged. If the link drops,
+// automation stays paused until the port reopens and the state is verified
+// again. Detection and recovery times go to Metrics.
+class VmcRecovery : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum State {
+        Idle,
+        Verifying,     // Clear sequence sent, waiting for a clean state
+        Failed         // Out of attempts; automation stays paused
+    };
+
+    static const int DEFAULT_VERIFY_TIMEOUT_MS = 2000;
+    static const int DEFAULT_MAX_ATTEMPTS = 3;
+    static const int DEFAULT_FAILURE_THRESHOLD = 3;
+
+    struct Options {
+        QList<QByteArray> clearFrames;         // Empty: clearFrame() for the reported error code
+        int verifyTimeoutMs = DEFAULT_VERIFY_TIMEOUT_MS;
+        int maxAttempts = DEFAULT_MAX_ATTEMPTS;
+        int failureThreshold = DEFAULT_FAILURE_THRESHOLD;  // Unacknowledged frames in a row; 0 disables
+        int rewindSteps = 0;                   // Automation steps to repeat on resume
+    };
+
+    explicit VmcRecovery(SerialCommunication *serialComm, QObject *parent = nullptr);
+
+    // Frame that clears error code on the VMC: the error frame with its flags zeroed
+    static QByteArray clearFrame(quint8 errorCode);
+    // Space separated hex frames, e.g. "0b30000043 0b00000b"
+    static bool parseFrames(const QString &text, QList<QByteArray> *frames, QString *errorMessage);
+    static Options optionsFromSettings();
+
+    void setAutomation(AutoKeypress *autoKeypress) { m_autoKeypress = autoKeypress; }
+    void setOptions(const Options &options) { m_options = options; }
+    Options options() const { return m_options; }
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return m_enabled; }
+    State state() const { return m_state; }
+
+    quint64 faults() const { return m_faults; }
+    quint64 recoveries() const { return m_recoveries; }
+    quint64 failures() const { return m_failures; }
+
+public slots:
+    // Runs the recovery sequence now, e.g. for the operator's Clear VMC Error
+    void recover();
+    void reset();
+
+signals:
+    void faultDetected(const QString &description, qint64 detectMs);
+    void recovered(qint64 recoverMs, int attempts);
+    void recoveryFailed(const QString &reason);
+
+private slots:
+    void handleFrame(const VmcFrame &frame);
+    void handleFrameDelivered();
+    void handleFrameFailed();
+    void handleVerifyTimeout();
+
+private:
+    SerialCommunication *m_serialComm;
+    AutoKeypress *m_autoKeypress;
+    Options m_options;
+    bool m_enabled;
+    State m_state;
+    ClockTimer m_verifyTimer;
+
+    quint8 m_errorCode;
+    quint8 m_errorFlags;
+    int m_consecutiveFailures;
+    qint64 m_firstSymptomNs;                   // First unacknowledged frame of the current run, 0 if none
+    qint64 m_detectedNs;
+    qint64 m_clearSentNs;
+    QList<QByteArray> m_awaitingEcho;         // Clear frames whose echo has not come back
+    int m_attempts;
+    bool m_pausedAutomation;
+
+    quint64 m_faults;
+    quint64 m_recoveries;
+    quint64 m_failures;
+
+    void startRecovery(const QString &description);
+    void sendClearSequence();
+    void finishRecovery();
+};
+
+#endif // VMCRECOVERY_H
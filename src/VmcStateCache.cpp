@@ -0,0 +1,96 @@
+#include "VmcStateCache.h"
+#include "VmcProfile.h"
+#include <QDateTime>
+#include <algorithm>
+
+VmcStateCache::VmcStateCache(QObject *parent)
+    : QObject(parent)
+{
+    reset();
+}
+
+int VmcStateCache::price(int selection) const
+{
+    if (selection < 0 || selection > VmcProtocol::MAX_SELECTION) {
+        return UNKNOWN_PRICE;
+    }
+    return m_prices[selection];
+}
+
+void VmcStateCache::reset()
+{
+    m_selectionEntry.clear();
+    m_lastCommittedSelection.clear();
+    m_creditCents = 0;
+    std::fill(std::begin(m_prices), std::end(m_prices), UNKNOWN_PRICE);
+    m_errorCode = 0;
+    m_errorFlags = 0;
+    m_lastSeenMs = 0;
+    m_lastKeypressMs = 0;
+    m_lastCreditMs = 0;
+    m_lastErrorMs = 0;
+    emit stateChanged();
+}
+
+void VmcStateCache::handleFrame(const VmcFrame &frame)
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    m_lastSeenMs = now;
+
+    if (frame.isKeepaliveResponse) {
+        emit stateChanged();
+        return;
+    }
+
+    // Keypad frames echoed by the VMC map back to the key that produced them
+    const std::shared_ptr<const VmcProfile> profile = VmcProfile::current();
+    const VmcProfile::CommandClass commandClass = profile->commandClass(frame.command);
+    const QChar key = profile->keyForFrame(frame.command, frame.arg, frame.value);
+    if (!key.isNull()) {
+        handleKey(key, now);
+    } else if (commandClass == VmcProfile::PriceCommand) {
+        int selection = 0;
+        int cents = 0;
+        profile->decodePrice(frame.raw, &selection, &cents);
+        if (selection == 0) {
+            // Selection 0 sets every selection at once
+            std::fill(std::begin(m_prices), std::end(m_prices), cents);
+        } else {
+            m_prices[selection] = cents;
+        }
+        emit priceChanged(selection, cents);
+    } else if (commandClass == VmcProfile::CreditCommand) {
+        int cents = (frame.arg << 8) | frame.value;
+        m_lastCreditMs = now;
+        if (cents != m_creditCents) {
+            m_creditCents = cents;
+            emit creditChanged(cents);
+        }
+    } else if (commandClass == VmcProfile::ErrorCommand) {
+        m_lastErrorMs = now;
+        if (frame.arg != m_errorCode || frame.value != m_errorFlags) {
+            m_errorCode = frame.arg;
+            m_errorFlags = frame.value;
+            emit errorChanged(m_errorCode, m_errorFlags);
+        }
+    }
+
+    emit stateChanged();
+}
+
+void VmcStateCache::handleKey(QChar key, qint64 now)
+{
+    m_lastKeypressMs = now;
+
+    if (key == '*') {
+        m_selectionEntry.clear();
+    } else if (key == '#') {
+        m_lastCommittedSelection = m_selectionEntry;
+        m_selectionEntry.clear();
+        emit selectionCommitted(m_lastCommittedSelection);
+    } else {
+        m_selectionEntry.append(key);
+    }
+
+    emit selectionEntryChanged(m_selectionEntry);
+}
@@ -0,0 +1,60 @@
+#ifndef VMCSTATECACHE_H
+#define VMCSTATECACHE_H
+
+#include <QObject>
+#include <QString>
+#include "VmcProtocol.h"
+
+// Local mirror of the VMC's state, built from decoded RX frames so the UI and
+// automation can query it without a round trip to the machine.
+class VmcStateCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int UNKNOWN_PRICE = -1;
+
+    explicit VmcStateCache(QObject *parent = nullptr);
+
+    QString selectionEntry() const { return m_selectionEntry; }
+    QString lastCommittedSelection() const { return m_lastCommittedSelection; }
+    int creditCents() const { return m_creditCents; }
+    int price(int selection) const;
+    bool hasError() const { return m_errorFlags != 0; }
+    quint8 errorCode() const { return m_errorCode; }
+    quint8 errorFlags() const { return m_errorFlags; }
+
+    // Milliseconds since epoch, 0 if never seen
+    qint64 lastSeenMs() const { return m_lastSeenMs; }
+    qint64 lastKeypressMs() const { return m_lastKeypressMs; }
+    qint64 lastCreditMs() const { return m_lastCreditMs; }
+    qint64 lastErrorMs() const { return m_lastErrorMs; }
+
+public slots:
+    void handleFrame(const VmcFrame &frame);
+    void reset();
+
+signals:
+    void selectionEntryChanged(const QString &entry);
+    void selectionCommitted(const QString &selection);
+    void creditChanged(int cents);
+    void priceChanged(int selection, int cents);
+    void errorChanged(quint8 code, quint8 flags);
+    void stateChanged();
+
+private:
+    QString m_selectionEntry;
+    QString m_lastCommittedSelection;
+    int m_creditCents;
+    int m_prices[VmcProtocol::MAX_SELECTION + 1];
+    quint8 m_errorCode;
+    quint8 m_errorFlags;
+    qint64 m_lastSeenMs;
+    qint64 m_lastKeypressMs;
+    qint64 m_lastCreditMs;
+    qint64 m_lastErrorMs;
+
+    void handleKey(QChar key, qint64 now);
+};
+
+#endif // VMCSTATECACHE_H
@@ -1,23 +1,336 @@
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QTextStream>
 #include "MainWindow.h"
+#include "CampaignRunner.h"
+#include "SimulationRunner.h"
+#include "FaultInjectingDevice.h"
+#include "LoadGenerator.h"
+#include "VmcDiscovery.h"
+#include "VmcProfile.h"
+#include "LinkProbe.h"
+#include "KeyRateTuner.h"
+#include "SyncInjector.h"
+#include "SerialBridge.h"
+#include "MetricsServer.h"
+#include "Tracer.h"
+#include "LogSink.h"
+#include "StallWatchdog.h"
+#include "MemoryBudget.h"
 
 #ifdef Q_OS_WIN
 #include <windows.h>
 #endif
 
+// Options that select a mode running without the GUI, given as --option value
+// or --option=value
+static bool isHeadless(int argc, char *argv[])
+{
+    static const char *const headlessOptions[] = {"--campaign", "--simulate", "--load", "--discover", "--probe", "--bridge",
+                                                  "--tune-rate", "--sync"};
+    for (int i = 1; i < argc; ++i) {
+        // QCommandLineParser takes everything after -- as positional
+        if (qstrcmp(argv[i], "--") == 0) {
+            break;
+        }
+        for (const char *option : headlessOptions) {
+            const uint length = qstrlen(option);
+            if (qstrncmp(argv[i], option, length) == 0 && (argv[i][length] == '\0' || argv[i][length] == '=')) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static int runHeadless(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption campaignOption("campaign", "Run the test campaign described in <file>.", "file");
+    QCommandLineOption simulateOption("simulate", "Run <script> against the simulated VMC on a virtual clock.", "script");
+    QCommandLineOption hoursOption("hours", "Simulated duration in hours.", "hours", "1");
+    QCommandLineOption intervalOption("interval", "Milliseconds between simulated keypresses.", "ms", "1000");
+    QCommandLineOption seedOption("seed", "Seed for the simulated VMC's response timing.", "seed", "1");
+    QCommandLineOption transcriptOption("transcript", "Write the simulated TX/RX transcript to <file>.", "file");
+    QCommandLineOption captureOption("capture", "Write a binary traffic capture of the simulation to <file>.", "file");
+    QCommandLineOption faultEveryOption("fault-every", "Make the simulated VMC raise an error every <frames> frames.",
+                                        "frames", "0");
+    QCommandLineOption faultsOption("faults",
+                                    "Inject link faults into --simulate or --load, e.g. drop=0.01,corrupt=0.0001.",
+                                    "spec");
+    QCommandLineOption recoverOption("recover", "Detect VMC faults and recover from them automatically.");
+    QCommandLineOption metricsPortOption("metrics-port", "Serve Prometheus metrics on 127.0.0.1:<port>.", "port");
+    QCommandLineOption traceOption("trace", "Record keypress path spans and save them as Chrome JSON to <file>.", "file");
+    QCommandLineOption loadOption("load", "Sweep open-loop keypress load over <port> (SIM for the simulated VMC).", "port");
+    QCommandLineOption ratesOption("rates", "Offered keypresses per second, one step per value.", "list", "1,2,5,10,20");
+    QCommandLineOption stepOption("step-seconds", "Length of each load step.", "seconds", "30");
+    QCommandLineOption arrivalOption("arrival", "Arrival schedule: constant, poisson or burst.", "schedule", "constant");
+    QCommandLineOption burstOption("burst", "Keypresses per burst with --arrival burst.", "count", "5");
+    QCommandLineOption loadKeysOption("load-keys", "Keys cycled through by the load, or a script file.", "keys", "1");
+    QCommandLineOption curveOption("curve", "Write the latency-vs-offered-load curve as CSV to <file>.", "file");
+    QCommandLineOption discoverOption("discover", "Probe every serial port for a VMC and list the ones that answer.");
+    QCommandLineOption baudsOption("bauds", "Baud rates tried by --discover, in order.", "list", "9600");
+    QCommandLineOption deadlineOption("deadline", "Milliseconds to wait for a VMC answer per baud rate.", "ms",
+                                      QString::number(VmcDiscovery::DEFAULT_DEADLINE_MS));
+    QCommandLineOption probeOption("probe", "Measure link quality to the VMC on <port> and suggest timeouts.", "port");
+    QCommandLineOption transactionsOption("transactions", "Transactions sent by --probe.", "count",
+                                          QString::number(LinkProbe::DEFAULT_TRANSACTIONS));
+    QCommandLineOption probeTimeoutOption("probe-timeout", "Milliseconds --probe waits for each answer.", "ms",
+                                          QString::number(LinkProbe::DEFAULT_TIMEOUT_MS));
+    QCommandLineOption tuneRateOption("tune-rate",
+                                      "Find the fastest key rate the VMC on <port> registers (SIM for the simulated VMC).",
+                                      "port");
+    QCommandLineOption minIntervalOption("min-interval", "Shortest interval between keys --tune-rate tries.", "ms",
+                                         QString::number(KeyRateTuner::DEFAULT_MIN_INTERVAL_MS));
+    QCommandLineOption simKeyOption("sim-key-ms", "Make the simulated VMC lose keys sent less than <ms> apart.",
+                                    "ms", "0");
+    QCommandLineOption syncOption("sync", "Press the same key on every VMC in the comma-separated <ports> at once.",
+                                  "ports");
+    QCommandLineOption syncEventsOption("sync-events", "Simultaneous keypresses sent by --sync.", "count",
+                                        QString::number(SyncInjector::DEFAULT_EVENTS));
+    QCommandLineOption syncIntervalOption("sync-interval", "Milliseconds between --sync keypresses.", "ms",
+                                          QString::number(SyncInjector::DEFAULT_INTERVAL_MS));
+    QCommandLineOption syncKeysOption("sync-keys", "Keys cycled through by --sync, or a script file.", "keys", "1");
+    QCommandLineOption syncCsvOption("sync-csv", "Write the skew and per-port offsets of every event to <file>.",
+                                     "file");
+    QCommandLineOption noPinOption("no-pin", "Do not pin the --sync port threads to CPU cores.");
+    QCommandLineOption saveBaselineOption("save-baseline", "Save --probe's RTT distribution to <file>.", "file");
+    QCommandLineOption baselineOption("baseline", "Compare --probe's RTT distribution against the one in <file>.",
+                                      "file");
+    QCommandLineOption labelOption("label", "Label stored with --save-baseline, e.g. the commit.", "text");
+    QCommandLineOption thresholdOption("threshold", "Median slowdown against --baseline flagged as a regression.",
+                                       "percent", "5");
+    QCommandLineOption alphaOption("alpha", "Significance level of the --baseline Mann-Whitney U test.", "p", "0.01");
+    QCommandLineOption bridgeOption("bridge", "Serve the serial <port> to remote clients over TCP.", "port");
+    QCommandLineOption listenOption("listen", "TCP port --bridge listens on.", "port",
+                                    QString::number(SerialBridgeServer::DEFAULT_PORT));
+    QCommandLineOption bindOption("bind", "Address --bridge listens on (127.0.0.1 by default; 0.0.0.0 for all).",
+                                  "address");
+    QCommandLineOption profileOption("profile", "Load VMC model profiles from <file>.", "file");
+    QCommandLineOption profileNameOption("profile-name", "Profile in --profile to use instead of its active one.", "name");
+    QCommandLineOption logDirOption("log-dir", "Write a rotating log to <dir>.", "dir");
+    QCommandLineOption stallOption("stall-ms", "Report event loop stalls longer than <ms>, with stacks.", "ms");
+    QCommandLineOption memoryReportOption("memory-report", "Print memory use against each subsystem budget at the end.");
+    parser.addOptions({profileOption, profileNameOption, logDirOption, stallOption, memoryReportOption});
+    parser.addOptions({campaignOption, simulateOption, hoursOption, intervalOption,
+                       seedOption, transcriptOption, captureOption, faultEveryOption, faultsOption, recoverOption,
+                       metricsPortOption, traceOption,
+                       loadOption, ratesOption, stepOption, arrivalOption, burstOption, loadKeysOption, curveOption,
+                       discoverOption, baudsOption, deadlineOption,
+                       probeOption, transactionsOption, probeTimeoutOption,
+                       saveBaselineOption, baselineOption, labelOption, thresholdOption, alphaOption,
+                       tuneRateOption, minIntervalOption, simKeyOption,
+                       syncOption, syncEventsOption, syncIntervalOption, syncKeysOption, syncCsvOption, noPinOption,
+                       bridgeOption, listenOption, bindOption});
+    parser.process(app);
+    MemoryBudget::loadSettings();
+
+    if (parser.isSet(logDirOption)) {
+        LogSink::Options logOptions;
+        QString logError;
+        logOptions.directory = parser.value(logDirOption);
+        if (!LogSink::start(logOptions, &logError)) {
+            QTextStream(stdout) << logError << Qt::endl;
+            return 2;
+        }
+        LogSink::installMessageHandler();
+    }
+
+    if (parser.isSet(stallOption)) {
+        StallWatchdog::start(parser.value(stallOption).toInt());
+        StallWatchdog::watchCurrentThread("main");
+    }
+
+    MetricsServer metricsServer;
+    if (parser.isSet(metricsPortOption)) {
+        QString metricsError;
+        if (!metricsServer.start(static_cast<quint16>(parser.value(metricsPortOption).toUInt()), &metricsError)) {
+            QTextStream(stdout) << metricsError << Qt::endl;
+            return 2;
+        }
+    }
+
+    if (parser.isSet(profileOption)) {
+        QString profileError;
+        std::shared_ptr<const VmcProfile> profile = VmcProfile::loadFile(parser.value(profileOption),
+                                                                         parser.value(profileNameOption),
+                                                                         &profileError);
+        if (!profile) {
+            QTextStream(stdout) << profileError << Qt::endl;
+            return 2;
+        }
+        VmcProfile::setCurrent(profile);
+    }
+
+    // Seeded like the run itself unless the spec names its own seed
+    FaultInjectingDevice::Config faults;
+    faults.seed = parser.value(seedOption).toUInt();
+    QString faultsError;
+    if (!FaultInjectingDevice::parseSpec(parser.value(faultsOption), &faults, &faultsError)) {
+        QTextStream(stdout) << faultsError << Qt::endl;
+        return 2;
+    }
+
+    Tracer::setEnabled(parser.isSet(traceOption));
+    int result = 2;
+    if (parser.isSet(campaignOption)) {
+        result = CampaignRunner::runFromFile(parser.value(campaignOption));
+    } else if (parser.isSet(discoverOption)) {
+        QList<qint32> baudRates;
+        if (!VmcDiscovery::parseBaudRates(parser.value(baudsOption), &baudRates)) {
+            QTextStream(stdout) << "Discover: invalid --bauds " << parser.value(baudsOption) << Qt::endl;
+            return 2;
+        }
+        result = VmcDiscovery::run(baudRates, qMax(1, parser.value(deadlineOption).toInt()));
+    } else if (parser.isSet(bridgeOption)) {
+        result = SerialBridgeServer::run(parser.value(bridgeOption), parser.value(bindOption),
+                                         static_cast<quint16>(parser.value(listenOption).toUInt()));
+    } else if (parser.isSet(probeOption)) {
+        LinkProbe::Options options;
+        options.portName = parser.value(probeOption);
+        options.config = SerialCommunication::configForPort(options.portName);
+        options.transactions = qMax(2, parser.value(transactionsOption).toInt());
+        options.timeoutMs = qMax(1, parser.value(probeTimeoutOption).toInt());
+        options.saveBaselinePath = parser.value(saveBaselineOption);
+        options.baselinePath = parser.value(baselineOption);
+        options.label = parser.value(labelOption);
+        options.compare.thresholdPercent = parser.value(thresholdOption).toDouble();
+        options.compare.alpha = parser.value(alphaOption).toDouble();
+        result = LinkProbe::run(options);
+    } else if (parser.isSet(tuneRateOption)) {
+        KeyRateTuner::Options options;
+        options.port = parser.value(tuneRateOption);
+        options.minIntervalMs = qMax(1, parser.value(minIntervalOption).toInt());
+        options.simulatedKeyIntervalMs = qMax(0, parser.value(simKeyOption).toInt());
+        options.seed = parser.value(seedOption).toUInt();
+        result = KeyRateTuner::run(options);
+    } else if (parser.isSet(syncOption)) {
+        SyncInjector::Options options;
+        QString scriptError;
+        if (!SyncInjector::parsePorts(parser.value(syncOption), &options.ports)) {
+            QTextStream(stdout) << "Sync: --sync needs two or more distinct ports, got " << parser.value(syncOption)
+                                << Qt::endl;
+            return 2;
+        }
+        if (!CampaignRunner::parseScript(parser.value(syncKeysOption), &options.keys, &scriptError)) {
+            QTextStream(stdout) << "Sync: " << scriptError << Qt::endl;
+            return 2;
+        }
+        options.events = qMax(1, parser.value(syncEventsOption).toInt());
+        options.intervalMs = qMax(0, parser.value(syncIntervalOption).toInt());
+        options.pinThreads = !parser.isSet(noPinOption);
+        options.csvPath = parser.value(syncCsvOption);
+        result = SyncInjector::run(options);
+    } else if (parser.isSet(loadOption)) {
+        LoadGenerator::Options options;
+        QString scriptError;
+        options.port = parser.value(loadOption);
+        if (!CampaignRunner::parseScript(parser.value(loadKeysOption), &options.keys, &scriptError)) {
+            QTextStream(stdout) << "Load: " << scriptError << Qt::endl;
+            return 2;
+        }
+        if (!LoadGenerator::parseRates(parser.value(ratesOption), &options.rates)) {
+            QTextStream(stdout) << "Load: invalid --rates " << parser.value(ratesOption) << "; each must be above 0 and at most "
+                                << LoadGenerator::MAX_RATE_PER_SECOND << " per second" << Qt::endl;
+            return 2;
+        }
+        if (!LoadGenerator::parseArrival(parser.value(arrivalOption), &options.arrival)) {
+            QTextStream(stdout) << "Load: unknown arrival schedule " << parser.value(arrivalOption) << Qt::endl;
+            return 2;
+        }
+        options.stepSeconds = qMax(1, parser.value(stepOption).toInt());
+        options.burstSize = qMax(1, parser.value(burstOption).toInt());
+        options.seed = parser.value(seedOption).toUInt();
+        options.curvePath = parser.value(curveOption);
+        options.faults = faults;
+        result = LoadGenerator::run(options);
+    } else {
+        SimulationRunner::Options options;
+        QString scriptError;
+        if (!CampaignRunner::parseScript(parser.value(simulateOption), &options.keys, &scriptError)) {
+            QTextStream(stdout) << "Simulation: " << scriptError << Qt::endl;
+            return 2;
+        }
+        options.durationHours = parser.value(hoursOption).toDouble();
+        options.intervalMs = parser.value(intervalOption).toInt();
+        options.seed = parser.value(seedOption).toUInt();
+        options.transcriptPath = parser.value(transcriptOption);
+        options.capturePath = parser.value(captureOption);
+        options.faultEveryFrames = qMax(0, parser.value(faultEveryOption).toInt());
+        options.autoRecover = parser.isSet(recoverOption);
+        options.faults = faults;
+        result = SimulationRunner::run(options);
+    }
+
+    if (parser.isSet(traceOption)) {
+        QString traceError;
+        if (!Tracer::exportChromeJson(parser.value(traceOption), &traceError)) {
+            QTextStream(stdout) << traceError << Qt::endl;
+        }
+    }
+    if (StallWatchdog::isRunning()) {
+        StallWatchdog::unwatchCurrentThread();
+        StallWatchdog::stop();
+        for (const QString &line : StallWatchdog::report()) {
+            QTextStream(stdout) << line << Qt::endl;
+        }
+    }
+    if (parser.isSet(memoryReportOption)) {
+        for (const QString &line : MemoryBudget::report()) {
+            QTextStream(stdout) << line << Qt::endl;
+        }
+    }
+    LogSink::stop();
+    return result;
+}
+
 int main(int argc, char *argv[]) {
+    if (isHeadless(argc, argv)) {
+        return runHeadless(argc, argv);
+    }
+
     #ifdef Q_OS_WIN
     // Hide console window
     ShowWindow(GetConsoleWindow(), SW_HIDE);
     #endif
-    
+
     QApplication app(argc, argv);
-    
-    MainWindow mainWindow;
-    mainWindow.show();
-    
-    return app.exec();
-}
 
+    MemoryBudget::loadSettings();
 
+    // MainWindow installs its own message handler, which also feeds the sink
+    QSettings settings("YourCompany", "asdKeypad");
+    if (settings.value("LogToDisk", true).toBool()) {
+        LogSink::Options logOptions;
+        QString logError;
+        logOptions.directory = settings.value("LogDirectory",
+            QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/logs").toString();
+        if (!LogSink::start(logOptions, &logError)) {
+            qWarning() << logError;
+        }
+    }
 
+    int result;
+    {
+        MainWindow mainWindow;
+        mainWindow.show();
+
+        // Started last so building the window is not taken for a stall
+        const int stallMs = settings.value("StallThresholdMs", StallWatchdog::DEFAULT_THRESHOLD_MS).toInt();
+        if (stallMs > 0) {
+            StallWatchdog::start(stallMs);
+            StallWatchdog::watchCurrentThread("GUI");
+        }
+        result = app.exec();
+        StallWatchdog::unwatchCurrentThread();
+        StallWatchdog::stop();
+    }
+    LogSink::stop();
+    return result;
+}
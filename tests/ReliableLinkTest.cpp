@@ -0,0 +1,108 @@
+#include "ReliableLink.h"
+#include "VirtualClock.h"
+#include "VmcProtocol.h"
+#include <QtTest>
+
+// ReliableLink on a virtual clock, with every transmitted frame treated as
+// written at once and echoes handed in by the test.
+class ReliableLinkTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void leftoverShadowDoesNotEatNextIdenticalEcho();
+    void staleEchoIsCountedAsDuplicate();
+
+private:
+    VirtualClock *m_clock = nullptr;
+    ReliableLink *m_link = nullptr;
+    int m_transmissions = 0;
+    int m_delivered = 0;
+    int m_failed = 0;
+
+    void echo(const QByteArray &frame);
+    void runFor(qint64 ms);
+};
+
+void ReliableLinkTest::init()
+{
+    m_clock = new VirtualClock;
+    VirtualClock::setActive(m_clock);
+    m_link = new ReliableLink;
+    m_transmissions = 0;
+    m_delivered = 0;
+    m_failed = 0;
+
+    connect(m_link, &ReliableLink::transmit, this, [this](const QByteArray &frame) {
+        m_transmissions++;
+        m_link->handleDispatched(frame);
+    });
+    connect(m_link, &ReliableLink::delivered, this, [this]() { m_delivered++; });
+    connect(m_link, &ReliableLink::failed, this, [this]() { m_failed++; });
+}
+
+void ReliableLinkTest::cleanup()
+{
+    delete m_link;
+    m_link = nullptr;
+    VirtualClock::setActive(nullptr);
+    delete m_clock;
+    m_clock = nullptr;
+}
+
+void ReliableLinkTest::echo(const QByteArray &frame)
+{
+    VmcFrameDecoder decoder;
+    const QVector<VmcFrame> frames = decoder.feed(frame);
+    QCOMPARE(frames.size(), 1);
+    m_link->handleFrame(frames.first());
+}
+
+void ReliableLinkTest::runFor(qint64 ms)
+{
+    const qint64 deadlineNs = m_clock->nowNs() + ms * 1000000;
+    m_clock->runUntil(deadlineNs);
+}
+
+void ReliableLinkTest::leftoverShadowDoesNotEatNextIdenticalEcho()
+{
+    const QByteArray key = VmcProtocol::encodeFrame(0x00, 0x03, 0x0C);
+
+    // First copy lost: one retransmission, then the only echo there will be
+    QVERIFY(m_link->submit(key, TxPriority::Operator));
+    runFor(RttEstimator::INITIAL_RTO_MS + 1);
+    QCOMPARE(m_transmissions, 2);
+    echo(key);
+    QCOMPARE(m_delivered, 1);
+
+    // The same key again, well within the RTO the shadow would live for
+    QVERIFY(m_link->submit(key, TxPriority::Operator));
+    QCOMPARE(m_transmissions, 3);
+    echo(key);
+    QCOMPARE(m_delivered, 2);
+
+    runFor(RttEstimator::MAX_RTO_MS * 2);
+    QCOMPARE(m_transmissions, 3);
+    QCOMPARE(m_failed, 0);
+    QCOMPARE(m_link->retransmissions(), quint64(1));
+}
+
+void ReliableLinkTest::staleEchoIsCountedAsDuplicate()
+{
+    const QByteArray key = VmcProtocol::encodeFrame(0x00, 0x03, 0x0C);
+
+    // Both copies answered: the second echo belongs to nothing in flight
+    QVERIFY(m_link->submit(key, TxPriority::Operator));
+    runFor(RttEstimator::INITIAL_RTO_MS + 1);
+    echo(key);
+    echo(key);
+
+    QCOMPARE(m_delivered, 1);
+    QCOMPARE(m_link->duplicateAcks(), quint64(1));
+    QCOMPARE(m_link->pendingCount(), 0);
+}
+
+QTEST_GUILESS_MAIN(ReliableLinkTest)
+#include "ReliableLinkTest.moc"
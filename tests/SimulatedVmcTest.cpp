@@ -0,0 +1,96 @@
+#include "SimulatedVmc.h"
+#include "VirtualClock.h"
+#include "VmcProfile.h"
+#include "VmcProtocol.h"
+#include <QJsonObject>
+#include <QtTest>
+
+namespace {
+
+const QByteArray REQUEST("PING");
+const QByteArray RESPONSE("PONG");
+
+}
+
+// SimulatedVmc and keepalive acks under a VMC profile whose keepalive
+// signatures differ from the built-in model's.
+class SimulatedVmcTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void answersProfileKeepalive();
+    void ignoresBuiltInKeepalive();
+    void keepaliveAckUsesProfileRequest();
+
+private:
+    VirtualClock *m_clock = nullptr;
+    SimulatedVmc *m_vmc = nullptr;
+
+    QByteArray exchange(const QByteArray &request);
+};
+
+void SimulatedVmcTest::init()
+{
+    const QJsonObject definition{
+        {"name", "alternate keepalive"},
+        {"keepalive", QJsonObject{{"request", QString::fromLatin1(REQUEST)},
+                                  {"response", QString::fromLatin1(RESPONSE)}}}
+    };
+    QString error;
+    const std::shared_ptr<const VmcProfile> profile = VmcProfile::compile(definition, &error);
+    QVERIFY2(profile != nullptr, qPrintable(error));
+    VmcProfile::setCurrent(profile);
+
+    m_clock = new VirtualClock;
+    VirtualClock::setActive(m_clock);
+    m_vmc = new SimulatedVmc(m_clock, SimulatedVmc::Config());
+    m_vmc->open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+}
+
+void SimulatedVmcTest::cleanup()
+{
+    delete m_vmc;
+    m_vmc = nullptr;
+    VirtualClock::setActive(nullptr);
+    delete m_clock;
+    m_clock = nullptr;
+    VmcProfile::setCurrent(VmcProfile::builtIn());
+}
+
+QByteArray SimulatedVmcTest::exchange(const QByteArray &request)
+{
+    m_vmc->write(request);
+    // Far longer than the line time plus the slowest simulated response
+    m_clock->runUntil(m_clock->nowNs() + Q_INT64_C(1000) * 1000000);
+    return m_vmc->readAll();
+}
+
+void SimulatedVmcTest::answersProfileKeepalive()
+{
+    QCOMPARE(exchange(REQUEST), RESPONSE);
+    QCOMPARE(m_vmc->keepalivesAnswered(), quint64(1));
+}
+
+void SimulatedVmcTest::ignoresBuiltInKeepalive()
+{
+    // The built-in request is line noise to this model
+    QCOMPARE(exchange(QByteArray(VmcProtocol::KEEPALIVE_REQUEST)), QByteArray());
+    QCOMPARE(m_vmc->keepalivesAnswered(), quint64(0));
+}
+
+void SimulatedVmcTest::keepaliveAckUsesProfileRequest()
+{
+    VmcFrameDecoder decoder;
+    decoder.setKeepaliveResponse(VmcProfile::current()->keepaliveResponse());
+    const QVector<VmcFrame> frames = decoder.feed(exchange(REQUEST));
+    QCOMPARE(frames.size(), 1);
+    QVERIFY(frames.first().isKeepaliveResponse);
+    QVERIFY(frames.first().acknowledges(REQUEST));
+    QVERIFY(!frames.first().acknowledges(QByteArray(VmcProtocol::KEEPALIVE_REQUEST)));
+}
+
+QTEST_GUILESS_MAIN(SimulatedVmcTest)
+#include "SimulatedVmcTest.moc"
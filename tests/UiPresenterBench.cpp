@@ -0,0 +1,106 @@
+#include "UiPresenter.h"
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QLineEdit>
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QTextEdit>
+#include <QtTest>
+
+// Drives UiPresenter the way automation does at high key rates: keys, log
+// lines and status updates arriving faster than the screen refreshes.
+class UiPresenterBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void stressAtThousandsOfEventsPerSecond();
+    void flushOneFrame();
+
+private:
+    static const int EVENTS_PER_SECOND = 3000;
+    static const int RUN_MS = 2000;
+    // One frame interval, plus room for a loaded CI machine to be late
+    static const int MAX_UPDATE_LATENCY_MS = 1000 / UiPresenter::FRAME_RATE_HZ + 100;
+};
+
+void UiPresenterBench::stressAtThousandsOfEventsPerSecond()
+{
+    QLineEdit display;
+    QTextEdit console;
+    UiPresenter presenter(&display, &console);
+
+    QElapsedTimer clock;
+    qint64 pendingSinceMs = -1;   // When the oldest unapplied status update was scheduled
+    qint64 maxLatencyMs = 0;
+    int statusApplied = 0;
+    int issued = 0;
+
+    clock.start();
+    while (clock.elapsed() < RUN_MS) {
+        // Catch up to the target rate, then let the event loop run the frame timer
+        const int due = static_cast<int>(clock.elapsed() * EVENTS_PER_SECOND / 1000);
+        for (; issued < due; ++issued) {
+            presenter.appendDisplay(QString::number(issued % 10));
+            presenter.appendLog(QString("event %1").arg(issued));
+            if (pendingSinceMs < 0) {
+                pendingSinceMs = clock.elapsed();
+            }
+            presenter.schedule("status", [&]() {
+                maxLatencyMs = qMax(maxLatencyMs, clock.elapsed() - pendingSinceMs);
+                pendingSinceMs = -1;
+                statusApplied++;
+            });
+            if (issued % 100 == 99) {
+                presenter.clearDisplay();
+            }
+        }
+        QCoreApplication::processEvents();
+    }
+    const qint64 elapsedMs = clock.elapsed();
+    presenter.flush();
+
+    qInfo() << issued << "events in" << elapsedMs << "ms," << presenter.framesApplied()
+            << "frames, worst update latency" << maxLatencyMs << "ms";
+
+    // The load really was 1k+ events per second
+    QVERIFY(issued * 1000 / elapsedMs >= 1000);
+
+    // Coalesced to the frame rate, yet every frame still got through
+    const qint64 maxFrames = elapsedMs * UiPresenter::FRAME_RATE_HZ / 1000 + 2;
+    QVERIFY2(static_cast<qint64>(presenter.framesApplied()) <= maxFrames,
+             qPrintable(QString("%1 frames for %2 ms").arg(presenter.framesApplied()).arg(elapsedMs)));
+    QVERIFY(statusApplied > 0);
+    QVERIFY2(maxLatencyMs <= MAX_UPDATE_LATENCY_MS,
+             qPrintable(QString("update waited %1 ms").arg(maxLatencyMs)));
+
+    // The console stays capped and ends with the newest line
+    QVERIFY(issued > UiPresenter::MAX_CONSOLE_LINES);
+    QVERIFY(console.document()->blockCount() <= UiPresenter::MAX_CONSOLE_LINES);
+    QCOMPARE(console.document()->lastBlock().text(), QString("event %1").arg(issued - 1));
+    QCOMPARE(display.text(), presenter.displayText());
+}
+
+void UiPresenterBench::flushOneFrame()
+{
+    QLineEdit display;
+    QTextEdit console;
+    UiPresenter presenter(&display, &console);
+
+    // A frame's worth of events at EVENTS_PER_SECOND, applied in one go
+    const int perFrame = EVENTS_PER_SECOND / UiPresenter::FRAME_RATE_HZ;
+    int frame = 0;
+    QBENCHMARK {
+        for (int i = 0; i < perFrame; ++i) {
+            presenter.appendDisplay(QString::number(i % 10));
+            presenter.appendLog(QString("frame %1 event %2").arg(frame).arg(i));
+            presenter.schedule("status", []() {});
+        }
+        presenter.flush();
+        frame++;
+    }
+    QVERIFY(console.document()->blockCount() <= UiPresenter::MAX_CONSOLE_LINES);
+}
+
+QTEST_MAIN(UiPresenterBench)
+#include "UiPresenterBench.moc"